@@ -34,14 +34,25 @@
 //
 #define CONF_TIME                       //!< system time
 #define CONF_MM                         //!< memory management
+// #define CONF_MM_SEGREGATED             //!< O(1) segregated free-list allocator
+// #define CONF_MM_POOL                   //!< fixed-size pools for task data
 #define CONF_TM                         //!< task management
+// #define CONF_TM_READYQ                 //!< ready queues, event driven wakeups
+// #define CONF_TM_WHEEL                  //!< timer wheel for sleep & timeout deadlines
+// #define CONF_TM_TICKLESS               //!< stop the system tick while idle
+// #define CONF_TM_INHERIT                //!< priority inheritance for locks
 #define CONF_AUTOSHUTOFF                //!< power down after x min of inactivity
 //#define CONF_TM_DEBUG                   //!< view key shows current instruction pointer
 #define CONF_SETJMP			//!< non local goto
 #define CONF_ATOMIC                     //!< atomic counters
 #define CONF_SEMAPHORES                 //!< POSIX semaphores
 #define CONF_CRITICAL_SECTIONS          //!< Critical Section support
+// #define CONF_MUTEX                     //!< mutexes
 #define CONF_PROGRAM                    //!< dynamic program loading support
+// #define CONF_PROGRAM_LZSS              //!< LZSS compressed program download
+// #define CONF_PROGRAM_MULTICAST         //!< one download to a group of bricks
+// #define CONF_PROFILE                   //!< PC sampling profiler, read over LNP
+// #define CONF_TRACE                     //!< kernel event trace, read over LNP
 #define CONF_VIS                        //!< generic visualization.
 //#define CONF_ROM_MEMCPY                 //!< Use the ROM memcpy routine
 
@@ -49,6 +60,10 @@
 //
 #define CONF_LNP                        //!< link networking protocol
 // #define CONF_LNP_FAST                  //!< enable 4800 bps LNP
+// #define CONF_LNP_ASYNC                 //!< queued LNP transmit, callbacks
+// #define CONF_LNP_PORTQ 4               //!< port receive rings, packets deep
+// #define CONF_LNP_TRANSPORT             //!< reliable sliding window transport
+// #define CONF_LNP_BROADCAST             //!< also receive at LNP_BROADCAST
 // Can override with compile-time option
 #if !defined(CONF_LNP_HOSTADDR)
 #define CONF_LNP_HOSTADDR 0             //!< LNP host address
@@ -98,6 +113,34 @@
 #error "Task management needs memory management."
 #endif
 
+#if defined(CONF_MM_SEGREGATED) && !defined(CONF_MM)
+#error "Segregated allocator needs memory management."
+#endif
+
+#if defined(CONF_MM_POOL) && !defined(CONF_MM)
+#error "Object pools need memory management."
+#endif
+
+#if defined(CONF_TM_READYQ) && !defined(CONF_TM)
+#error "Ready queues need task management."
+#endif
+
+#if defined(CONF_TM_WHEEL) && !defined(CONF_TM_READYQ)
+#error "Timer wheel needs ready queues."
+#endif
+
+#if defined(CONF_TM_TICKLESS) && !defined(CONF_TM_WHEEL)
+#error "Tickless idle needs the timer wheel."
+#endif
+
+#if defined(CONF_TM_INHERIT) && !defined(CONF_TM_READYQ)
+#error "Priority inheritance needs ready queues."
+#endif
+
+#if defined(CONF_MUTEX) && !defined(CONF_TM)
+#error "Mutexes need task management."
+#endif
+
 #if defined(CONF_TM) && !defined(CONF_ATOMIC)
 #error "Task management needs atomic counters for kernel lock"
 #endif
@@ -106,6 +149,22 @@
 #error "Tasksafe networking needs semaphores."
 #endif
 
+#if defined(CONF_LNP_ASYNC) && (!defined(CONF_LNP) || !defined(CONF_TM))
+#error "Queued transmit needs networking and task management."
+#endif
+
+#if defined(CONF_LNP_PORTQ) && (!defined(CONF_LNP) || !defined(CONF_TM))
+#error "Port receive rings need networking and task management."
+#endif
+
+#if defined(CONF_LNP_TRANSPORT) && (!defined(CONF_LNP) || !defined(CONF_TM))
+#error "Reliable transport needs networking and task management."
+#endif
+
+#if defined(CONF_LNP_BROADCAST) && !defined(CONF_LNP)
+#error "Broadcast addressing needs networking."
+#endif
+
 #if defined(CONF_SEMAPHORES) && !defined(CONF_ATOMIC)
 #error "Semphores need atomic counters"
 #endif
@@ -134,6 +193,22 @@
 #error "Program support needs task management, networking, key debouncing, and ASCII."
 #endif
 
+#if defined(CONF_PROGRAM_LZSS) && !defined(CONF_PROGRAM)
+#error "Compressed download needs program support."
+#endif
+
+#if defined(CONF_PROGRAM_MULTICAST) && (!defined(CONF_PROGRAM) || !defined(CONF_LNP_BROADCAST))
+#error "Multicast download needs program support and broadcast addressing."
+#endif
+
+#if defined(CONF_PROFILE) && !defined(CONF_PROGRAM)
+#error "Profiling needs program support."
+#endif
+
+#if defined(CONF_TRACE) && !defined(CONF_PROGRAM)
+#error "Tracing needs program support."
+#endif
+
 #if defined(CONF_DSENSOR_ROTATION) && !defined(CONF_DSENSOR)
 #error "Rotation sensor needs general sensor code."
 #endif
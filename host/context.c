@@ -0,0 +1,128 @@
+/*! \file   context.c
+    \brief  Implementation: task contexts for the host build
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  A task's sp_save points to a host_context_t at the bottom of its
+ *  stack area; the rest of the area is the task's stack. The single
+ *  tasking context lives here and uses the process stack.
+ */
+
+#include <signal.h>
+#include <stddef.h>
+#include <ucontext.h>
+
+#include "host.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! a task context
+typedef struct {
+  ucontext_t uc;                        //!< saved registers and signal mask
+  int (*code_start)(int,char**);        //!< entry point
+  int argc;                             //!< first entry argument
+  char **argv;                          //!< second entry argument
+  void (*redirect)(int);                //!< continue here if set
+  size_t stack_size;                    //!< bytes following this struct
+} host_context_t;
+
+//! task exit from kernel/tm.c (exit is mapped in unistd.h)
+extern void tm_exit(int code) __attribute__ ((noreturn));
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Internal Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static host_context_t single;           //!< the single tasking context
+static host_context_t *current;         //!< the context being resumed
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! first code a new or redirected context runs
+static void context_start(void) {
+  host_context_t *ctx=current;
+
+  if(ctx->redirect)
+    ctx->redirect(-1);
+  tm_exit(ctx->code_start(ctx->argc,ctx->argv));
+}
+
+//! (re)start a context at context_start() on an empty stack
+static void context_make(host_context_t *ctx) {
+  getcontext(&ctx->uc);
+  ctx->uc.uc_stack.ss_sp=ctx+1;
+  ctx->uc.uc_stack.ss_size=ctx->stack_size;
+  ctx->uc.uc_link=NULL;
+  sigemptyset(&ctx->uc.uc_sigmask);     // tasks start with IRQs enabled
+  makecontext(&ctx->uc,context_start,0);
+}
+
+size_t *tm_host_context(size_t *stack,size_t stack_size,
+                        int (*code_start)(int,char**),int argc,char **argv) {
+  host_context_t *ctx;
+  size_t pad;
+
+  if(stack==NULL)
+    return (size_t*) &single;
+
+  pad=(16-((size_t) stack & 15)) & 15;  // ucontext_t wants 16 bytes
+  ctx=(host_context_t*) ((char*) stack+pad);
+  stack_size-=pad;
+
+  ctx->code_start=code_start;
+  ctx->argc=argc;
+  ctx->argv=argv;
+  ctx->redirect=NULL;
+  ctx->stack_size=(stack_size-sizeof(host_context_t)) & ~(size_t) 15;
+  context_make(ctx);
+
+  return (size_t*) ctx;
+}
+
+void tm_host_switch(size_t *old_sp,size_t *new_sp) {
+  host_context_t *old=(host_context_t*) old_sp;
+
+  current=(host_context_t*) new_sp;
+  if(old)
+    swapcontext(&old->uc,&current->uc);
+  else
+    setcontext(&current->uc);           // zombie, never resumed
+}
+
+void tm_host_redirect(size_t *sp,void (*func)(int)) {
+  host_context_t *ctx=(host_context_t*) sp;
+
+  if(ctx==&single)
+    return;                             // single tasking never exits
+  ctx->redirect=func;
+  context_make(ctx);
+}
+
+void tm_host_idle(void) {
+  sigset_t none;
+
+  sigemptyset(&none);
+  sigsuspend(&none);                    // wait for the next tick
+}
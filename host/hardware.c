@@ -0,0 +1,304 @@
+/*! \file   hardware.c
+    \brief  Implementation: simulated RCX hardware for the host build
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The kernel runs unchanged on top of this file: on-chip registers
+ *  are plain variables, interrupts are a 1 ms SIGALRM tick that calls
+ *  the handlers through the usual vectors, and IRQ masking blocks
+ *  that signal. The serial port moves one byte per tick between
+ *  host_ir_in / host_ir_out and the kernel, echoing transmitted bytes
+ *  like the real IR receiver does. It reads host_ir_in only as far as
+ *  the receive fifo has room, so a fast sender waits in its pipe or
+ *  pty instead of losing bytes.
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "../include/sys/h8.h"
+#include "../include/rom/registers.h"
+#include "../include/lnp/sys/irq.h"
+
+#include "host.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// 16 bit timer
+//
+unsigned char T_IER;
+volatile unsigned char T_CSR;
+volatile unsigned T_CNT;
+unsigned T_OCRA;
+unsigned T_OCRB;
+unsigned char T_CR;
+unsigned char T_OCR;
+volatile unsigned T_ICRA;
+volatile unsigned T_ICRB;
+volatile unsigned T_ICRC;
+volatile unsigned T_ICRD;
+
+// 8 bit timers
+//
+unsigned char STCR;
+unsigned char T0_CR;
+volatile unsigned char T0_CSR;
+unsigned char T0_CORA;
+unsigned char T0_CORB;
+volatile unsigned char T0_CNT;
+unsigned char T1_CR;
+volatile unsigned char T1_CSR;
+unsigned char T1_CORA;
+unsigned char T1_CORB;
+volatile unsigned char T1_CNT;
+
+// serial port
+//
+volatile unsigned char S_RDR;
+unsigned char S_TDR;
+unsigned char S_MR;
+unsigned char S_CR;
+volatile unsigned char S_SR;
+unsigned char S_BRR;
+unsigned char S_TCR;
+
+// A/D converter, inputs open
+//
+volatile unsigned ad_data[4]={0xffc0,0xffc0,0xffc0,0xffc0};
+volatile unsigned char AD_CSR;
+unsigned char AD_CR;
+
+// ports, keys released (active low)
+//
+unsigned char SYSCR;
+unsigned char PORT1_PCR,PORT2_PCR,PORT3_PCR;
+unsigned char PORT1_DDR,PORT2_DDR,PORT3_DDR,PORT4_DDR,PORT5_DDR,PORT6_DDR;
+volatile unsigned char PORT1=0xff,PORT2=0xff,PORT3=0xff,PORT4=0xff;
+volatile unsigned char PORT5=0xff,PORT6=0xff,PORT7=0xff;
+
+// watchdog
+//
+volatile unsigned int WDT_CSR;
+volatile unsigned char WDT_CNT;
+
+// ROM shadows and memory mapped devices
+//
+unsigned char rom_port1_ddr,rom_port2_ddr,rom_port3_ddr,rom_port4_ddr;
+unsigned char rom_port5_ddr,rom_port6_ddr,rom_port7_pin;
+
+unsigned char motor_controller;         //!< motor controller port
+unsigned char display_memory[16];       //!< 0xef43..0xef4b
+unsigned char bit_carry;                //!< carry flag of sys/bitops.h
+
+// interrupt vectors
+//
+void *reset_vector,*nmi_vector,*irq0_vector,*irq1_vector,*irq2_vector;
+void *icia_vector,*icib_vector,*icic_vector,*icid_vector;
+void *ocia_vector,*ocib_vector,*fovi_vector;
+void *cmi0a_vector,*cmi0b_vector,*ovi0_vector;
+void *cmi1a_vector,*cmi1b_vector,*ovi1_vector;
+void *eri_vector,*rxi_vector,*txi_vector,*tei_vector;
+void *ad_vector,*wovf_vector;
+
+void *rom_reset_vector;
+
+int host_ir_in=-1;                      //!< IR receive descriptor
+int host_ir_out=-1;                     //!< IR transmit descriptor
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Internal Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static sigset_t irq_set;                //!< the interrupt signal
+
+static unsigned char rx_fifo[256];      //!< bytes in the air
+static unsigned char rx_head,rx_tail;   //!< rx_fifo get / put positions
+
+static int tx_busy;                     //!< shift register loaded
+static unsigned char tx_shift;          //!< shift register
+static unsigned char tx_enabled;        //!< last SCR_TRANSMIT state
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! the ROM's empty handler
+void rom_dummy_handler(void) {
+}
+
+//! call an interrupt handler through its vector
+static void irq_call(void *vector) {
+  ((void (*)(void)) vector)();
+}
+
+void disable_irqs(void) {
+  sigprocmask(SIG_BLOCK,&irq_set,NULL);
+}
+
+void enable_irqs(void) {
+  sigprocmask(SIG_UNBLOCK,&irq_set,NULL);
+}
+
+unsigned char irq_save(void) {
+  sigset_t old;
+
+  sigprocmask(SIG_BLOCK,&irq_set,&old);
+  return sigismember(&old,SIGALRM) ? 0x80 : 0;
+}
+
+void irq_restore(unsigned char ccr) {
+  sigprocmask((ccr & 0x80) ? SIG_BLOCK : SIG_UNBLOCK,&irq_set,NULL);
+}
+
+//! put a byte on the air
+static void rx_put(unsigned char c) {
+  if((unsigned char)(rx_tail+1)!=rx_head)
+    rx_fifo[rx_tail++]=c;
+}
+
+//! free places in rx_fifo
+static unsigned rx_room(void) {
+  return (unsigned char)(rx_head-rx_tail-1);
+}
+
+//! step the serial port by one byte time
+/*! one place in rx_fifo stays free for the echo of our own byte.
+*/
+static void serial_step(void) {
+  unsigned char buf[16];
+  ssize_t n,i;
+  unsigned room;
+
+  room=rx_room();
+  if(host_ir_in>=0 && room>1) {
+    if(room-1<sizeof(buf))
+      n=read(host_ir_in,buf,room-1);
+    else
+      n=read(host_ir_in,buf,sizeof(buf));
+    for(i=0; i<n; i++)
+      rx_put(buf[i]);
+  }
+
+  // transmitter: TDR -> shift register -> air
+  //
+  if(tx_busy) {
+    tx_busy=0;
+    rx_put(tx_shift);                   // we hear ourselves
+    if(host_ir_out>=0)
+      n=write(host_ir_out,&tx_shift,1);
+  }
+  if(S_CR & SCR_TRANSMIT) {
+    if(!tx_enabled)
+      S_SR|=SSR_TRANS_EMPTY;
+    else if(!(S_SR & SSR_TRANS_EMPTY)) {
+      tx_shift=S_TDR;
+      tx_busy=1;
+      S_SR|=SSR_TRANS_EMPTY;
+    } else
+      S_SR|=SSR_TRANS_END;
+  }
+  tx_enabled=S_CR & SCR_TRANSMIT;
+
+  if((S_CR & SCR_TX_IRQ) && (S_SR & SSR_TRANS_EMPTY))
+    irq_call(txi_vector);
+  if((S_CR & SCR_TE_IRQ) && (S_SR & SSR_TRANS_END))
+    irq_call(tei_vector);
+
+  // receiver
+  //
+  if((S_CR & SCR_RECEIVE) && !(S_SR & SSR_RECV_FULL) && rx_head!=rx_tail) {
+    S_RDR=rx_fifo[rx_head++];
+    S_SR|=SSR_RECV_FULL;
+    if(S_CR & SCR_RX_IRQ)
+      irq_call(rxi_vector);
+  }
+}
+
+//! the 1 ms interrupt tick
+/*! compare A comes last, as the task switcher may leave from there.
+*/
+static void tick(int sig) {
+  if(WDT_CSR & WDT_CSR_ENABLE)
+    irq_call(nmi_vector);
+
+  if(AD_CSR & ADCSR_START) {            // conversions are instant
+    AD_CSR=(AD_CSR & ~ADCSR_START) | ADCSR_END;
+    if(AD_CSR & ADCSR_ENABLE_IRQ)
+      irq_call(ad_vector);
+  }
+
+  serial_step();
+
+  if(T_IER & TIER_ENABLE_OCB) {
+    T_CSR|=TCSR_OCB;
+    irq_call(ocib_vector);
+  }
+  if(T_IER & TIER_ENABLE_OCA) {
+    T_CSR|=TCSR_OCA;
+    irq_call(ocia_vector);
+  }
+}
+
+//! set up the vectors and start the interrupt tick
+void host_hardware_init(void) {
+  struct sigaction sa;
+  struct itimerval it;
+  static void **const vectors[]={
+    &reset_vector,&nmi_vector,&irq0_vector,&irq1_vector,&irq2_vector,
+    &icia_vector,&icib_vector,&icic_vector,&icid_vector,
+    &ocia_vector,&ocib_vector,&fovi_vector,
+    &cmi0a_vector,&cmi0b_vector,&ovi0_vector,
+    &cmi1a_vector,&cmi1b_vector,&ovi1_vector,
+    &eri_vector,&rxi_vector,&txi_vector,&tei_vector,
+    &ad_vector,&wovf_vector,&rom_reset_vector
+  };
+  unsigned i;
+
+  sigemptyset(&irq_set);
+  sigaddset(&irq_set,SIGALRM);
+
+  for(i=0; i<sizeof(vectors)/sizeof(vectors[0]); i++)
+    *vectors[i]=(void*) &rom_dummy_handler;
+
+  memset(&sa,0,sizeof(sa));
+  sa.sa_handler=tick;
+  sa.sa_flags=SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGALRM,&sa,NULL);
+
+  it.it_interval.tv_sec=0;
+  it.it_interval.tv_usec=1000;
+  it.it_value=it.it_interval;
+  setitimer(ITIMER_REAL,&it,NULL);
+}
+
+//! stop the interrupt tick
+void host_hardware_shutdown(void) {
+  struct itimerval it;
+
+  disable_irqs();
+  memset(&it,0,sizeof(it));
+  setitimer(ITIMER_REAL,&it,NULL);
+}
@@ -0,0 +1,76 @@
+/*! \file   host.h
+    \brief  Interface: running the kernel on the host
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+#ifndef __host_h__
+#define __host_h__
+
+#include <stddef.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////
+
+//! IR receive descriptor, -1 for none
+/*! read without blocking, one byte per simulated byte time.
+*/
+extern int host_ir_in;
+
+//! IR transmit descriptor, -1 for none
+/*! gets every byte the brick sends.
+*/
+extern int host_ir_out;
+
+//! user program entry, from kernel/tm.c
+extern int (*tm_host_user_entry)(int,char**);
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! boot the kernel
+/*! \param entry started by the program manager in place of downloaded
+    programs, or as the only program without CONF_PROGRAM. may be NULL.
+    never returns, powering off ends the process.
+*/
+extern void host_start(int (*entry)(int,char**)) __attribute__ ((noreturn));
+
+//! set up the vectors and start the interrupt tick
+extern void host_hardware_init(void);
+
+//! stop the interrupt tick
+extern void host_hardware_shutdown(void);
+
+//! task context hooks, see include/sys/tm.h
+extern size_t *tm_host_context(size_t *stack,size_t stack_size,
+                               int (*code_start)(int,char**),
+                               int argc,char **argv);
+extern void tm_host_switch(size_t *old_sp,size_t *new_sp);
+extern void tm_host_redirect(size_t *sp,void (*func)(int));
+extern void tm_host_idle(void);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // __host_h__
@@ -0,0 +1,31 @@
+/*! \file   main.c
+    \brief  A simulated RCX on stdin / stdout
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  IR bytes are read from stdin and sent to stdout, so the simulated
+ *  brick can be wired to a tty or socket with the usual tools.
+ */
+
+#include <unistd.h>
+
+#include "host.h"
+
+int main(int argc,char **argv) {
+  host_ir_in=STDIN_FILENO;
+  host_ir_out=STDOUT_FILENO;
+
+  host_start(NULL);
+}
@@ -0,0 +1,95 @@
+/*! \file   rom.c
+    \brief  Implementation: ROM routines and startup for the host build
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+
+//! the kernel entry, from kernel/kmain.c
+extern void kmain(void) __attribute__ ((noreturn));
+
+extern unsigned char display_memory[];
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// the display has no segment map here; only its memory is kept.
+//
+void lcd_show(int segment) {
+}
+
+void lcd_hide(int segment) {
+}
+
+void lcd_number(int i,int n,int c) {
+}
+
+void lcd_clear(void) {
+  memset(display_memory,0,9);
+}
+
+void lcd_init(void) {
+  lcd_clear();
+}
+
+void lcd_power_on(void) {
+}
+
+void lcd_power_off(void) {
+}
+
+void lcd_refresh(void) {
+}
+
+void lcd_refresh_next_byte(void) {
+}
+
+void sound_system(unsigned nr) {
+}
+
+int sound_playing(void) {
+  return 0;
+}
+
+void power_init(void) {
+}
+
+//! there is nobody to press on again.
+void power_off(void) {
+  host_hardware_shutdown();
+  exit(0);
+}
+
+//! erasing the firmware ends the process, too.
+void reset(void) {
+  host_hardware_shutdown();
+  exit(0);
+}
+
+void host_start(int (*entry)(int,char**)) {
+  tm_host_user_entry=entry;
+
+  if(host_ir_in>=0)
+    fcntl(host_ir_in,F_SETFL,fcntl(host_ir_in,F_GETFL) | O_NONBLOCK);
+
+  host_hardware_init();
+  kmain();
+}
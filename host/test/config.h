@@ -0,0 +1,30 @@
+/*! \file host/test/config.h
+  \brief  kernel configuration file for the host tests
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The host build's configuration, with the options each test is
+ *  built for given on the command line. The test is the only program:
+ *  kmain() starts it instead of the program manager.
+ */
+
+#ifndef __host_test_config_h__
+#define __host_test_config_h__
+
+#include "../config.h"
+
+#undef CONF_PROGRAM
+
+#endif // __host_test_config_h__
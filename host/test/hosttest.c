@@ -0,0 +1,104 @@
+/*! \file   hosttest.c
+    \brief  Implementation: host services for the kernel tests
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "host.h"
+#include "hosttest.h"
+
+//! from the simulated hardware, see sys/irq.h
+extern unsigned char irq_save(void);
+extern void irq_restore(unsigned char ccr);
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+int test_failures;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+int test_printf(const char *format,...) {
+  unsigned char ccr=irq_save();         // tasks switch from the tick
+  va_list ap;
+  int n;
+
+  va_start(ap,format);
+  n=vprintf(format,ap);
+  va_end(ap);
+  fflush(stdout);
+  irq_restore(ccr);
+  return n;
+}
+
+int test_check(int ok,const char *what,const char *file,int line) {
+  if(!ok) {
+    test_failures++;
+    test_printf("%s:%d: check failed: %s\n",file,line,what);
+  }
+  return ok;
+}
+
+unsigned long long test_nsecs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return 1000000000ULL*ts.tv_sec + ts.tv_nsec;
+}
+
+char *test_read_file(const char *path,unsigned long *length) {
+  FILE *f;
+  char *data;
+  long n;
+
+  if((f=fopen(path,"rb"))==NULL) {
+    perror(path);
+    return NULL;
+  }
+  if(fseek(f,0,SEEK_END) || (n=ftell(f))<0 || fseek(f,0,SEEK_SET)
+     || (data=malloc(n+1))==NULL) {
+    perror(path);
+    fclose(f);
+    return NULL;
+  }
+  if(fread(data,1,n,f)!=(size_t) n) {
+    perror(path);
+    free(data);
+    fclose(f);
+    return NULL;
+  }
+  fclose(f);
+  data[n]=0;
+  *length=n;
+  return data;
+}
+
+void test_exit(void) {
+  host_hardware_shutdown();
+  if(test_failures)
+    printf("%d checks failed\n",test_failures);
+  fflush(stdout);
+  exit(test_failures ? 1 : 0);
+}
@@ -0,0 +1,81 @@
+/*! \file   hosttest.h
+    \brief  Interface: host services for the kernel tests
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The tests are compiled like the kernel, against the brickOS
+ *  headers only. This is what they get from the host, see hosttest.c.
+ */
+
+#ifndef __hosttest_h__
+#define __hosttest_h__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! check a condition, report it if it doesn't hold
+#define TEST_CHECK(cond) \
+  test_check((cond)!=0,#cond,__FILE__,__LINE__)
+
+///////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////
+
+extern int test_failures;               //!< checks that failed
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! boot the kernel with entry as its only task, see host.h
+extern void host_start(int (*entry)(int,char**)) __attribute__ ((noreturn));
+
+//! printf() on standard output, with IRQs masked
+extern int test_printf(const char *format,...)
+  __attribute__ ((format (printf,1,2)));
+
+//! count and report a failed check
+/*! \return ok
+*/
+extern int test_check(int ok,const char *what,const char *file,int line);
+
+//! host time in nanoseconds
+extern unsigned long long test_nsecs(void);
+
+//! read a whole file
+/*! \param length set to its length
+    \return its contents with a 0 appended, NULL on error
+*/
+extern char *test_read_file(const char *path,unsigned long *length);
+
+//! stop the kernel and exit, with status 1 if a check failed
+extern void test_exit(void) __attribute__ ((noreturn));
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // __hosttest_h__
@@ -0,0 +1,195 @@
+/*! \file   inherit.c
+    \brief  Test priority inheritance of mutexes
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  A low priority task holds a mutex that a high priority task wants,
+ *  while a middle priority task hogs the processor. Without inheritance
+ *  the low task never gets to release the mutex. With it, the holder
+ *  must run at the high priority until it releases the mutex, and at
+ *  its own after. Also when it is boosted while asleep, and when the
+ *  high task is killed while it waits, which removes the chain the
+ *  holder was lent (tm_disinherit_chain()).
+ *
+ *  The test runs as the first task, above the three.
+ */
+
+#include <unistd.h>
+#include <mutex.h>
+#include <sys/tm.h>
+
+#include "hosttest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define PRIO_LOW	3
+#define PRIO_MID	5
+#define PRIO_HIGH	8
+
+#define SETTLE		20		//!< ms for the tasks to get somewhere
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static mutex_t lock=MUTEX_INITIALIZER;
+
+static volatile int release;		//!< low may unlock
+static volatile int hog;		//!< mid keeps the processor
+static volatile int low_locked,low_done,high_locked,high_result;
+static volatile int restored;		//!< low unboosted when high got it
+
+static tdata_t *low;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! hold the lock until released
+static int low_task(int argc,char **argv) {
+  mutex_lock(&lock);
+  low_locked=1;
+  while(!release)
+    ;
+  mutex_unlock(&lock);
+  low_done=1;
+  return 0;
+}
+
+//! hold the lock while asleep
+static int low_sleeper(int argc,char **argv) {
+  mutex_lock(&lock);
+  low_locked=1;
+  msleep(4*SETTLE);
+  mutex_unlock(&lock);
+  low_done=1;
+  return 0;
+}
+
+//! keep the processor from the low task
+static int mid_task(int argc,char **argv) {
+  while(hog)
+    ;
+  return 0;
+}
+
+//! take the lock once
+static int high_task(int argc,char **argv) {
+  high_result=mutex_lock(&lock);
+  if(high_result==0) {
+    restored=(low->rprio==low->priority);
+    high_locked=1;
+    mutex_unlock(&lock);
+  }
+  return 0;
+}
+
+//! start a task of the test
+static tdata_t *start(int (*code)(int,char**),priority_t priority) {
+  tid_t tid=execi(code,0,NULL,priority,DEFAULT_STACK_SIZE);
+
+  TEST_CHECK(tid!=-1);
+  return (tdata_t*) tid;
+}
+
+//! low holds the lock, mid hogs, high wants the lock
+static tdata_t *setup(int (*holder)(int,char**)) {
+  tdata_t *high;
+
+  release=low_locked=low_done=high_locked=restored=0;
+  high_result=1;
+  hog=1;
+  low=start(holder,PRIO_LOW);
+  msleep(SETTLE);
+  TEST_CHECK(low_locked);
+  start(mid_task,PRIO_MID);
+  high=start(high_task,PRIO_HIGH);
+  msleep(SETTLE);
+  TEST_CHECK(!high_locked);
+  TEST_CHECK(low->held==1);
+  TEST_CHECK(low->priority->priority==PRIO_LOW);
+  TEST_CHECK(low->rprio->priority==PRIO_HIGH);	// boosted
+  return high;
+}
+
+//! let everything finish
+static void finish(void) {
+  release=1;
+  hog=0;
+  msleep(SETTLE);
+  TEST_CHECK(low_done);
+  TEST_CHECK(lock.owner==NULL);
+}
+
+//! boosted until unlocked, then back to its own priority
+static void test_boost(void) {
+  test_printf("boost and restore\n");
+  setup(low_task);
+  release=1;
+  msleep(SETTLE);
+  TEST_CHECK(high_locked);
+  TEST_CHECK(restored);
+  TEST_CHECK(!low_done);		// mid is ahead of it again
+  TEST_CHECK(low->rprio==low->priority);
+  TEST_CHECK(low->held==0);
+  finish();
+}
+
+//! boosted while asleep, runs at the lent priority when it wakes
+static void test_asleep(void) {
+  test_printf("boost while asleep\n");
+  setup(low_sleeper);
+  msleep(3*SETTLE);
+  TEST_CHECK(high_locked);
+  TEST_CHECK(restored);
+  TEST_CHECK(!low_done);
+  finish();
+}
+
+//! the lender is killed, which takes the lent chain away
+static void test_killed(void) {
+  tdata_t *high;
+
+  test_printf("lender killed\n");
+  high=setup(low_task);
+  kill((tid_t) high);
+  msleep(SETTLE);
+  TEST_CHECK(high_result==1);		// exited inside mutex_lock()
+  TEST_CHECK(!high_locked);
+  TEST_CHECK(lock.owner==low);
+  TEST_CHECK(low->held==1);
+  TEST_CHECK(low->rprio==low->priority);
+  TEST_CHECK(low->rprio->priority==PRIO_LOW);
+  finish();
+}
+
+static int test(int argc,char **argv) {
+  test_boost();
+  test_asleep();
+  test_killed();
+  test_exit();
+}
+
+int main(int argc,char **argv) {
+  host_start(test);
+}
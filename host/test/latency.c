@@ -0,0 +1,215 @@
+/*! \file   latency.c
+    \brief  Measure the wakeup latency of sleeps and timed waits
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The first task, above all others, sleeps with msleep(), lets
+ *  sem_timedwait() time out and waits for posts from a lower priority
+ *  task, while background tasks sleep for random times and one spins
+ *  at the bottom. How late it wakes is kept in a histogram, in host time and
+ *  in system ticks. Built with and without CONF_TM_WHEEL, for
+ *  comparing the timer wheel with the sorted sleeper list.
+ *
+ *  Never waking early, and waking on a post, are checked. Host time
+ *  depends on the host, so lateness is only reported.
+ *
+ *  usage: latency [samples]
+ */
+
+#include <unistd.h>
+#include <semaphore.h>
+#include <string.h>
+#include <time.h>
+
+#include "hosttest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define SAMPLES		200		//!< default samples of each kind
+#define SLEEPERS	12		//!< background sleepers
+
+#define PRIO_POSTER	8
+#define PRIO_SLEEPER	6
+#define PRIO_SPINNER	1
+
+#define BINS		9
+
+#ifdef CONF_TM_WHEEL
+#define TIMERS		"timer wheel"
+#else
+#define TIMERS		"sleeper list"
+#endif
+
+//! lateness of the wakeups of one kind
+typedef struct {
+  const char *name;
+  unsigned long samples;
+  unsigned long bins[BINS];		//!< by host time, see limits
+  unsigned long ticks[4];		//!< 0, 1, 2, more ticks late
+  long long worst;			//!< nanoseconds
+  long long total;
+} histogram_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! upper limits of the bins, microseconds late
+static const long limits[BINS-1]={ 0, 50, 100, 250, 500, 1000, 2000, 5000 };
+
+static histogram_t sleeps={ "msleep" };
+static histogram_t timeouts={ "timeout" };
+static histogram_t posts={ "post" };
+
+static sem_t sem;
+static volatile unsigned long long posted;	//!< host time of the post
+static volatile int running=1;
+
+static unsigned long seed=1;
+static unsigned long samples=SAMPLES;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! a pseudo random number below n
+static unsigned rnd(unsigned n) {
+  seed=seed*1103515245+12345;
+  return ((seed>>16)&0x7fff)*n/0x8000;
+}
+
+//! add a sample
+/*! \param nsecs host time late
+    \param ticks system ticks late, or -1 if not known
+*/
+static void sample(histogram_t *h,long long nsecs,long ticks) {
+  unsigned b;
+
+  for(b=0; b<BINS-1 && nsecs>limits[b]*1000LL; b++)
+    ;
+  h->bins[b]++;
+  if(ticks>=0)
+    h->ticks[ticks<3 ? ticks : 3]++;
+  if(h->samples==0 || nsecs>h->worst)
+    h->worst=nsecs;
+  h->total+=nsecs;
+  h->samples++;
+}
+
+//! print a histogram
+static void report(histogram_t *h) {
+  unsigned b;
+
+  if(h->samples==0)
+    return;
+  test_printf("  %-8s mean %6lld us, worst %6lld us, ticks late %lu/%lu/%lu/%lu\n",
+              h->name,h->total/(long long) h->samples/1000,h->worst/1000,
+              h->ticks[0],h->ticks[1],h->ticks[2],h->ticks[3]);
+  for(b=0; b<BINS; b++)
+    if(b<BINS-1)
+      test_printf("    <= %5ld us %6lu\n",limits[b],h->bins[b]);
+    else
+      test_printf("     > %5ld us %6lu\n",limits[b-1],h->bins[b]);
+}
+
+//! sleep for random times
+static int sleeper(int argc,char **argv) {
+  while(running)
+    msleep(1+rnd(50));
+  return 0;
+}
+
+//! keep the processor busy below everyone
+static int spinner(int argc,char **argv) {
+  while(running)
+    ;
+  return 0;
+}
+
+//! post the semaphore now and then
+static int poster(int argc,char **argv) {
+  while(running) {
+    msleep(1+rnd(3));
+    posted=test_nsecs();
+    sem_post(&sem);
+  }
+  return 0;
+}
+
+static int test(int argc,char **argv) {
+  unsigned long n=samples,i;
+
+  for(i=0; i<SLEEPERS; i++)
+    execi(sleeper,0,NULL,PRIO_SLEEPER,DEFAULT_STACK_SIZE);
+  execi(spinner,0,NULL,PRIO_SPINNER,DEFAULT_STACK_SIZE);
+
+  for(i=0; i<n; i++) {
+    unsigned d=1+rnd(5);
+    time_t start=get_system_up_time(),woke;
+    unsigned long long host=test_nsecs();
+
+    TEST_CHECK(msleep(d)==0);
+    woke=get_system_up_time();
+    host=test_nsecs()-host;
+    if(!TEST_CHECK(woke-start>=d))	// early
+      break;
+    sample(&sleeps,(long long) host-d*1000000LL,woke-start-d);
+  }
+
+  sem_init(&sem,0,0);
+  for(i=0; i<n; i++) {
+    unsigned d=1+rnd(5);
+    time_t start=get_system_up_time(),woke;
+    unsigned long long host=test_nsecs();
+
+    TEST_CHECK(sem_timedwait(&sem,start+d)==-1);
+    woke=get_system_up_time();
+    host=test_nsecs()-host;
+    if(!TEST_CHECK(woke-start>=d))
+      break;
+    sample(&timeouts,(long long) host-d*1000000LL,woke-start-d);
+  }
+
+  execi(poster,0,NULL,PRIO_POSTER,DEFAULT_STACK_SIZE);
+  for(i=0; i<n; i++) {
+    if(!TEST_CHECK(sem_timedwait(&sem,get_system_up_time()+100)==0))
+      break;
+    sample(&posts,test_nsecs()-posted,-1);
+  }
+  running=0;
+
+  test_printf("%s, %d sleepers\n",TIMERS,SLEEPERS);
+  report(&sleeps);
+  report(&timeouts);
+  report(&posts);
+  test_exit();
+}
+
+int main(int argc,char **argv) {
+  const char *arg;
+
+  if(argc>1)
+    for(samples=0, arg=argv[1]; *arg>='0' && *arg<='9'; arg++)
+      samples=samples*10+*arg-'0';
+  host_start(test);
+}
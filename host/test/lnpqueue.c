@@ -0,0 +1,118 @@
+/*! \file   lnpqueue.c
+    \brief  Test blocking LNP writes behind a full transmit queue
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The transmit queue is filled with asynchronous frames, then a
+ *  blocking write must wait for a slot, send its frame and return 0.
+ *  The stack below is left holding TX_COLL first, as an empty frame
+ *  written there does, so a write that looks at a state it never set
+ *  reports a collision.
+ *
+ *  All frames must complete in the order they were queued, without
+ *  collisions; the simulated tower echoes every byte.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <lnp.h>
+#include <lnp-logical.h>
+#include <sys/lnp-logical.h>
+
+#include "hosttest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define ROUNDS		5		//!< times the queue is filled
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static lnp_tx_t frames[LNP_TX_QUEUE];
+static lnp_tx_t extra;			//!< one more than fits
+static unsigned char payload[LNP_TX_QUEUE][32];
+
+static volatile unsigned done,collided;
+static lnp_tx_t *order[LNP_TX_QUEUE];
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! count a completed async frame
+static void frame_done(lnp_tx_t *tx) {
+  if(tx->state==TX_COLL)
+    collided++;
+  if(done<LNP_TX_QUEUE)
+    order[done]=tx;
+  done++;
+}
+
+//! leave TX_COLL on the stack a blocking write will use
+static void __attribute__ ((noinline)) poison(void) {
+  volatile signed char stack[256];
+  unsigned i;
+
+  for(i=0; i<sizeof(stack); i++)
+    stack[i]=TX_COLL;
+  TEST_CHECK(lnp_logical_write(payload[0],0)==TX_COLL);	// empty
+}
+
+//! fill the queue, then write behind it
+static void __attribute__ ((noinline)) round_trip(unsigned round) {
+  static unsigned char blocking[]="behind a full queue";
+  unsigned i;
+
+  done=collided=0;
+  for(i=0; i<LNP_TX_QUEUE; i++) {
+    memset(payload[i],'a'+round+i,sizeof(payload[i]));
+    TEST_CHECK(lnp_integrity_write_async(frames+i,payload[i],
+                                         sizeof(payload[i]),frame_done)==0);
+  }
+  TEST_CHECK(lnp_integrity_write_async(&extra,payload[0],1,frame_done)==-1);
+
+  TEST_CHECK(lnp_integrity_write(blocking,sizeof(blocking))==0);
+
+  msleep(10);
+  TEST_CHECK(done==LNP_TX_QUEUE);
+  TEST_CHECK(collided==0);
+  for(i=0; i<LNP_TX_QUEUE && i<done; i++)
+    TEST_CHECK(order[i]==frames+i);
+}
+
+static int test(int argc,char **argv) {
+  unsigned r;
+
+  for(r=0; r<ROUNDS; r++) {
+    poison();
+    round_trip(r);
+  }
+  test_printf("%d rounds of %d queued frames and a blocking write\n",
+              ROUNDS,LNP_TX_QUEUE);
+  test_exit();
+}
+
+int main(int argc,char **argv) {
+  host_start(test);
+}
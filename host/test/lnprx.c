@@ -0,0 +1,306 @@
+/*! \file   lnprx.c
+    \brief  Replay captured LNP traffic through the integrity layer
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The frames of captures written by lnpcap are put back together into
+ *  the byte stream the receiver saw, and fed through the kernel's
+ *  lnp_integrity_byte() and through the one it replaced, kept below,
+ *  byte after byte with IRQs masked like in the receive interrupt. The
+ *  best time of the repeats is printed per byte for both.
+ *
+ *  Both must hand the same packets to the handlers. An empty packet
+ *  followed by another must give both to the kernel's.
+ *
+ *  usage: lnprx [-r repeats] capture.pcap...
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <lnp.h>
+#include <sys/lnp.h>
+#include <sys/irq.h>
+
+#include "hosttest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define REPEATS		200		//!< default passes over the stream
+#define STREAM_MAX	0x40000		//!< most bytes of all captures
+
+#define PCAP_MAGIC	0xa1b2c3d4
+#define PCAP_USER0	147		//!< lnpcap's link type
+
+// as in kernel/lnp.c, which has no header for lnp_receive_packet()
+void lnp_receive_packet(const unsigned char *data);
+
+#define lnp_checksum_init(sum)  (unsigned char)((sum) = 0xff)
+#define lnp_checksum_step(sum,d)  (unsigned char)((sum) += (d))
+
+//! what the handlers were given
+typedef struct {
+  unsigned long packets;
+  unsigned long bytes;
+  unsigned long hash;			//!< of sources, lengths and payloads
+} delivered_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned char stream[STREAM_MAX];	//!< the bytes of all captures
+static unsigned long stream_length;
+
+static delivered_t delivered;
+static unsigned long repeats=REPEATS;
+
+static int captures;
+static char **capture;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! lnp_integrity_byte() before the payload short cut, without the
+//! RCX protocol states and CONF_VIS, which this kernel doesn't have
+static void old_integrity_byte(unsigned char b) {
+  static unsigned char buffer[256+3];
+  static int bytesRead,endOfData;
+  static unsigned char chk;
+
+  if(lnp_integrity_state==LNPwaitHeader)
+    bytesRead=0;
+
+  buffer[bytesRead++]=b;
+
+  switch(lnp_integrity_state) {
+    case LNPwaitHeader:
+      // valid headers are 0xf0 .. 0xf7
+      //
+      if(((b & 0xf8) == 0xf0) || (b == 0x55)) {
+        // Init checksum
+        lnp_checksum_init( chk );
+
+        // switch on protocol header
+        if (b == 0x55) {
+          lnp_integrity_reset();
+        } else {
+          lnp_integrity_state++;
+        }
+      }
+      break;
+
+    case LNPwaitLength:
+      endOfData=b+2;
+      lnp_integrity_state++;
+      break;
+
+    case LNPwaitData:
+      if(bytesRead==endOfData)
+  lnp_integrity_state++;
+      break;
+
+    case LNPwaitCRC:
+      if(b==chk)
+  lnp_receive_packet(buffer);
+      lnp_integrity_reset();
+    break;
+
+    default:
+      break;
+  }
+  // Accumulate checksum
+  lnp_checksum_step( chk, b );
+}
+
+//! remember a packet
+static void deliver(const unsigned char *data,unsigned char length,
+                    unsigned src) {
+  unsigned long h=delivered.hash*31+src*257+length;
+  unsigned char i;
+
+  for(i=0; i<length; i++)
+    h=h*31+data[i];
+  delivered.hash=h;
+  delivered.packets++;
+  delivered.bytes+=length;
+}
+
+static void addressing_handler(const unsigned char *data,unsigned char length,
+                               unsigned char src) {
+  deliver(data,length,src);
+}
+
+static void integrity_handler(const unsigned char *data,unsigned char length) {
+  deliver(data,length,0x100);
+}
+
+static unsigned long le32(const unsigned char *b) {
+  return b[0] | (b[1]<<8) | ((unsigned long) b[2]<<16)
+         | ((unsigned long) b[3]<<24);
+}
+
+static unsigned long be32(const unsigned char *b) {
+  return b[3] | (b[2]<<8) | ((unsigned long) b[1]<<16)
+         | ((unsigned long) b[0]<<24);
+}
+
+//! append the frames of a capture to the stream
+/*! the capture is written in the byte order of the host it was
+    taken on.
+    \return 0 on success
+*/
+static int read_capture(const char *path) {
+  unsigned char *file,*p,*end;
+  unsigned long length,magic;
+  unsigned long (*get32)(const unsigned char *);
+
+  if((file=(unsigned char*) test_read_file(path,&length))==NULL)
+    return -1;
+  get32=le32;
+  if(length<24 || ((magic=get32(file))!=PCAP_MAGIC
+                   && (get32=be32, magic=get32(file))!=PCAP_MAGIC)) {
+    test_printf("%s: not a pcap file\n",path);
+    return -1;
+  }
+  if(get32(file+20)!=PCAP_USER0) {
+    test_printf("%s: link type %lu is not LNP\n",path,get32(file+20));
+    return -1;
+  }
+
+  end=file+length;
+  for(p=file+24; p+16<=end; ) {
+    unsigned long frame=get32(p+8);
+
+    p+=16;
+    if(frame>end-p) {
+      test_printf("%s: truncated\n",path);
+      return -1;
+    }
+    if(frame>STREAM_MAX-stream_length) {
+      test_printf("%s: more than %u bytes in all\n",path,STREAM_MAX);
+      return -1;
+    }
+    memcpy(stream+stream_length,p,frame);
+    stream_length+=frame;
+    p+=frame;
+  }
+  return 0;
+}
+
+//! one pass over bytes, the way the receive interrupt feeds them
+/*! \return host time taken
+*/
+static unsigned long long replay(void (*byte)(unsigned char),
+                                 const unsigned char *bytes,
+                                 unsigned long length) {
+  unsigned long long start;
+  unsigned char ccr;
+  unsigned long i;
+
+  lnp_integrity_reset();
+  ccr=irq_save();
+  start=test_nsecs();
+  for(i=0; i<length; i++)
+    byte(bytes[i]);
+  start=test_nsecs()-start;
+  irq_restore(ccr);
+  return start;
+}
+
+//! an empty packet and one after it
+static void test_empty(void) {
+  static const unsigned char two[]={
+    0xf0,0x00,0xef,
+    0xf0,0x01,0x2a,0x1a
+  };
+
+  memset(&delivered,0,sizeof(delivered));
+  replay(old_integrity_byte,two,sizeof(two));
+  test_printf("empty packet, then one: old %lu packets",delivered.packets);
+
+  memset(&delivered,0,sizeof(delivered));
+  replay(lnp_integrity_byte,two,sizeof(two));
+  test_printf(", new %lu\n",delivered.packets);
+  TEST_CHECK(delivered.packets==2 && delivered.bytes==1);
+}
+
+static int test(int argc,char **argv) {
+  unsigned long long old_best=0,new_best=0,t;
+  delivered_t old_delivered,new_delivered;
+  unsigned long r;
+  int i;
+
+  for(i=0; i<captures; i++)
+    if(!TEST_CHECK(read_capture(capture[i])==0))
+      test_exit();
+  TEST_CHECK(stream_length>0);
+
+  lnp_integrity_set_handler(integrity_handler);
+  for(i=0; i<=LNP_PORTMASK; i++)
+    lnp_addressing_set_handler(i,addressing_handler);
+
+  memset(&delivered,0,sizeof(delivered));
+  replay(old_integrity_byte,stream,stream_length);
+  old_delivered=delivered;
+  memset(&delivered,0,sizeof(delivered));
+  replay(lnp_integrity_byte,stream,stream_length);
+  new_delivered=delivered;
+
+  test_printf("%lu bytes, %lu packets for this host, %lu payload bytes\n",
+              stream_length,new_delivered.packets,new_delivered.bytes);
+  TEST_CHECK(new_delivered.packets>0);
+  TEST_CHECK(old_delivered.packets==new_delivered.packets);
+  TEST_CHECK(old_delivered.bytes==new_delivered.bytes);
+  TEST_CHECK(old_delivered.hash==new_delivered.hash);
+
+  for(r=0; r<repeats; r++) {
+    t=replay(old_integrity_byte,stream,stream_length);
+    if(r==0 || t<old_best)
+      old_best=t;
+    t=replay(lnp_integrity_byte,stream,stream_length);
+    if(r==0 || t<new_best)
+      new_best=t;
+  }
+  test_printf("  old %6.2f ns per byte\n",(double) old_best/stream_length);
+  test_printf("  new %6.2f ns per byte, %.0f%% of old\n",
+              (double) new_best/stream_length,100.0*new_best/old_best);
+
+  test_empty();
+  test_exit();
+}
+
+int main(int argc,char **argv) {
+  const char *arg;
+
+  for(argv++, argc--; argc>1 && !strcmp(*argv,"-r"); argv+=2, argc-=2)
+    for(repeats=0, arg=argv[1]; *arg>='0' && *arg<='9'; arg++)
+      repeats=repeats*10+*arg-'0';
+  if(argc==0) {
+    test_printf("usage: lnprx [-r repeats] capture.pcap...\n");
+    return 2;
+  }
+  captures=argc;
+  capture=argv;
+  host_start(test);
+}
@@ -0,0 +1,580 @@
+/*! \file   mmreplay.c
+    \brief  Replay allocation traces against the kernel allocator
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Runs a trace of malloc(), free() and task exits through mm.c as it
+ *  is built: first fit, or segregated fit with CONF_MM_SEGREGATED.
+ *
+ *  The trace is replayed twice. The first time the heap is walked and
+ *  checked after every step, the data of a block is checked when it is
+ *  freed, and no block of an exiting task may survive mm_reaper(). Then
+ *  every call is timed, for comparing the allocators on the same trace.
+ *  The fastest of some repeats (-r) counts, which leaves out the host's
+ *  own hiccups.
+ *
+ *  A trace is text, one step per line, sizes in RCX bytes:
+ *
+ *    a <block> <bytes> <task>    task allocates block
+ *    A <block> <bytes> <task>    the same, and malloc() must not fail
+ *    f <block>                   block is freed
+ *    x <task>                    task exits, mm_reaper() frees the rest
+ *    # ...                       comment
+ *
+ *  Tasks are numbered 1 to 15. The host heap is cut down to the size
+ *  of an RCX heap (-h) and its words are as many as on the RCX, so
+ *  blocks split and join the same way. -g makes up a trace instead of
+ *  reading one, see session() and churn().
+ *
+ *  usage: mmreplay [-h heapbytes] [-r repeats] trace
+ *         mmreplay [-h heapbytes] [-r repeats] -g session|churn seed
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mm.h>
+#include <sys/tm.h>
+
+#include "hosttest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define TASKS		16		//!< task 0 owns the filler block
+#define BLOCKS		4096		//!< block numbers 0..BLOCKS-1
+#define STEPS		100000		//!< longest trace
+
+#define HEAP_BYTES	12288		//!< default RCX heap
+
+#ifdef CONF_MM_SEGREGATED
+#define ALLOCATOR	"segregated fit"
+#define BLOCK_SIZE(ptr)	MM_SIZE(ptr)
+#else
+#define ALLOCATOR	"first fit"
+#define BLOCK_SIZE(ptr)	(*((ptr)+1))
+#endif
+
+//! one step of a trace
+typedef struct {
+  char op;				//!< 'a', 'f' or 'x'
+  unsigned short block;
+  unsigned short task;
+  unsigned bytes;
+  unsigned char sure;			//!< 'A': malloc() must not fail
+} step_t;
+
+//! a block of the trace
+typedef struct {
+  size_t *data;				//!< NULL if not allocated
+  unsigned words;
+  unsigned char task;
+} block_t;
+
+//! time spent in allocator calls of one kind
+typedef struct {
+  unsigned long calls;
+  unsigned long long nsecs;
+  unsigned long long worst;
+} timing_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static tdata_t tasks[TASKS];		//!< only their addresses are used
+
+static step_t steps[STEPS];
+static unsigned nsteps;
+
+static block_t blocks[BLOCKS];
+
+static unsigned heap_words;		//!< RCX heap, data words
+static unsigned long peak_words;	//!< most words in use
+static unsigned long failures;		//!< malloc() returned NULL
+
+static unsigned long long best[STEPS];	//!< fastest time of each step
+
+static unsigned long seed;
+
+static unsigned char owner[BLOCKS];	//!< made up traces: 0 or task
+static unsigned bytes[BLOCKS];		//!< made up traces: size
+static unsigned next_block;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! a pseudo random number below n
+static unsigned rnd(unsigned n) {
+  seed=seed*1103515245+12345;
+  return ((seed>>16)&0x7fff)*n/0x8000;
+}
+
+//! what a block is filled with
+static size_t pattern(unsigned block,unsigned i) {
+  return ((size_t) block<<16) ^ i ^ 0x5a5a;
+}
+
+//! add a step to the trace
+static void step(char op,unsigned block,unsigned bytes,unsigned task) {
+  if(nsteps<STEPS) {
+    steps[nsteps].op=op;
+    steps[nsteps].block=block;
+    steps[nsteps].bytes=bytes;
+    steps[nsteps].task=task;
+    steps[nsteps].sure=0;
+    nsteps++;
+  }
+}
+
+//! read a number, skipping blanks before it
+static int number(const char **s,unsigned *n) {
+  while(**s==' ' || **s=='\t')
+    (*s)++;
+  if(**s<'0' || **s>'9')
+    return 0;
+  for(*n=0; **s>='0' && **s<='9'; (*s)++)
+    *n=*n*10+**s-'0';
+  return 1;
+}
+
+//! read a trace file
+static int read_trace(const char *path) {
+  unsigned long length;
+  const char *s,*text=test_read_file(path,&length);
+  unsigned line=1,block,bytes,task;
+
+  if(text==NULL)
+    return 0;
+  for(s=text; *s; line++) {
+    char op=*s;
+    int ok=1;
+
+    if(op=='a' || op=='A' || op=='f' || op=='x') {
+      int sure=op=='A';
+
+      s++;
+      block=bytes=task=0;
+      if(sure)
+        op='a';
+      if(op=='a')
+        ok=number(&s,&block) && number(&s,&bytes) && number(&s,&task);
+      else if(op=='f')
+        ok=number(&s,&block);
+      else
+        ok=number(&s,&task);
+      ok=ok && block<BLOCKS && (op=='f' || (task>0 && task<TASKS));
+      if(ok) {
+        step(op,block,bytes,task);
+        steps[nsteps-1].sure=sure;
+      }
+    } else
+      ok=(op=='#' || op=='\n');
+    if(!ok) {
+      test_printf("%s:%u: bad step\n",path,line);
+      return 0;
+    }
+    while(*s && *(s++)!='\n')
+      ;
+  }
+  return 1;
+}
+
+//! allocate a block in a made up trace
+static unsigned new_block(unsigned bytes,unsigned task) {
+  while(owner[next_block])
+    next_block=(next_block+1)%BLOCKS;
+  owner[next_block]=task;
+  step('a',next_block,bytes,task);
+  return next_block;
+}
+
+//! free a block in a made up trace, unless it was reaped
+static void free_block(unsigned block,unsigned task) {
+  if(owner[block]==task) {
+    owner[block]=0;
+    step('f',block,0,0);
+  }
+}
+
+//! a task exits in a made up trace
+static void exit_task(unsigned task) {
+  unsigned b;
+
+  step('x',0,0,task);
+  for(b=0; b<BLOCKS; b++)
+    if(owner[b]==task)
+      owner[b]=0;
+}
+
+//! the steps of brickOS sessions
+/*! task 1 is the kernel. it keeps some buffers, downloads programs
+    into one of four slots and starts tasks, which allocate, start
+    tasks of their own and exit. the task data and stack of a task
+    belong to the task that started it, which frees them once the
+    task is gone, unless they were reaped with it.
+*/
+static void session(unsigned n) {
+  unsigned char parent[TASKS];
+  unsigned short tdata[TASKS],stack[TASKS],slot[4];
+  unsigned t,b,i;
+
+  memset(parent,0,sizeof(parent));
+  parent[1]=1;
+  for(i=0; i<4; i++)
+    slot[i]=new_block(2,1);
+  new_block(4*(64+2),1);		// lnp port ring
+  new_block(160,1);			// transport buffers
+
+  while(nsteps<n) {
+    unsigned r=rnd(100);
+
+    t=1+rnd(TASKS-1);
+    if(r<5) {				// download a program
+      unsigned missing,buffer;
+
+      i=rnd(4);
+      free_block(slot[i],1);
+      missing=new_block(8+rnd(24),1);
+      buffer=new_block(253,1);
+      slot[i]=new_block(200+rnd(2400),1);
+      free_block(buffer,1);
+      free_block(missing,1);
+    } else if(r<20) {			// start a task
+      unsigned p=1+rnd(TASKS-1);
+
+      if(t!=1 && !parent[t] && parent[p]) {
+        parent[t]=p;
+        tdata[t]=new_block(40,p);
+        stack[t]=new_block(p==1 ? 512 : 128+rnd(384),p);
+        if(p!=1)
+          new_block(8,p);		// priority chain
+      }
+    } else if(r<60) {			// a task allocates
+      if(t!=1 && parent[t])
+        new_block(rnd(4) ? 4+rnd(60) : 64+rnd(448),t);
+    } else if(r<90) {			// a task frees
+      if(t!=1 && parent[t])
+        for(i=0, b=rnd(BLOCKS); i<BLOCKS; i++, b=(b+1)%BLOCKS)
+          if(owner[b]==t) {
+            free_block(b,t);
+            break;
+          }
+    } else if(t!=1 && parent[t]) {	// a task exits
+      exit_task(t);
+      free_block(tdata[t],parent[t]);
+      free_block(stack[t],parent[t]);
+      parent[t]=0;
+    }
+  }
+}
+
+//! the steps of random churn
+/*! eight tasks allocate sizes up to 1k, mostly small ones, free
+    random blocks and exit now and then, keeping the heap about
+    two thirds full.
+*/
+static void churn(unsigned n) {
+  unsigned long used=0;
+  unsigned b,t,i;
+
+  while(nsteps<n) {
+    unsigned r=rnd(100);
+
+    t=1+rnd(8);
+    if(r<2) {
+      for(b=0; b<BLOCKS; b++)
+        if(owner[b]==t)
+          used-=bytes[b];
+      exit_task(t);
+    } else if(used<heap_words*2*2/3 ? r<55 : r<25) {
+      unsigned size=2+(rnd(8) ? rnd(64) : rnd(1024));
+
+      b=new_block(size,t);
+      bytes[b]=size+2*MM_HEADER_SIZE;
+      used+=bytes[b];
+    } else
+      for(i=0, b=rnd(BLOCKS); i<BLOCKS; i++, b=(b+1)%BLOCKS)
+        if(owner[b]) {
+          used-=bytes[b];
+          free_block(b,owner[b]);
+          break;
+        }
+  }
+}
+
+//! walk the heap and check it is consistent
+/*! \return words in use, headers included
+*/
+static unsigned long check_heap(void) {
+  size_t *ptr=&mm_start,*first_free=NULL;
+  unsigned long words=0,used=0,free_blocks=0,free_words=0;
+#ifdef CONF_MM_SEGREGATED
+  int prev_free=0;
+#endif
+
+  while(MM_IN_HEAP(ptr)) {
+    size_t size=BLOCK_SIZE(ptr);
+
+    if(!TEST_CHECK(size>0 && ptr+size+MM_HEADER_SIZE<=mm_heap+MM_HOST_WORDS))
+      return 0;
+    if(*ptr==MM_FREE) {
+      if(!first_free)
+        first_free=ptr;
+      free_blocks++;
+      free_words+=size;
+#ifdef CONF_MM_SEGREGATED
+      TEST_CHECK(!prev_free);		// never two in a row
+      TEST_CHECK(*(ptr+size+1)==(size_t) ptr);
+#endif
+    } else {
+      TEST_CHECK(*ptr>=(size_t) &tasks[0] && *ptr<(size_t) &tasks[TASKS]);
+      used+=size+MM_HEADER_SIZE;
+    }
+#ifdef CONF_MM_SEGREGATED
+    TEST_CHECK(!(*(ptr+1) & MM_PREV_FREE)==!prev_free);
+    prev_free=(*ptr==MM_FREE);
+#endif
+    words+=size+MM_HEADER_SIZE;
+    ptr+=size+MM_HEADER_SIZE;
+  }
+  TEST_CHECK(ptr==mm_heap+MM_HOST_WORDS);
+  TEST_CHECK(words==MM_HOST_WORDS);
+  TEST_CHECK((unsigned long) mm_free_mem()==free_words*sizeof(size_t));
+
+#ifdef CONF_MM_SEGREGATED
+  {
+    unsigned long listed=0;
+    unsigned c;
+
+    for(c=0; c<MM_CLASSES; c++) {
+      size_t *prev=NULL;
+
+      TEST_CHECK(!(mm_class_map & (1<<c))==!mm_free_list[c]);
+      for(ptr=mm_free_list[c]; ptr && listed<=free_blocks;
+          ptr=(size_t*) *(ptr+2), listed++) {
+        TEST_CHECK(*ptr==MM_FREE);
+        TEST_CHECK(MM_SIZE(ptr)>=(1UL<<c) && MM_SIZE(ptr)<(2UL<<c));
+        TEST_CHECK(*(ptr+3)==(size_t) prev);
+        prev=ptr;
+      }
+    }
+    TEST_CHECK(listed==free_blocks);
+  }
+#else
+  // all blocks before the first free one are in use
+  TEST_CHECK(mm_first_free==(first_free ? first_free : ptr));
+#endif
+  return used;
+}
+
+//! allocate the filler that cuts the heap down to the RCX's
+static void heap_init(void) {
+  unsigned i;
+
+  mm_init();
+  ctid=&tasks[0];
+  malloc((MM_HOST_WORDS-2*MM_HEADER_SIZE-heap_words)*sizeof(size_t));
+  for(i=0; i<BLOCKS; i++)
+    blocks[i].data=NULL;
+}
+
+//! time an allocator call
+static void timing(unsigned s,unsigned long long start) {
+  unsigned long long nsecs=test_nsecs()-start;
+
+  if(nsecs<best[s])
+    best[s]=nsecs;
+}
+
+//! replay the trace
+/*! \param checked check the heap and the blocks, else time the calls
+*/
+static void replay(int checked) {
+  unsigned s,i,filler;
+  unsigned long long start;
+
+  heap_init();
+  filler=BLOCK_SIZE(&mm_start);
+  if(checked)
+    check_heap();
+
+  for(s=0; s<nsteps; s++) {
+    step_t *st=&steps[s];
+    block_t *b=&blocks[st->block];
+
+    ctid=&tasks[st->task];
+    switch(st->op) {
+    case 'a':
+      if(b->data) {
+        test_printf("step %u: block %u allocated twice\n",s+1,st->block);
+        test_failures++;
+        return;
+      }
+      start=test_nsecs();
+      b->data=malloc((st->bytes+1)/2*sizeof(size_t));
+      b->words=(st->bytes+1)/2;
+      b->task=st->task;
+      if(!checked) {
+        timing(s,start);
+        break;
+      }
+      if(b->data==NULL) {
+        TEST_CHECK(!st->sure);
+        failures++;
+        break;
+      }
+      TEST_CHECK(MM_IN_HEAP(b->data));
+      TEST_CHECK(*(b->data-2)==(size_t) ctid);
+      TEST_CHECK(BLOCK_SIZE(b->data-2)>=b->words);
+      for(i=0; i<b->words; i++)
+        b->data[i]=pattern(st->block,i);
+      break;
+
+    case 'f':
+      if(b->data==NULL)
+        break;				// failed or reaped
+      if(checked)
+        for(i=0; i<b->words; i++)
+          if(!TEST_CHECK(b->data[i]==pattern(st->block,i)))
+            break;
+      start=test_nsecs();
+      free(b->data);
+      if(!checked)
+        timing(s,start);
+      b->data=NULL;
+      break;
+
+    case 'x':
+      start=test_nsecs();
+      mm_reaper();
+      if(!checked)
+        timing(s,start);
+      for(i=0; i<BLOCKS; i++)
+        if(blocks[i].data && blocks[i].task==st->task)
+          blocks[i].data=NULL;
+      break;
+    }
+
+    if(checked) {
+      unsigned long used=check_heap();
+
+      if(used-filler-MM_HEADER_SIZE>peak_words)
+        peak_words=used-filler-MM_HEADER_SIZE;
+      if(st->op=='x') {
+        size_t *ptr;
+
+        for(ptr=&mm_start; MM_IN_HEAP(ptr); ptr+=BLOCK_SIZE(ptr)+MM_HEADER_SIZE)
+          if(!TEST_CHECK(*ptr!=(size_t) ctid))
+            break;
+      }
+      if(test_failures) {
+        test_printf("step %u: %c %u %u %u\n",
+                    s+1,st->op,st->block,st->bytes,st->task);
+        return;
+      }
+    }
+  }
+
+  if(checked) {
+    // the other blocks are untouched, and nothing is left once
+    // every task is gone.
+    //
+    for(s=0; s<BLOCKS; s++)
+      if(blocks[s].data)
+        for(i=0; i<blocks[s].words; i++)
+          if(!TEST_CHECK(blocks[s].data[i]==pattern(s,i)))
+            break;
+    for(s=1; s<TASKS; s++) {
+      ctid=&tasks[s];
+      mm_reaper();
+    }
+    check_heap();
+    TEST_CHECK(mm_free_mem()==heap_words*sizeof(size_t));
+  }
+}
+
+//! print the time per call of one kind
+static void report(const char *name,char op) {
+  timing_t t;
+  unsigned s;
+
+  memset(&t,0,sizeof(t));
+  for(s=0; s<nsteps; s++)
+    if(steps[s].op==op && best[s]!=~0ULL) {	// not a free() skipped
+      t.calls++;
+      t.nsecs+=best[s];
+      if(best[s]>t.worst)
+        t.worst=best[s];
+    }
+  if(t.calls)
+    test_printf("  %-7s %6lu calls, mean %5llu ns, worst %6llu ns\n",name,
+                t.calls,t.nsecs/t.calls,t.worst);
+}
+
+int main(int argc,char **argv) {
+  unsigned heap_bytes=HEAP_BYTES,repeats=10,r;
+  const char *usage="usage: mmreplay [-h heapbytes] [-r repeats] "
+                    "trace | -g session|churn seed\n";
+  const char *arg;
+
+  for(argv++, argc--; argc>2 && **argv=='-'; argv+=2, argc-=2) {
+    arg=argv[1];
+    if(!strcmp(*argv,"-h") && number(&arg,&heap_bytes))
+      ;
+    else if(!strcmp(*argv,"-r") && number(&arg,&repeats))
+      ;
+    else
+      break;
+  }
+  heap_words=heap_bytes/2;
+
+  arg=argv[2];
+  if(argc==3 && !strcmp(*argv,"-g") && number(&arg,&r)) {
+    seed=r;
+    if(!strcmp(argv[1],"session"))
+      session(20000);
+    else if(!strcmp(argv[1],"churn"))
+      churn(50000);
+  } else if(argc==1 && !read_trace(*argv))
+    test_exit();
+  if(nsteps==0) {
+    test_printf("%s",usage);
+    test_failures++;
+    test_exit();
+  }
+
+  replay(1);
+  if(test_failures)
+    test_exit();
+  memset(best,0xff,sizeof(best));
+  for(r=0; r<repeats; r++)
+    replay(0);
+
+  test_printf("%s, %u byte heap, %u steps\n",ALLOCATOR,heap_bytes,nsteps);
+  test_printf("  %lu bytes peak use, %lu allocations failed\n",
+              peak_words*2,failures);
+  report("malloc",'a');
+  report("free",'f');
+  report("reaper",'x');
+  test_exit();
+}
@@ -0,0 +1,143 @@
+/*! \file   sched.c
+    \brief  Time task switches with many blocked tasks
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  A ring of tasks passes a token around through semaphores, so every
+ *  hand-off parks one task and picks another. More and more tasks are
+ *  added that wait on semaphores nobody posts, above the ring, and
+ *  the time per hand-off is printed for each count. Built with and
+ *  without CONF_TM_READYQ, for comparing the ready queues with the
+ *  scheduler polling every task. A switch on the host costs a few
+ *  system calls of its own, so look at how the time grows with the
+ *  tasks waiting rather than at the times themselves.
+ *
+ *  That every round of the ring completes, and that execi() rejects
+ *  priorities the ready queues can't hold, is checked.
+ *
+ *  usage: sched [rounds]
+ */
+
+#include <unistd.h>
+#include <semaphore.h>
+
+#include "hosttest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define RING		4		//!< tasks passing the token
+#define ROUNDS		20000		//!< default rounds per count
+#define WAITERS		96		//!< most waiting tasks, 64k stacks each
+
+#define PRIO_RING	5
+#define PRIO_WAITERS	11		//!< and up, above the test task
+
+#ifdef CONF_TM_READYQ
+#define SCHEDULER	"ready queues"
+#else
+#define SCHEDULER	"polling"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static const unsigned counts[]={ 0, 8, 32, WAITERS };
+
+static sem_t ring[RING];
+static sem_t never;			//!< the waiters wait on this
+static sem_t done;			//!< the ring has gone round
+
+static volatile unsigned long rounds,target;
+static unsigned long nrounds=ROUNDS;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! pass the token on
+static int ring_task(int argc,char **argv) {
+  unsigned i=argc;
+
+  while(1) {
+    sem_wait(&ring[i]);
+    if(i==0 && ++rounds==target) {
+      sem_post(&done);
+      continue;
+    }
+    sem_post(&ring[(i+1)%RING]);
+  }
+  return 0;
+}
+
+//! wait for nothing
+static int waiter(int argc,char **argv) {
+  sem_wait(&never);
+  return 0;
+}
+
+static int test(int argc,char **argv) {
+  unsigned waiters=0,c,i;
+
+  for(i=0; i<RING; i++)
+    sem_init(&ring[i],0,0);
+  sem_init(&never,0,0);
+  sem_init(&done,0,0);
+  for(i=0; i<RING; i++)
+    TEST_CHECK(execi(ring_task,i,NULL,PRIO_RING,DEFAULT_STACK_SIZE)!=-1);
+
+#ifdef CONF_TM_READYQ
+  TEST_CHECK(execi(waiter,0,NULL,PRIO_HIGHEST+1,DEFAULT_STACK_SIZE)==-1);
+#endif
+
+  test_printf("%s, %d tasks in the ring\n",SCHEDULER,RING);
+  for(c=0; c<sizeof(counts)/sizeof(counts[0]); c++) {
+    unsigned long long start;
+
+    while(waiters<counts[c]) {
+      TEST_CHECK(execi(waiter,0,NULL,
+                       PRIO_WAITERS+waiters%(PRIO_HIGHEST-PRIO_WAITERS+1),
+                       DEFAULT_STACK_SIZE)!=-1);
+      waiters++;
+    }
+    msleep(10);				// let them block
+
+    start=test_nsecs();
+    target=rounds+nrounds;
+    sem_post(&ring[0]);
+    sem_wait(&done);
+    TEST_CHECK(rounds==target);
+    test_printf("  %3u waiting: %6llu ns per hand-off\n",waiters,
+                (test_nsecs()-start)/(nrounds*RING));
+  }
+  test_exit();
+}
+
+int main(int argc,char **argv) {
+  const char *arg;
+
+  if(argc>1)
+    for(nrounds=0, arg=argv[1]; *arg>='0' && *arg<='9'; arg++)
+      nrounds=nrounds*10+*arg-'0';
+  host_start(test);
+}
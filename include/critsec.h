@@ -37,6 +37,7 @@ extern "C" {
 #if defined(CONF_TM) && defined(CONF_CRITICAL_SECTIONS)
 #include <sys/tm.h>
 #include <atomic.h>
+#include <unistd.h>
 
 #ifndef DOXYGEN_SHOULD_SKIP_INTERNALS
 //! critical section data structure
@@ -98,7 +99,11 @@ extern int enter_critical_section(critsec_t* cs);
     \sa enter_critical_section
     \sa destroy_critical_section
  */
-#define leave_critical_section(cs) atomic_dec(&(cs)->count)
+#ifdef CONF_TM_INHERIT
+extern int leave_critical_section(critsec_t* cs);
+#else
+#define leave_critical_section(cs) (atomic_dec(&(cs)->count),notify_event(cs))
+#endif
 
 //! destroy critical section (does nothing)
 /*! currently there are no resources that are dynamically
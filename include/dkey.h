@@ -64,6 +64,11 @@ extern volatile unsigned char dkey_multi;
  */
 extern volatile unsigned char dkey;
 
+//! the debouncing timer
+/*! non-zero while a key change settles.
+ */
+extern char dkey_timer;
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Functions
@@ -79,6 +84,10 @@ extern wakeup_t dkey_pressed(wakeup_t data);
 //
 extern wakeup_t dkey_released(wakeup_t data);
 
+#ifdef CONF_HOST
+#define getchar	dkey_getchar		// not the C library's
+#endif
+
   //! wait for keypress and return key code.
 /*! key combinations not admissible.
  */
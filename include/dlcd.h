@@ -35,6 +35,7 @@
 extern "C" {
 #endif
 
+#include <config.h>
 #include <sys/bitops.h>
 
 ///////////////////////////////////////////////////////////////////////
@@ -188,7 +189,12 @@ extern "C" {
 
 //! helper macros
 //
+#ifdef CONF_HOST
+extern unsigned char display_memory[];	// simulated 0xef43..0xef4b
+#define BYTE_OF(a,b)	(display_memory+((a)-0xef43))
+#else
 #define BYTE_OF(a,b)	a
+#endif
 #define BIT_OF(a,b)	b
 
 #ifdef  __cplusplus
@@ -34,20 +34,61 @@ extern "C" {
 
 #ifdef CONF_LNP
 
-#ifdef CONF_HOST
+#if defined(CONF_HOST) && !defined(CONF_HOST_SIM)
 #include <stddef.h>
 #else
 #include <mem.h>
 #include <sys/h8.h>
 #endif
 
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+#define LNP_IOV_MAX	4	//!< max. segments of a frame
+
+//! a segment of a frame to transmit
+typedef struct {
+  const void *base;		//!< first byte
+  size_t len;			//!< number of bytes
+} lnp_iovec_t;
+
+#ifdef CONF_LNP_ASYNC
+#define LNP_TX_QUEUE	4	//!< max. queued frames, a power of 2
+
+typedef struct lnp_tx lnp_tx_t;
+
+//! transmit completion callback
+/*! called from the receive interrupt handler or the system tick,
+ *  with IRQs disabled. tx->state tells how it went.
+*/
+typedef void (*lnp_tx_done_t)(lnp_tx_t *tx);
+
+//! a queued frame
+/*! owned by the sender, and must not be touched while lnp_tx_pending().
+ *  the integrity and addressing layers keep their header and checksum
+ *  in it, so the frame needs no other storage than the payload.
+*/
+struct lnp_tx {
+  lnp_iovec_t iov[LNP_IOV_MAX];	//!< the segments
+  unsigned char count;		//!< number of segments
+  unsigned char header[4];	//!< integrity/addressing header
+  unsigned char sum;		//!< integrity checksum
+  volatile signed char state;	//!< TX_QUEUED, TX_ACTIVE, TX_IDLE or TX_COLL
+  size_t len;			//!< frame length
+  lnp_tx_done_t done;		//!< completion callback, or NULL
+};
+#endif // CONF_LNP_ASYNC
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Functions
 //
 ///////////////////////////////////////////////////////////////////////
 
-#ifndef CONF_HOST
+#if !defined(CONF_HOST) || defined(CONF_HOST_SIM)
 //! Set the IR transmitter range
 /*! Configure the INFRARED transmitter power
  *  \param far:  0: sets short range, 1: sets long range
@@ -86,6 +127,46 @@ extern inline int lnp_logical_range_is_far(void) {
 */
 extern int lnp_logical_write(const void *buf,size_t len);
 
+//! Write segments to IR port as one frame
+/*! The segments are transmitted one after another, straight from
+ *  where they are; nothing is copied.
+ * \param iov the segments, at most LNP_IOV_MAX non-empty ones
+ * \param count number of segments
+ * \return 0 if OK, else collision
+ *
+ *  NOTE: doesn't return until all are written, so the segments
+ *  may live on the caller's stack (blocking write)
+*/
+extern int lnp_logical_writev(const lnp_iovec_t *iov,unsigned char count);
+
+#ifdef CONF_LNP_ASYNC
+//! Queue a write to the IR port
+/*! \param tx frame handle, must stay valid until done
+ * \param buf data to transmit, must stay valid until done
+ * \param len number of bytes to transmit
+ * \param done completion callback, or NULL
+ * \return 0 if queued, -1 if the queue is full
+ *
+ *  NOTE: returns at once. the frame is done when lnp_tx_pending()
+ *  is false, then tx->state is 0 if OK, else collision.
+*/
+extern int lnp_logical_write_async(lnp_tx_t *tx,const void *buf,size_t len,
+                                   lnp_tx_done_t done);
+
+//! Take a queued frame back, or abort it while on the air
+/*! \param tx frame handle
+ *
+ *  NOTE: done is called with state collision, unless the frame
+ *  was done already.
+*/
+extern void lnp_tx_cancel(lnp_tx_t *tx);
+
+//! Is a queued frame still waiting or being transmitted?
+extern inline int lnp_tx_pending(const lnp_tx_t *tx) {
+  return tx->state>0;
+}
+#endif // CONF_LNP_ASYNC
+
 //! Empty the IR receive buffer.
 /*!  \return Nothing
 */
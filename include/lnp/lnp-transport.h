@@ -0,0 +1,197 @@
+/*! \file   include/lnp/lnp-transport.h
+    \brief  LNP Interface: reliable sliding window transport
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License
+ *  at http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ *  the License for the specific language governing rights and
+ *  limitations under the License.
+ */
+
+#ifndef __lnp_transport_h__
+#define __lnp_transport_h__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <config.h>
+
+#ifdef CONF_LNP_TRANSPORT
+
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! max. payload of a transport frame, two bytes less than LNP's
+#define LNP_TP_MTU          251
+
+#define LNP_TP_WINDOW_MAX   16    //!< max. frames in flight
+#define LNP_TP_WINDOW       4     //!< default frames in flight
+#define LNP_TP_RTO          500   //!< ms of silence before retransmitting
+#define LNP_TP_RETRIES      5     //!< timeouts in a row before giving up
+
+//! frame types, first byte of the addressing layer payload
+/*! DATA: 2+n: b[type] b[seq] array[payload]
+    ACK:  3:   b[type] b[next seq expected] b[free receive slots]
+*/
+#define LNP_TP_DATA         0x10  //!< data frame
+#define LNP_TP_SYN          0x01  //!< flag: first frame of a stream
+#define LNP_TP_ACK          0x20  //!< cumulative acknowledgement
+
+//! bytes of buffer a transport with the given window and size needs
+#define LNP_TP_BUFSIZE(window,size)  (2*(window)*((size)+1))
+
+//! transport state
+/*! go-back-n: the sender keeps up to window frames in flight and
+    resends all of them from the oldest after a timeout. the receiver
+    takes frames in order only, queues them until they are read and
+    acknowledges every frame with the next sequence number it expects
+    and the slots it has free.
+
+    the protocol engine below only keeps state; the caller moves
+    frames between it and the link and supplies the time in ms.
+*/
+typedef struct lnp_tp {
+  unsigned char window;         //!< frames in flight and queued
+  unsigned char size;           //!< max. payload of a frame
+  unsigned rto;                 //!< ms of silence before retransmitting
+  unsigned byte_time;           //!< ms to transmit a byte
+
+  unsigned char *tx;            //!< window send slots: length, payload
+  unsigned char *rx;            //!< window receive slots: length, payload
+
+  unsigned char snd_iss;        //!< sequence number of the first frame
+  unsigned char snd_una;        //!< oldest frame not acknowledged
+  unsigned char snd_nxt;        //!< next frame to transmit
+  unsigned char snd_max;        //!< frame after the last one transmitted
+  unsigned char snd_end;        //!< frame after the last one queued
+  unsigned char snd_wnd;        //!< frames the receiver will take
+  unsigned char syn;            //!< first frame not acknowledged yet
+  unsigned char probe;          //!< send one frame despite snd_wnd
+  unsigned char timeouts;       //!< timeouts without progress
+  unsigned long timer;          //!< retransmit deadline, if running
+
+  unsigned char rcv_nxt;        //!< next frame expected
+  unsigned char rcv_head;       //!< oldest frame not read
+  volatile unsigned char rcv_count;     //!< frames not read
+  unsigned char rcv_syn;        //!< sequence number of the last SYN
+  unsigned char rcv_synced;     //!< a SYN was received
+  volatile unsigned char ack_due;       //!< an ack must be sent
+
+  unsigned frames;              //!< frames transmitted
+  unsigned resent;              //!< frames retransmitted
+
+  unsigned char port;           //!< local port
+  unsigned char peer;           //!< remote address and port
+  struct lnp_tp *next;          //!< next open transport
+} lnp_tp_t;
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! set up the protocol engine
+/*! \param tp the transport
+    \param buf LNP_TP_BUFSIZE(window,size) bytes for the frames
+    \param window frames in flight, at most LNP_TP_WINDOW_MAX
+    \param size max. payload of a frame, at most LNP_TP_MTU
+    \param iss first sequence number, should differ between streams
+*/
+extern void lnp_tp_init(lnp_tp_t *tp,unsigned char *buf,unsigned char window,
+                        unsigned char size,unsigned char iss);
+
+//! queue a frame for transmission
+/*! \return 0 if queued, -1 if window frames are queued or len > size
+*/
+extern int lnp_tp_queue(lnp_tp_t *tp,const void *data,unsigned char len);
+
+//! take the oldest received frame
+/*! \param buf buffer of size bytes
+    \return length of the payload, -1 if there is none
+*/
+extern int lnp_tp_read(lnp_tp_t *tp,void *buf);
+
+//! pass a frame received from the peer
+/*! \param data addressing layer payload
+    \param len its length
+    \param now the time in ms
+
+    IRQ handler safe, transmits nothing.
+*/
+extern void lnp_tp_input(lnp_tp_t *tp,const unsigned char *data,
+                         unsigned char len,unsigned long now);
+
+//! get the next frame to transmit
+/*! \param buf buffer of size+2 bytes for the frame
+    \param now the time in ms
+    \return length of the frame, 0 if there is nothing to transmit
+*/
+extern int lnp_tp_output(lnp_tp_t *tp,unsigned char *buf,unsigned long now);
+
+//! can a frame be queued?
+extern inline int lnp_tp_space(const lnp_tp_t *tp) {
+  return (unsigned char) (tp->snd_end-tp->snd_una) < tp->window;
+}
+
+//! have all queued frames been acknowledged?
+extern inline int lnp_tp_done(const lnp_tp_t *tp) {
+  return tp->snd_una==tp->snd_end;
+}
+
+//! has the peer stopped answering?
+extern inline int lnp_tp_failed(const lnp_tp_t *tp) {
+  return tp->timeouts>LNP_TP_RETRIES;
+}
+
+//! open a transport to a peer
+/*! \param tp the transport
+    \param port local port, its addressing handler is taken over
+    \param peer remote address and port
+    \param window frames in flight, 0 for LNP_TP_WINDOW
+    \param size max. payload of a frame, at most LNP_TP_MTU
+    \return 0 on success, -1 if out of memory or the peer has a transport
+
+    the transport only moves frames while a task is in lnp_tp_send(),
+    lnp_tp_recv() or lnp_tp_flush(). the host utilities have their
+    own implementation of these, on top of the tower.
+*/
+extern int lnp_tp_open(lnp_tp_t *tp,unsigned char port,unsigned char peer,
+                       unsigned char window,unsigned char size);
+
+//! close a transport, dropping frames not yet acknowledged
+extern void lnp_tp_close(lnp_tp_t *tp);
+
+//! send a frame, blocking while the window is full
+/*! \return 0 if queued, -1 if the peer stopped answering or on shutdown
+*/
+extern int lnp_tp_send(lnp_tp_t *tp,const void *data,unsigned char len);
+
+//! receive a frame, blocking
+/*! \param buf buffer of size bytes
+    \return length of the payload, -1 on shutdown
+*/
+extern int lnp_tp_recv(lnp_tp_t *tp,void *buf);
+
+//! wait until all frames sent have been acknowledged
+/*! \return 0 if they have, -1 if the peer stopped answering or on shutdown
+*/
+extern int lnp_tp_flush(lnp_tp_t *tp);
+
+#endif // CONF_LNP_TRANSPORT
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // __lnp_transport_h__
@@ -37,6 +37,9 @@ extern "C" {
 #ifdef CONF_RCX_MESSAGE
 #include <unistd.h>
 #endif
+#ifdef CONF_LNP_ASYNC
+#include "lnp-logical.h"
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -60,6 +63,11 @@ typedef void (*lnp_addressing_handler_t) (const unsigned char *, unsigned char,
 //! dummy addressing layer packet handler
 #define LNP_DUMMY_ADDRESSING ((lnp_addressing_handler_t)0)
 
+#ifdef CONF_LNP_PORTQ
+//! max. payload of an addressing layer packet
+#define LNP_PORT_MTU  253
+#endif
+
 #ifdef CONF_RCX_PROTOCOL
 //! handler for remote
 /*! arguments are (buttonstate)
@@ -163,6 +171,71 @@ extern int lnp_integrity_write(const unsigned char *data,unsigned char length);
 extern int lnp_addressing_write(const unsigned char *data,unsigned char length,
                          unsigned char dest,unsigned char srcport);
 
+//! send a frame made of a header and a payload, adding the checksum
+/*! the frame is transmitted straight from header and data, without
+    a transmit buffer.
+    \param header header bytes, starting with the packet type
+    \param hlength length of header
+    \param data payload, owned by the caller
+    \param length length of data
+    \return 0 on success.
+*/
+extern int lnp_frame_write(const unsigned char *header,unsigned char hlength,
+                           const unsigned char *data,unsigned char length);
+
+#ifdef CONF_LNP_PORTQ
+//! give a port a receive ring
+/*! packets for the port are queued in the ring instead of being
+    passed to its handler, which runs in interrupt context. close
+    the ring before the program exits.
+    \param port the port
+    \param depth number of packets the ring holds, e.g. CONF_LNP_PORTQ
+    \param size max. payload of a packet, at most LNP_PORT_MTU
+    \return 0 on success, -1 if out of memory or the port has a ring
+*/
+extern int lnp_port_open(unsigned char port,unsigned char depth,
+                         unsigned char size);
+
+//! take the receive ring from a port and free it
+extern void lnp_port_close(unsigned char port);
+
+//! receive a packet from the ring of a port, blocking
+/*! \param port the port
+    \param buf buffer for the payload, as large as the ring's size
+    \param src where to store the sender's address, or NULL
+    \return length of the payload, -1 if the port has no ring
+             or the task is shut down
+
+    several tasks may wait on a port, each packet goes to one of them.
+*/
+extern int lnp_port_recv(unsigned char port,unsigned char *buf,
+                         unsigned char *src);
+
+//! packets dropped by the ring of a port since the last call
+/*! \return number of dropped packets, 255 for 255 or more
+*/
+extern unsigned char lnp_port_dropped(unsigned char port);
+#endif // CONF_LNP_PORTQ
+
+#ifdef CONF_LNP_ASYNC
+//! queue a LNP integrity layer packet of given length
+/*! returns at once. tx and data must stay valid until
+    lnp_tx_pending(tx) is false, done is called then.
+    \return 0 if queued, -1 if the transmit queue is full.
+*/
+extern int lnp_integrity_write_async(lnp_tx_t *tx,const unsigned char *data,
+                                     unsigned char length,lnp_tx_done_t done);
+
+//! queue a LNP addressing layer packet of given length
+/*! like lnp_integrity_write_async().
+    \return 0 if queued, -1 if the transmit queue is full.
+*/
+extern int lnp_addressing_write_async(lnp_tx_t *tx,const unsigned char *data,
+                                      unsigned char length,unsigned char dest,
+                                      unsigned char srcport,
+                                      lnp_tx_done_t done);
+#endif // CONF_LNP_ASYNC
+
 #endif // CONF_LNP
 
 #ifdef  __cplusplus
@@ -0,0 +1,72 @@
+/*! \file   include/lnp/lzss.h
+    \brief  LZSS decompression of downloaded programs
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License
+ *  at http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ *  the License for the specific language governing rights and
+ *  limitations under the License.
+ */
+
+#ifndef __lzss_h__
+#define __lzss_h__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <config.h>
+
+#ifdef CONF_PROGRAM_LZSS
+
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! the token stream
+/*! a flag byte precedes each group of up to 8 tokens, its bits from
+    the least significant one on tell the kind of each token:
+    1: literal   1: b[byte]
+    0: match     2: b[(length-LZSS_MIN)<<4 | (distance-1)>>8]
+                    b[(distance-1) & 0xff]
+    a match copies length bytes from distance bytes back in the
+    output, which may overlap the bytes it produces. the output
+    itself is the window, so the decoder needs no memory of its own.
+*/
+#define LZSS_MIN            3     //!< shortest match
+#define LZSS_MAX            18    //!< longest match
+#define LZSS_WINDOW         4096  //!< farthest match
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! expand a token stream
+/*! \param dst where to expand to
+    \param done bytes already expanded before dst, matches may reach back
+           this far
+    \param room bytes free at dst
+    \param src the tokens, whole ones only
+    \param len length of src
+    \return bytes expanded, -1 if the stream is corrupt or doesn't fit
+*/
+extern int lzss_decode(unsigned char *dst,unsigned done,unsigned room,
+                       const unsigned char *src,unsigned len);
+
+#endif // CONF_PROGRAM_LZSS
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // __lzss_h__
@@ -32,6 +32,8 @@
 #ifndef __sys_irq_h__
 #define __sys_irq_h__
 
+#include <config.h>
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -42,7 +44,7 @@ extern "C" {
 //
 ///////////////////////////////////////////////////////////////////////
 
-#ifdef CONF_RCX_COMPILER
+#if defined(CONF_RCX_COMPILER) || defined(CONF_HOST)
 #define HANDLER_WRAPPER(wrapstring,handstring)
 #else
 #define HANDLER_WRAPPER(wrapstring,handstring) \
@@ -94,6 +96,14 @@ extern void rom_dummy_handler(); //!< address of an RTS instruction
 //
 ///////////////////////////////////////////////////////////////////////
 
+#ifdef CONF_HOST
+// the simulated hardware blocks its interrupt signals instead.
+//
+extern void disable_irqs(void);
+extern void enable_irqs(void);
+extern unsigned char irq_save(void);
+extern void irq_restore(unsigned char ccr);
+#else
 //! disable interrupt processing
 extern inline void disable_irqs() {
   __asm__ __volatile__("\torc  #0x80,ccr\n":::"cc");
@@ -104,6 +114,21 @@ extern inline void enable_irqs() {
   __asm__ __volatile__("\tandc #0x7f,ccr\n":::"cc");
 }
 
+//! disable interrupt processing
+/*! \return previous flags, to be passed to irq_restore()
+*/
+extern inline unsigned char irq_save() {
+  unsigned char ccr;
+  __asm__ __volatile__("\tstc  ccr,%0\n\torc  #0x80,ccr\n":"=r"(ccr)::"cc");
+  return ccr;
+}
+
+//! restore interrupt processing state saved by irq_save()
+extern inline void irq_restore(unsigned char ccr) {
+  __asm__ __volatile__("\tldc  %0,ccr\n"::"r"(ccr):"cc");
+}
+#endif // CONF_HOST
+
 #ifdef  __cplusplus
 }
 #endif
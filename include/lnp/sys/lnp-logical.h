@@ -34,7 +34,7 @@ extern "C" {
 
 #ifdef CONF_LNP
 
-#ifndef CONF_HOST
+#if !defined(CONF_HOST) || defined(CONF_HOST_SIM)
 #include <time.h>
 #else
 #define MSECS_TO_TICKS(a)   (a)
@@ -66,6 +66,7 @@ extern "C" {
 #define TX_COLL   (-1)    //!< not transmitting, last xmit was collision
 #define TX_IDLE   ( 0)    //!< not transmitting, last xmit OK
 #define TX_ACTIVE ( 1)    //!< currently transmitting
+#define TX_QUEUED ( 2)    //!< frame waiting in the transmit queue
 
 
 ///////////////////////////////////////////////////////////////////////
@@ -76,6 +77,10 @@ extern "C" {
 
 extern volatile signed char tx_state;   //!< transmit status
 
+#ifdef CONF_LNP_ASYNC
+extern volatile unsigned char tx_queued;  //!< frames in the transmit queue
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -100,6 +105,26 @@ void txend_handler(void)
 #endif
 ;
 
+//! Abort the frame on the air as a collision
+/*! IRQs must be disabled.
+*/
+extern void lnp_tx_abort(void);
+
+#ifdef CONF_LNP_ASYNC
+//! Queue a frame of tx->count segments, non-blocking
+/*! \return 0 if queued, -1 if full
+*/
+extern int lnp_logical_queue(lnp_tx_t *tx);
+
+//! Start the next queued frame if the medium is free
+/*! called by the system tick while frames are queued
+*/
+extern void lnp_tx_handler(void);
+
+//! Drop all queued frames, without callbacks
+extern void lnp_tx_flush(void);
+#endif
+
 #endif  // CONF_LNP
 
 #ifdef  __cplusplus
@@ -45,6 +45,9 @@ extern "C" {
 //! LNP port mask is derived from host mask
 #define LNP_PORTMASK  (0x00ff & ~CONF_LNP_HOSTMASK)
 
+//! the highest host address, received by all nodes with CONF_LNP_BROADCAST
+#define LNP_BROADCAST CONF_LNP_HOSTMASK
+
 #if defined(CONF_RCX_PROTOCOL) || defined(CONF_RCX_MESSAGE)
 //! length of header from remote/rcx, -1 because first byte is used to id sequence
 #define LNP_RCX_HEADER_LENGTH (3-1)
@@ -56,6 +59,16 @@ extern "C" {
 #define LNP_RCX_MSG_OP_LENGTH (5-3)
 #endif
 
+#ifdef CONF_HOST
+//! handler for the frames the integrity layer takes apart
+/*! \param frame the frame, from the header to the checksum
+    \param length its length
+    \param valid nonzero if its checksum matched
+*/
+typedef void (*lnp_monitor_handler_t) (const unsigned char *frame,
+                                       unsigned length, int valid);
+#endif
+
 //! states for the integrity layer state machine
 typedef enum {
   LNPwaitHeader,
@@ -93,6 +106,22 @@ typedef enum {
 #endif
 } lnp_integrity_state_t;
 
+#ifdef CONF_LNP_PORTQ
+//! a port receive ring
+/*! slot n is at slots+n*(size+2) and holds length, sender and
+    payload of a packet. the interrupt handler appends behind
+    the count slots starting at head.
+*/
+typedef struct {
+  unsigned char head;           //!< oldest packet
+  volatile unsigned char count; //!< packets in the ring
+  unsigned char depth;          //!< number of slots
+  unsigned char size;           //!< max. payload of a slot
+  unsigned char dropped;        //!< packets dropped, saturating
+  unsigned char slots[0];       //!< the slots
+} lnp_port_t;
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -109,6 +138,11 @@ extern unsigned short lnp_timeout;
 //! the integrity layer state
 extern lnp_integrity_state_t lnp_integrity_state;
 
+#ifdef CONF_HOST
+//! sees every frame before it is handled, for capture tools
+extern lnp_monitor_handler_t lnp_monitor_handler;
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -116,8 +150,11 @@ extern lnp_integrity_state_t lnp_integrity_state;
 //
 ///////////////////////////////////////////////////////////////////////
 
-//! the LNP `copy and compute checksum' function.
-extern unsigned char lnp_checksum_copy( unsigned char *dest,
+//! the LNP checksum function.
+/*! \param sum checksum of the bytes before data
+    \return sum plus the bytes of data
+*/
+extern unsigned char lnp_checksum( unsigned char sum,
           const unsigned char *data,
           unsigned length );
 
@@ -26,6 +26,8 @@
 #ifndef __mem_h__
 #define __mem_h__
 
+#include <config.h>
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Definitions
@@ -34,6 +36,10 @@
 
 #define NULL		((void*)0)	//!< null pointer value
 
+#ifdef CONF_HOST
+typedef __SIZE_TYPE__	size_t;		//!< data type for memory sizes
+#else
 typedef unsigned	size_t;		//!< data type for memory sizes
+#endif
 
 #endif
@@ -0,0 +1,88 @@
+/*! \file   include/mutex.h
+    \brief  Interface: mutexes for task synchronization
+ */
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License
+ *  at http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ *  the License for the specific language governing rights and
+ *  limitations under the License.
+ */
+
+#ifndef __mutex_h__
+#define __mutex_h__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <config.h>
+
+#ifdef CONF_MUTEX
+
+#include <tm.h>
+
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! the mutex data-type
+/*! unlike a semaphore, a mutex has an owner. with CONF_TM_INHERIT,
+    the owner runs at the priority of the highest priority task
+    waiting for it.
+*/
+typedef struct {
+  tdata_t * volatile owner;                     //!< locking task, or NULL
+} mutex_t;
+
+//! static initializer for an unlocked mutex
+#define MUTEX_INITIALIZER  { NULL }
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! initialize a mutex
+/*! \param mutex the mutex, which is unlocked afterwards
+ */
+#define mutex_init(mutex)     ((mutex)->owner=NULL)
+
+//! lock a mutex, waiting until it is available
+/*! mutexes are not recursive.
+ *  \param mutex a valid mutex
+ *  \return 0 on success, -1 if the task was asked to shutdown
+ */
+extern int mutex_lock(mutex_t *mutex);
+
+//! lock a mutex if it is available
+/*! \param mutex a valid mutex
+ *  \return 0 on success, -1 if it is locked
+ */
+extern int mutex_trylock(mutex_t *mutex);
+
+//! unlock a mutex
+/*! must be called by the task that locked it.
+ *  \param mutex a valid mutex
+ *  \return always 0
+ */
+extern int mutex_unlock(mutex_t *mutex);
+
+//! destroy a mutex (does nothing)
+#define mutex_destroy(mutex)
+
+#endif // CONF_MUTEX
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // __mutex_h__
@@ -35,6 +35,8 @@
 extern "C" {
 #endif
 
+#include <config.h>
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Definitions
@@ -150,6 +152,14 @@ typedef enum {
 #define ASMVOLATILE __volatile__
 #endif
 
+#ifdef CONF_HOST
+// ROM calls are simulated by the host build
+//
+extern void lcd_show(lcd_segment segment);
+extern void lcd_hide(lcd_segment segment);
+extern void lcd_number(int i, lcd_number_style n, lcd_comma_style c);
+extern void lcd_clear(void);
+#else
 //! show LCD segment
 /*! \param segment segment to show
  */
@@ -196,6 +206,7 @@ extern inline void lcd_clear(void)
 		       "pop r6\n"
   );
 }
+#endif // CONF_HOST
 
 #ifdef  __cplusplus
 }
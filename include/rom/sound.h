@@ -30,6 +30,8 @@
 #ifndef __rom_sound_h__
 #define __rom_sound_h__
 
+#include <config.h>
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -47,6 +49,10 @@ extern "C" {
  *   implemented at this time.
  *  \bug FIXME: register clobbers
 */
+#ifdef CONF_HOST
+extern void sound_system(unsigned nr);
+extern int sound_playing(void);
+#else
 extern inline void sound_system(unsigned nr)
 {
   __asm__ __volatile__(
@@ -80,6 +86,7 @@ extern inline int sound_playing(void)
 
   return rc;
 }
+#endif // CONF_HOST
 
 #ifdef  __cplusplus
 }
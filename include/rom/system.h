@@ -26,6 +26,8 @@
 #ifndef __rom_system_h__
 #define __rom_system_h__
 
+#include <config.h>
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -38,6 +40,13 @@ extern "C" {
 //
 ///////////////////////////////////////////////////////////////////////
 
+#ifdef CONF_HOST
+//! enters software standby mode.
+extern void power_off(void);
+
+//! disables software standby mode.
+extern void power_init(void);
+#else
 //! enters software standby mode.
 extern inline void power_off(void)
 {
@@ -59,6 +68,7 @@ extern inline void power_init(void) {
   pop r6\n\
 ");
 }
+#endif // CONF_HOST
 
 //! erases BrickOS, returning control to ROM.
 extern void reset(void) __attribute__((noreturn));
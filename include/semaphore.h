@@ -34,6 +34,10 @@ extern "C" {
 #include <config.h>
 #include <time.h> /* time_t */
 #include <atomic.h>
+#include <unistd.h> /* notify_event() */
+#ifdef CONF_TRACE
+#include <sys/trace.h>
+#endif
 
 #ifdef CONF_SEMAPHORES
 
@@ -123,6 +127,10 @@ extern int sem_trywait(sem_t * sem);
 extern inline int sem_post(sem_t * sem) 
 { 
 	atomic_inc(sem);
+#ifdef CONF_TRACE
+	trace_event(TRACE_SEM_POST,*sem,(unsigned) ((size_t)sem));
+#endif
+	notify_event((void*) sem);
 	return 0;
 }
 
@@ -35,6 +35,16 @@ extern "C" {
 
 #include <mem.h>
 
+#ifdef CONF_HOST
+// the host build links against the C library of the PC.
+// keep the kernel allocator from replacing its malloc(). function-like,
+// so members and variables of the same name are left alone.
+//
+#define calloc(nmemb,size)	mm_calloc(nmemb,size)
+#define malloc(size)		mm_malloc(size)
+#define free(ptr)		mm_free(ptr)
+#endif
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Functions
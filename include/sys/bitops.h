@@ -30,12 +30,35 @@
 extern "C" {
 #endif
 
+#include <config.h>
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Functions
 //
 ///////////////////////////////////////////////////////////////////////
 
+#ifdef CONF_HOST
+//
+// plain C on the host. the carry flag is simulated.
+//
+
+extern unsigned char bit_carry;		//!< simulated carry flag
+
+#define bit_set(byte,bit)	\
+  (*((volatile unsigned char*)(byte))|=(1<<(bit)))
+#define bit_clear(byte,bit)	\
+  (*((volatile unsigned char*)(byte))&=~(1<<(bit)))
+#define bit_load(mask,bit)	\
+  (bit_carry=((mask)>>(bit))&1)
+#define bit_iload(mask,bit)	\
+  (bit_carry=(~(mask)>>(bit))&1)
+#define bit_store(byte,bit)	\
+  (*((volatile unsigned char*)(byte))=				\
+   (*((volatile unsigned char*)(byte)) & ~(1<<(bit))) | (bit_carry<<(bit)))
+
+#else
+
 // g++ warns about __asm__ const. we define the problem away.
 // the CXX symbol is predefined in the Makefile
 //
@@ -83,6 +106,8 @@ __asm__ ASMCONST ( "bild %0,%1l\n" : : "i" (bit),"r" (mask):"cc")
 #define bit_store(byte,bit)	\
 __asm__ ASMCONST ( "bst %0,@%1\n" : : "i" (bit),"r" (byte))
 
+#endif // CONF_HOST
+
 #ifdef  __cplusplus
 }
 #endif
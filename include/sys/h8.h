@@ -26,6 +26,8 @@
 #ifndef __sys_h8_h__
 #define __sys_h8_h__
 
+#include <config.h>
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -272,6 +274,26 @@ extern          unsigned char S_TCR;
 // A/D converter
 //
 
+#ifdef CONF_HOST
+//! simulated A/D converter data registers A..D
+/*! 16 bit values in native ints, so sensor pointer arithmetic holds.
+*/
+extern volatile unsigned ad_data[4];
+
+#define AD_A	(ad_data[0])	//!< A/D converter data register A
+#define AD_B	(ad_data[1])	//!< A/D converter data register B
+#define AD_C	(ad_data[2])	//!< A/D converter data register C
+#define AD_D	(ad_data[3])	//!< A/D converter data register D
+
+#define AD_A_H	(((volatile unsigned char *) &AD_A)[1])	//!< A high
+#define AD_A_L	(((volatile unsigned char *) &AD_A)[0])	//!< A low
+#define AD_B_H	(((volatile unsigned char *) &AD_B)[1])	//!< B high
+#define AD_B_L	(((volatile unsigned char *) &AD_B)[0])	//!< B low
+#define AD_C_H	(((volatile unsigned char *) &AD_C)[1])	//!< C high
+#define AD_C_L	(((volatile unsigned char *) &AD_C)[0])	//!< C low
+#define AD_D_H	(((volatile unsigned char *) &AD_D)[1])	//!< D high
+#define AD_D_L	(((volatile unsigned char *) &AD_D)[0])	//!< D low
+#else
 //! A/D converter data register A high
 extern volatile unsigned char AD_A_H;
 
@@ -316,6 +338,7 @@ extern volatile unsigned      AD_C;
 //! A/D converter data register D
 /*! bits 0..5 reserved, probably zero */
 extern volatile unsigned      AD_D;
+#endif // CONF_HOST
 
 
 //! A/D converter control / status register
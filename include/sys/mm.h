@@ -53,10 +53,60 @@ extern "C" {
 #define MM_HEADER_SIZE	2			//!< 2 words header: pid, size
 #define MM_SPLIT_THRESH	(MM_HEADER_SIZE+8)	//!< split off if 8+ data bytes
 
+#ifdef CONF_HOST
+#define MM_HOST_WORDS	0x100000		//!< simulated ram in words
+
+extern size_t mm_heap[MM_HOST_WORDS];		//!< simulated ram
+#define mm_start	(mm_heap[0])		//!< start of the heap
+
+//! does a heap walk pointer still point into the heap?
+#define MM_IN_HEAP(ptr)	((ptr)>=&mm_start && (ptr)<mm_heap+MM_HOST_WORDS)
+#else
 extern size_t mm_start;				//!< end of kernel code + data
 
+//! does a heap walk pointer still point into the heap?
+/*! the last block ends at 0xffff, so walks wrap around to 0.
+*/
+#define MM_IN_HEAP(ptr)	((ptr)>=&mm_start)
+#endif
+
+//! size in words of a block of bytes
+#define MM_WORDS(bytes)	(((bytes)+sizeof(size_t)-1)/sizeof(size_t))
+
+#ifdef CONF_MM_SEGREGATED
+
+// segregated fit allocator
+//
+// free blocks are kept on one doubly linked list per power-of-two
+// size class. a free block stores the list links in its first two
+// data words and a pointer to its own header in its last data word
+// (boundary tag), so that free() can find a free predecessor in O(1).
+// bit 15 of the size field tells whether the preceding block is free.
+//
+
+#ifdef CONF_HOST
+#define MM_PREV_FREE	0x80000000UL		//!< size flag: predecessor free
+#define MM_SIZE_MASK	0x7fffffffUL		//!< size field without flags
+#define MM_CLASSES	21			//!< size classes 2^0..2^20 words
+#else
+#define MM_PREV_FREE	0x8000			//!< size flag: predecessor free
+#define MM_SIZE_MASK	0x7fff			//!< size field without flags
+#define MM_CLASSES	15			//!< size classes 2^0..2^14 words
+#endif
+#define MM_MIN_DATA	3			//!< next, prev, boundary tag
+
+//! size of a block in words, without flags
+#define MM_SIZE(ptr)	((*((ptr)+1)) & MM_SIZE_MASK)
+
+extern size_t* mm_free_list[MM_CLASSES];	//!< free lists by size class
+extern unsigned mm_class_map;			//!< bit n set: list n not empty
+
+#else
+
 extern size_t* mm_first_free;			//!< ptr to first free block.
 
+#endif // CONF_MM_SEGREGATED
+
 // Macros for mm_init()
 // Always alternate FREE and RESERVED.
 //
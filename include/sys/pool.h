@@ -0,0 +1,99 @@
+/*! \file   include/sys/pool.h
+    \brief  Internal Interface: fixed-size object pools
+ */
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License
+ *  at http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ *  the License for the specific language governing rights and
+ *  limitations under the License.
+ */
+
+#ifndef __sys_pool_h__
+#define __sys_pool_h__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <config.h>
+
+#ifdef CONF_MM_POOL
+
+#include <mem.h>
+
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! a pool of equally sized objects in a static arena
+/*! objects are handed out from a list of returned objects first,
+    then from the part of the arena that was never used. the
+    first word of a free object links to the next one.
+*/
+typedef struct {
+  void *free;                   //!< list of returned objects
+  char *arena;                  //!< start of arena
+  char *unused;                 //!< first object never handed out
+  char *end;                    //!< end of arena
+  size_t size;                  //!< object size in bytes
+
+  unsigned char used;           //!< objects currently handed out
+  unsigned char high;           //!< high-water mark of used
+  unsigned char misses;         //!< allocations passed on to malloc()
+} pool_t;
+
+//! object size rounded to whole words
+#define POOL_OBJECT_SIZE(size)	(((size)+1) & ~1)
+
+//! static initializer for a pool
+/*! \param arena word aligned storage for count objects
+    \param size  object size, see POOL_OBJECT_SIZE
+    \param count number of objects
+*/
+#define POOL_INITIALIZER(arena,size,count)			\
+	{ NULL, (char*) (arena), (char*) (arena),		\
+	  ((char*) (arena))+POOL_OBJECT_SIZE(size)*(count),	\
+	  POOL_OBJECT_SIZE(size), 0, 0, 0 }
+
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! initialize a pool at run time
+/*! \param pool  the pool
+    \param arena word aligned storage for count objects
+    \param size  object size in bytes
+    \param count number of objects
+*/
+extern void pool_init(pool_t *pool,void *arena,size_t size,unsigned count);
+
+//! allocate an object
+/*! \return pointer to object, NULL if the pool and the heap are exhausted.
+
+    falls back to malloc() when the pool is empty.
+*/
+extern void *pool_alloc(pool_t *pool);
+
+//! return an object
+/*! \param ptr an object from pool_alloc(pool), may be NULL.
+*/
+extern void pool_free(pool_t *pool,void *ptr);
+
+#endif // CONF_MM_POOL
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // __sys_pool_h__
@@ -0,0 +1,106 @@
+/*! \file   include/sys/profile.h
+    \brief  Internal Interface: PC sampling profiler
+ */
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License
+ *  at http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ *  the License for the specific language governing rights and
+ *  limitations under the License.
+ */
+
+#ifndef __sys_profile_h__
+#define __sys_profile_h__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <config.h>
+
+#ifdef CONF_PROFILE
+
+#include <mem.h>
+#include <sys/program.h>
+
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+#define PROFILE_KERNEL		0	//!< range id of the kernel .text
+#define PROFILE_KERNEL_HI	1	//!< range id of the kernel .text.hi
+#define PROFILE_PROGRAM		2	//!< range id of program 0
+
+#define PROFILE_RANGES	(PROFILE_PROGRAM+PROG_MAX)	//!< max. ranges
+#define PROFILE_CHUNK	120	//!< bins per PROFdata packet
+
+//! a text range covered by the histogram
+/*! bin 0 counts samples outside of all ranges (ROM, stacks).
+*/
+typedef struct {
+  unsigned base;                //!< first address
+  unsigned size;                //!< size in bytes
+  unsigned bin;                 //!< bin of base
+  unsigned char id;             //!< PROFILE_KERNEL ...
+} profile_range_t;
+
+//! profiler commands, second byte of a CMDprofile packet
+/*! all replies go to the sender's port and start with CMDprofile, too.
+*/
+typedef enum {
+  PROFstart,                    //!< 2+1: b[shift], reply as PROFstop
+                                //!<   with n=0 if out of memory
+  PROFstop,                     //!< 2: reply 2+8+7n: l[samples] b[shift]
+                                //!<   b[n] s[bins]
+                                //!<   n * (b[id] s[base] s[size] s[bin])
+  PROFread,                     //!< 2+2: s[first bin]
+                                //!< reply PROFdata..., PROFend
+  PROFdata,                     //!< 2+2+2n: s[bin] s[count]*n
+  PROFend                       //!< 2+6: s[bins] l[samples]
+} profile_cmd_t;
+
+///////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////
+
+extern volatile unsigned char profile_active;   //!< sampling enabled
+extern volatile unsigned long profile_samples;  //!< samples taken
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! count a sample, called by the task switch handler
+/*! \param pc the interrupted program counter
+*/
+extern void profile_sample(unsigned pc);
+
+//! handle a CMDprofile packet from the program port
+/*! \param data packet data after the CMDprofile byte
+    \param length length of data
+    \param src address to reply to
+*/
+extern void profile_command(const unsigned char *data,unsigned char length,
+                            unsigned char src);
+
+//! stop sampling and free the histogram
+extern void profile_shutdown(void);
+
+#endif // CONF_PROFILE
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // __sys_profile_h__
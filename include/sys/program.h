@@ -63,6 +63,9 @@ typedef struct {
   priority_t prio;    	//!< priority to run this program at
 
   size_t downloaded;  	//!< number of bytes downloaded so far.
+#ifdef CONF_PROGRAM_MULTICAST
+  unsigned char *missing;	//!< bitmap of the CMDmulticast chunks to come
+#endif
 } program_t;
 
 /**
@@ -79,9 +82,39 @@ typedef enum {
   CMDrun,     	      	//!< 1+ 1: b[nr]
   CMDirmode,		//!< 1+ 1: b[0=near/1=far]
   CMDsethost,			//!< 1+ 1: b[hostaddr]
+  CMDprofile,			//!< 1+>1: b[profile_cmd_t] ...
+  CMDtrace,			//!< 1+>1: b[trace_cmd_t] ...
+  CMDwindow,			//!< 1+>3: b[nr|PROG_ACK|PROG_LZSS] s[offset]
+				//         array[data], reply 1+3: b[nr]
+				//         s[downloaded]
+  CMDsums,			//!< 1+ 3: b[nr] s[first block], reply 1+>11:
+				//         b[nr] s[text] s[textsize] s[datasize]
+				//         s[bsssize] s[first block] array[s[crc]]
+  CMDpatch,			//!< 1+>3: b[nr] s[offset] array[data]
+  CMDcommit,			//!< 1+ 8: b[nr] s[stacksize] s[start] s[crc]
+				//         b[prio]
+  CMDmulticast,			//!< 1+>19: b[nr] s[base] s[offset]
+				//         array[b[relocs]] array[data], no reply
+  CMDmissing,			//!< 1+ 1: b[nr], reply 1+>3: b[nr] s[chunks]
+				//         array[b[bitmap]]
   CMDlast     	      	//!< ?
 } packet_cmd_t;
 
+//! CMDwindow: acknowledge this chunk with the bytes downloaded so far
+#define PROG_ACK	0x80
+//! CMDwindow: the data are LZSS tokens, see lzss.h
+#define PROG_LZSS	0x40
+
+//! CMDsums: bytes of the program image per checksum
+#define PROG_BLOCK	64
+//! CMDsums: max. checksums per reply
+#define PROG_SUMS	120
+
+//! CMDmulticast: bytes per chunk, the last one may be shorter
+#define PROG_CHUNK	0xe0
+//! CMDmulticast: bitmap of the words of a chunk to relocate, in bytes
+#define PROG_RELOCS	(PROG_CHUNK/16)
+
 #endif /* DOXYGEN_SHOULD_SKIP_INTERNALS */
 
 ///////////////////////////////////////////////////////////////////////
@@ -105,6 +138,14 @@ extern void program_stop(int flag);
 /*! \return 0 if invalid */
 extern int program_valid(unsigned nr);
 
+#ifdef CONF_PROFILE
+//! text segment of a program
+/*! \param size set to the text size
+    \return NULL if the program is invalid
+*/
+extern void *program_text(unsigned nr,size_t *size);
+#endif
+
 //! initialize program support
 extern void program_init();
 
@@ -44,6 +44,11 @@ extern "C" {
 #define TM_DEFAULT_SLICE 20	//!< default multitasking timeslice
 #endif
 
+#ifdef CONF_TM_TICKLESS
+#define SYSTIME_IDLE_MIN   4	//!< shortest tickless sleep in ms
+#define SYSTIME_IDLE_MAX 100	//!< longest tickless sleep in ms (key latency)
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -57,6 +62,17 @@ extern "C" {
 extern void* systime_tm_return;
 #endif
 
+#ifdef CONF_TM_TICKLESS
+//! number of system ticks suppressed by tickless idle
+/*! every suppressed tick is a clock NMI and a compare interrupt not
+    taken; the compare interrupts alternate between the subsystem
+    handler and the task switcher. h8sim runs of an idle kernel with
+    and without CONF_TM_TICKLESS show the states of those handlers and
+    of tm_idle_task, where sleeping is charged.
+*/
+extern volatile unsigned long systime_idle_ticks;
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -84,6 +100,18 @@ void systime_set_switcher(void* switcher);
 void systime_set_timeslice(unsigned char slice);
 #endif	// CONF_TM
 
+#ifdef CONF_TM_TICKLESS
+//! stop the system tick until the next deadline, if nothing needs it
+/*! called by the idle task with IRQs disabled.
+*/
+void systime_idle(void);
+
+//! restart the system tick after tickless idle and catch up sys_time
+/*! IRQ handler safe; does nothing if the tick is running.
+*/
+void systime_wake(void);
+#endif // CONF_TM_TICKLESS
+
 time_t get_system_up_time(void);
 #endif  // CONF_TIME
 
@@ -35,6 +35,7 @@ extern "C" {
 #ifdef CONF_TM
 
 #include "../tm.h"
+#include "../time.h"
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -45,8 +46,34 @@ extern "C" {
 
 #define SP_RETURN_OFFSET	10	//!< return address offset on stack in words.
 
+#ifdef CONF_HOST
+#define TM_HOST_STACK_SIZE	0x10000	//!< minimum stack for host signal frames
+
+//! make a suspended task continue in func when switched to
+#define TM_SET_RETURN(sp,func)	tm_host_redirect((sp),(func))
+#else
+//! make a suspended task continue in func when switched to
+#define TM_SET_RETURN(sp,func)	(*((sp)+SP_RETURN_OFFSET)=(size_t)(func))
+#endif
+
 #define IDLE_STACK_SIZE		128	//!< should suffice for IRQ service
 
+#define TM_POOL_TASKS		8	//!< pooled task data and priority chains
+
+#ifdef CONF_TM_READYQ
+#define TM_WAIT_BUCKETS		8	//!< hash buckets for parked tasks
+
+//! hash bucket of an event object
+#define TM_WAIT_HASH(wchan)	((((size_t)(wchan))>>1) & (TM_WAIT_BUCKETS-1))
+#endif
+
+#ifdef CONF_TM_WHEEL
+#define TM_WHEEL_SLOTS		16	//!< timer wheel slots, a power of 2
+
+//! timer wheel slot of a deadline
+#define TM_WHEEL_SLOT(t)	(((unsigned)(t)) & (TM_WHEEL_SLOTS-1))
+#endif
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Variables
@@ -66,6 +93,33 @@ extern volatile unsigned int nb_system_tasks;
   // tm_timeslice is from kernel/systime.c
 extern volatile unsigned char tm_timeslice;	//!< task time slice
 
+#ifdef CONF_TM_READYQ
+extern pchain_t *tm_prio[PRIO_HIGHEST+1];	//!< priority chains by level
+extern unsigned long tm_ready_map;		//!< bit n set: level n ready
+#endif
+
+#if defined(CONF_TM_WHEEL) || defined(CONF_HOST)
+  // tm_current_slice is from kernel/systime.c
+extern volatile unsigned char tm_current_slice;	//!< current time remaining
+#endif
+
+#ifdef CONF_HOST
+  // all code is host text, so user tasks are told by their entry
+extern int (*tm_host_user_entry)(int,char**);	//!< user program entry
+#endif
+
+#ifdef CONF_TM_WHEEL
+  // checked by the task switch handler in kernel/systime.c
+extern volatile unsigned int tm_timers;		//!< number of armed timers
+#endif
+
+#ifdef CONF_MM_POOL
+#include <sys/pool.h>
+
+extern pool_t tm_tdata_pool;		//!< task data objects
+extern pool_t tm_pchain_pool;		//!< priority chain objects
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -84,6 +138,34 @@ extern void tm_init(void);
 */
 extern void tm_start(void);
 
+#ifdef CONF_TM_WHEEL
+//! wake the tasks whose deadline has passed
+/*! called by the task switch handler while timers are armed.
+*/
+extern void tm_timer_handler(void);
+
+//! time until the earliest armed timer
+/*! \param now the current system time
+    \return msecs to the earliest deadline, ~0 if no timer is armed.
+    called with IRQs disabled.
+*/
+extern time_t tm_timer_due(time_t now);
+#endif
+
+#ifdef CONF_TM_INHERIT
+//! lend the current task's priority to the holder of a lock
+/*! \param holder the task holding the lock the current task waits for.
+    called with IRQs disabled.
+*/
+extern void tm_inherit(tdata_t *holder);
+
+//! the current task released an inheriting lock
+/*! \return non-zero if it lost a borrowed priority and should yield.
+    called with IRQs disabled.
+*/
+extern int tm_disinherit(void);
+#endif
+
 
 //! the task switcher IRQ handler
 /*! located in the assembler process module
@@ -105,6 +187,31 @@ extern size_t *tm_scheduler(size_t *old_sp);
 */
 extern int tm_idle_task(int,char**);
 
+#ifdef CONF_HOST
+//! set up a task context on the host
+/*! \param stack stack area, NULL for the single tasking context
+    \param stack_size size of the stack area in bytes
+    \param code_start entry point, called as exit(code_start(argc,argv))
+    \return the context, stored as the task's sp_save.
+    located in host/context.c
+*/
+extern size_t *tm_host_context(size_t *stack,size_t stack_size,
+                               int (*code_start)(int,char**),
+                               int argc,char **argv);
+
+//! switch host contexts
+/*! \param old_sp context to save to, NULL if it's a zombie's
+    \param new_sp context to resume
+*/
+extern void tm_host_switch(size_t *old_sp,size_t *new_sp);
+
+//! make a suspended host context continue in func(-1)
+extern void tm_host_redirect(size_t *sp,void (*func)(int));
+
+//! wait for the next interrupt
+extern void tm_host_idle(void);
+#endif
+
 #endif	// CONF_TM
 
 #ifdef  __cplusplus
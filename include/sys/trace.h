@@ -0,0 +1,136 @@
+/*! \file   include/sys/trace.h
+    \brief  Internal Interface: kernel event trace
+ */
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License
+ *  at http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ *  the License for the specific language governing rights and
+ *  limitations under the License.
+ */
+
+#ifndef __sys_trace_h__
+#define __sys_trace_h__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <config.h>
+
+#ifdef CONF_TRACE
+
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+#define TRACE_SIZE	128	//!< entries in the ring, a power of 2
+#define TRACE_CHUNK	240	//!< bytes per TRACEdata packet
+
+//! trace event types
+/*! data and arg of the entry, task addresses are those of the tdata_t.
+*/
+typedef enum {
+  TRACE_NONE,                   //!< unused entry
+  TRACE_SWITCH,                 //!< task switch. data: priority, arg: task
+  TRACE_BLOCK,                  //!< wait_event(). data: 1 if arg is the
+                                //!<   event object, 0 if the wakeup function
+  TRACE_WAKE,                   //!< wakeup function returned non-zero.
+                                //!<   data: priority, arg: task
+  TRACE_SEM_WAIT,               //!< sem_wait(). data: count, arg: semaphore
+  TRACE_SEM_POST,               //!< sem_post(). data: count, arg: semaphore
+  TRACE_TX_START,               //!< LNP frame transmit. arg: length
+  TRACE_TX_END,                 //!< transmit done. data: tx_state,
+                                //!<   arg: length
+  TRACE_COLLISION,              //!< echo mismatch or receive error while
+                                //!<   transmitting. data: 0 or serial
+                                //!<   status, arg: bytes left to verify
+  TRACE_RX_START,               //!< LNP frame receive. data: first byte
+  TRACE_RX_END,                 //!< back to waiting for a header
+  TRACE_RX_ERROR                //!< framing/parity/overrun error.
+                                //!<   data: serial status
+} trace_type_t;
+
+//! a trace entry
+typedef struct {
+  unsigned time;                //!< sys_time, low 16 bits
+  unsigned char type;           //!< trace_type_t
+  unsigned char data;           //!< type specific
+  unsigned arg;                 //!< type specific
+} trace_entry_t;
+
+//! the trace ring
+/*! this is what TRACEread sends, as it is in memory (big endian).
+    the oldest entry is entry[0] until the ring has wrapped, then
+    entry[count % TRACE_SIZE].
+*/
+typedef struct {
+  unsigned count;               //!< entries written, modulo 2^16
+  unsigned size;                //!< TRACE_SIZE
+  unsigned char wrapped;        //!< the ring has been filled
+  unsigned char stopped;        //!< recording is stopped
+  trace_entry_t entry[TRACE_SIZE];      //!< the entries
+} trace_ring_t;
+
+//! trace commands, second byte of a CMDtrace packet
+/*! all replies go to the sender's port and start with CMDtrace, too.
+*/
+typedef enum {
+  TRACEstart,                   //!< 2: resume recording, reply as TRACEstop
+  TRACEstop,                    //!< 2: stop recording, reply 2+4:
+                                //!<   s[count] s[image size]
+  TRACEclear,                   //!< 2: empty the ring, reply as TRACEstop
+  TRACEread,                    //!< 2+2: s[first byte]
+                                //!<   reply TRACEdata..., TRACEend
+  TRACEdata,                    //!< 2+2+n: s[offset] array[image bytes]
+  TRACEend                      //!< 2+2: s[image size]
+} trace_cmd_t;
+
+///////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////
+
+extern trace_ring_t trace_ring;         //!< the trace ring
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! record an event
+/*! \param type trace_type_t
+    \param data type specific byte
+    \param arg type specific word
+
+    IRQ handler safe.
+*/
+extern void trace_event(unsigned char type,unsigned char data,unsigned arg);
+
+//! empty the ring and start recording
+extern void trace_init(void);
+
+//! handle a CMDtrace packet from the program port
+/*! \param data packet data after the CMDtrace byte
+    \param length length of data
+    \param src address to reply to
+*/
+extern void trace_command(const unsigned char *data,unsigned char length,
+                          unsigned char src);
+
+#endif // CONF_TRACE
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // __sys_trace_h__
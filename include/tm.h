@@ -75,6 +75,9 @@ typedef unsigned long wakeup_t;                 //!< wakeup data area type
 #define T_KERNEL  	(1 << 0)                    //!< kernel task
 #define T_USER    	(1 << 1)                    //!< user task
 #define T_IDLE    	(1 << 2)                    //!< idle task
+#define T_BLOCKED 	(1 << 3)                    //!< parked until event
+#define T_DEADLINE	(1 << 4)                    //!< waiting with a deadline
+#define T_TIMED   	(1 << 5)                    //!< on the timer wheel
 #define T_SHUTDOWN	(1 << 7)                    //!< shutdown requested
 
 
@@ -92,6 +95,11 @@ struct _pchain_t {
   struct _pchain_t *prev;                       //!< higher priority chain
 
   struct _tdata_t *ctid;                        //!< current task in chain
+
+#ifdef CONF_TM_READYQ
+  struct _tdata_t *rhead;                       //!< first ready task
+  struct _tdata_t *rtail;                       //!< last ready task
+#endif
 };
 
 /** priority chain data type
@@ -117,6 +125,21 @@ struct _tdata_t {
 
   wakeup_t(*wakeup) (wakeup_t);                 //!< event wakeup function
   wakeup_t wakeup_data;                         //!< user data for wakeup fn
+
+#ifdef CONF_TM_READYQ
+  struct _tdata_t *rnext;                       //!< next in ready/wait queue
+  void *wchan;                                  //!< event object waited on
+#endif
+
+#ifdef CONF_TM_WHEEL
+  struct _tdata_t *tnext;                       //!< next in timer wheel slot
+  unsigned long deadline;                       //!< wait deadline (a time_t)
+#endif
+
+#ifdef CONF_TM_INHERIT
+  pchain_t *rprio;                              //!< chain queued on, if boosted
+  unsigned char held;                           //!< inheriting locks held
+#endif
 };
 
 //! task data type
@@ -140,7 +163,11 @@ extern tdata_t *ctid;
 //! task id type
 /*! In effect, the kernel simply typecasts *tdata_t to tid_t.
  */
+#ifdef CONF_HOST
+typedef signed long tid_t;
+#else
 typedef signed int tid_t;
+#endif
 
 #ifdef  __cplusplus
 }
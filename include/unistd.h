@@ -33,6 +33,14 @@ extern "C" {
 #include <tm.h>
 #include <time.h>
 
+#ifdef CONF_HOST
+// avoid clashes with the C library of the PC
+//
+#define kill	tm_kill
+#define exit	tm_exit
+#define sleep	tm_sleep
+#endif
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Functions
@@ -45,7 +53,8 @@ extern "C" {
  *  \param code_start the entry-point of the new task
  *  \param argc the count of arguments passed (0 if none)
  *  \param argv an array of pointers each pointing to an argument (NULL if none)
- *  \param priority the priority at which to run this task
+ *  \param priority the priority at which to run this task, at most PRIO_HIGHEST
+ *         with CONF_TM_READYQ
  *  \param stack_size the amount of memory in bytes to allocate to this task for its call stack
  *  \return -1 if failed to start, else tid (task-id)
  */
@@ -93,6 +102,45 @@ extern void yield(void);
  */
 extern wakeup_t wait_event(wakeup_t(*wakeup) (wakeup_t), wakeup_t data);
 
+#ifdef CONF_TM_READYQ
+/*! suspend task until wakeup function returns non-null, polling it
+ *  only after notify_event() was called for the event object
+ *  \param wchan the event object, e.g. a semaphore
+ *  \param wakeup the function to be called when woken up
+ *  \param data the wakeup_t structure to be passed to the called function
+ *  \return wakeup() return value
+ *  \note wakeup function is called in task scheduler context
+ */
+extern wakeup_t wait_event_on(void *wchan,
+                              wakeup_t(*wakeup) (wakeup_t), wakeup_t data);
+
+/*! make tasks waiting on an event object check their wakeup function
+ *  \param wchan the event object
+ *  \note IRQ handler safe
+ */
+extern void notify_event(void *wchan);
+#else
+#define wait_event_on(wchan,wakeup,data)  wait_event(wakeup,data)
+#define notify_event(wchan)               ((void) 0)
+#endif
+
+#ifdef CONF_TM_WHEEL
+/*! like wait_event_on(), but also poll the wakeup function once the
+ *  deadline has passed
+ *  \param wchan the event object, e.g. a semaphore
+ *  \param wakeup the function to be called when woken up
+ *  \param data the wakeup_t structure to be passed to the called function
+ *  \param deadline system time after which to poll wakeup() again
+ *  \return wakeup() return value
+ *  \note wakeup() must itself check for the deadline.
+ */
+extern wakeup_t wait_event_until(void *wchan,
+                                 wakeup_t(*wakeup) (wakeup_t), wakeup_t data,
+                                 time_t deadline);
+#else
+#define wait_event_until(wchan,wakeup,data,deadline)  wait_event(wakeup,data)
+#endif
+
 
 //! delay execution allowing other tasks to run
 /*! \param sec sleep duration in seconds
@@ -118,6 +166,10 @@ extern inline wakeup_t wait_event(wakeup_t(*wakeup) (wakeup_t), wakeup_t data)
   return res;
 }
 
+#define wait_event_on(wchan,wakeup,data)  wait_event(wakeup,data)
+#define wait_event_until(wchan,wakeup,data,deadline)  wait_event(wakeup,data)
+#define notify_event(wchan)               ((void) 0)
+
 // Replacement for sleep/msleep if no TM 
 #define	sleep(s)	delay(1000*(s))
 #define msleep(s)	delay(s)
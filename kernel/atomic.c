@@ -2,6 +2,19 @@
 #include <atomic.h>
 
 #ifdef CONF_ATOMIC
+#ifdef CONF_HOST
+// the simulated interrupts are signals on the one kernel thread, so
+// a single read-modify-write instruction can't be torn by them. no
+// need to mask them, which takes two system calls.
+//
+void atomic_inc(atomic_t* counter) {
+  __atomic_add_fetch(counter,1,__ATOMIC_SEQ_CST);
+}
+
+void atomic_dec(atomic_t* counter) {
+  __atomic_sub_fetch(counter,1,__ATOMIC_SEQ_CST);
+}
+#else
 /**
  * increment atomic counter without interruption.
  * locks interrupts except NMI, increments count
@@ -43,4 +56,5 @@ __asm__("\n\
          ldc   r1h, ccr\n\
          rts\n\
 ");
+#endif // CONF_HOST
 #endif
@@ -6,6 +6,7 @@
 
 #if defined(CONF_TM)
 #include <sys/tm.h>
+#include <sys/irq.h>
 #include <tm.h>
 
 //! critical section counter for kernel/task manager
@@ -29,6 +30,20 @@ atomic_t kernel_critsec_count;
     \return 0xffff if failure, 0 if successful
     \sa locked_decrement
  */
+#ifdef CONF_HOST
+int locked_check_and_increment(atomic_t* counter, tdata_t** tid) {
+  unsigned char ccr=irq_save();
+
+  if(*counter!=0 && *tid!=ctid) {
+    irq_restore(ccr);
+    return 0xffff;
+  }
+  (*counter)++;
+  *tid=ctid;
+  irq_restore(ccr);
+  return 0;
+}
+#else
 int locked_check_and_increment(atomic_t* counter, tdata_t** tid);
 __asm__("\n\
 .text\n\
@@ -69,6 +84,7 @@ __asm__("\n\
           pop.w  r4\n\
           rts\n\
         ");
+#endif // CONF_HOST
 
 //! wakeup when critical section is available
 /*! wakeup function used to detect when a critical
@@ -76,11 +92,13 @@ __asm__("\n\
     an interrupt, so interrupts are already disabled.
  */
 wakeup_t wait_critical_section(wakeup_t data) {
-  critsec_t* cs = (critsec_t*)((unsigned)data);
+  critsec_t* cs = (critsec_t*)((size_t)data);
   if (locked_check_and_increment(&cs->count, &cs->task) == 0xffff)
     return 0;
-  else
-    return 1;
+#ifdef CONF_TM_INHERIT
+  ctid->held++;                       // scheduler set ctid to the waiter
+#endif
+  return 1;
 }
 
 //! lock a critical section, or wait until it is available.
@@ -94,10 +112,47 @@ wakeup_t wait_critical_section(wakeup_t data) {
     \sa destroy_critical_section
  */
 int enter_critical_section(critsec_t* cs) {
-  if (locked_check_and_increment(&cs->count, &cs->task) == 0xffff)
-    return wait_event(&wait_critical_section, (wakeup_t)((unsigned)cs));
+#ifdef CONF_TM_INHERIT
+  unsigned char ccr;
+#endif
+  if (locked_check_and_increment(&cs->count, &cs->task) == 0xffff) {
+#ifdef CONF_TM_INHERIT
+    ccr = irq_save();
+    if (cs->count != 0)
+      tm_inherit(cs->task);           // lend our priority to the holder
+    irq_restore(ccr);
+#endif
+    return wait_event_on(cs, &wait_critical_section, (wakeup_t)((size_t)cs));
+  }
+#ifdef CONF_TM_INHERIT
+  if (cs->count == 1)
+    ctid->held++;                     // outermost level
+#endif
   return 1;
 }
+
+#ifdef CONF_TM_INHERIT
+//! leave critical section
+/*! drops a priority borrowed from waiting tasks
+    when the outermost level is left.
+
+    \param cs pointer to critical section (critsec_t)
+    \return always 0
+ */
+int leave_critical_section(critsec_t* cs) {
+  int boosted = 0;
+  unsigned char ccr = irq_save();
+
+  if (--cs->count == 0)
+    boosted = tm_disinherit();
+  irq_restore(ccr);
+
+  notify_event(cs);
+  if (boosted)
+    yield();                          // let the waiter have it
+  return 0;
+}
+#endif // CONF_TM_INHERIT
 #endif // CONF_CRITICAL_SECTIONS
 #endif // CONF_TM
 
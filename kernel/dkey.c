@@ -29,6 +29,10 @@
 
 #include <unistd.h>
 #include <sys/tm.h>
+#include <sys/irq.h>
+#ifdef CONF_HOST
+#include <sys/h8.h>
+#endif
 
 #ifdef CONF_AUTOSHUTOFF
 #include <sys/timeout.h>
@@ -56,6 +60,31 @@ char dkey_timer __attribute__ ((unused)); //! debouncing timer
 // Functions
 //
 ///////////////////////////////////////////////////////////////////////////////
+#ifdef CONF_HOST
+//! the key debouncer, called from the subsystem handler
+/*! keys are active low: PORT4 bit 1,2 and PORT7 bit 6,7.
+*/
+void dkey_handler(void) {
+  unsigned char keys,changed;
+
+  if(dkey_timer!=0) {                       // still debouncing
+    dkey_timer--;
+    return;
+  }
+
+  keys=((PORT4 & 0x02) ? 0 : 0x01) | ((PORT4 & 0x04) ? 0 : 0x02) |
+       ((PORT7 & 0x40) ? 0 : 0x04) | ((PORT7 & 0x80) ? 0 : 0x08);
+  changed=keys ^ dkey_multi;
+  if(changed) {
+    dkey_multi=keys;
+    dkey=keys & changed;                    // newly pressed keys
+    dkey_timer=100;
+#ifdef CONF_TM_READYQ
+    notify_event((void*) &dkey);
+#endif
+  }
+}
+#else
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 __asm__("\n\
 .text\n\
@@ -95,11 +124,28 @@ dkey_check:\n\
 \n\
      mov.b #100,r6l  	      	  ; set debouncing timer\n\
      mov.b r6l,@_dkey_timer\n\
-\n\
+"
+#ifdef CONF_TM_READYQ
+"\n\
+     jsr _dkey_notify             ; wake tasks in getchar()\n\
+"
+#endif // CONF_TM_READYQ
+"\n\
 dkey_same:\n\
    rts\n\
 ");
 #endif // DOXYGEN_SHOULD_SKIP_THIS
+#endif // CONF_HOST
+
+#if defined(CONF_TM_READYQ) && !defined(CONF_HOST)
+//! tell waiting tasks the key state changed
+/*! called from dkey_handler.
+*/
+HANDLER_WRAPPER("dkey_notify","dkey_notify_core");
+void dkey_notify_core(void) {
+  notify_event((void*) &dkey);
+}
+#endif // CONF_TM_READYQ
 
 //! wakeup if any of the given keys is pressed.
 //
@@ -122,11 +168,11 @@ wakeup_t dkey_released(wakeup_t data) {
 //! get and return a single key press, after waiting for it to arrive
 //
 int getchar(void) {
-  wait_event(dkey_released,KEY_ANY);
+  wait_event_on((void*) &dkey,dkey_released,KEY_ANY);
 #ifdef CONF_AUTOSHUTOFF
   shutoff_restart();
 #endif
-  wait_event(dkey_pressed ,KEY_ANY);
+  wait_event_on((void*) &dkey,dkey_pressed ,KEY_ANY);
   return dkey;
 }
 
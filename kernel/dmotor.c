@@ -66,6 +66,32 @@ MotorState dm_a,                  //!< motor A state
 //! direct motor output handler
 /*! called by system timer in the 16bit timer OCIA irq
 */
+#ifdef CONF_HOST
+//! advance one motor's pulse width modulation
+/*! \return the drive pattern if the running sum overflowed, else 0.
+    a delta of 255 maps to 256 (always on).
+*/
+static inline unsigned char dm_step(MotorState *m) {
+  unsigned sum=m->access.c.sum + m->access.c.delta +
+               (m->access.c.delta==MAX_SPEED);
+
+  m->access.c.sum=sum;
+  return sum>0xff ? m->dir : 0;
+}
+
+void dm_handler(void) {
+#ifdef CONF_DMOTOR_HOLD
+  unsigned char out=0xcf;
+#else
+  unsigned char out=0;
+#endif
+
+  out^=dm_step(&dm_a);
+  out^=dm_step(&dm_b);
+  out^=dm_step(&dm_c);
+  motor_controller=out;                 // output motor waveform
+}
+#else
 extern void dm_handler(void);
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 __asm__("\n\
@@ -125,6 +151,7 @@ _dm_handler:\n\
 		rts		\n\
 	");
 #endif // DOXYGEN_SHOULD_SKIP_THIS
+#endif // CONF_HOST
 	
 		
 //! initialize motors
@@ -478,6 +478,31 @@ void ds_mux_handler() {
 
 //! sensor A/D conversion IRQ handler
 //
+#ifdef CONF_HOST
+void ds_handler(void) {
+  unsigned char channel=ds_channel;
+
+  if(ds_activation & (1<<channel))
+    PORT6|=1<<channel;                  // activate output of last port scanned
+
+#ifdef CONF_DSENSOR_ROTATION
+  if(ds_rotation & (1<<channel))
+    ds_rotation_handler();
+#endif
+#ifdef CONF_DSENSOR_MUX
+  if(ds_mux & (1<<channel))
+    ds_mux_handler();
+#endif
+
+  channel=(channel+1) & 0x03;           // next channel
+  if(ds_activation & (1<<channel))
+    PORT6&=~(1<<channel);               // set output inactive for reading
+  ds_channel=channel;
+
+  AD_CSR=(AD_CSR & 0x7c) | channel;     // scan next channel
+  AD_CSR|=ADCSR_START;                  // go!
+}
+#else
 extern void ds_handler(void);
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 __asm__("\n\
@@ -572,6 +597,7 @@ settle:\n\
    rts\n\
 ");
 #endif // DOXYGEN_SHOULD_SKIP_THIS
+#endif // CONF_HOST
 
 
 //! initialize sensor a/d conversion
@@ -119,7 +119,7 @@ static inline void play_pause() {
 ///////////////////////////////////////////////////////////////////////////////
 
 //! sound handler, called from system timer interrupt
-#ifdef CONF_RCX_COMPILER
+#if defined(CONF_RCX_COMPILER) || defined(CONF_HOST)
 void dsound_handler(void) {
 #else
 HANDLER_WRAPPER("dsound_handler","dsound_core");
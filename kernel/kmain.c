@@ -39,6 +39,9 @@
 #ifdef CONF_AUTOSHUTOFF
 #include <sys/timeout.h>
 #endif
+#ifdef CONF_TRACE
+#include <sys/trace.h>
+#endif
 #include <rom/system.h>
 
 #include <dbutton.h>
@@ -57,11 +60,13 @@
  */
 unsigned char *firmware_string = "Do you byte, when I knock?";
 
+#ifndef CONF_HOST
 extern char __bss;		//!< the start of the uninitialized data segment
 extern char __bss_end;	//!< the end of the uninitialized data segment
 
 //! the high memory segment
 extern char __text_hi, __etext_hi;
+#endif
 
 #if defined(CONF_DSOUND) && defined(CONF_ON_OFF_SOUND)
 static const note_t on_sound[]={{PITCH_G4, 1}, {PITCH_G5, 1}, {PITCH_END, 0}};
@@ -147,18 +152,22 @@ void kmain(void)
   int c;
 #endif
 
+#ifndef CONF_HOST
   /* Install the text.hi segment in the correct place.  The
    * firmware loader puts it in the bss segment, we copy it 
    * to it's final location.
    */
   memcpy(&__text_hi, &__bss, &__etext_hi - &__text_hi);
+#endif
 
   reset_vector = rom_reset_vector;
 
   /* Turn off motor, since writing to hitext manipulates motors */
   motor_controller = 0;
   
+#ifndef CONF_HOST
   memset(&__bss, 0, &__bss_end - &__bss);
+#endif
 
 #ifdef CONF_MM
   mm_init();
@@ -176,6 +185,9 @@ void kmain(void)
 #ifdef CONF_DSOUND
     dsound_init();
 #endif
+#ifdef CONF_TRACE
+    trace_init();
+#endif
 #ifdef CONF_TIME
     systime_init();
 #endif
@@ -220,7 +232,12 @@ void kmain(void)
     //
 #ifdef CONF_TM
 #  ifndef CONF_PROGRAM
+#    ifdef CONF_HOST
+    if(tm_host_user_entry)
+      execi(tm_host_user_entry,0,0,PRIO_NORMAL,DEFAULT_STACK_SIZE);
+#    else
     execi(&main,0,0,PRIO_NORMAL,DEFAULT_STACK_SIZE);
+#    endif
 #  endif
     tm_start();
 #else
@@ -37,6 +37,9 @@
 #ifdef CONF_AUTOSHUTOFF
 #include <sys/timeout.h>
 #endif
+#ifdef CONF_TRACE
+#include <sys/trace.h>
+#endif
 
 #include <time.h>
 #include <mem.h>
@@ -51,9 +54,19 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 
+#ifndef CONF_LNP_ASYNC
+static lnp_iovec_t tx_iov[LNP_IOV_MAX]; //!< non-empty segments of the frame
+#endif
+static const lnp_iovec_t *tx_last;      //!< last segment
+
+static const lnp_iovec_t *tx_seg;       //!< segment being transmitted
 static const unsigned char *tx_ptr; //!< ptr to next byte to transmit
+static const unsigned char *tx_end; //!< ptr to byte after last of tx_seg
+
+static const lnp_iovec_t *tx_vseg;      //!< segment being verified
 static const unsigned char *tx_verify;  //!< ptr to next byte to verify
-static const unsigned char *tx_end; //!< ptr to byte after last
+static const unsigned char *tx_vend;    //!< ptr to byte after last of tx_vseg
+static size_t tx_left;                  //!< bytes left to verify
 
 volatile signed char tx_state;    //!< flag: transmission state
 
@@ -65,7 +78,13 @@ volatile signed char tx_state;    //!< flag: transmission state
 
 static time_t allow_tx;                 //!< time to allow new transmission
 
-#ifdef CONF_TM
+#if defined(CONF_LNP_ASYNC)
+//! frames to transmit, the oldest at tx_head is on the air
+//! while tx_state is TX_ACTIVE.
+static lnp_tx_t *tx_queue[LNP_TX_QUEUE];
+static unsigned char tx_head;           //!< index of the oldest frame
+volatile unsigned char tx_queued;       //!< frames in the queue
+#elif defined(CONF_TM)
 static sem_t tx_sem;                //!< transmitter access semaphore
 #endif
 
@@ -101,32 +120,114 @@ extern inline void carrier_shutdown(void) {
   T1_CSR =0;
 }
 
+//! time to allow the next transmission after a frame
+/*! \param len frame length
+    \param last last byte of the frame
+*/
+static time_t tx_backoff(size_t len,unsigned char last) {
+  unsigned char tmp;
+
+  if(tx_state==TX_IDLE)
+    tmp=LNP_WAIT_TXOK;
+  else
+    tmp=LNP_WAIT_COLL + ( ((unsigned char) 0x0f) &
+        ( ((unsigned char) len)+
+          last+
+          ((unsigned char) get_system_up_time())    ) );
+  return get_system_up_time()+tmp;
+}
+
+#ifdef CONF_LNP_ASYNC
+//! the frame on the air is done
+/*! \param state TX_IDLE or TX_COLL
+
+    takes it off the queue, sets the backoff and tells the sender.
+    IRQs must be disabled.
+*/
+static void tx_complete(signed char state) {
+  lnp_tx_t *tx=tx_queue[tx_head];
+
+  tx_state=state;
+  tx_head=(tx_head+1) & (LNP_TX_QUEUE-1);
+  tx_queued--;
+  allow_tx=tx_backoff(tx->len,
+                      ((const unsigned char*) tx_last->base)[tx_last->len-1]);
+#ifdef CONF_TRACE
+  trace_event(TRACE_TX_END,state,tx->len);
+#endif
+
+  tx->state=state;
+  notify_event((void*) tx);
+  notify_event((void*) tx_queue);               // a slot is free
+  if(tx->done)
+    tx->done(tx);
+}
+#else
+//! the frame on the air is done
+/*! \param state TX_IDLE or TX_COLL
+*/
+static void tx_complete(signed char state) {
+  tx_state=state;
+  notify_event((void*) &tx_state);
+}
+#endif
+
+//! abort the frame on the air as a collision
+/*! for lnp_integrity_reset() on a timeout while transmitting.
+    IRQs must be disabled.
+*/
+void lnp_tx_abort(void) {
+  txend_handler();
+  tx_complete(TX_COLL);
+}
+
 //! the byte received interrupt handler
 //
-#ifdef CONF_RCX_COMPILER
+#if defined(CONF_RCX_COMPILER)
 static void rx_handler(void) {
+#elif defined(CONF_HOST)
+void rx_handler(void) {
 #else
 HANDLER_WRAPPER("rx_handler","rx_core");
 void rx_core(void) {
 #endif
   time_t new_tx;
+#ifdef CONF_TRACE
+  int active;
+#endif
   lnp_timeout_reset();
   if(tx_state<TX_ACTIVE) {
     // foreign bytes
     //
     new_tx = get_system_up_time()+LNP_BYTE_SAFE;
     if (new_tx > allow_tx) allow_tx = new_tx;
+#ifdef CONF_TRACE
+    active=lnp_integrity_active();
+    lnp_integrity_byte(S_RDR);
+    if(!active && lnp_integrity_active())
+      trace_event(TRACE_RX_START,S_RDR,0);
+    else if(active && !lnp_integrity_active())
+      trace_event(TRACE_RX_END,0,0);
+#else
     lnp_integrity_byte(S_RDR);
+#endif
   } else {
     // echos of own bytes -> collision detection
     //
     if(S_RDR!=*tx_verify) {
+#ifdef CONF_TRACE
+      trace_event(TRACE_COLLISION,0,tx_left);
+#endif
       txend_handler();
-      tx_state=TX_COLL;
-    } else if( tx_end <= ++tx_verify ) {
+      tx_complete(TX_COLL);
+    } else if( --tx_left == 0 ) {
       // let transmission end handler handle things
       //
-      tx_state=TX_IDLE;
+      tx_complete(TX_IDLE);
+    } else if( ++tx_verify == tx_vend ) {
+      tx_vseg++;
+      tx_verify=tx_vseg->base;
+      tx_vend  =tx_verify+tx_vseg->len;
     }
   }
 
@@ -137,20 +238,28 @@ void rx_core(void) {
 
 //! the receive error interrupt handler
 //
-#ifdef CONF_RCX_COMPILER
+#if defined(CONF_RCX_COMPILER)
 static void rxerror_handler(void) {
+#elif defined(CONF_HOST)
+void rxerror_handler(void) {
 #else
 HANDLER_WRAPPER("rxerror_handler","rxerror_core");
 void rxerror_core(void) {
 #endif
   time_t new_tx;
   if(tx_state<TX_ACTIVE) {
+#ifdef CONF_TRACE
+    trace_event(TRACE_RX_ERROR,S_SR,0);
+#endif
     lnp_integrity_reset();
     new_tx = get_system_up_time()+LNP_BYTE_SAFE;
     if (new_tx > allow_tx) allow_tx = new_tx;
   } else {
+#ifdef CONF_TRACE
+    trace_event(TRACE_COLLISION,S_SR,tx_left);
+#endif
     txend_handler();
-    tx_state=TX_COLL;
+    tx_complete(TX_COLL);
   }
 
   S_SR&=~SSR_ERRORS;
@@ -158,7 +267,7 @@ void rxerror_core(void) {
 
 //! the end-of-transmission interrupt handler
 //
-#ifdef CONF_RCX_COMPILER
+#if defined(CONF_RCX_COMPILER) || defined(CONF_HOST)
 void txend_handler(void) {
 #else
 HANDLER_WRAPPER("txend_handler","txend_core");
@@ -171,14 +280,22 @@ void txend_core(void) {
 }
 
 //! the transmit byte interrupt handler
-/*! write next byte if there's one left, otherwise unhook irq.
+/*! write next byte if there's one left, going on with the next
+    segment at the end of one, otherwise unhook irq.
 */
-#ifdef CONF_RCX_COMPILER
+#if defined(CONF_RCX_COMPILER)
 static void tx_handler(void) {
+#elif defined(CONF_HOST)
+void tx_handler(void) {
 #else
 HANDLER_WRAPPER("tx_handler","tx_core");
 void tx_core(void) {
 #endif
+  if(tx_ptr==tx_end && tx_seg!=tx_last) {
+    tx_seg++;
+    tx_ptr=tx_seg->base;
+    tx_end=tx_ptr+tx_seg->len;
+  }
   if(tx_ptr<tx_end) {
     // transmit next byte
     //
@@ -197,10 +314,13 @@ void lnp_logical_shutdown(void) {
   carrier_shutdown();
   lnp_logical_range(0);
 
+#ifdef CONF_LNP_ASYNC
+  lnp_tx_flush();
+#endif
   tx_state=TX_IDLE;
   allow_tx=0;
 
-#ifdef CONF_TM
+#if defined(CONF_TM) && !defined(CONF_LNP_ASYNC)
   sem_destroy(&tx_sem);
 #endif
 }
@@ -213,7 +333,7 @@ void lnp_logical_init(void) {
   //
   lnp_logical_shutdown();
 
-#ifdef CONF_TM
+#if defined(CONF_TM) && !defined(CONF_LNP_ASYNC)
   sem_init(&tx_sem,0,1);
 #endif
 
@@ -244,6 +364,205 @@ void lnp_logical_init(void) {
   S_CR=SCR_RECEIVE | SCR_RX_IRQ;
 }
 
+//! write to IR port, blocking.
+/*! \param buf data to transmit
+    \param len number of bytes to transmit
+    \return 0 on success, else collision
+*/
+int lnp_logical_write(const void* buf,size_t len) {
+  lnp_iovec_t iov;
+
+  iov.base=buf;
+  iov.len =len;
+  return lnp_logical_writev(&iov,1);
+}
+
+#ifdef CONF_LNP_ASYNC
+//! start the oldest queued frame once the medium is free
+/*! called by the system tick while frames are queued, and on queueing.
+    IRQs must be disabled.
+*/
+#if defined(CONF_RCX_COMPILER) || defined(CONF_HOST)
+void lnp_tx_handler(void) {
+#else
+HANDLER_WRAPPER("lnp_tx_handler","lnp_tx_core");
+void lnp_tx_core(void) {
+#endif
+  lnp_tx_t *tx;
+
+  if(tx_state==TX_ACTIVE || tx_queued==0 ||
+     get_system_up_time() < allow_tx)
+    return;
+
+  tx=tx_queue[tx_head];
+  tx->state=TX_ACTIVE;
+  lnp_timeout_reset();
+
+  tx_last=tx->iov+tx->count-1;                  // what to transmit
+  tx_seg=tx_vseg=tx->iov;
+  tx_verify=tx_ptr=tx->iov[0].base;
+  tx_vend=tx_end=tx_ptr+tx->iov[0].len;
+  tx_left=tx->len;
+
+  tx_state=TX_ACTIVE;
+#ifdef CONF_TRACE
+  trace_event(TRACE_TX_START,0,tx->len);
+#endif
+  S_SR&=~(SSR_TRANS_EMPTY | SSR_TRANS_END);     // clear flags
+  S_CR|=SCR_TRANSMIT | SCR_TX_IRQ | SCR_TE_IRQ; // enable transmit & irqs
+}
+
+//! queue a frame, non-blocking
+/*! \param tx the frame: iov, count and done set. must stay valid and
+              unchanged until tx->state is below TX_ACTIVE.
+    \return 0 if queued, -1 if the queue is full or the frame empty
+*/
+int lnp_logical_queue(lnp_tx_t *tx) {
+  unsigned char ccr,i,n;
+
+  // drop empty segments, the transmitter and the
+  // echo check would stall on them.
+  //
+  tx->len=0;
+  for(i=n=0; i<tx->count; i++)
+    if(tx->iov[i].len!=0) {
+      tx->iov[n++]=tx->iov[i];
+      tx->len+=tx->iov[i].len;
+    }
+  tx->count=n;
+  if(tx->len==0) {
+    tx->state=TX_COLL;
+    return -1;
+  }
+
+#ifdef CONF_AUTOSHUTOFF
+  shutoff_restart();
+#endif
+
+  ccr=irq_save();
+  if(tx_queued==LNP_TX_QUEUE) {
+    irq_restore(ccr);
+    return -1;
+  }
+  tx->state=TX_QUEUED;
+  tx_queue[(tx_head+tx_queued) & (LNP_TX_QUEUE-1)]=tx;
+  tx_queued++;
+  lnp_tx_handler();
+  irq_restore(ccr);
+
+  return 0;
+}
+
+//! write to IR port, non-blocking.
+/*! \param tx frame handle, owned by the caller
+    \param buf data to transmit
+    \param len number of bytes to transmit
+    \param done completion callback, or NULL
+    \return 0 if queued, -1 if the queue is full
+*/
+int lnp_logical_write_async(lnp_tx_t *tx,const void *buf,size_t len,
+                            lnp_tx_done_t done) {
+  tx->iov[0].base=buf;
+  tx->iov[0].len =len;
+  tx->count=1;
+  tx->done =done;
+  return lnp_logical_queue(tx);
+}
+
+//! take a frame off the queue, or abort it if it is on the air
+/*! its state becomes TX_COLL and done is called, unless it was
+    done already.
+*/
+void lnp_tx_cancel(lnp_tx_t *tx) {
+  unsigned char ccr=irq_save();
+  unsigned char i;
+
+  if(tx->state==TX_ACTIVE) {
+    txend_handler();
+    tx_complete(TX_COLL);
+  } else if(tx->state==TX_QUEUED) {
+    for(i=0; i<tx_queued; i++)
+      if(tx_queue[(tx_head+i) & (LNP_TX_QUEUE-1)]==tx)
+        break;
+    for(; i+1<tx_queued; i++)
+      tx_queue[(tx_head+i) & (LNP_TX_QUEUE-1)]=
+        tx_queue[(tx_head+i+1) & (LNP_TX_QUEUE-1)];
+    tx_queued--;
+
+    tx->state=TX_COLL;
+    notify_event((void*) tx);
+    notify_event((void*) tx_queue);
+    if(tx->done)
+      tx->done(tx);
+  }
+
+  irq_restore(ccr);
+}
+
+//! drop all queued frames, without calling their callbacks
+/*! for program stop and power off, when the callbacks may be gone.
+*/
+void lnp_tx_flush(void) {
+  unsigned char ccr=irq_save();
+  lnp_tx_t *tx;
+
+  if(tx_state==TX_ACTIVE) {
+    txend_handler();
+    tx_state=TX_COLL;
+  }
+  while(tx_queued) {
+    tx=tx_queue[tx_head];
+    tx_head=(tx_head+1) & (LNP_TX_QUEUE-1);
+    tx_queued--;
+
+    tx->state=TX_COLL;
+    notify_event((void*) tx);
+  }
+  notify_event((void*) tx_queue);
+
+  irq_restore(ccr);
+}
+
+static wakeup_t write_slot(wakeup_t data) {
+  return *((volatile unsigned char*)&tx_queued)<LNP_TX_QUEUE;
+}
+
+static wakeup_t write_complete(wakeup_t data) {
+  return ((lnp_tx_t*) ((size_t) data))->state<TX_ACTIVE;
+}
+
+//! write segments to IR port as one frame, blocking.
+/*! \param iov the segments, transmitted where they are
+    \param count number of segments
+    \return 0 on success, else collision
+
+    queues the frame like lnp_logical_queue() and waits for it.
+*/
+int lnp_logical_writev(const lnp_iovec_t *iov,unsigned char count) {
+  lnp_tx_t tx;
+
+  if(count>LNP_IOV_MAX)
+    return TX_COLL;
+  for(tx.count=0; tx.count<count; tx.count++)
+    tx.iov[tx.count]=iov[tx.count];
+  tx.done=NULL;
+  tx.state=TX_IDLE;                             // not set when full
+
+  while(lnp_logical_queue(&tx)) {
+    if(tx.state==TX_COLL)
+      return TX_COLL;                           // empty
+    if(wait_event_on((void*) tx_queue,write_slot,0)==0)
+      return TX_COLL;                           // shutdown
+  }
+
+  if(wait_event_on((void*) &tx,write_complete,
+                   (wakeup_t) ((size_t) &tx))==0)
+    lnp_tx_cancel(&tx);                         // shutdown, tx goes away
+
+  return tx.state;
+}
+
+#else // CONF_LNP_ASYNC
 
 static wakeup_t write_allow(wakeup_t data) {
   return get_system_up_time() >= *((volatile time_t*)&allow_tx);
@@ -253,46 +572,68 @@ static wakeup_t write_complete(wakeup_t data) {
   return *((volatile signed char*)&tx_state)<TX_ACTIVE;
 }
 
-//! write to IR port, blocking.
-/*! \param buf data to transmit
-    \param len number of bytes to transmit
+//! write segments to IR port as one frame, blocking.
+/*! \param iov the segments, transmitted where they are
+    \param count number of segments
     \return 0 on success, else collision
 */
-int lnp_logical_write(const void* buf,size_t len) {
-  unsigned char tmp;
+int lnp_logical_writev(const lnp_iovec_t *iov,unsigned char count) {
+  unsigned char last;
+  lnp_iovec_t *seg;
+  size_t len;
 
 #ifdef CONF_TM
   if (sem_wait(&tx_sem) == -1)
   	return tx_state;
 #endif
 
+  // collect the non-empty segments, the transmitter and the
+  // echo check would stall on empty ones.
+  //
+  seg=tx_iov;
+  len=0;
+  for(; count>0; iov++, count--)
+    if(iov->len!=0) {
+      if(seg==tx_iov+LNP_IOV_MAX) {
+#ifdef CONF_TM
+        sem_post(&tx_sem);
+#endif
+        return TX_COLL;                       // too many segments
+      }
+      *(seg++)=*iov;
+      len+=iov->len;
+    }
+
 #ifdef CONF_AUTOSHUTOFF
   shutoff_restart();
 #endif
 
-	if (wait_event(write_allow,0) != 0)
+	if (len!=0 && wait_event(write_allow,0) != 0)
 	{
 	  lnp_timeout_reset();
 
-  	tx_verify=tx_ptr=buf;                 // what to transmit
-	  tx_end=buf+len;
+	  tx_last=seg-1;                        // what to transmit
+	  last=((const unsigned char*) tx_last->base)[tx_last->len-1];
+	  tx_seg=tx_vseg=tx_iov;
+	  tx_verify=tx_ptr=tx_iov->base;
+	  tx_vend=tx_end=tx_ptr+tx_iov->len;
+	  tx_left=len;
 
 	  tx_state=TX_ACTIVE;
+#ifdef CONF_TRACE
+	  trace_event(TRACE_TX_START,0,len);
+#endif
 	  S_SR&=~(SSR_TRANS_EMPTY | SSR_TRANS_END); // clear flags
 	  S_CR|=SCR_TRANSMIT | SCR_TX_IRQ | SCR_TE_IRQ; // enable transmit & irqs
 
-	  wait_event(write_complete,0);
+	  wait_event_on((void*) &tx_state,write_complete,0);
+#ifdef CONF_TRACE
+	  trace_event(TRACE_TX_END,tx_state,len);
+#endif
 
 	  // determine delay before next transmission
 	  //
-	  if(tx_state==TX_IDLE)
-	    tmp=LNP_WAIT_TXOK;
-	  else
-	    tmp=LNP_WAIT_COLL + ( ((unsigned char) 0x0f) &
-	        ( ((unsigned char) len)+
-	          ((unsigned char*)buf)[len-1]+
-	          ((unsigned char) get_system_up_time())    ) );
-	  allow_tx=get_system_up_time()+tmp;
+	  allow_tx=tx_backoff(len,last);
 	}
 
 #ifdef CONF_TM
@@ -302,4 +643,6 @@ int lnp_logical_write(const void* buf,size_t len) {
   return tx_state;
 }
 
+#endif // CONF_LNP_ASYNC
+
 #endif  // CONF_LNP
@@ -0,0 +1,470 @@
+/*! \file   lnp-transport.c
+    \brief  Implementation: reliable sliding window transport over LNP
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The protocol engine is shared with the host utilities, which
+ *  build this file like lnp.c: it never touches the link or the
+ *  clock itself. The blocking calls at the end are the brick's;
+ *  lnphost.c has the tower's.
+ *
+ *  Sequence numbers are 8 bits and the window a power of two, so
+ *  frame n always lives in slot n & (window-1).
+ */
+
+#include <lnp-transport.h>
+
+#ifdef CONF_LNP_TRANSPORT
+
+#include <sys/lnp.h>
+#include <sys/lnp-logical.h>
+#include <string.h>
+
+#if !defined(CONF_HOST) || defined(CONF_HOST_SIM)
+#include <sys/irq.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <semaphore.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Internal Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define LNP_TP_OVERHEAD   7     //!< LNP and transport header, checksum
+
+//! send slot of frame n
+#define tx_slot(tp,n)   ((tp)->tx+((n) & ((tp)->window-1))*((tp)->size+1))
+
+//! receive slot n
+#define rx_slot(tp,n)   ((tp)->rx+((n) & ((tp)->window-1))*((tp)->size+1))
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Protocol engine
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! set up the protocol engine
+/*! \param tp the transport
+    \param buf LNP_TP_BUFSIZE(window,size) bytes for the frames
+    \param window frames in flight, at most LNP_TP_WINDOW_MAX.
+           rounded down to a power of two.
+    \param size max. payload of a frame, at most LNP_TP_MTU
+    \param iss first sequence number, should differ between streams
+*/
+void lnp_tp_init(lnp_tp_t *tp,unsigned char *buf,unsigned char window,
+                 unsigned char size,unsigned char iss) {
+  unsigned char w;
+
+  if(window>LNP_TP_WINDOW_MAX)
+    window=LNP_TP_WINDOW_MAX;
+  for(w=1; (w<<1)<=window; w<<=1)
+    ;
+
+  memset(tp,0,sizeof(lnp_tp_t));
+  tp->window   =w;
+  tp->size     =size;
+  tp->rto      =LNP_TP_RTO;
+  tp->byte_time=LNP_BYTE_TIME;
+  tp->tx       =buf;
+  tp->rx       =buf+w*(size+1);
+
+  tp->snd_iss=tp->snd_una=tp->snd_nxt=tp->snd_max=tp->snd_end=iss;
+  tp->snd_wnd=w;
+  tp->syn    =1;
+}
+
+//! queue a frame for transmission
+/*! \return 0 if queued, -1 if window frames are queued or len > size
+*/
+int lnp_tp_queue(lnp_tp_t *tp,const void *data,unsigned char len) {
+  unsigned char *slot;
+
+  if(!lnp_tp_space(tp) || len>tp->size)
+    return -1;
+
+  slot=tx_slot(tp,tp->snd_end);
+  slot[0]=len;
+  memcpy(slot+1,data,len);
+  tp->snd_end++;
+
+  return 0;
+}
+
+//! take the oldest received frame
+/*! \param buf buffer of size bytes
+    \return length of the payload, -1 if there is none
+*/
+int lnp_tp_read(lnp_tp_t *tp,void *buf) {
+  unsigned char *slot;
+
+  if(tp->rcv_count==0)
+    return -1;
+
+  slot=rx_slot(tp,tp->rcv_head);
+  memcpy(buf,slot+1,slot[0]);
+  tp->rcv_head++;
+
+  // a full receiver has told the sender to stop, tell it to go on.
+  //
+  if(tp->rcv_count--==tp->window)
+    tp->ack_due=1;
+
+  return slot[0];
+}
+
+//! pass a frame received from the peer
+/*! \param data addressing layer payload
+    \param len its length
+    \param now the time in ms
+
+    IRQ handler safe, transmits nothing.
+*/
+void lnp_tp_input(lnp_tp_t *tp,const unsigned char *data,
+                  unsigned char len,unsigned long now) {
+  unsigned char seq,acked;
+  unsigned char *slot;
+
+  if(len<2)
+    return;
+  seq=data[1];
+
+  if((data[0] & 0xf0)==LNP_TP_DATA) {
+    // a SYN we haven't seen starts a new stream
+    //
+    if((data[0] & LNP_TP_SYN) && (!tp->rcv_synced || seq!=tp->rcv_syn)) {
+      tp->rcv_nxt   =seq;
+      tp->rcv_syn   =seq;
+      tp->rcv_synced=1;
+    }
+    if(!tp->rcv_synced)
+      return;
+
+    // in order and room for it? anything else gets the same ack again.
+    //
+    if(seq==tp->rcv_nxt && tp->rcv_count<tp->window && len-2<=tp->size) {
+      slot=rx_slot(tp,tp->rcv_head+tp->rcv_count);
+      slot[0]=len-2;
+      memcpy(slot+1,data+2,len-2);
+      tp->rcv_count++;
+      tp->rcv_nxt++;
+    }
+    tp->ack_due=1;
+
+  } else if(data[0]==LNP_TP_ACK && len>=3) {
+    // acks beyond what was transmitted are stale or bogus
+    //
+    acked=seq-tp->snd_una;
+    if(acked>(unsigned char) (tp->snd_max-tp->snd_una))
+      return;
+
+    if(acked) {
+      if((unsigned char) (tp->snd_nxt-tp->snd_una)<acked)
+        tp->snd_nxt=seq;                        // overtook a go-back
+      tp->snd_una=seq;
+      tp->syn=0;
+      tp->timer=tp->snd_una==tp->snd_max ? 0 : now+tp->rto;
+    } else if(tp->snd_nxt!=tp->snd_una && data[2]) {
+      // the link is half duplex, so the receiver heard all we sent
+      // before it answered. it's still missing the oldest frame.
+      //
+      tp->snd_nxt=tp->snd_una;
+    }
+    tp->timeouts=0;
+
+    tp->snd_wnd=data[2]<tp->window ? data[2] : tp->window;
+    if(tp->snd_wnd)
+      tp->probe=0;
+  }
+}
+
+//! get the next frame to transmit
+/*! \param buf buffer of size+2 bytes for the frame
+    \param now the time in ms
+    \return length of the frame, 0 if there is nothing to transmit
+
+    acks go first. after a timeout, all frames in flight are sent
+    again, or the oldest one only if the receiver has no room.
+*/
+int lnp_tp_output(lnp_tp_t *tp,unsigned char *buf,unsigned long now) {
+  unsigned char *slot;
+  unsigned char flight;
+
+  if(tp->ack_due) {
+    tp->ack_due=0;
+    buf[0]=LNP_TP_ACK;
+    buf[1]=tp->rcv_nxt;
+    buf[2]=tp->window-tp->rcv_count;
+    return 3;
+  }
+
+  if(tp->timer && (long) (now-tp->timer)>=0) {
+    tp->timer=0;
+    tp->timeouts++;
+    tp->snd_nxt=tp->snd_una;                    // go back n
+    if(tp->snd_wnd==0)
+      tp->probe=1;
+  }
+
+  flight=tp->snd_nxt-tp->snd_una;
+  if(tp->snd_nxt==tp->snd_end ||
+     (flight>=tp->snd_wnd && !(tp->probe && flight==0))) {
+    // waiting for room at the receiver. without a timer, a lost
+    // window update would stall us for good.
+    //
+    if(tp->snd_nxt!=tp->snd_end && !tp->timer)
+      tp->timer=now+tp->rto;
+    return 0;
+  }
+
+  slot=tx_slot(tp,tp->snd_nxt);
+  buf[0]=LNP_TP_DATA;
+  if(tp->syn && tp->snd_nxt==tp->snd_iss)
+    buf[0]|=LNP_TP_SYN;
+  buf[1]=tp->snd_nxt;
+  memcpy(buf+2,slot+1,slot[0]);
+
+  if(flight<(unsigned char) (tp->snd_max-tp->snd_una))
+    tp->resent++;
+  else
+    tp->snd_max=tp->snd_nxt+1;
+  tp->snd_nxt++;
+  tp->frames++;
+  tp->probe=0;
+
+  // the peer can only answer once we are silent.
+  //
+  tp->timer=now+tp->rto+(slot[0]+LNP_TP_OVERHEAD)*tp->byte_time;
+
+  return slot[0]+2;
+}
+
+#if !defined(CONF_HOST) || defined(CONF_HOST_SIM)
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Blocking interface
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static lnp_tp_t *lnp_tp_list;           //!< the open transports
+static sem_t lnp_tp_sem=1;              //!< the task pumping frames
+
+//! addressing layer handler of the transport ports, called from interrupt
+static void lnp_tp_handler(const unsigned char *data,unsigned char len,
+                           unsigned char src) {
+  lnp_tp_t *tp;
+
+  for(tp=lnp_tp_list; tp; tp=tp->next)
+    if(tp->peer==src) {
+      lnp_tp_input(tp,data,len,get_system_up_time());
+      notify_event(tp);
+      break;
+    }
+}
+
+//! the frame buffer behind the slots
+#define tp_frame(tp)  ((tp)->rx+(tp)->window*((tp)->size+1))
+
+//! transmit what the engine has to
+/*! a frame is on the air from the frame buffer until the write
+    returns, so one task at a time pumps. the transports share the
+    medium anyway.
+*/
+static void lnp_tp_pump(lnp_tp_t *tp) {
+  unsigned char ccr;
+  int len;
+
+  if(sem_wait(&lnp_tp_sem)==-1)
+    return;                                     // shutdown
+
+  for(;;) {
+    ccr=irq_save();
+    len=lnp_tp_output(tp,tp_frame(tp),get_system_up_time());
+    irq_restore(ccr);
+
+    if(len==0)
+      break;
+    lnp_addressing_write(tp_frame(tp),len,tp->peer,tp->port);
+  }
+
+  sem_post(&lnp_tp_sem);
+}
+
+//! does the engine have something to transmit?
+static int lnp_tp_work(lnp_tp_t *tp) {
+  unsigned char flight=tp->snd_nxt-tp->snd_una;
+
+  return tp->ack_due ||
+         (tp->timer && (long) (get_system_up_time()-tp->timer)>=0) ||
+         (tp->snd_nxt!=tp->snd_end && flight<tp->snd_wnd);
+}
+
+static wakeup_t lnp_tp_space_wakeup(wakeup_t data) {
+  lnp_tp_t *tp=(lnp_tp_t*) ((size_t) data);
+
+  return lnp_tp_work(tp) || lnp_tp_space(tp);
+}
+
+static wakeup_t lnp_tp_recv_wakeup(wakeup_t data) {
+  lnp_tp_t *tp=(lnp_tp_t*) ((size_t) data);
+
+  return lnp_tp_work(tp) || tp->rcv_count;
+}
+
+static wakeup_t lnp_tp_done_wakeup(wakeup_t data) {
+  lnp_tp_t *tp=(lnp_tp_t*) ((size_t) data);
+
+  return lnp_tp_work(tp) || lnp_tp_done(tp);
+}
+
+//! wait for the engine, a frame's ack or the retransmit timer
+/*! \return 0 on shutdown
+*/
+static wakeup_t lnp_tp_wait(lnp_tp_t *tp,wakeup_t (*wakeup)(wakeup_t)) {
+  if(tp->timer)
+    return wait_event_until(tp,wakeup,(wakeup_t) ((size_t) tp),tp->timer);
+  return wait_event_on(tp,wakeup,(wakeup_t) ((size_t) tp));
+}
+
+//! open a transport to a peer
+/*! \param tp the transport
+    \param port local port, its addressing handler is taken over
+    \param peer remote address and port
+    \param window frames in flight, 0 for LNP_TP_WINDOW
+    \param size max. payload of a frame, at most LNP_TP_MTU
+    \return 0 on success, -1 if out of memory or the peer has a transport
+*/
+int lnp_tp_open(lnp_tp_t *tp,unsigned char port,unsigned char peer,
+                unsigned char window,unsigned char size) {
+  unsigned char *buf;
+  lnp_tp_t *other;
+  unsigned char ccr;
+
+  if(size>LNP_TP_MTU)
+    return -1;
+  for(other=lnp_tp_list; other; other=other->next)
+    if(other->peer==peer)
+      return -1;
+  if(!window)
+    window=LNP_TP_WINDOW;
+  if((buf=malloc(LNP_TP_BUFSIZE(window,size)+size+2))==NULL)
+    return -1;
+
+  lnp_tp_init(tp,buf,window,size,(unsigned char) get_system_up_time());
+  tp->port=port & LNP_PORTMASK;
+  tp->peer=peer;
+
+  ccr=irq_save();
+  tp->next=lnp_tp_list;
+  lnp_tp_list=tp;
+  lnp_addressing_set_handler(tp->port,lnp_tp_handler);
+  irq_restore(ccr);
+
+  return 0;
+}
+
+//! close a transport, dropping frames not yet acknowledged
+void lnp_tp_close(lnp_tp_t *tp) {
+  lnp_tp_t **link;
+  unsigned char ccr;
+
+  ccr=irq_save();
+  for(link=&lnp_tp_list; *link; link=&(*link)->next)
+    if(*link==tp) {
+      *link=tp->next;
+      break;
+    }
+  for(link=&lnp_tp_list; *link; link=&(*link)->next)
+    if((*link)->port==tp->port)
+      break;
+  if(!*link)
+    lnp_addressing_set_handler(tp->port,LNP_DUMMY_ADDRESSING);
+  irq_restore(ccr);
+
+  free(tp->tx);
+}
+
+//! send a frame, blocking while the window is full
+/*! \return 0 if queued, -1 if the peer stopped answering or on shutdown
+*/
+int lnp_tp_send(lnp_tp_t *tp,const void *data,unsigned char len) {
+  unsigned char ccr;
+  int result;
+
+  for(;;) {
+    lnp_tp_pump(tp);
+    if(lnp_tp_failed(tp))
+      return -1;
+    if(lnp_tp_space(tp))
+      break;
+    if(lnp_tp_wait(tp,lnp_tp_space_wakeup)==0)
+      return -1;
+  }
+
+  ccr=irq_save();
+  result=lnp_tp_queue(tp,data,len);
+  irq_restore(ccr);
+
+  lnp_tp_pump(tp);
+  return result;
+}
+
+//! receive a frame, blocking
+/*! \param buf buffer of size bytes
+    \return length of the payload, -1 on shutdown
+*/
+int lnp_tp_recv(lnp_tp_t *tp,void *buf) {
+  unsigned char ccr;
+  int len;
+
+  for(;;) {
+    lnp_tp_pump(tp);
+
+    ccr=irq_save();
+    len=lnp_tp_read(tp,buf);
+    irq_restore(ccr);
+
+    if(len>=0) {
+      lnp_tp_pump(tp);                          // window update
+      return len;
+    }
+    if(lnp_tp_wait(tp,lnp_tp_recv_wakeup)==0)
+      return -1;
+  }
+}
+
+//! wait until all frames sent have been acknowledged
+/*! \return 0 if they have, -1 if the peer stopped answering or on shutdown
+*/
+int lnp_tp_flush(lnp_tp_t *tp) {
+  for(;;) {
+    lnp_tp_pump(tp);
+    if(lnp_tp_done(tp))
+      return 0;
+    if(lnp_tp_failed(tp))
+      return -1;
+    if(lnp_tp_wait(tp,lnp_tp_done_wakeup)==0)
+      return -1;
+  }
+}
+
+#endif // !CONF_HOST || CONF_HOST_SIM
+
+#endif // CONF_LNP_TRANSPORT
@@ -59,6 +59,10 @@
 
 #include <string.h>
 
+#if !defined(CONF_HOST) || defined(CONF_HOST_SIM)
+#include <unistd.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Variables
@@ -89,9 +93,15 @@ volatile lnp_integrity_handler_t lnp_integrity_handler;
 */
 volatile lnp_addressing_handler_t lnp_addressing_handler[LNP_PORTMASK+1];
 
-#if !defined(CONF_MM)
-static char lnp_buffer[260];
-#endif // CONF_MM
+#ifdef CONF_HOST
+//! sees every frame before it is handled, for capture tools
+lnp_monitor_handler_t lnp_monitor_handler;
+#endif
+
+#ifdef CONF_LNP_PORTQ
+//! receive rings, checked before the handlers
+static lnp_port_t * volatile lnp_port[LNP_PORTMASK+1];
+#endif
 
 #if defined(CONF_RCX_PROTOCOL)
 //! remote handler
@@ -132,64 +142,94 @@ unsigned char lnp_rcx_message;
 #define lnp_checksum_step(sum,d)  (unsigned char)((sum) += (d))
 
 #ifdef CONF_HOST
-unsigned char lnp_checksum_copy( unsigned char *dest,
-                                 const unsigned char *data, 
-                                 unsigned length )
-{
-  unsigned char a = 0xff;
-  unsigned char t;
+#define lnp_monitor(frame,length,valid) \
+  do { \
+    if(lnp_monitor_handler) \
+      lnp_monitor_handler((frame),(length),(valid)); \
+  } while(0)
+#else
+#define lnp_monitor(frame,length,valid)
+#endif
 
-  do {
-    t = *data++;
-    a += t;
-    *dest++ = t;
-    length--;
-  } while (length > 0);
+#ifdef CONF_HOST
+unsigned char lnp_checksum( unsigned char sum,
+                            const unsigned char *data,
+                            unsigned length )
+{
+  while (length-- > 0)
+    sum += *data++;
 
-  return a;
+  return sum;
 }
 #else
+// a word at a time: from the external RAM, 22 states a byte where the
+// byte loop copying the frame took 50 (util/h8sim-src/lnpsum.c)
+//
 __asm__(
 	".text\n"
-	"_lnp_checksum_copy:\n"
-	";; r0: dest, r1: data, r2: length;\n"
+	"_lnp_checksum:\n"
+	";; r0l: sum, r1: data, r2: length;\n"
 	
-	"    add.w r0,r2         ; r2: end \n"
-	"    mov.b #0xff,r3l     ; r3l: a  \n"
+	"    add.w r1,r2         ; r2: end \n"
+	"    cmp.w r1,r2 \n"
+	"    beq   3f \n"
+	"    subs  #1,r2         ; r2: last byte \n"
+	
+	"    btst  #0,r1l        ; odd address: a byte first \n"
+	"    beq   1f \n"
+	"    mov.b @r1+,r3l \n"
+	"    add.b r3l,r0l \n"
+	"    bra   1f \n"
 	
 	"0:\n"
-	"    mov.b @r1+,r3h      ; r3h = *data++ \n"
-	"    add.b r3h,r3l       ; a += r3h      \n"
-	"    mov.b r3h,@r0       ; *dest++ = r3h \n"
-	"    adds  #1,r0 \n"
-	"    cmp.w r0,r2 \n"
-	"    bne   0b \n"
+	"    mov.w @r1+,r3       ; r3 = *data++, two bytes \n"
+	"    add.b r3h,r0l       ; sum += r3h    \n"
+	"    add.b r3l,r0l       ; sum += r3l    \n"
+	"1:\n"
+	"    cmp.w r2,r1 \n"
+	"    bcs   0b            ; two bytes or more left \n"
+	"    bne   3f            ; none left \n"
 	
-	"    sub.w r0,r0 \n"
-	"    mov.b r3l,r0l \n"
+	"    mov.b @r1,r3l       ; the last one \n"
+	"    add.b r3l,r0l \n"
+	"3:\n"
+	"    sub.b r0h,r0h \n"
 	"    rts \n"
 	);
 #endif
 
+//! send a frame made of a header and a payload, adding the checksum
+/*! the frame is transmitted straight from header and data, without
+    a transmit buffer.
+    \return 0 on success.
+*/
+int lnp_frame_write(const unsigned char *header,unsigned char hlength,
+                    const unsigned char *data,unsigned char length) {
+  lnp_iovec_t iov[3];
+  unsigned char c;
+
+  lnp_checksum_init( c );
+  c = lnp_checksum( c, header, hlength );
+  c = lnp_checksum( c, data, length );
+
+  iov[0].base = header;
+  iov[0].len  = hlength;
+  iov[1].base = data;
+  iov[1].len  = length;
+  iov[2].base = &c;
+  iov[2].len  = 1;
+  return lnp_logical_writev(iov,3);
+}
+
 //! send a LNP integrity layer packet of given length
 /*! \return 0 on success.
 */
 int lnp_integrity_write(const unsigned char *data,unsigned char length) {
-  int r;
-#if defined(CONF_MM)
-  char* buffer_ptr = malloc(length+3);
-#else // CONF_MM
-  char* buffer_ptr = lnp_buffer;
-#endif // CONF_MM
-  unsigned char c = lnp_checksum_copy( buffer_ptr+2, data, length);
-  lnp_checksum_step( c, buffer_ptr[0]=0xf0 );
-  lnp_checksum_step( c, buffer_ptr[1]=length );
-  buffer_ptr[length+2] = c;
-  r = lnp_logical_write(buffer_ptr,length+3);
-#if defined(CONF_MM)
-  free(buffer_ptr); 
-#endif // CONF_MM
-  return r;
+  unsigned char header[2];
+
+  header[0] = 0xf0;
+  header[1] = length;
+  return lnp_frame_write(header,2,data,length);
 }
 
 //! send a LNP addressing layer packet of given length
@@ -197,26 +237,204 @@ int lnp_integrity_write(const unsigned char *data,unsigned char length) {
 */
 int lnp_addressing_write(const unsigned char *data,unsigned char length,
                          unsigned char dest,unsigned char srcport) {
-  int r;
-#if defined(CONF_MM)
-  char* buffer_ptr = malloc(length+5);
-#else // CONF_MM
-  char* buffer_ptr = lnp_buffer;
-#endif // CONF_MM
-  unsigned char c = lnp_checksum_copy( buffer_ptr+4, data, length );
-  lnp_checksum_step( c, buffer_ptr[0]=0xf1 );
-  lnp_checksum_step( c, buffer_ptr[1]=length+2 );
-  lnp_checksum_step( c, buffer_ptr[2]=dest );
-  lnp_checksum_step( c, buffer_ptr[3]=
-                   (lnp_hostaddr | (srcport & LNP_PORTMASK)) );
-  buffer_ptr[length+4] = c;
-  r = lnp_logical_write(buffer_ptr,length+5);
-#if defined(CONF_MM)
-  free(buffer_ptr); 
-#endif // CONF_MM
-  return r;
+  unsigned char header[4];
+
+  header[0] = 0xf1;
+  header[1] = length+2;
+  header[2] = dest;
+  header[3] = lnp_hostaddr | (srcport & LNP_PORTMASK);
+  return lnp_frame_write(header,4,data,length);
 }
 
+#ifdef CONF_LNP_ASYNC
+//! queue a frame made of tx->header and a payload, adding the checksum
+static int lnp_frame_queue(lnp_tx_t *tx,unsigned char hlength,
+                           const unsigned char *data,unsigned char length,
+                           lnp_tx_done_t done) {
+  lnp_checksum_init( tx->sum );
+  tx->sum = lnp_checksum( tx->sum, tx->header, hlength );
+  tx->sum = lnp_checksum( tx->sum, data, length );
+
+  tx->iov[0].base = tx->header;
+  tx->iov[0].len  = hlength;
+  tx->iov[1].base = data;
+  tx->iov[1].len  = length;
+  tx->iov[2].base = &tx->sum;
+  tx->iov[2].len  = 1;
+  tx->count = 3;
+  tx->done  = done;
+  return lnp_logical_queue(tx);
+}
+
+//! queue a LNP integrity layer packet of given length
+/*! \return 0 if queued, -1 if the transmit queue is full.
+*/
+int lnp_integrity_write_async(lnp_tx_t *tx,const unsigned char *data,
+                              unsigned char length,lnp_tx_done_t done) {
+  tx->header[0] = 0xf0;
+  tx->header[1] = length;
+  return lnp_frame_queue(tx,2,data,length,done);
+}
+
+//! queue a LNP addressing layer packet of given length
+/*! \return 0 if queued, -1 if the transmit queue is full.
+*/
+int lnp_addressing_write_async(lnp_tx_t *tx,const unsigned char *data,
+                               unsigned char length,unsigned char dest,
+                               unsigned char srcport,lnp_tx_done_t done) {
+  tx->header[0] = 0xf1;
+  tx->header[1] = length+2;
+  tx->header[2] = dest;
+  tx->header[3] = lnp_hostaddr | (srcport & LNP_PORTMASK);
+  return lnp_frame_queue(tx,4,data,length,done);
+}
+#endif // CONF_LNP_ASYNC
+
+#ifdef CONF_LNP_PORTQ
+//! the slot number n of a ring
+#define lnp_port_slot(ring,n)	((ring)->slots+(n)*((ring)->size+2))
+
+//! store a packet in the receive ring of a port, called from interrupt
+/*! the packet is dropped if the ring is full or it doesn't fit a slot.
+*/
+static void lnp_port_put(unsigned char port,const unsigned char *data,
+                         unsigned char length,unsigned char src) {
+  lnp_port_t *ring=lnp_port[port];
+  unsigned char *slot;
+  unsigned char n;
+
+  if(ring->count==ring->depth || length>ring->size) {
+    if(ring->dropped!=0xff)
+      ring->dropped++;
+    return;
+  }
+
+  n=ring->head+ring->count;
+  if(n>=ring->depth)
+    n-=ring->depth;
+  slot=lnp_port_slot(ring,n);
+  slot[0]=length;
+  slot[1]=src;
+  memcpy(slot+2,data,length);
+  ring->count++;
+
+  notify_event((void*) &lnp_port[port]);
+}
+
+//! give a port a receive ring
+/*! \param port the port
+    \param depth number of packets the ring holds
+    \param size max. payload of a packet, at most LNP_PORT_MTU
+    \return 0 on success, -1 if out of memory or the port has a ring
+
+    packets for the port are queued in the ring instead of being passed
+    to its handler. the ring is allocated by the calling task.
+*/
+int lnp_port_open(unsigned char port,unsigned char depth,unsigned char size) {
+  lnp_port_t *ring;
+
+  port&=LNP_PORTMASK;
+  if(lnp_port[port] || depth==0 || size>LNP_PORT_MTU)
+    return -1;
+  if((ring=malloc(sizeof(lnp_port_t)+depth*(size+2)))==NULL)
+    return -1;
+
+  ring->head   =0;
+  ring->count  =0;
+  ring->depth  =depth;
+  ring->size   =size;
+  ring->dropped=0;
+  lnp_port[port]=ring;
+
+  return 0;
+}
+
+//! take the receive ring from a port and free it
+/*! tasks waiting in lnp_port_recv() return -1.
+*/
+void lnp_port_close(unsigned char port) {
+  lnp_port_t *ring;
+  unsigned char ccr;
+
+  port&=LNP_PORTMASK;
+  ccr=irq_save();
+  ring=lnp_port[port];
+  lnp_port[port]=NULL;
+  notify_event((void*) &lnp_port[port]);
+  irq_restore(ccr);
+
+  free(ring);
+}
+
+static wakeup_t lnp_port_ready(wakeup_t data) {
+  lnp_port_t *ring=lnp_port[data];
+
+  return ring==NULL || ring->count!=0;
+}
+
+//! receive a packet from the ring of a port, blocking
+/*! \param port the port
+    \param buf buffer for the payload, as large as the ring's size
+    \param src where to store the sender's address, or NULL
+    \return length of the payload, -1 if the port has no ring
+             or the task is shut down
+
+    several tasks may wait on a port, each packet goes to one of them.
+*/
+int lnp_port_recv(unsigned char port,unsigned char *buf,unsigned char *src) {
+  lnp_port_t *ring;
+  unsigned char *slot;
+  unsigned char ccr,length;
+
+  port&=LNP_PORTMASK;
+  for(;;) {
+    if(wait_event_on((void*) &lnp_port[port],lnp_port_ready,port)==0)
+      return -1;
+
+    // take the head slot with interrupts off: another reader may have
+    // emptied the ring since the wakeup, and lnp_port_close() frees
+    // the ring only after taking it from the port. a slot is at most
+    // LNP_PORT_MTU+2 bytes, less than a byte time on the air.
+    //
+    ccr=irq_save();
+    if((ring=lnp_port[port])==NULL) {
+      irq_restore(ccr);
+      return -1;
+    }
+    if(ring->count!=0)
+      break;
+    irq_restore(ccr);
+  }
+
+  slot=lnp_port_slot(ring,ring->head);
+  length=slot[0];
+  if(src)
+    *src=slot[1];
+  memcpy(buf,slot+2,length);
+
+  if(++ring->head==ring->depth)
+    ring->head=0;
+  ring->count--;
+  irq_restore(ccr);
+
+  return length;
+}
+
+//! packets dropped by the ring of a port since the last call
+/*! \return number of dropped packets, 255 for 255 or more
+*/
+unsigned char lnp_port_dropped(unsigned char port) {
+  lnp_port_t *ring=lnp_port[port & LNP_PORTMASK];
+  unsigned char dropped=0;
+
+  if(ring) {
+    dropped=ring->dropped;
+    ring->dropped=0;
+  }
+  return dropped;
+}
+#endif // CONF_LNP_PORTQ
+
 //! handle LNP packet from the integrity layer
 void lnp_receive_packet(const unsigned char *data) {
   unsigned char header=*(data++);
@@ -241,8 +459,21 @@ void lnp_receive_packet(const unsigned char *data) {
       if(length>2) {
         unsigned char dest=*(data++);
 
-        if(lnp_hostaddr == (dest & LNP_HOSTMASK)) {
+        if(lnp_hostaddr == (dest & LNP_HOSTMASK)
+#ifdef CONF_LNP_BROADCAST
+           || LNP_BROADCAST == (dest & LNP_HOSTMASK)
+#endif
+          ) {
           unsigned char port=dest & LNP_PORTMASK;
+#ifdef CONF_LNP_PORTQ
+          if(lnp_port[port]) {
+#ifdef CONF_AUTOSHUTOFF
+            shutoff_restart();
+#endif
+            lnp_port_put(port,data+1,length-2,*data);
+            break;
+          }
+#endif
           addrh = lnp_addressing_handler[port];
           if(addrh) {
             unsigned char src=*(data++);
@@ -258,19 +489,32 @@ void lnp_receive_packet(const unsigned char *data) {
 }
 
 //! receive a byte, decoding LNP packets with a state machine.
+/*! called from the receive interrupt for every byte on the air. the
+    payload bytes, most of a packet, take a short cut around the switch
+    that only stores, sums and counts them.
+*/
 void lnp_integrity_byte(unsigned char b) {
   static unsigned char buffer[256+3];
-  static int bytesRead,endOfData;
+  static unsigned char *pos,*end;
   static unsigned char chk;
 
+  if(lnp_integrity_state==LNPwaitData) {
+    *pos++=b;
+    lnp_checksum_step( chk, b );
+    if(pos==end)
+      lnp_integrity_state=LNPwaitCRC;
+    return;
+  }
+
   if(lnp_integrity_state==LNPwaitHeader)
-    bytesRead=0;
+    pos=buffer;
 
-  buffer[bytesRead++]=b;
+  *pos++=b;
 
   switch(lnp_integrity_state) {
     case LNPwaitHeader:
-      // valid headers are 0xf0 .. 0xf7
+      // valid headers are 0xf0 .. 0xf7, a mask and a compare
+      // are cheaper than a table lookup on the H8
       //
       if(((b & 0xf8) == 0xf0) || (b == 0x55)) {
 #ifdef CONF_VIS
@@ -303,16 +547,18 @@ void lnp_integrity_byte(unsigned char b) {
       break;
 
     case LNPwaitLength:
-      endOfData=b+2;
-      lnp_integrity_state++;
+      // an empty packet has its checksum next
+      //
+      end=buffer+b+2;
+      lnp_integrity_state=b ? LNPwaitData : LNPwaitCRC;
       break;
 
     case LNPwaitData:
-      if(bytesRead==endOfData)
-  lnp_integrity_state++;
+      // the short cut above
       break;
 
     case LNPwaitCRC:
+      lnp_monitor(buffer,pos-buffer,b==chk);
       if(b==chk)
   lnp_receive_packet(buffer);
       lnp_integrity_reset();
@@ -375,6 +621,7 @@ void lnp_integrity_byte(unsigned char b) {
 
     case LNPwaitRCI:
       // if checksum valid and remote handler has been installed, call remote handler
+    lnp_monitor(buffer,pos-buffer,b == (unsigned char)~lnp_rcx_checksum);
     if ( b == (unsigned char)~lnp_rcx_checksum) {
 #if defined(CONF_RCX_MESSAGE)
      // if a message, set message number and exit
@@ -429,6 +676,7 @@ void lnp_integrity_byte(unsigned char b) {
 
     case LNPwaitMCC:
       // set message variable if it is valid message
+      lnp_monitor(buffer,pos-buffer,(unsigned char)~b == lnp_rcx_temp1);
       if ( (unsigned char)~b == lnp_rcx_temp1 )
         lnp_rcx_message = lnp_rcx_temp0;
       // reset state machine
@@ -447,11 +695,10 @@ void lnp_integrity_reset(void) {
 HANDLER_WRAPPER("lnp_integrity_reset","lnp_integrity_reset_core");
 void lnp_integrity_reset_core(void) {
 #endif
-#ifndef CONF_HOST
-  if(tx_state>TX_IDLE) {
-    txend_handler();
-    tx_state=TX_COLL;
-  } else
+#if !defined(CONF_HOST) || defined(CONF_HOST_SIM)
+  if(tx_state>TX_IDLE)
+    lnp_tx_abort();                     // like a collision
+  else
 #endif
   if(lnp_integrity_state!=LNPwaitHeader) {
     lnp_integrity_state=LNPwaitHeader;
@@ -496,8 +743,15 @@ void lnp_timeout_set(unsigned short timeout) {
 void lnp_init(void) {
   int k;
   
-  for(k=1; k<=LNP_PORTMASK; k++)
+  for(k=1; k<=LNP_PORTMASK; k++) {
     lnp_addressing_handler[k]=LNP_DUMMY_ADDRESSING;
+#ifdef CONF_LNP_PORTQ
+    // the rings belong to the programs and go with their memory.
+    //
+    lnp_port[k]=NULL;
+    notify_event((void*) &lnp_port[k]);
+#endif
+  }
   lnp_integrity_handler=LNP_DUMMY_INTEGRITY;
 
 #if defined(CONF_RCX_PROTOCOL)
@@ -518,12 +772,8 @@ wakeup_t msg_received(wakeup_t m) {
  */
 int send_msg(unsigned char msg)
 {
-  int r;
-#if defined(CONF_MM)
-  char* buffer_ptr = malloc(9);
-#else // CONF_MM
-  char* buffer_ptr = lnp_buffer;
-#endif // CONF_MM
+  unsigned char buffer_ptr[9];
+
   buffer_ptr[0]=0x55;
   buffer_ptr[1]=0xff;
   buffer_ptr[2]=0x00;
@@ -533,11 +783,7 @@ int send_msg(unsigned char msg)
   buffer_ptr[6]=(unsigned char) (0xff-msg);
   buffer_ptr[7]=(unsigned char) (0xf7+msg);
   buffer_ptr[8]=(unsigned char) (0x08-msg);
-  r = lnp_logical_write(buffer_ptr,9);
-#if defined(CONF_MM)
-  free(buffer_ptr); 
-#endif // CONF_MM
-  return r;
+  return lnp_logical_write(buffer_ptr,9);
 }
 #endif
 
@@ -0,0 +1,74 @@
+/*! \file   lzss.c
+    \brief  Implementation: LZSS decompression of downloaded programs
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The host cuts the stream into packets at token boundaries, each
+ *  starting with a flag byte of its own, so every packet expands on
+ *  its own right behind the bytes downloaded before it. The host
+ *  utilities compile this file, too, to read compressed executables.
+ */
+
+#include <lzss.h>
+
+#ifdef CONF_PROGRAM_LZSS
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+int lzss_decode(unsigned char *dst,unsigned done,unsigned room,
+                const unsigned char *src,unsigned len) {
+  const unsigned char *end=src+len;
+  unsigned char *out=dst, *limit=dst+room;
+  const unsigned char *from;
+  unsigned flags=0, length, distance;
+
+  while(src<end) {
+    // the flag byte's bits are shifted out towards a marker bit
+    //
+    flags>>=1;
+    if(!(flags & 0x100)) {
+      flags=*src++ | 0xff00;
+      if(src==end)
+        break;
+    }
+
+    if(flags & 1) {
+      if(out==limit)
+        return -1;
+      *out++=*src++;
+    } else {
+      if(end-src<2)
+        return -1;
+      length  =(src[0]>>4)+LZSS_MIN;
+      distance=(((src[0] & 0x0f)<<8) | src[1])+1;
+      src+=2;
+
+      if(distance>done+(out-dst) || length>(unsigned) (limit-out))
+        return -1;
+      from=out-distance;
+      do
+        *out++=*from++;
+      while(--length);
+    }
+  }
+
+  return out-dst;
+}
+
+#endif // CONF_PROGRAM_LZSS
@@ -38,7 +38,16 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
       
+#ifdef CONF_MM_SEGREGATED
+size_t *mm_free_list[MM_CLASSES];  //!< free blocks by size class
+unsigned mm_class_map;             //!< bit n set: mm_free_list[n] not empty
+#else
 size_t *mm_first_free;        //!< first free block
+#endif
+
+#ifdef CONF_HOST
+size_t mm_heap[MM_HOST_WORDS];     //!< simulated ram
+#endif
 
 #ifndef CONF_TM
 typedef size_t tid_t;                           //! dummy process ID type
@@ -63,6 +72,98 @@ const tid_t ctid=0x0001;
 // 4 ... 4+2n: data
 //
 
+#ifdef CONF_MM_SEGREGATED
+
+//
+// free block structure (segregated fit):
+// 0 1       : MM_FREE
+// 2 3       : size of data block >> 1, MM_PREV_FREE flag
+// 4 5       : next free block in size class
+// 6 7       : previous free block in size class
+// ...
+// 2+2n 3+2n : pointer to owner field (boundary tag)
+//
+// no two free blocks are ever adjacent.
+//
+
+//! size class of a block
+/*! \param size data size in words
+    \return floor(log2(size))
+*/
+static inline unsigned mm_class(size_t size) {
+  unsigned c=0;
+
+  while(size>>=1)
+    c++;
+  return c;
+}
+
+//! remove a free block from its size class list
+/*! \param ptr pointer to owner field of the block
+*/
+static void mm_unlink(size_t *ptr) {
+  size_t *next=(size_t*) *(ptr+2);
+  size_t *prev=(size_t*) *(ptr+3);
+  unsigned c=mm_class(MM_SIZE(ptr));
+
+  if(prev)
+    *(prev+2)=(size_t) next;
+  else {
+    mm_free_list[c]=next;
+    if(next==NULL)
+      mm_class_map&=~(1<<c);
+  }
+  if(next)
+    *(next+3)=(size_t) prev;
+}
+
+//! put a free block at the head of its size class list
+/*! also writes the boundary tag and flags the following block.
+    \param ptr pointer to owner field of the block
+*/
+static void mm_insert(size_t *ptr) {
+  size_t size=MM_SIZE(ptr);
+  size_t *next=ptr+size+MM_HEADER_SIZE;
+  unsigned c=mm_class(size);
+
+  *ptr=MM_FREE;
+  *(ptr+2)=(size_t) mm_free_list[c];
+  *(ptr+3)=(size_t) NULL;
+  if(mm_free_list[c])
+    *(mm_free_list[c]+3)=(size_t) ptr;
+  mm_free_list[c]=ptr;
+  mm_class_map|=1<<c;
+
+  *(next-1)=(size_t) ptr;               // boundary tag
+  if(MM_IN_HEAP(next))
+    *(next+1)|=MM_PREV_FREE;
+}
+
+//! release a block and join it with its free neighbours
+/*! \param ptr pointer to owner field of the block
+    \return pointer to owner field of the resulting free block
+*/
+static size_t *mm_free_block(size_t *ptr) {
+  size_t *next=ptr+MM_SIZE(ptr)+MM_HEADER_SIZE;
+  size_t *prev;
+
+  if(MM_IN_HEAP(next) && *next==MM_FREE) {
+    mm_unlink(next);                    // join successor
+    *(ptr+1)+=MM_SIZE(next)+MM_HEADER_SIZE;
+  }
+  if(*(ptr+1) & MM_PREV_FREE) {
+    prev=(size_t*) *(ptr-1);            // join predecessor
+    mm_unlink(prev);
+    *(prev+1)+=MM_SIZE(ptr)+MM_HEADER_SIZE;
+    ptr=prev;
+  }
+  mm_insert(ptr);
+
+  return ptr;
+}
+
+#else
+
 //! check for free blocks after this one and join them if possible
 /* \param ptr pointer to size field of current block
    \return size of block
@@ -71,7 +172,7 @@ size_t mm_try_join(size_t *ptr) {
   size_t *next=ptr+*ptr+1;
   size_t increase=0;
   
-  while(*next==MM_FREE && next>=&mm_start) {
+  while(MM_IN_HEAP(next) && *next==MM_FREE) {
     increase+=*(next+1) + MM_HEADER_SIZE;
     next    +=*(next+1) + MM_HEADER_SIZE;
   }
@@ -86,7 +187,7 @@ void mm_defrag() {
 #ifdef CONF_TM
   ENTER_KERNEL_CRITICAL_SECTION();
 #endif
-  while(ptr >= &mm_start) {
+  while(MM_IN_HEAP(ptr)) {
     if(*ptr == MM_FREE)
       mm_try_join(ptr+1);
     ptr += *(ptr+1);
@@ -103,21 +204,36 @@ void mm_defrag() {
 void mm_update_first_free(size_t *start) {
   size_t *ptr=start;
   
-  while((*ptr!=MM_FREE) && (ptr>=&mm_start))
+  while(MM_IN_HEAP(ptr) && (*ptr!=MM_FREE))
     ptr+=*(ptr+1)+MM_HEADER_SIZE;
 
   mm_first_free=ptr;
 }
 
+#endif // CONF_MM_SEGREGATED
+
 
 //! initialize memory management
 /*!
 */
 void mm_init() {
-  size_t *current,*next;
+  size_t *current;
+#ifndef CONF_HOST
+  size_t *next;
+#endif
+#ifdef CONF_MM_SEGREGATED
+  unsigned c;
+#endif
   
   current=&mm_start;
 
+#ifdef CONF_HOST
+  // one flat block of simulated ram
+  //
+  *current=MM_FREE;
+  *(current+1)=MM_HOST_WORDS-MM_HEADER_SIZE;
+#else
+
   // memory layout
   //
   MM_BLOCK_FREE    (&mm_start);   // ram
@@ -132,26 +248,124 @@ void mm_init() {
 
   // expand last block to encompass all available memory
   *current=(int)(((-(int) current)-2)>>1);
+#endif // CONF_HOST
   
+#ifdef CONF_MM_SEGREGATED
+  for(c=0; c<MM_CLASSES; c++)
+    mm_free_list[c]=NULL;
+  mm_class_map=0;
+
+  for(current=&mm_start; MM_IN_HEAP(current);
+      current+=MM_SIZE(current)+MM_HEADER_SIZE)
+    if(*current==MM_FREE)
+      mm_insert(current);
+#else
   mm_update_first_free(&mm_start);
+#endif
 }
 
+#ifdef CONF_MM_SEGREGATED
 
 //! allocate a block of memory
 /*! \param size requested block size
     \return 0 on error, else pointer to block.
+
+    takes the head of the block's own size class if it fits,
+    else the head of the next non-empty larger class, else the first
+    block further down its own class that fits.
 */
 void *malloc(size_t size) {
   size_t *ptr,*next;
+  unsigned c,map;
   
-  size=(size+1)>>1;       // only multiples of 2
+  size=MM_WORDS(size);    // only whole words
+  if(size<MM_MIN_DATA)
+    size=MM_MIN_DATA;     // room for links and tag once freed
+  c=mm_class(size);
+
+#ifdef CONF_TM
+  ENTER_KERNEL_CRITICAL_SECTION();
+#endif
+  ptr=mm_free_list[c];
+  if(ptr==NULL || MM_SIZE(ptr)<size) {
+    map=mm_class_map & ~((2<<c)-1);     // any block up there fits
+    if(map!=0) {
+      do
+        c++;
+      while(!(map & (1<<c)));
+      ptr=mm_free_list[c];
+    } else {
+      while(ptr!=NULL && MM_SIZE(ptr)<size)
+        ptr=(size_t*) *(ptr+2);         // next in class
+      if(ptr==NULL) {
+#ifdef CONF_TM
+        LEAVE_KERNEL_CRITICAL_SECTION();
+#endif
+        return NULL;
+      }
+    }
+  }
+
+  mm_unlink(ptr);
+  *ptr=(size_t)ctid;      // set owner
+
+  next=ptr+MM_SIZE(ptr)+MM_HEADER_SIZE;
+  if((MM_SIZE(ptr)-size)>=MM_SPLIT_THRESH) {
+    next=ptr+size+MM_HEADER_SIZE;       // split off the rest
+    *(next+1)=MM_SIZE(ptr)-size-MM_HEADER_SIZE;
+    *(ptr+1)=(*(ptr+1) & MM_PREV_FREE) | size;
+    mm_insert(next);
+  } else if(MM_IN_HEAP(next))
+    *(next+1)&=~MM_PREV_FREE;
+
+#ifdef CONF_TM
+  LEAVE_KERNEL_CRITICAL_SECTION();
+#endif
+  return (void*) (ptr+MM_HEADER_SIZE);
+}
+
+
+//! free a previously allocated block of memory.
+/*! \param the_ptr pointer to block
+
+    neighbouring free blocks are joined right away.
+*/
+void free(void *the_ptr) {
+  size_t *ptr=the_ptr;
+  
+  if(ptr==NULL || (((size_t)ptr)&1) )
+    return;
+  
+  // free may be called by the scheduler, which only runs while
+  // the kernel critical section is not held.
+  //
+#ifdef CONF_TM
+  ENTER_KERNEL_CRITICAL_SECTION();
+#endif
+  mm_free_block(ptr-MM_HEADER_SIZE);
+#ifdef CONF_TM
+  LEAVE_KERNEL_CRITICAL_SECTION();
+#endif
+}
+
+#else
+
+
+//! allocate a block of memory
+/*! \param size requested block size
+    \return 0 on error, else pointer to block.
+*/
+void *malloc(size_t size) {
+  size_t *ptr,*next;
+  
+  size=MM_WORDS(size);    // only whole words
   
 #ifdef CONF_TM
   ENTER_KERNEL_CRITICAL_SECTION();
 #endif
   ptr=mm_first_free;
   
-  while(ptr>=&mm_start) {
+  while(MM_IN_HEAP(ptr)) {
     if(*(ptr++)==MM_FREE) {     // free block?
 #ifdef CONF_TM
       mm_try_join(ptr);   // unite with later blocks
@@ -214,7 +428,7 @@ void free(void *the_ptr) {
         //
         // therefore, just update mm_first_free
         //
-  if(ptr<mm_first_free || mm_first_free<&mm_start)
+  if(ptr<mm_first_free || !MM_IN_HEAP(mm_first_free))
     mm_first_free=ptr;                // update mm_first_free
 #else
         // without task management, we have the time to
@@ -229,11 +443,13 @@ void free(void *the_ptr) {
   }
   mm_try_join(p2+1);        // defragment free areas
 
-  if(ptr<mm_first_free || mm_first_free<&mm_start)
+  if(ptr<mm_first_free || !MM_IN_HEAP(mm_first_free))
     mm_update_first_free(ptr);    // update mm_first_free
 #endif
 }
 
+#endif // CONF_MM_SEGREGATED
+
 
 //! allocate adjacent blocks of memory
 /*! \param nmemb number of blocks (must be > 0)
@@ -265,38 +481,67 @@ void *calloc(size_t nmemb, size_t size) {
 void mm_reaper() {
   size_t *ptr;
   
-  // pass 1: mark as free 
+#ifdef CONF_MM_SEGREGATED
+#ifdef CONF_TM
+  ENTER_KERNEL_CRITICAL_SECTION();
+#endif
   ptr=&mm_start;
-  while(ptr>=&mm_start) {
+  while(MM_IN_HEAP(ptr)) {
     if(*ptr==(size_t)ctid)
+      ptr=mm_free_block(ptr);
+    ptr+=MM_SIZE(ptr)+MM_HEADER_SIZE;
+  }
+#ifdef CONF_TM
+  LEAVE_KERNEL_CRITICAL_SECTION();
+#endif
+#else
+  // pass 1: mark as free 
+  ptr=&mm_start;
+  while(MM_IN_HEAP(ptr)) {
+    if(*ptr==(size_t)ctid) {
       *ptr=MM_FREE;
+      if(ptr<mm_first_free || !MM_IN_HEAP(mm_first_free))
+        mm_first_free=ptr;              // like free()
+    }
     ptr+=*(ptr+1)+MM_HEADER_SIZE;
   }
 
   // pass 2: defragment free areas
   // this may alter free blocks
   mm_defrag();
+#endif // CONF_MM_SEGREGATED
 } 
 
 //! return the number of bytes of unallocated memory
 int mm_free_mem(void) {
   int free = 0;
   size_t *ptr;
+#ifdef CONF_MM_SEGREGATED
+  unsigned c;
+#endif
   
 #ifdef CONF_TM
   ENTER_KERNEL_CRITICAL_SECTION();
 #endif
 
+#ifdef CONF_MM_SEGREGATED
+  // Iterate through the size class lists
+  for (c = 0; c < MM_CLASSES; c++)
+    for (ptr = mm_free_list[c]; ptr != NULL; ptr = (size_t*) *(ptr+2))
+      free += MM_SIZE(ptr);
+#else
   // Iterate through the free list
   for (ptr = mm_first_free; 
-       ptr >= &mm_start; 
+       MM_IN_HEAP(ptr); 
        ptr += *(ptr+1) + MM_HEADER_SIZE)
-    free += *(ptr+1);
+    if(*ptr == MM_FREE)
+      free += *(ptr+1);
+#endif
 
 #ifdef CONF_TM
   LEAVE_KERNEL_CRITICAL_SECTION();
 #endif    
-  return free*2;
+  return free*sizeof(size_t);
 }
 
 #endif
@@ -0,0 +1,97 @@
+/*! \file   mutex.c
+    \brief  Implementation: mutexes for task synchronization
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+#include <mutex.h>
+
+#ifdef CONF_MUTEX
+
+#include <sys/tm.h>
+#include <sys/irq.h>
+#include <unistd.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! take a mutex for the current task, if it is free
+/*! \return 1 if taken, 0 if not. IRQs must be disabled.
+*/
+static int mutex_take(mutex_t *mutex) {
+  if (mutex->owner != NULL)
+    return 0;
+  mutex->owner = ctid;
+#ifdef CONF_TM_INHERIT
+  ctid->held++;
+#endif
+  return 1;
+}
+
+//! the mutex wakeup function for wait_event().
+/*! \param data pointer to the mutex passed as a wakeup_t
+
+    called by the scheduler with ctid set to the waiting task.
+*/
+static wakeup_t mutex_event_wait(wakeup_t data) {
+  return mutex_take((mutex_t*) ((size_t) data));
+}
+
+int mutex_trylock(mutex_t *mutex) {
+  unsigned char ccr = irq_save();
+  int taken = mutex_take(mutex);
+
+  irq_restore(ccr);
+  return taken ? 0 : -1;
+}
+
+int mutex_lock(mutex_t *mutex) {
+#ifdef CONF_TM_INHERIT
+  unsigned char ccr;
+#endif
+
+  if (mutex_trylock(mutex) == 0)
+    return 0;
+
+#ifdef CONF_TM_INHERIT
+  ccr = irq_save();
+  tm_inherit(mutex->owner);             // lend our priority to the owner
+  irq_restore(ccr);
+#endif
+
+  if (wait_event_on(mutex, mutex_event_wait,
+                    (wakeup_t) ((size_t) mutex)) == 0)
+    return -1;
+  return 0;
+}
+
+int mutex_unlock(mutex_t *mutex) {
+  int boosted = 0;
+  unsigned char ccr = irq_save();
+
+  mutex->owner = NULL;
+#ifdef CONF_TM_INHERIT
+  boosted = tm_disinherit();
+#endif
+  irq_restore(ccr);
+
+  notify_event(mutex);
+  if (boosted)
+    yield();                            // let the waiter have it
+  return 0;
+}
+
+#endif // CONF_MUTEX
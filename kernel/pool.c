@@ -0,0 +1,103 @@
+/*! \file   pool.c
+    \brief  Implementation: fixed-size object pools
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+#include <sys/pool.h>
+
+#ifdef CONF_MM_POOL
+
+#include <stdlib.h>
+#include <sys/critsec.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! initialize a pool at run time
+/*! \param pool  the pool
+    \param arena word aligned storage for count objects
+    \param size  object size in bytes
+    \param count number of objects
+*/
+void pool_init(pool_t *pool,void *arena,size_t size,unsigned count) {
+  pool->free  =NULL;
+  pool->size  =POOL_OBJECT_SIZE(size);
+  pool->arena =arena;
+  pool->unused=arena;
+  pool->end   =pool->arena+pool->size*count;
+  pool->used  =0;
+  pool->high  =0;
+  pool->misses=0;
+}
+
+//! allocate an object
+/*! \return pointer to object, NULL if the pool and the heap are exhausted.
+
+    constant time unless the pool is empty, then falls back to malloc().
+*/
+void *pool_alloc(pool_t *pool) {
+  void *ptr;
+
+#ifdef CONF_TM
+  ENTER_KERNEL_CRITICAL_SECTION();
+#endif
+  if((ptr=pool->free)!=NULL)
+    pool->free=*((void**) ptr);
+  else if(pool->unused<pool->end) {
+    ptr=pool->unused;
+    pool->unused+=pool->size;
+  }
+  if(ptr!=NULL && ++pool->used>pool->high)
+    pool->high=pool->used;
+#ifdef CONF_TM
+  LEAVE_KERNEL_CRITICAL_SECTION();
+#endif
+
+#ifdef CONF_MM
+  if(ptr==NULL) {
+    pool->misses++;
+    ptr=malloc(pool->size);
+  }
+#endif
+  return ptr;
+}
+
+//! return an object
+/*! \param ptr an object from pool_alloc(pool), may be NULL.
+
+    objects from outside the arena are passed on to free().
+    may be called by the scheduler.
+*/
+void pool_free(pool_t *pool,void *ptr) {
+  if((char*) ptr>=pool->arena && (char*) ptr<pool->end) {
+#ifdef CONF_TM
+    ENTER_KERNEL_CRITICAL_SECTION();
+#endif
+    *((void**) ptr)=pool->free;
+    pool->free=ptr;
+    pool->used--;
+#ifdef CONF_TM
+    LEAVE_KERNEL_CRITICAL_SECTION();
+#endif
+  }
+#ifdef CONF_MM
+  else
+    free(ptr);
+#endif
+}
+
+#endif // CONF_MM_POOL
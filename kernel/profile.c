@@ -0,0 +1,229 @@
+/*! \file   profile.c
+    \brief  Implementation: PC sampling profiler
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The task switch handler passes the PC it interrupted to
+ *  profile_sample() on every tick while sampling is on. The PC is
+ *  counted in a bin of 2^shift bytes of the text range it falls in:
+ *  the kernel's .text and .text.hi and the text of each program that
+ *  was loaded when sampling started. Ranges and the histogram are
+ *  set up by PROFstart, which the host sends to the program port,
+ *  and the host maps bins back to symbols.
+ */
+
+#include <sys/profile.h>
+
+#ifdef CONF_PROFILE
+
+#include <stdlib.h>
+#include <lnp/lnp.h>
+#include <sys/irq.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Global Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+volatile unsigned char profile_active;  //!< sampling enabled
+volatile unsigned long profile_samples; //!< samples taken
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Internal Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+extern char __text, __text_end;         //!< kernel .text (linker script)
+extern char __text_hi, __etext_hi;      //!< kernel .text.hi
+
+static profile_range_t profile_ranges[PROFILE_RANGES];  //!< covered text
+static unsigned char profile_nranges;   //!< ranges in use
+static unsigned char profile_shift;     //!< log2 of bytes per bin
+
+static unsigned *profile_bins;          //!< the histogram
+static unsigned profile_nbins;          //!< bins in the histogram
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! count a sample
+/*! \param pc the interrupted program counter
+
+    counts saturate instead of wrapping around.
+*/
+#if defined(CONF_RCX_COMPILER)
+void profile_sample(unsigned pc) {
+#else
+HANDLER_WRAPPER("profile_sample","profile_sample_core");
+void profile_sample_core(unsigned pc) {
+#endif
+  const profile_range_t *range;
+  unsigned bin=0;
+
+  for(range=profile_ranges; range<profile_ranges+profile_nranges; range++)
+    if(pc-range->base < range->size) {
+      bin=range->bin+((pc-range->base)>>profile_shift);
+      break;
+    }
+
+  if(profile_bins[bin]!=0xffff)
+    profile_bins[bin]++;
+  profile_samples++;
+}
+
+//! add a text range behind the last one
+static void profile_range(unsigned char id,const void *text,size_t size) {
+  profile_range_t *range=profile_ranges+profile_nranges;
+
+  if(!size)
+    return;
+  range->id  =id;
+  range->base=(unsigned) text;
+  range->size=size;
+  range->bin =profile_nbins;
+  profile_nbins+=(size+(1<<profile_shift)-1)>>profile_shift;
+  profile_nranges++;
+}
+
+//! stop sampling and free the histogram
+void profile_shutdown(void) {
+  profile_active=0;
+  free(profile_bins);
+  profile_bins=NULL;
+  profile_nbins=0;
+  profile_nranges=0;
+}
+
+//! set up the ranges and an empty histogram, then start sampling
+/*! without memory for the histogram, no ranges are left.
+*/
+static void profile_start(unsigned char shift) {
+  unsigned nr;
+  size_t size;
+  void *text;
+
+  profile_shutdown();
+
+  profile_shift=shift;
+  profile_nbins=1;                      // bin 0: outside of all ranges
+  profile_range(PROFILE_KERNEL,&__text,&__text_end-&__text);
+  profile_range(PROFILE_KERNEL_HI,&__text_hi,&__etext_hi-&__text_hi);
+  for(nr=0; nr<PROG_MAX; nr++)
+    if((text=program_text(nr,&size))!=NULL)
+      profile_range(PROFILE_PROGRAM+nr,text,size);
+
+  if((profile_bins=calloc(profile_nbins,sizeof(unsigned)))==NULL) {
+    profile_nbins=0;
+    profile_nranges=0;
+    return;
+  }
+  profile_samples=0;
+  profile_active=1;
+}
+
+//! store a big endian word
+static unsigned char *profile_put(unsigned char *p,unsigned w) {
+  *(p++)=w>>8;
+  *(p++)=w;
+  return p;
+}
+
+//! reply with the number of samples and the ranges
+static void profile_info(unsigned char *msg,unsigned char src) {
+  unsigned char *p,i;
+
+  p=profile_put(msg+2,profile_samples>>16);
+  p=profile_put(p,profile_samples);
+  *(p++)=profile_shift;
+  *(p++)=profile_nranges;
+  p=profile_put(p,profile_nbins);
+  for(i=0; i<profile_nranges; i++) {
+    *(p++)=profile_ranges[i].id;
+    p=profile_put(p,profile_ranges[i].base);
+    p=profile_put(p,profile_ranges[i].size);
+    p=profile_put(p,profile_ranges[i].bin);
+  }
+  lnp_addressing_write(msg,p-msg,src,0);
+}
+
+//! stream the histogram from bin first on
+/*! stops at the first lost packet. the host asks again from there.
+*/
+static void profile_read(unsigned char *msg,unsigned first,
+                         unsigned char src) {
+  unsigned char *p;
+  unsigned bin;
+
+  while(first<profile_nbins) {
+    p=profile_put(msg+2,first);
+    for(bin=first; bin<profile_nbins && bin<first+PROFILE_CHUNK; bin++)
+      p=profile_put(p,profile_bins[bin]);
+
+    msg[1]=PROFdata;
+    if(lnp_addressing_write(msg,p-msg,src,0))
+      return;
+    first=bin;
+  }
+
+  msg[1]=PROFend;
+  p=profile_put(msg+2,profile_nbins);
+  p=profile_put(p,profile_samples>>16);
+  p=profile_put(p,profile_samples);
+  lnp_addressing_write(msg,p-msg,src,0);
+}
+
+//! handle a CMDprofile packet from the program port
+/*! \param data packet data after the CMDprofile byte
+    \param length length of data
+    \param src address to reply to
+*/
+void profile_command(const unsigned char *data,unsigned char length,
+                     unsigned char src) {
+  unsigned char *msg;
+
+  if((msg=malloc(4+2*PROFILE_CHUNK))==NULL)
+    return;
+  msg[0]=CMDprofile;
+  msg[1]=data[0];
+
+  switch(data[0]) {
+    case PROFstart:
+      if(length<2)
+        break;
+      profile_start(data[1] & 0x0f);
+      profile_info(msg,src);
+      break;
+
+    case PROFstop:
+      profile_active=0;
+      profile_info(msg,src);
+      break;
+
+    case PROFread:
+      if(length<3)
+        break;
+      profile_read(msg,(data[1]<<8) | data[2],src);
+      break;
+  }
+
+  free(msg);
+}
+
+#endif // CONF_PROFILE
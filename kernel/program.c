@@ -57,8 +57,17 @@
 #include <sys/battery.h>
 #include <dsound.h>
 #include <remote.h>
+#ifdef CONF_PROGRAM_LZSS
+#include <lzss.h>
+#endif
 
 #include <conio.h>
+#ifdef CONF_PROFILE
+#include <sys/profile.h>
+#endif
+#ifdef CONF_TRACE
+#include <sys/trace.h>
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -82,7 +91,15 @@ const unsigned char min_length[]={
    4, // CMDdata
    2, // CMDrun
    2, // CMDirmode
-   2  // CMDsethost
+   2, // CMDsethost
+   2, // CMDprofile
+   2, // CMDtrace
+   4, // CMDwindow
+   4, // CMDsums
+   5, // CMDpatch
+   9, // CMDcommit
+  21, // CMDmulticast
+   2  // CMDmissing
 };
 
 static program_t programs[PROG_MAX];      //!< the programs
@@ -91,7 +108,9 @@ static unsigned char* buffer_ptr;         //!< packet receive buffer
 volatile unsigned char packet_len;        //!< packet length
 volatile unsigned char packet_src;        //!< packet sender
 
+#ifndef CONF_LNP_PORTQ
 static sem_t packet_sem;                  //!< synchronization semaphore
+#endif
 
 #if 0
 #define debugs(a) { cputs(a); msleep(500); }
@@ -101,6 +120,16 @@ static sem_t packet_sem;                  //!< synchronization semaphore
 #define debugw(a)
 #endif
 
+#ifdef CONF_HOST
+//! 16 bit word of a packet, in the RCX's big endian byte order
+#define PROG_WORD(p)		((size_t)(((p)[0]<<8) | (p)[1]))
+#define PROG_PUT_WORD(p,w)	((p)[0]=((size_t)(w))>>8, (p)[1]=(size_t)(w))
+#else
+//! 16 bit word of a packet, in the RCX's big endian byte order
+#define PROG_WORD(p)		(*(size_t*)(p))
+#define PROG_PUT_WORD(p,w)	((p)[0]=((size_t)(w))>>8, (p)[1]=(size_t)(w))
+#endif
+
 // Forward ref
 int lrkey_handler(unsigned int etype, unsigned int key);
 
@@ -120,6 +149,19 @@ int program_valid(unsigned nr) {
          (prog->text_size+prog->data_size==prog->downloaded);
 }
 
+#ifdef CONF_PROFILE
+//! text segment of a program
+/*! \param size set to the text size
+    \return NULL if the program is invalid
+*/
+void *program_text(unsigned nr,size_t *size) {
+  if(!program_valid(nr))
+    return NULL;
+  *size=programs[nr].text_size;
+  return programs[nr].text;
+}
+#endif
+
 //! run the given program
 static void program_run(unsigned nr) {
   if(program_valid(nr)) {
@@ -130,12 +172,188 @@ static void program_run(unsigned nr) {
     memcpy(prog->data,prog->data_orig,prog->data_size);
     memset(prog->bss,0,prog->bss_size);
 
+#ifdef CONF_HOST
+    // downloaded H8/300 code can't run on the PC.
+    // start the host's user entry in its place.
+    if(tm_host_user_entry)
+      execi(tm_host_user_entry,0,0,prog->prio,prog->stack_size);
+#else
     execi((void*) (((char*)prog->text)
             + prog->start  ),
     0,0,prog->prio,prog->stack_size);
+#endif
+  }
+}
+
+//! account for bytes downloaded to the end of a program
+/*! the data segment is saved once the program is complete.
+*/
+static void program_advance(unsigned nr,program_t *prog,size_t length) {
+  prog->downloaded+=length;
+
+  if(program_valid(nr)) {
+    // copy original data segment and we're done.
+    //
+    memcpy(prog->data_orig,prog->data,prog->data_size);
+    cls();
+  } else
+    cputw(prog->downloaded);
+}
+
+//! append a downloaded chunk to a program
+static void program_append(unsigned nr,program_t *prog,
+                           const unsigned char *data,size_t length) {
+  memcpy(prog->text+prog->downloaded,data,length);
+  program_advance(nr,prog,length);
+}
+
+//! where a byte of the program image is kept
+/*! the image is the text followed by the original data segment.
+    \param length set to the image bytes kept contiguous from there
+*/
+static unsigned char *program_image(program_t *prog,size_t offset,
+                                    size_t *length) {
+  if(offset<prog->text_size) {
+    *length=prog->text_size-offset;
+    return prog->text+offset;
+  }
+  offset-=prog->text_size;
+  *length=prog->data_size-offset;
+  return prog->data_orig+offset;
+}
+
+//! CRC-16 (CCITT) of a part of the program image
+static unsigned program_crc(program_t *prog,size_t offset,size_t length) {
+  unsigned crc=0xffff, bit;
+  unsigned char *ptr;
+  size_t n;
+
+  while(length) {
+    ptr=program_image(prog,offset,&n);
+    if(n>length)
+      n=length;
+    offset+=n;
+    length-=n;
+
+    while(n--) {
+      crc^=*ptr++<<8;
+      for(bit=0; bit<8; bit++)
+        crc=(crc & 0x8000) ? (crc<<1)^0x1021 : crc<<1;
+      crc&=0xffff;
+    }
+  }
+  return crc;
+}
+
+//! answer CMDsums with the checksums of the blocks from first on
+static void program_sums(unsigned nr,program_t *prog,unsigned first,
+                         unsigned char dest) {
+  size_t size=prog->text_size+prog->data_size, offset=first*PROG_BLOCK;
+  unsigned char *msg;
+  unsigned n;
+
+  if((msg=malloc(12+2*PROG_SUMS))==NULL)
+    return;
+
+  msg[0]=CMDsums;
+  msg[1]=nr;
+  PROG_PUT_WORD(msg+ 2,prog->text);
+  PROG_PUT_WORD(msg+ 4,prog->text_size);
+  PROG_PUT_WORD(msg+ 6,prog->data_size);
+  PROG_PUT_WORD(msg+ 8,prog->bss_size);
+  PROG_PUT_WORD(msg+10,first);
+  for(n=0; n<PROG_SUMS && offset<size; n++, offset+=PROG_BLOCK)
+    PROG_PUT_WORD(msg+12+2*n,
+                  program_crc(prog,offset,size-offset<PROG_BLOCK ?
+                                          size-offset : PROG_BLOCK));
+  lnp_addressing_write(msg,12+2*n,dest,0);
+  free(msg);
+}
+
+#ifdef CONF_PROGRAM_MULTICAST
+//! CMDmulticast chunks of a program image of the given size
+#define PROG_CHUNKS(size)	(((size)+PROG_CHUNK-1)/PROG_CHUNK)
+
+//! store a chunk multicast to a group of bricks
+/*! the chunk is relocated to base, each brick moves the words in the
+    bitmap relocs to its own text. the chunks come in any order, and
+    again when the host repairs what some brick missed. the program is
+    downloaded once the last one is in. a download with CMDdata or
+    CMDwindow under way goes on alone.
+*/
+static void program_chunk(unsigned nr,program_t *prog,size_t base,
+                          size_t offset,const unsigned char *relocs,
+                          const unsigned char *data,size_t length) {
+  size_t size=prog->text_size+prog->data_size;
+  size_t delta=(size_t)prog->text-base;
+  unsigned chunk=offset/PROG_CHUNK, bytes=(PROG_CHUNKS(size)+7)/8, i;
+  unsigned char *ptr;
+
+  if(prog->downloaded || offset%PROG_CHUNK || offset>=size ||
+     length!=(size-offset<PROG_CHUNK ? size-offset : PROG_CHUNK))
+    return;
+  if(!prog->missing) {
+    if((prog->missing=malloc(bytes))==NULL)
+      return;
+    memset(prog->missing,0xff,bytes);
+    prog->missing[bytes-1]=0xff >> (8*bytes-PROG_CHUNKS(size));
   }
+  if(!(prog->missing[chunk/8] & (1<<(chunk%8))))
+    return;
+  prog->missing[chunk/8]&=~(1<<(chunk%8));
+  memcpy(prog->text+offset,data,length);
+  for(i=0; i<length/2; i++)
+    if(relocs[i/8] & (1<<(i%8))) {
+      ptr=prog->text+offset+2*i;
+      PROG_PUT_WORD(ptr,PROG_WORD(ptr)+delta);
+    }
+
+  for(i=0; i<bytes; i++)
+    if(prog->missing[i])
+      return;
+  free(prog->missing);
+  prog->missing=NULL;
+  program_advance(nr,prog,size);
+}
+
+//! answer CMDmissing with the bitmap of the chunks still to come
+/*! a program downloaded some other way misses none.
+*/
+static void program_missing(unsigned nr,program_t *prog,unsigned char dest) {
+  unsigned chunks=PROG_CHUNKS(prog->text_size+prog->data_size);
+  unsigned bytes=(chunks+7)/8;
+  unsigned char *msg;
+
+  if((msg=malloc(4+bytes))==NULL)
+    return;
+
+  msg[0]=CMDmissing;
+  msg[1]=nr;
+  PROG_PUT_WORD(msg+2,chunks);
+  if(prog->missing)
+    memcpy(msg+4,prog->missing,bytes);
+  else
+    memset(msg+4,program_valid(nr) ? 0 : 0xff,bytes);
+  lnp_addressing_write(msg,4+bytes,dest,0);
+  free(msg);
 }
+#endif
+
+#ifdef CONF_LNP_PORTQ
+//! wait for the next packet from the receive ring of port 0
+/*! \return 0 if buffer_ptr holds a packet of packet_len bytes
+*/
+static int packet_wait(void) {
+  unsigned char src;
+  int length;
 
+  if((length=lnp_port_recv(0,buffer_ptr,&src))<=0)
+    return -1;
+  packet_len=length;
+  packet_src=src;
+  return 0;
+}
+#else
 //! packet handler, called from interrupt
 /*! allocates buffer, copies data and wakes parser task.
 */
@@ -157,6 +375,19 @@ static void packet_producer(const unsigned char *data,
   sem_post(&packet_sem);
 }
 
+//! wait for the next packet from packet_producer()
+/*! \return 0 if buffer_ptr holds a packet of packet_len bytes
+*/
+static int packet_wait(void) {
+  packet_len=0;
+  free(buffer_ptr);
+  buffer_ptr = 0;
+  if (sem_wait(&packet_sem) == -1 || buffer_ptr == 0)
+    return -1;
+  return 0;
+}
+#endif
+
 //! packet command parser task
 static int packet_consumer(int argc, char *argv[]) {
   packet_cmd_t cmd;
@@ -165,16 +396,17 @@ static int packet_consumer(int argc, char *argv[]) {
   const static unsigned char acknowledge=CMDacknowledge;
   char msg[8];
 
+#ifdef CONF_LNP_PORTQ
+  // packets are copied from the ring, so one buffer will do.
+  //
+  if ((buffer_ptr = malloc(LNP_PORT_MTU)) == 0)
+    return -1;
+#endif
+
   while (!shutdown_requested()) {
     // wait for new packet
     //
-    packet_len=0;
-    free(buffer_ptr);
-    buffer_ptr = 0;
-    if (sem_wait(&packet_sem) != -1) {
-      if (buffer_ptr == 0)
-        continue;
-
+    if (packet_wait() == 0) {
       debugw(*(size_t*)buffer_ptr);
 
       // handle trivial errors
@@ -206,11 +438,24 @@ static int packet_consumer(int argc, char *argv[]) {
         lnp_set_hostaddr(buffer_ptr[1]);
         continue;
       }
+
+#ifdef CONF_PROFILE
+      if (cmd == CMDprofile) {
+        profile_command(buffer_ptr+1,packet_len-1,packet_src);
+        continue;
+      }
+#endif
+#ifdef CONF_TRACE
+      if (cmd == CMDtrace) {
+        trace_command(buffer_ptr+1,packet_len-1,packet_src);
+        continue;
+      }
+#endif
   
       // Get program number, validate value
-      if((cmd > CMDacknowledge) && (cmd <= CMDrun)) {
+      if(((cmd > CMDacknowledge) && (cmd <= CMDrun)) || cmd >= CMDsums) {
         nr = buffer_ptr[1];
-        if(nr > PROG_MAX)
+        if(nr >= PROG_MAX)
           continue;
 #ifndef CONF_VIS
         cputc_hex_0(nr+1);
@@ -227,6 +472,9 @@ static int packet_consumer(int argc, char *argv[]) {
         if(nb_tasks <= nb_system_tasks) {
           if(prog->text)
             free(prog->text);
+#ifdef CONF_PROGRAM_MULTICAST
+          free(prog->missing);
+#endif
           memset(prog,0,sizeof(program_t));
 
 #ifndef CONF_VIS
@@ -242,7 +490,16 @@ static int packet_consumer(int argc, char *argv[]) {
       case CMDcreate:
         debugs("crea");
         if(!prog->text) {
+#ifdef CONF_HOST
+          prog->text_size =PROG_WORD(buffer_ptr+2);
+          prog->data_size =PROG_WORD(buffer_ptr+4);
+          prog->bss_size  =PROG_WORD(buffer_ptr+6);
+          prog->stack_size=PROG_WORD(buffer_ptr+8);
+          prog->start     =PROG_WORD(buffer_ptr+10);
+          prog->prio      =buffer_ptr[12];
+#else
           memcpy(&(prog->text_size),buffer_ptr+2,11);
+#endif
 
           if((prog->text=malloc(prog->text_size+
                 2*prog->data_size+
@@ -259,7 +516,13 @@ static int packet_consumer(int argc, char *argv[]) {
 
             msg[0]=CMDacknowledge;
             msg[1]=nr;
+#ifdef CONF_HOST
+            PROG_PUT_WORD(msg+2,prog->text);
+            PROG_PUT_WORD(msg+4,prog->data);
+            PROG_PUT_WORD(msg+6,prog->bss);
+#else
             memcpy(msg+2,prog,6);
+#endif
             lnp_addressing_write(msg,8,packet_src,0);
           } else
             memset(prog,0,sizeof(program_t));
@@ -269,19 +532,10 @@ static int packet_consumer(int argc, char *argv[]) {
       case CMDdata:
         debugs("data");
         if(prog->text && !program_valid(nr)) {
-          size_t offset=*(size_t*)(buffer_ptr+2);
+          size_t offset=PROG_WORD(buffer_ptr+2);
           if(offset<=prog->downloaded) {
             if(offset==prog->downloaded) {
-              memcpy(prog->text+offset,buffer_ptr+4,packet_len-4);
-              prog->downloaded+=packet_len-4;
-
-              if(program_valid(nr)) {
-                // copy original data segment and we're done.
-                //
-                memcpy(prog->data_orig,prog->data,prog->data_size);
-                cls();
-              } else
-                cputw(prog->downloaded);
+              program_append(nr,prog,buffer_ptr+4,packet_len-4);
               debugs("OK");
             } else
               debugs("OLD");
@@ -291,6 +545,117 @@ static int packet_consumer(int argc, char *argv[]) {
         }
         break;
 
+      case CMDwindow:
+        debugs("wind");
+#ifdef CONF_PROGRAM_LZSS
+        nr = buffer_ptr[1] & ~(PROG_ACK | PROG_LZSS);
+#else
+        nr = buffer_ptr[1] & ~PROG_ACK;
+#endif
+        if(nr >= PROG_MAX)
+          break;
+        prog = programs+nr;
+        if(prog->text) {
+          size_t offset=PROG_WORD(buffer_ptr+2);
+          size_t room=prog->text_size+prog->data_size-offset;
+
+          // the host keeps several chunks in flight. duplicates and
+          // chunks behind a lost one are dropped, the host goes back
+          // to the offset acknowledged.
+          //
+          if(offset==prog->downloaded && !program_valid(nr)) {
+#ifdef CONF_PROGRAM_LZSS
+            if(buffer_ptr[1] & PROG_LZSS) {
+              int length=lzss_decode(prog->text+offset,offset,room,
+                                     buffer_ptr+4,packet_len-4);
+              if(length>0)
+                program_advance(nr,prog,length);
+            } else
+#endif
+            if(packet_len-4 <= room)
+              program_append(nr,prog,buffer_ptr+4,packet_len-4);
+          }
+
+          if(buffer_ptr[1] & PROG_ACK) {
+            msg[0]=CMDacknowledge;
+            msg[1]=nr;
+            PROG_PUT_WORD(msg+2,prog->downloaded);
+            lnp_addressing_write(msg,4,packet_src,0);
+          }
+        }
+        break;
+
+      case CMDsums:
+        // an empty slot answers with sizes of 0
+        //
+        debugs("sums");
+        program_sums(nr,prog,PROG_WORD(buffer_ptr+2),packet_src);
+        break;
+
+#ifdef CONF_PROGRAM_MULTICAST
+      case CMDmulticast:
+        // sent to LNP_BROADCAST, all bricks of the group take it
+        //
+        debugs("mcst");
+        if(prog->text && !program_valid(nr))
+          program_chunk(nr,prog,PROG_WORD(buffer_ptr+2),
+                        PROG_WORD(buffer_ptr+4),buffer_ptr+6,
+                        buffer_ptr+6+PROG_RELOCS,
+                        packet_len-6-PROG_RELOCS);
+        break;
+
+      case CMDmissing:
+        debugs("miss");
+        program_missing(nr,prog,packet_src);
+        break;
+#endif
+
+      case CMDpatch:
+        // the program is invalid from its first patch on until the
+        // image checksum in CMDcommit is right.
+        //
+        debugs("ptch");
+        if(prog->text && nb_tasks <= nb_system_tasks) {
+          size_t offset=PROG_WORD(buffer_ptr+2), length=packet_len-4, n;
+          size_t size=prog->text_size+prog->data_size;
+          const unsigned char *data=buffer_ptr+4;
+          unsigned char *ptr;
+
+          if(offset>size || length>size-offset)     // offset+length wraps
+            break;
+          prog->downloaded=0;
+          while(length) {
+            ptr=program_image(prog,offset,&n);
+            if(n>length)
+              n=length;
+            memcpy(ptr,data,n);
+            data+=n;
+            offset+=n;
+            length-=n;
+          }
+          debugs("OK");
+          lnp_addressing_write(&acknowledge,1,packet_src,0);
+        }
+        break;
+
+      case CMDcommit:
+        debugs("comt");
+        if(prog->text && nb_tasks <= nb_system_tasks) {
+          size_t size=prog->text_size+prog->data_size;
+
+          if(program_crc(prog,0,size)!=PROG_WORD(buffer_ptr+6))
+            break;
+          prog->stack_size=PROG_WORD(buffer_ptr+2);
+          prog->start     =PROG_WORD(buffer_ptr+4);
+          prog->prio      =buffer_ptr[8];
+          prog->downloaded=size;
+          cls();
+
+          debugs("OK");
+          lnp_addressing_write(&acknowledge,1,packet_src,0);
+        }
+        break;
+
       case CMDrun:
         debugs("run");
         if(program_valid(nr)) {
@@ -351,6 +716,9 @@ void program_stop(int flag) {
 #endif
 #ifdef CONF_DSENSOR
   ds_init();
+#endif
+#ifdef CONF_LNP_ASYNC
+  lnp_tx_flush();                       // frames may live in program memory
 #endif
   lnp_init();
 #ifdef CONF_LR_HANDLER
@@ -473,6 +841,18 @@ gotkey:
         cputw(mm_free_mem());
         if ((c = getchar()) != KEY_VIEW) goto gotkey;
 
+#if defined(CONF_MM_POOL)
+        // pool high-water marks: task data, priority chains
+        cputs("task");
+        if ((c = getchar()) != KEY_VIEW) goto gotkey;
+        lcd_int(tm_tdata_pool.high);
+        if ((c = getchar()) != KEY_VIEW) goto gotkey;
+        cputs("prio");
+        if ((c = getchar()) != KEY_VIEW) goto gotkey;
+        lcd_int(tm_pchain_pool.high);
+        if ((c = getchar()) != KEY_VIEW) goto gotkey;
+#endif // CONF_MM_POOL
+
 #if defined(CONF_DSENSOR)
         cputs("batt");
         if ((c = getchar()) != KEY_VIEW) goto gotkey;
@@ -485,7 +865,7 @@ gotkey:
     }
 
     if(clear) {
-      wait_event(dkey_released,KEY_ANY);
+      wait_event_on((void*) &dkey,dkey_released,KEY_ANY);
       cls();
     }
   }
@@ -637,7 +1017,11 @@ int lrkey_handler(unsigned int etype, unsigned int key) {
 */
 void program_init() {
   packet_len=0;
+#ifdef CONF_LNP_PORTQ
+  lnp_port_open(0,CONF_LNP_PORTQ,LNP_PORT_MTU);
+#else
   sem_init(&packet_sem,0,0);
+#endif
   execi(&packet_consumer,0,0,PRIO_HIGHEST,DEFAULT_STACK_SIZE);
   execi(&key_handler,0,0,PRIO_HIGHEST,DEFAULT_STACK_SIZE);
 
@@ -647,16 +1031,25 @@ void program_init() {
   lr_set_handler(lrkey_handler);
 #endif
 
+#ifndef CONF_LNP_PORTQ
   lnp_addressing_set_handler(0,&packet_producer);
   buffer_ptr = 0;
+#endif
 }
 
 //! shutdown program support
 /*! run in single tasking mode
 */
 void program_shutdown() {
+#ifdef CONF_LNP_PORTQ
+  lnp_port_close(0);
+#else
   lnp_addressing_set_handler(0,LNP_DUMMY_ADDRESSING);
   sem_destroy(&packet_sem);
+#endif
+#ifdef CONF_PROFILE
+  profile_shutdown();
+#endif
 
 #ifdef CONF_LR_HANDLER
   lr_shutdown();
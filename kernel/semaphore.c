@@ -28,6 +28,10 @@
 #ifdef CONF_SEMAPHORES
 
 #include <unistd.h>
+#include <sys/irq.h>
+#ifdef CONF_TRACE
+#include <sys/trace.h>
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -39,7 +43,7 @@
 /*! \param data pointer to the semaphore passed as a wakeup_t
 */
 wakeup_t sem_event_wait(wakeup_t data) {
-	sem_t *sem=(sem_t*) ((unsigned)data);
+	sem_t *sem=(sem_t*) ((size_t)data);
 	
 	// we're called by the scheduler, therefore in an IRQ handler,
 	// so no worrying about IRQs.
@@ -63,8 +67,12 @@ wakeup_t sem_event_wait(wakeup_t data) {
 int sem_wait(sem_t * sem) {
 	// check if semaphore is available, if not, go to sleep
 	
+#ifdef CONF_TRACE
+	trace_event(TRACE_SEM_WAIT,*sem,(unsigned) ((size_t)sem));
+#endif
 	if(sem_trywait(sem))
-		if (wait_event(sem_event_wait,(unsigned long) ((unsigned)sem)) == 0)
+		if (wait_event_on((void*) sem,sem_event_wait,
+		                  (unsigned long) ((size_t)sem)) == 0)
 			return -1;
 	
 	return 0;
@@ -76,7 +84,7 @@ typedef struct {
 } timeout_sem_data_t;
 
 static wakeup_t sem_event_timeout_wait(wakeup_t data) {
-	timeout_sem_data_t *tsem = (timeout_sem_data_t*) ((unsigned)data);
+	timeout_sem_data_t *tsem = (timeout_sem_data_t*) ((size_t)data);
 	
 	// we're called by the scheduler, therefore in an IRQ handler,
 	// so no worrying about IRQs.
@@ -99,9 +107,13 @@ int sem_timedwait(sem_t *sem,
 	data.sem = sem;
 	data.abs_timeout = abs_timeout;
 	
+#ifdef CONF_TRACE
+	trace_event(TRACE_SEM_WAIT,*sem,(unsigned) ((size_t)sem));
+#endif
 	if (sem_trywait(sem)) {
-		if (wait_event(sem_event_timeout_wait, 
-			       (wakeup_t) ((unsigned) &data)) != 1) {
+		if (wait_event_until((void*) sem, sem_event_timeout_wait,
+				     (wakeup_t) ((size_t) &data),
+				     abs_timeout) != 1) {
 			return -1; // timeout reached.
 		}
 	}
@@ -119,6 +131,19 @@ int sem_timedwait(sem_t *sem,
    
     this is IRQ handler safe.
 */
+#ifdef CONF_HOST
+int sem_trywait(sem_t * sem) {
+	unsigned char ccr=irq_save();
+	int rc=0xffff;
+
+	if(*sem!=0) {
+		(*sem)--;
+		rc=0;
+	}
+	irq_restore(ccr);
+	return rc;
+}
+#else
 int sem_trywait(sem_t * sem);
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 __asm__("\n\
@@ -143,5 +168,6 @@ __asm__("\n\
 	rts\n\
 	");
 #endif // DOXYGEN_SHOULD_SKIP_THIS
+#endif // CONF_HOST
 	
 #endif // CONF_SEMAPHORES
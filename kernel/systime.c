@@ -50,6 +50,24 @@
 #include <sys/timeout.h>
 #endif
 
+#ifdef CONF_HOST
+#include <sys/tm.h>
+#include <sys/lnp.h>
+#endif
+
+#ifdef CONF_TM_TICKLESS
+#include <sys/tm.h>
+#include <dkey.h>
+#include <dsound.h>
+#include <dmotor.h>
+#include <sys/lnp.h>
+#include <sys/lnp-logical.h>
+#endif
+
+#if defined(CONF_LNP_ASYNC) && !defined(CONF_TM_TICKLESS)
+#include <sys/lnp-logical.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Global Variables
@@ -75,6 +93,15 @@ volatile unsigned char tm_current_slice;        //!< current time remaining
 void* tm_switcher_vector;                       //!< pointer to task switcher
 #endif
 
+#ifdef CONF_TM_TICKLESS
+volatile unsigned long systime_idle_ticks;      //!< suppressed ticks
+
+static unsigned char systime_idling;            //!< flag: tick stopped
+static unsigned systime_idle_cnt;               //!< T_CNT when stopped
+static unsigned systime_idle_ocra;              //!< compare A when stopped
+static unsigned systime_idle_frac;              //!< partial msec when stopped
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -86,6 +113,11 @@ void* tm_switcher_vector;                       //!< pointer to task switcher
 /*! this is the system clock
  */
 extern void clock_handler(void);
+#ifdef CONF_HOST
+void clock_handler(void) {
+  sys_time++;
+}
+#else
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 __asm__("\n\
 .text\n\
@@ -108,6 +140,7 @@ __asm__("\n\
                 rts\n\
        ");
 #endif // DOXYGEN_SHOULD_SKIP_THIS
+#endif // CONF_HOST
 
 //! subsystem handler for every 2nd msec
 /*! this is the pulse of the system (subsystems).
@@ -120,6 +153,99 @@ extern void subsystem_handler(void);
 /*! handles swapping between tasks
  */
 extern void task_switch_handler(void);
+#ifdef CONF_HOST
+#ifdef CONF_DKEY
+extern void dkey_handler(void);
+#endif
+#ifdef CONF_DMOTOR
+extern void dm_handler(void);
+#endif
+#if defined(CONF_BATTERY_INDICATOR) && !defined(CONF_TM)
+extern unsigned int battery_refresh_counter,battery_refresh_period;
+#endif
+#ifdef CONF_VIS
+extern unsigned char vis_refresh_counter,vis_refresh_period;
+extern void vis_handler(void);
+#endif
+#ifdef CONF_LCD_REFRESH
+extern unsigned char lcd_refresh_counter,lcd_refresh_period;
+#endif
+
+void subsystem_handler(void) {
+#ifdef CONF_DSOUND
+  dsound_handler();
+#endif
+#ifdef CONF_LNP
+  if(--lnp_timeout_counter==0) {
+    lnp_integrity_reset();
+    lnp_timeout_counter=lnp_timeout;
+  }
+#ifdef CONF_LNP_ASYNC
+  if(tx_queued)
+    lnp_tx_handler();
+#endif
+#endif
+#ifdef CONF_DKEY
+  dkey_handler();
+#endif
+#if defined(CONF_BATTERY_INDICATOR) && !defined(CONF_TM)
+  if(--battery_refresh_counter==0) {
+    battery_refresh();
+    battery_refresh_counter=battery_refresh_period;
+  }
+#endif
+#ifdef CONF_AUTOSHUTOFF
+  if(--auto_shutoff_counter==0) {
+    autoshutoff_check();
+    auto_shutoff_counter=auto_shutoff_period;
+  }
+#endif
+#ifdef CONF_VIS
+  if(--vis_refresh_counter==0) {
+    vis_handler();
+    vis_refresh_counter=vis_refresh_period;
+  }
+#endif
+#ifdef CONF_LCD_REFRESH
+  if(--lcd_refresh_counter==0) {
+    lcd_refresh_next_byte();
+    lcd_refresh_counter=lcd_refresh_period;
+  }
+#endif
+  T_CSR&=~TCSR_OCB;                             // reset compare B IRQ flag
+
+#ifdef CONF_TM
+  task_switch_handler();
+#else
+#ifdef CONF_DMOTOR
+  dm_handler();
+#endif
+  T_CSR&=~TCSR_OCA;
+#endif
+}
+
+#ifdef CONF_TM
+void task_switch_handler(void) {
+  // drive the motors first: the switcher returns to
+  // the next task, not here. it also resets the timeslice.
+  //
+#ifdef CONF_DMOTOR
+  dm_handler();
+#endif
+#ifdef CONF_TM_WHEEL
+  if(tm_timers)
+    tm_timer_handler();                         // wake expired waiters
+#endif
+  if(--tm_current_slice==0) {                   // timeslice elapsed?
+    if(kernel_critsec_count)
+      tm_current_slice=1;                       // wait another tick
+    else
+      ((void (*)(void)) tm_switcher_vector)();
+  }
+  T_CSR&=~TCSR_OCA;                             // reset compare A IRQ flag
+}
+#endif // CONF_TM
+#else
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 __asm__("\n\
 .text\n\
@@ -153,6 +279,15 @@ _subsystem_handler:\n\
               sys_noreset:\n\
                 mov.w r6,@_lnp_timeout_counter\n\
         "
+#ifdef CONF_LNP_ASYNC
+        "\n\
+                mov.b @_tx_queued,r6l           ; frames to transmit?\n\
+                beq sys_notxq\n\
+                  jsr _lnp_tx_handler\n\
+\n\
+              sys_notxq:\n\
+        "
+#endif // CONF_LNP_ASYNC
 #endif // CONF_LNP
 
 #ifdef CONF_DKEY
@@ -226,7 +361,30 @@ _subsystem_handler:\n\
                 pop r0                          ; if fallthrough, pop r0\n\
               _task_switch_handler:\n\
                 push r0                         ; save r0\n\
+        "
+#ifdef CONF_PROFILE
+        "\n\
+                mov.b @_profile_active,r6l      ; sampling?\n\
+                beq sys_noprofile\n\
 \n\
+                  ; stack: r0, ROM dispatcher return, r6, ccr, pc\n\
+                  mov.w @(8,r7),r0              ; interrupted pc\n\
+                  jsr _profile_sample\n\
+\n\
+              sys_noprofile:\n\
+        "
+#endif // CONF_PROFILE
+#ifdef CONF_TM_WHEEL
+        "\n\
+                mov.w @_tm_timers,r6            ; any timers armed?\n\
+                beq sys_notimers\n\
+\n\
+                  jsr _tm_timer_handler         ; wake expired waiters\n\
+\n\
+              sys_notimers:\n\
+        "
+#endif // CONF_TM_WHEEL
+        "\n\
                 mov.b @_tm_current_slice,r6l\n\
                 dec r6l\n\
                 bne sys_noswitch                ; timeslice elapsed?\n\
@@ -261,6 +419,7 @@ _subsystem_handler:\n\
         "
 );
 #endif // DOXYGEN_SHOULD_SKIP_THIS
+#endif // CONF_HOST
 
 
 //! initialize system timer
@@ -340,6 +499,169 @@ void systime_set_timeslice(unsigned char slice) {
 
 #endif
 
+#ifdef CONF_TM_TICKLESS
+#define SYSTIME_CNT_MSEC	500	//!< 16-bit timer counts per msec
+#define SYSTIME_WDT_PRESET	7	//!< watchdog count set by clock_handler
+
+//! compare A handler during tickless idle
+/*! catches up, then continues as the task switch handler.
+*/
+extern void systime_idle_handler(void);
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+__asm__("\n\
+.text\n\
+.align 1\n\
+_systime_idle_handler:\n\
+                jsr _systime_wake               ; restart the tick\n\
+                jmp @_task_switch_handler\n\
+");
+#endif // DOXYGEN_SHOULD_SKIP_THIS
+
+//! (re)start the clock NMI
+/*! \param count initial watchdog count. the NMI fires on overflow.
+*/
+static void systime_wdt_start(unsigned char count) {
+  WDT_CSR = WDT_CNT_PASSWORD | count;
+  WDT_CSR = WDT_CSR_PASSWORD
+        | WDT_CSR_CLOCK_64
+	| WDT_CSR_WATCHDOG_NMI
+        | WDT_CSR_ENABLE
+        | WDT_CSR_MODE_WATCHDOG;
+}
+
+//! check if any subsystem needs the tick
+/*! \return 0 if something besides the idle task needs to run.
+*/
+static int systime_quiet(void) {
+  if(tm_ready_map!=1UL)                         // only the idle task?
+    return 0;
+#ifdef CONF_DKEY
+  if(dkey_timer!=0 || dkey_multi!=0)            // debouncing / key held
+    return 0;
+#endif
+#ifdef CONF_DSOUND
+  if(dsound_next_note)                          // playing
+    return 0;
+#endif
+#ifdef CONF_DMOTOR
+  if((dm_a.access.c.delta!=MIN_SPEED && dm_a.access.c.delta!=MAX_SPEED) ||
+     (dm_b.access.c.delta!=MIN_SPEED && dm_b.access.c.delta!=MAX_SPEED) ||
+     (dm_c.access.c.delta!=MIN_SPEED && dm_c.access.c.delta!=MAX_SPEED))
+    return 0;                                   // pulse width modulating
+#endif
+#ifdef CONF_LNP
+  if(tx_state>=TX_ACTIVE || lnp_integrity_active())
+    return 0;
+#ifdef CONF_LNP_ASYNC
+  if(tx_queued)
+    return 0;                                   // waiting for the medium
+#endif
+#endif
+  return 1;
+}
+
+//! stop the system tick until the next deadline, if nothing needs it
+/*! the clock NMI is stopped and compare A is moved to the next
+    deadline; compare B is masked. systime_wake() restarts both.
+    IRQs must be disabled.
+*/
+void systime_idle(void) {
+  unsigned char tick;
+  time_t span;
+
+  if(systime_idling || !systime_quiet())
+    return;
+
+  span=tm_timer_due(get_system_up_time());
+  if(span<SYSTIME_IDLE_MIN)
+    return;
+  if(span>SYSTIME_IDLE_MAX)
+    span=SYSTIME_IDLE_MAX;
+
+  // remember how far into the msec the clock is, then stop it.
+  // a watchdog count is two timer counts. stopping clears the
+  // count, so it is read before; if the NMI comes in between, the
+  // msec has just begun and is already in sys_time.
+  //
+  tick=(unsigned char) sys_time;
+  systime_idle_frac=(WDT_CNT-SYSTIME_WDT_PRESET)*2;
+  WDT_CSR = WDT_CSR_PASSWORD
+        | WDT_CSR_CLOCK_64
+	| WDT_CSR_WATCHDOG_NMI
+        | WDT_CSR_MODE_WATCHDOG;
+  if(tick!=(unsigned char) sys_time) {
+    systime_idle_frac=0;
+    span--;
+  }
+
+  systime_idle_cnt =T_CNT;
+  systime_idle_ocra=systime_idle_cnt+(unsigned) span*SYSTIME_CNT_MSEC;
+
+  T_IER &= ~TIER_ENABLE_OCB;
+  T_OCR &= ~TOCR_OCRB;
+  T_OCRA = systime_idle_ocra;
+  T_OCR |= TOCR_OCRB;
+  ocia_vector = &systime_idle_handler;
+
+  systime_idling=1;
+}
+
+//! restart the system tick after tickless idle and catch up sys_time
+/*! called from the compare A handler when the deadline is reached,
+    or by the idle task when another IRQ woke it up early.
+*/
+#if defined(CONF_RCX_COMPILER) || defined(CONF_HOST)
+void systime_wake(void) {
+#else
+HANDLER_WRAPPER("systime_wake","systime_wake_core");
+void systime_wake_core(void) {
+#endif
+  unsigned long counts;
+  unsigned msecs,part;
+
+  if(!systime_idling)
+    return;
+  systime_idling=0;
+
+  // counts since the tick stopped. the counter
+  // restarts from zero on a compare A match.
+  //
+  if(T_CSR & TCSR_OCA)
+    counts=(unsigned long) (systime_idle_ocra-systime_idle_cnt) + T_CNT;
+  else
+    counts=T_CNT-systime_idle_cnt;
+  T_CNT = 0;
+
+  counts+=systime_idle_frac;
+  msecs =counts / SYSTIME_CNT_MSEC;
+  sys_time+=msecs;
+  systime_idle_ticks+=msecs;
+
+  // restart the tick. the clock NMI resumes mid-msec
+  //
+  part=(counts % SYSTIME_CNT_MSEC)/2;
+  if(part>0xff-SYSTIME_WDT_PRESET)
+    part=0xff-SYSTIME_WDT_PRESET;
+  systime_wdt_start(SYSTIME_WDT_PRESET + part);
+
+  T_OCR &= ~TOCR_OCRB;
+  T_OCRA = 1000;
+  T_OCR |= TOCR_OCRB;
+  T_CSR &= ~TCSR_OCB;
+  T_IER |= TIER_ENABLE_OCB;
+  ocia_vector = &task_switch_handler;
+
+#ifdef CONF_AUTOSHUTOFF
+  // the subsystem handler runs every 2nd msec
+  //
+  if(auto_shutoff_counter > msecs/2)
+    auto_shutoff_counter-=msecs/2;
+  else
+    auto_shutoff_counter=1;
+#endif
+}
+#endif // CONF_TM_TICKLESS
+
 //! retrieve the current system time
 /*! \return number of msecs the system has been running
  *  Since sys_time is 32bits, it takes more than one
@@ -348,6 +670,11 @@ void systime_set_timeslice(unsigned char slice) {
  *  unmatched (lower 16bits could overflow and reset to
  *  0, while upper 16bits were already read)
  */
+#ifdef CONF_HOST
+time_t get_system_up_time(void) {
+  return sys_time;                              // 32 bit loads are atomic
+}
+#else
 extern time_t get_system_up_time(void);
 __asm__("\n\
 .text\n\
@@ -364,5 +691,6 @@ _get_system_up_time:\n\
     pop   r2\n\
     rts\n\
 ");
+#endif // CONF_HOST
 
 #endif // CONF_TIME
@@ -27,6 +27,8 @@
 #include <sys/irq.h>
 #include <sys/tm.h>
 #include <sys/timeout.h>
+#include <dkey.h>
+#include <unistd.h>
 
 #ifdef CONF_AUTOSHUTOFF
 volatile unsigned int auto_shutoff_counter = 0;   //<! current count - used by the system timer
@@ -56,8 +58,12 @@ void autoshutoff_check_core(void) {
   if (nb_tasks <= nb_system_tasks) {
 #endif // CONF_TM
     auto_shutoff_elapsed++;
-    if (auto_shutoff_elapsed > auto_shutoff_secs)
+    if (auto_shutoff_elapsed > auto_shutoff_secs) {
       idle_powerdown = 1;
+#if defined(CONF_TM_READYQ) && defined(CONF_DKEY)
+      notify_event((void*) &dkey);	// getchar() reports KEY_ONOFF
+#endif
+    }
 #ifdef CONF_TM
   }
    else
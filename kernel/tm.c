@@ -37,6 +37,9 @@
 #include <sys/time.h>
 #include <sys/irq.h>
 #include <sys/bitops.h>
+#ifdef CONF_TRACE
+#include <sys/trace.h>
+#endif
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -63,6 +66,46 @@ tdata_t *ctid;                                  //!< ptr to current task data
 volatile unsigned int nb_tasks;                 //!< number of tasks
 volatile unsigned int nb_system_tasks;          //!< number of system (kernel) tasks
 
+#ifdef CONF_HOST
+int (*tm_host_user_entry)(int,char**);          //!< user program entry
+#endif
+
+#ifdef CONF_MM_POOL
+static tdata_t  tm_tdata_arena[TM_POOL_TASKS];  //!< task data storage
+static pchain_t tm_pchain_arena[TM_POOL_TASKS]; //!< priority chain storage
+
+//! task data objects
+pool_t tm_tdata_pool=POOL_INITIALIZER(tm_tdata_arena,sizeof(tdata_t),
+                                      TM_POOL_TASKS);
+//! priority chain objects
+pool_t tm_pchain_pool=POOL_INITIALIZER(tm_pchain_arena,sizeof(pchain_t),
+                                       TM_POOL_TASKS);
+
+#define tdata_alloc()     pool_alloc(&tm_tdata_pool)
+#define tdata_free(td)    pool_free(&tm_tdata_pool,td)
+#define pchain_alloc()    pool_alloc(&tm_pchain_pool)
+#define pchain_free(pc)   pool_free(&tm_pchain_pool,pc)
+#else
+#define tdata_alloc()     malloc(sizeof(tdata_t))
+#define tdata_free(td)    free(td)
+#define pchain_alloc()    malloc(sizeof(pchain_t))
+#define pchain_free(pc)   free(pc)
+#endif
+
+#ifdef CONF_TM_READYQ
+pchain_t *tm_prio[PRIO_HIGHEST+1];              //!< priority chains by level
+unsigned long tm_ready_map;                     //!< bit n set: level n ready
+
+static tdata_t *tm_blocked[TM_WAIT_BUCKETS];    //!< parked tasks by event
+#ifdef CONF_TM_WHEEL
+static tdata_t *tm_wheel[TM_WHEEL_SLOTS];       //!< armed timers by deadline
+static time_t tm_wheel_time;                    //!< last tick processed
+volatile unsigned int tm_timers;                //!< number of armed timers
+#else
+static tdata_t *tm_sleepers;                    //!< sleeping tasks by deadline
+#endif
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Functions
@@ -97,10 +140,348 @@ void integrity_check(void) {
 #endif 
     
 
+#ifdef CONF_TM_READYQ
+//
+// ready queues:
+//
+// every priority chain keeps a FIFO of the tasks that may run, linked
+// through rnext. this includes the running task and tasks polling a
+// wakeup function set by wait_event(). tasks in wait_event_on() whose
+// wakeup function said no are parked in tm_blocked[] (or tm_sleepers
+// for msleep) until notify_event() or their deadline puts them back.
+// with CONF_TM_WHEEL, deadlines are kept on the timer wheel instead,
+// which the task switch handler advances every tick.
+//
+// all functions below must be called with IRQs disabled.
+//
+
+#ifdef CONF_TM_INHERIT
+#define tm_queue_of(td)   ((td)->rprio)         //!< may be borrowed
+#else
+#define tm_queue_of(td)   ((td)->priority)
+#endif
+
+//! append a task to the ready queue of its priority
+static void tm_enqueue(tdata_t *td) {
+  pchain_t *priority=tm_queue_of(td);
+
+  td->tflags&=~T_BLOCKED;
+  td->rnext=NULL;
+  if(priority->rtail)
+    priority->rtail->rnext=td;
+  else {
+    priority->rhead=td;
+    tm_ready_map|=1UL<<priority->priority;
+  }
+  priority->rtail=td;
+}
+
+//! take the first task off a ready queue
+static tdata_t *tm_dequeue(pchain_t *priority) {
+  tdata_t *td=priority->rhead;
+
+  if((priority->rhead=td->rnext)==NULL) {
+    priority->rtail=NULL;
+    tm_ready_map&=~(1UL<<priority->priority);
+  }
+  return td;
+}
+
+//! remove a task from the ready queue of its priority
+static void tm_unqueue(tdata_t *td) {
+  pchain_t *priority=tm_queue_of(td);
+  tdata_t *prev=NULL, *cur=priority->rhead;
+
+  while(cur!=NULL && cur!=td) {
+    prev=cur;
+    cur=cur->rnext;
+  }
+  if(cur==NULL)
+    return;
+
+  if(prev)
+    prev->rnext=td->rnext;
+  else
+    priority->rhead=td->rnext;
+  if(priority->rtail==td)
+    priority->rtail=prev;
+  if(priority->rhead==NULL)
+    tm_ready_map&=~(1UL<<priority->priority);
+}
+
+//! the wait queue a parked task belongs on
+static tdata_t **tm_wait_queue(tdata_t *td) {
+#ifndef CONF_TM_WHEEL
+  if(td->wchan==&tm_sleepers)
+    return &tm_sleepers;
+#endif
+  return &tm_blocked[TM_WAIT_HASH(td->wchan)];
+}
+
+//! park a task until its event is notified
+/*! sleepers are kept sorted by deadline.
+*/
+static void tm_park(tdata_t *td) {
+  tdata_t **queue=tm_wait_queue(td);
+
+#ifndef CONF_TM_WHEEL
+  if(queue==&tm_sleepers)
+    while(*queue!=NULL &&
+          (time_t) (*queue)->wakeup_data <= (time_t) td->wakeup_data)
+      queue=&(*queue)->rnext;
+#endif
+
+  td->tflags|=T_BLOCKED;
+  td->rnext=*queue;
+  *queue=td;
+}
+
+//! return a parked task to its ready queue
+static void tm_unpark(tdata_t *td) {
+  tdata_t **queue;
+
+  if((td->tflags & T_BLOCKED)==0)
+    return;
+  for(queue=tm_wait_queue(td); *queue!=td; queue=&(*queue)->rnext)
+    ;
+  *queue=td->rnext;
+  tm_enqueue(td);
+}
+
+#ifdef CONF_TM_WHEEL
+//! put a task's deadline on the timer wheel
+/*! \return 0 if the deadline has already passed.
+*/
+static int tm_timer_arm(tdata_t *td) {
+  tdata_t **slot;
+
+  if(td->tflags & T_TIMED)
+    return 1;
+  if(tm_timers==0)
+    tm_wheel_time=get_system_up_time();
+  if((long) (td->deadline - tm_wheel_time) <= 0)
+    return 0;
+
+  slot=&tm_wheel[TM_WHEEL_SLOT(td->deadline)];
+  td->tnext=*slot;
+  *slot=td;
+  td->tflags|=T_TIMED;
+  tm_timers++;
+  return 1;
+}
+
+//! take a task's deadline off the timer wheel
+static void tm_timer_disarm(tdata_t *td) {
+  tdata_t **slot;
+
+  if((td->tflags & T_TIMED)==0)
+    return;
+  for(slot=&tm_wheel[TM_WHEEL_SLOT(td->deadline)]; *slot!=td;
+      slot=&(*slot)->tnext)
+    ;
+  *slot=td->tnext;
+  td->tflags&=~T_TIMED;
+  tm_timers--;
+}
+
+//! time until the earliest armed timer
+/*! \param now the current system time
+    \return msecs to the earliest deadline, ~0 if no timer is armed.
+*/
+time_t tm_timer_due(time_t now) {
+  time_t due=~0UL,left;
+  tdata_t *td;
+  int k;
+
+  if(tm_timers==0)
+    return due;
+  for(k=0; k<TM_WHEEL_SLOTS; k++)
+    for(td=tm_wheel[k]; td!=NULL; td=td->tnext) {
+      left=td->deadline - now;
+      if((long) left <= 0)
+        return 0;
+      if(left<due)
+        due=left;
+    }
+  return due;
+}
+
+//! the timer handler, called by the task switch handler while timers are armed
+/*! advances the wheel to the current time and readies the tasks
+    whose deadline has come. if one of them may preempt the current
+    task, the current timeslice is ended.
+*/
+#if defined(CONF_RCX_COMPILER) || defined(CONF_HOST)
+void tm_timer_handler(void) {
+#else
+HANDLER_WRAPPER("tm_timer_handler","tm_timer_core");
+void tm_timer_core(void) {
+#endif
+  time_t now=get_system_up_time();
+  tdata_t **slot,*td;
+
+  while(tm_timers!=0 && tm_wheel_time!=now) {
+    tm_wheel_time++;
+    slot=&tm_wheel[TM_WHEEL_SLOT(tm_wheel_time)];
+    while((td=*slot)!=NULL) {
+      if(td->deadline!=tm_wheel_time) {
+        slot=&td->tnext;                        // a later round
+        continue;
+      }
+      *slot=td->tnext;
+      td->tflags&=~T_TIMED;
+      tm_timers--;
+
+      tm_unpark(td);
+      if(tm_queue_of(td)->priority >= tm_queue_of(ctid)->priority)
+        tm_current_slice=1;                     // switch on this tick
+    }
+  }
+}
+#endif // CONF_TM_WHEEL
+
+//! find a task willing to run on a priority level
+/*! \return the task, or NULL if there is none.
+
+    polls waiting tasks; parks those waiting on an event object.
+*/
+static tdata_t *tm_pick(pchain_t *priority) {
+  tdata_t *next,*first=NULL;
+  wakeup_t tmp;
+
+  while((next=priority->rhead)!=NULL && next!=first) {
+    tm_dequeue(priority);
+
+    if (next->tstate==T_SLEEPING)
+      return next;
+
+    if (next->tstate==T_WAITING) {
+      if ((next->tflags & T_SHUTDOWN) != 0) {
+        next->wakeup_data = 0;
+        return next;
+      }
+      ctid = next;
+      tmp = next->wakeup(next->wakeup_data);
+      if (tmp != 0) {
+        next->wakeup_data = tmp;
+#ifdef CONF_TRACE
+        trace_event(TRACE_WAKE,next->priority->priority,
+                    (unsigned) (size_t) next);
+#endif
+        return next;
+      }
+      if (next->wchan != NULL
+#ifdef CONF_TM_WHEEL
+          && ((next->tflags & T_DEADLINE)==0 || tm_timer_arm(next))
+#endif
+         ) {
+        tm_park(next);
+        continue;
+      }
+    }
+
+    tm_enqueue(next);                           // poll again later
+    if(first==NULL)
+      first=next;
+  }
+  return NULL;
+}
+
+//! make tasks waiting on an event object check their wakeup function
+/*! \param wchan the event object
+
+    IRQ handler safe.
+*/
+void notify_event(void *wchan) {
+  tdata_t **queue,*td;
+  unsigned char ccr=irq_save();
+
+  queue=&tm_blocked[TM_WAIT_HASH(wchan)];
+  while((td=*queue)!=NULL) {
+    if(td->wchan==wchan) {
+      *queue=td->rnext;
+      tm_enqueue(td);
+    } else
+      queue=&td->rnext;
+  }
+
+  irq_restore(ccr);
+}
+
+#ifdef CONF_TM_INHERIT
+//
+// priority inheritance:
+//
+// a task holding an inheriting lock is queued on the chain of the
+// highest priority task that waited for it, until it holds no such
+// locks anymore. one level only: a boosted holder waiting for
+// another lock does not pass the boost on.
+//
+
+//! move a task to another chain's ready queue
+static void tm_requeue(tdata_t *td,pchain_t *to) {
+  if(td->tflags & T_BLOCKED)
+    td->rprio=to;                               // enqueued there on unpark
+  else {
+    tm_unqueue(td);
+    td->rprio=to;
+    tm_enqueue(td);
+  }
+}
+
+//! lend the current task's priority to the holder of a lock
+void tm_inherit(tdata_t *holder) {
+  if(holder==NULL || holder==ctid ||
+     holder->rprio->priority >= ctid->rprio->priority)
+    return;
+  tm_requeue(holder,ctid->rprio);
+}
+
+//! the current task released an inheriting lock
+int tm_disinherit(void) {
+  if(--ctid->held!=0 || ctid->rprio==ctid->priority)
+    return 0;
+  tm_requeue(ctid,ctid->priority);
+  return 1;
+}
+
+//! return borrowed priorities of a chain about to be removed
+/*! only a waiter on a killed task's chain can have lent it.
+*/
+static void tm_disinherit_chain(pchain_t *chain) {
+  pchain_t *pchain;
+  tdata_t *td;
+
+  for(pchain=priority_head; pchain!=NULL; pchain=pchain->next) {
+    td=pchain->ctid;
+    do {
+      if(td->rprio==chain)
+        tm_requeue(td,td->priority);
+      td=td->next;
+    } while(td!=pchain->ctid);
+  }
+}
+#endif // CONF_TM_INHERIT
+#endif // CONF_TM_READYQ
+
 //! the task switcher
 /*! the task switcher saves active context and passes sp to scheduler
     then restores new context from returned sp
 */
+#ifdef CONF_HOST
+void tm_switcher(void) {
+  size_t *old_sp=ctid->sp_save;
+  size_t *new_sp;
+
+  if(ctid->tstate==T_ZOMBIE)
+    old_sp=NULL;                              // context is being freed
+
+  new_sp=tm_scheduler(old_sp);
+  tm_current_slice=tm_timeslice;              // new timeslice
+  if(new_sp!=old_sp)
+    tm_host_switch(old_sp,new_sp);
+}
+#else
 void tm_switcher(void);
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 __asm__("\n\
@@ -136,6 +517,7 @@ _tm_switcher_return:    \n\
       rts                                     ; return to new task\n\
 ");
 #endif  // DOXYGEN_SHOULD_SKIP_THIS
+#endif  // CONF_HOST
 
 
 //! the task scheduler
@@ -147,11 +529,28 @@ _tm_switcher_return:    \n\
 size_t *tm_scheduler(size_t *old_sp) {
   tdata_t  *next;                             // next task to execute
   pchain_t *priority;
+#ifdef CONF_TM_READYQ
+  unsigned long map,bit;
+  unsigned char level;
+#ifndef CONF_TM_WHEEL
+  time_t now;
+#endif
+#else
   wakeup_t tmp;
+#endif
+#ifdef CONF_TRACE
+  tdata_t  *prev=ctid;                        // for the trace
+#endif
 
   priority=ctid->priority;
   switch(ctid->tstate) {
   case T_ZOMBIE:
+#ifdef CONF_TM_READYQ
+    tm_unqueue(ctid);
+#endif
+#ifdef CONF_TM_WHEEL
+    tm_timer_disarm(ctid);                    // killed while waiting
+#endif
     if(ctid->next!=ctid) {
       // remove from chain for this priority level
       //
@@ -169,22 +568,31 @@ size_t *tm_scheduler(size_t *old_sp) {
         priority->prev->next = priority->next;
       else
         priority_head = priority->next;
-      free(priority);
+#ifdef CONF_TM_READYQ
+      tm_prio[priority->priority] = NULL;
+#endif
+#ifdef CONF_TM_INHERIT
+      tm_disinherit_chain(priority);
+#endif
+      pchain_free(priority);
     }
       
+    // check flags before the task data is freed,
+    // freeing may overwrite them.
+    //
+    if ((ctid->tflags & T_KERNEL)==T_KERNEL)
+      --nb_system_tasks;
+
     // We're on that stack frame being freed right now,
     // but nobody can interrupt us anyways.
     //
     free(ctid->stack_base);                   // free stack
-    free(ctid);                               // free task data
+    tdata_free(ctid);                         // free task data
 
     //
     // FIXME: exit code?
     //
 
-    if ((ctid->tflags & T_KERNEL)==T_KERNEL)
-      --nb_system_tasks;
-
     switch(--nb_tasks) {
     case 1:
 #ifdef CONF_TM_DEBUG    
@@ -194,7 +602,7 @@ size_t *tm_scheduler(size_t *old_sp) {
       }
 #endif // CONF_TM_DEBUG
       // only the idle task remains
-      *((priority_head->ctid->sp_save) + SP_RETURN_OFFSET ) = (size_t) &exit;
+      TM_SET_RETURN(priority_head->ctid->sp_save,&exit);
       priority_head->ctid->tstate=T_SLEEPING;
       break;
     
@@ -218,6 +626,51 @@ size_t *tm_scheduler(size_t *old_sp) {
   }
 
 
+#ifdef CONF_TM_READYQ
+#ifndef CONF_TM_WHEEL
+  // wake up sleepers whose deadline has passed
+  //
+  now=get_system_up_time();
+  while(tm_sleepers!=NULL && (time_t) tm_sleepers->wakeup_data<=now) {
+    next=tm_sleepers;
+    tm_sleepers=next->rnext;
+    tm_enqueue(next);
+  }
+#endif
+
+  // find next task willing to run, highest ready level first.
+  // the idle task is always ready.
+  //
+  map=tm_ready_map;
+  bit=1UL<<PRIO_HIGHEST;
+  level=PRIO_HIGHEST;
+  while (1) {
+    while (!(map & bit)) {
+      bit>>=1;
+      level--;
+    }
+    if ((next=tm_pick(tm_prio[level]))!=NULL)
+      break;
+
+    map&=~bit;
+    if (map==0) {
+      // everybody is polling. start over.
+      map=tm_ready_map;
+      bit=1UL<<PRIO_HIGHEST;
+      level=PRIO_HIGHEST;
+    }
+  }
+  tm_enqueue(next);                           // round robin
+
+#ifndef CONF_TM_WHEEL
+  // shorten the next timeslice if a sleeper is due earlier
+  //
+  tm_timeslice = TM_DEFAULT_SLICE;
+  if (tm_sleepers!=NULL &&
+      (time_t) tm_sleepers->wakeup_data - now < TM_DEFAULT_SLICE)
+    tm_timeslice = (time_t) tm_sleepers->wakeup_data - now;
+#endif
+#else
   // find next task willing to run
   //  
   priority=priority_head;
@@ -235,6 +688,10 @@ size_t *tm_scheduler(size_t *old_sp) {
       tmp = next->wakeup(next->wakeup_data);
       if (tmp != 0) {
         next->wakeup_data = tmp;
+#ifdef CONF_TRACE
+        trace_event(TRACE_WAKE,next->priority->priority,
+                    (unsigned) (size_t) next);
+#endif
         break;
       }
     }
@@ -259,8 +716,14 @@ size_t *tm_scheduler(size_t *old_sp) {
     } else
       next=next->next;
   }
+#endif // CONF_TM_READYQ
   ctid=next->priority->ctid=next;             // execute next task
   ctid->tstate=T_RUNNING;
+#ifdef CONF_TRACE
+  if (ctid!=prev)
+    trace_event(TRACE_SWITCH,ctid->priority->priority,
+                (unsigned) (size_t) ctid);
+#endif
 
   return ctid->sp_save;
 }
@@ -268,6 +731,14 @@ size_t *tm_scheduler(size_t *old_sp) {
 //! yield the rest of the current timeslice
 /*! (does not speed up the system clock)
 */
+#ifdef CONF_HOST
+void yield(void) {
+  unsigned char ccr=irq_save();               // fake an IRQ
+
+  tm_switcher();
+  irq_restore(ccr);
+}
+#else
 extern void yield(void);
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 __asm__("\n\
@@ -292,12 +763,37 @@ _yield:\n\
       jmp     @_tm_switcher          ; call task switcher\n\
 ");
 #endif  // DOXYGEN_SHOULD_SKIP_THIS
+#endif  // CONF_HOST
 
 //! the idle system task
-/*! infinite sleep instruction to conserve power
+/*! infinite sleep instruction to conserve power.
+    with CONF_TM_TICKLESS, the system tick is stopped while sleeping
+    if nothing needs it until the next deadline.
 */
 extern int tm_idle_task(int argc,char **argv) __attribute__ ((noreturn));
+#ifdef CONF_HOST
+int tm_idle_task(int argc,char **argv) {
+  while(1)
+    tm_host_idle();
+}
+#else
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
+#ifdef CONF_TM_TICKLESS
+__asm__("\n\
+.text\n\
+.align 1\n\
+_tm_idle_task:\n\
+      orc #0x80,ccr                 ; block all but NMI\n\
+      jsr _systime_idle             ; stop the tick, if possible\n\
+      andc #0x7f,ccr                ; IRQs are only taken after\n\
+      sleep                         ; the sleep instruction\n\
+\n\
+      orc #0x80,ccr\n\
+      jsr _systime_wake             ; woken early? restart the tick\n\
+      andc #0x7f,ccr\n\
+      bra _tm_idle_task\n\
+");
+#else
 __asm__("\n\
 .text\n\
 .align 1\n\
@@ -305,7 +801,9 @@ _tm_idle_task:\n\
       sleep\n\
       bra _tm_idle_task\n\
 ");
+#endif // CONF_TM_TICKLESS
 #endif  // DOXYGEN_SHOULD_SKIP_THIS
+#endif  // CONF_HOST
 
 #ifdef CONF_VIS
 //! the man system task
@@ -360,11 +858,36 @@ void tm_init(void) {
   nb_tasks=0;
   nb_system_tasks=0;
   priority_head=NULL;
+#ifdef CONF_TM_READYQ
+  {
+    int k;
+
+    for(k=0; k<=PRIO_HIGHEST; k++)
+      tm_prio[k]=NULL;
+    for(k=0; k<TM_WAIT_BUCKETS; k++)
+      tm_blocked[k]=NULL;
+  }
+  tm_ready_map=0;
+#ifdef CONF_TM_WHEEL
+  {
+    int k;
+
+    for(k=0; k<TM_WHEEL_SLOTS; k++)
+      tm_wheel[k]=NULL;
+  }
+  tm_timers=0;
+#else
+  tm_sleepers=NULL;
+#endif
+#endif
   INITIALIZE_KERNEL_CRITICAL_SECTION(); 
  
   // the single tasking context
   //
   td_single.tstate=T_RUNNING;
+#ifdef CONF_HOST
+  td_single.sp_save=tm_host_context(NULL,0,NULL,0,NULL);
+#endif
   ctid=&td_single;
 
   // the idle task is an institution
@@ -405,12 +928,19 @@ void tm_start(void) {
     \param stack_size stack size for new task
     \return -1: fail, else tid.
     
-    will return to caller in any case.
+    will return to caller in any case. with CONF_TM_READYQ, priorities
+    above PRIO_HIGHEST fail.
 */
 tid_t execi(int (*code_start)(int,char**),int argc, char **argv,
             priority_t priority,size_t stack_size) {
   pchain_t *pchain, *ppchain; // for traversing priority chain
   int freepchain=0;
+#ifdef CONF_TM_READYQ
+  unsigned char ccr;
+
+  if(priority>PRIO_HIGHEST)
+    return -1;                          // ready map has no bits above
+#endif
   
   // get memory
   //
@@ -420,22 +950,30 @@ tid_t execi(int (*code_start)(int,char**),int argc, char **argv,
   // avoid deadlock of memory and task semaphores
   // by preallocation.
   
-  tdata_t *td=malloc(sizeof(tdata_t));
+#ifdef CONF_HOST
+  if(stack_size<TM_HOST_STACK_SIZE)
+    stack_size=TM_HOST_STACK_SIZE;      // signal frames are big on a PC
+#endif
+  tdata_t *td=tdata_alloc();
   size_t *sp=malloc(stack_size);
   
   // for allocating new priority chain
-  pchain_t *newpchain=malloc(sizeof(pchain_t));
+  pchain_t *newpchain=pchain_alloc();
 
   if (td == NULL || sp == NULL || newpchain == NULL)
   {
-    free(td);
+    tdata_free(td);
     free(sp);
-    free(newpchain);
+    pchain_free(newpchain);
     return -1;
   }
   
   td->tflags = 0;
+#ifdef CONF_HOST
+  if (code_start!=tm_host_user_entry && !(ctid->tflags & T_USER))
+#else
   if ((size_t)code_start < (size_t)&mm_start)
+#endif
   {
     td->tflags |= T_KERNEL;
     nb_system_tasks++;
@@ -445,6 +983,9 @@ tid_t execi(int (*code_start)(int,char**),int argc, char **argv,
 
   td->stack_base=sp;                  // these we know already.
 
+#ifdef CONF_HOST
+  sp=tm_host_context(sp,stack_size,code_start,argc,argv);
+#else
   sp+=(stack_size>>1);                // setup initial stack
 
   // when main() returns a value, it passes it in r0
@@ -472,6 +1013,7 @@ tid_t execi(int (*code_start)(int,char**),int argc, char **argv,
   *(--sp)=0;
   *(--sp)=0;
   *(--sp)=0;
+#endif // CONF_HOST
 
   td->sp_save=sp;                   // save sp for tm_switcher
   td->tstate=T_SLEEPING;              // task is waiting for execution
@@ -489,6 +1031,10 @@ tid_t execi(int (*code_start)(int,char**),int argc, char **argv,
     //
     newpchain->priority=priority;
     newpchain->ctid=td;
+#ifdef CONF_TM_READYQ
+    newpchain->rhead=newpchain->rtail=NULL;
+    tm_prio[priority]=newpchain;
+#endif
 
     newpchain->next=pchain;
     if(pchain)
@@ -514,10 +1060,21 @@ tid_t execi(int (*code_start)(int,char**),int argc, char **argv,
   }
   nb_tasks++;
 
+#ifdef CONF_TM_READYQ
+  td->wchan=NULL;
+#ifdef CONF_TM_INHERIT
+  td->rprio=td->priority;
+  td->held=0;
+#endif
+  ccr=irq_save();
+  tm_enqueue(td);
+  irq_restore(ccr);
+#endif
+
   LEAVE_KERNEL_CRITICAL_SECTION();  
 
   if(freepchain)
-    free(newpchain);
+    pchain_free(newpchain);
   
   return (tid_t) td;                  // tid = (tid_t) &tdata_t_struct
 }
@@ -546,17 +1103,83 @@ void exit(int code) {
 wakeup_t wait_event(wakeup_t (*wakeup)(wakeup_t),wakeup_t data) {
   ctid->wakeup     =wakeup;
   ctid->wakeup_data=data;
+#ifdef CONF_TM_READYQ
+  ctid->wchan      =NULL;
+#endif
+  ctid->tstate     =T_WAITING;
+#ifdef CONF_TRACE
+  trace_event(TRACE_BLOCK,0,(unsigned) (size_t) wakeup);
+#endif
+
+  yield();
+
+  return ctid->wakeup_data;
+}
+
+#ifdef CONF_TM_READYQ
+//! suspend task until wakeup function is non-null
+/*! \param wchan event object. wakeup is only polled again after
+           notify_event(wchan).
+    \param wakeup the wakeup function. called in task scheduler context.
+    \param data argument passed to wakeup function by scheduler
+    \return return value passed on from wakeup, 0 if exits prematurely
+*/
+wakeup_t wait_event_on(void *wchan,
+                       wakeup_t (*wakeup)(wakeup_t),wakeup_t data) {
+  ctid->wakeup     =wakeup;
+  ctid->wakeup_data=data;
+  ctid->wchan      =wchan;
   ctid->tstate     =T_WAITING;
+#ifdef CONF_TRACE
+  trace_event(TRACE_BLOCK,1,(unsigned) (size_t) wchan);
+#endif
 
   yield();
 
   return ctid->wakeup_data;
 }
+#endif
+
+#ifdef CONF_TM_WHEEL
+//! suspend task until wakeup function is non-null
+/*! \param wchan event object. wakeup is only polled again after
+           notify_event(wchan) or once the deadline has passed.
+    \param wakeup the wakeup function. called in task scheduler context.
+    \param data argument passed to wakeup function by scheduler
+    \param deadline system time to poll wakeup again at
+    \return return value passed on from wakeup, 0 if exits prematurely
+*/
+wakeup_t wait_event_until(void *wchan,
+                          wakeup_t (*wakeup)(wakeup_t),wakeup_t data,
+                          time_t deadline) {
+  unsigned char ccr;
+  wakeup_t result;
+
+  ccr=irq_save();
+  ctid->deadline   =deadline;
+  ctid->tflags    |=T_DEADLINE;
+  irq_restore(ccr);
+
+  result=wait_event_on(wchan,wakeup,data);
+
+  ccr=irq_save();
+  tm_timer_disarm(ctid);                        // woken before deadline
+  ctid->tflags    &=~T_DEADLINE;
+  irq_restore(ccr);
+
+  return result;
+}
+#endif
 
 //! wakeup function for sleep
 /*! \param data time to wakeup encoded as a wakeup_t
 */
 static wakeup_t tm_sleep_wakeup(wakeup_t data) {
+#ifdef CONF_TM_WHEEL
+  // the timer wheel takes care of waking us on time
+  //
+  return ((time_t)data) <= get_system_up_time() ? -1 : 0;
+#else
   time_t remaining = ((time_t)data) - get_system_up_time();
 
   if (((time_t)data) <= get_system_up_time())
@@ -569,6 +1192,7 @@ static wakeup_t tm_sleep_wakeup(wakeup_t data) {
     tm_timeslice = remaining;
 
   return 0;
+#endif
 }
 
 //! delay execution allowing other tasks to run.
@@ -577,8 +1201,14 @@ static wakeup_t tm_sleep_wakeup(wakeup_t data) {
  */
 unsigned int msleep(unsigned int msec)
 {
-#if defined(CONF_TIME) && defined(CONF_TM)
-  if (wait_event(&tm_sleep_wakeup, get_system_up_time() + MSECS_TO_TICKS(msec)) == 0)
+#if defined(CONF_TM_WHEEL)
+  time_t deadline=get_system_up_time() + MSECS_TO_TICKS(msec);
+
+  if (wait_event_until(tm_wheel, &tm_sleep_wakeup, deadline, deadline) == 0)
+    return (MSECS_TO_TICKS(msec) - get_system_up_time());
+#elif defined(CONF_TIME) && defined(CONF_TM)
+  if (wait_event_on(&tm_sleepers, &tm_sleep_wakeup,
+                    get_system_up_time() + MSECS_TO_TICKS(msec)) == 0)
     return (MSECS_TO_TICKS(msec) - get_system_up_time());
 #else
   delay(msec);
@@ -600,7 +1230,15 @@ unsigned int sleep(unsigned int sec)
  */
 void shutdown_task(tid_t tid) {
   tdata_t *td=(tdata_t*) tid;
+#ifdef CONF_TM_READYQ
+  unsigned char ccr=irq_save();
+
+  td->tflags |= T_SHUTDOWN;
+  tm_unpark(td);                      // let it see the request
+  irq_restore(ccr);
+#else
   td->tflags |= T_SHUTDOWN;
+#endif
 }
 
 //! request that tasks with any of the specified flags shutdown.
@@ -620,6 +1258,11 @@ void shutdown_tasks(tflags_t flags) {
         // signal shutdown
         //
         td->tflags |= T_SHUTDOWN;
+#ifdef CONF_TM_READYQ
+        disable_irqs();
+        tm_unpark(td);
+        enable_irqs();
+#endif
       }
       td = td->next;
     } while (td != pchain->ctid);
@@ -642,8 +1285,13 @@ void kill(tid_t tid) {
 
     ENTER_KERNEL_CRITICAL_SECTION(); 
 
-    *( (td->sp_save) + SP_RETURN_OFFSET )=(size_t) &exit;
+    TM_SET_RETURN(td->sp_save,&exit);
     td->tstate=T_SLEEPING;    // in case it's waiting.
+#ifdef CONF_TM_READYQ
+    disable_irqs();
+    tm_unpark(td);
+    enable_irqs();
+#endif
 
     LEAVE_KERNEL_CRITICAL_SECTION();
   }
@@ -674,8 +1322,13 @@ void killall(priority_t prio) {
       if((td!=ctid) && ((td->tflags & flags) == 0)) {
         // kill it
         //
-        *( (td->sp_save) + SP_RETURN_OFFSET )=(size_t) &exit;
+        TM_SET_RETURN(td->sp_save,&exit);
         td->tstate=T_SLEEPING;    // in case it's waiting.
+#ifdef CONF_TM_READYQ
+        disable_irqs();
+        tm_unpark(td);
+        enable_irqs();
+#endif
       }
       td=td->next;
     } while(td!=pchain->ctid);
@@ -0,0 +1,161 @@
+/*! \file   trace.c
+    \brief  Implementation: kernel event trace
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The scheduler, wait_event(), the semaphores and the LNP logical
+ *  layer record events in a fixed ring, overwriting the oldest. The
+ *  host stops recording with TRACEstop on the program port, reads the
+ *  ring with TRACEread and resumes with TRACEstart; a simulator can
+ *  just as well take trace_ring from a memory dump. Recording starts
+ *  at power on.
+ */
+
+#include <sys/trace.h>
+
+#ifdef CONF_TRACE
+
+#include <stdlib.h>
+#include <string.h>
+#include <lnp/lnp.h>
+#include <sys/irq.h>
+#include <time.h>
+#include <sys/program.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Global Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+trace_ring_t trace_ring;                        //!< the trace ring
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Internal Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+extern volatile time_t sys_time;                //!< the system time
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! record an event
+/*! \param type trace_type_t
+    \param data type specific byte
+    \param arg type specific word
+
+    IRQ handler safe.
+*/
+void trace_event(unsigned char type,unsigned char data,unsigned arg) {
+  unsigned char ccr=irq_save();
+  trace_entry_t *entry;
+
+  if(!trace_ring.stopped) {
+    entry=trace_ring.entry+(trace_ring.count & (TRACE_SIZE-1));
+    entry->time=(unsigned) sys_time;
+    entry->type=type;
+    entry->data=data;
+    entry->arg =arg;
+    if((++trace_ring.count & (TRACE_SIZE-1))==0)
+      trace_ring.wrapped=1;
+  }
+
+  irq_restore(ccr);
+}
+
+//! empty the ring and start recording
+void trace_init(void) {
+  memset(&trace_ring,0,sizeof(trace_ring));
+  trace_ring.size=TRACE_SIZE;
+}
+
+//! store a big endian word
+static unsigned char *trace_put(unsigned char *p,unsigned w) {
+  *(p++)=w>>8;
+  *(p++)=w;
+  return p;
+}
+
+//! stream the ring image from byte first on
+/*! stops at the first lost packet. the host asks again from there.
+*/
+static void trace_read(unsigned char *msg,unsigned first,unsigned char src) {
+  unsigned size;
+
+  while(first<sizeof(trace_ring)) {
+    size=sizeof(trace_ring)-first;
+    if(size>TRACE_CHUNK)
+      size=TRACE_CHUNK;
+    trace_put(msg+2,first);
+    memcpy(msg+4,((unsigned char*) &trace_ring)+first,size);
+
+    msg[1]=TRACEdata;
+    if(lnp_addressing_write(msg,4+size,src,0))
+      return;
+    first+=size;
+  }
+
+  msg[1]=TRACEend;
+  trace_put(msg+2,sizeof(trace_ring));
+  lnp_addressing_write(msg,4,src,0);
+}
+
+//! handle a CMDtrace packet from the program port
+/*! \param data packet data after the CMDtrace byte
+    \param length length of data
+    \param src address to reply to
+*/
+void trace_command(const unsigned char *data,unsigned char length,
+                   unsigned char src) {
+  unsigned char *msg,ccr;
+
+  if((msg=malloc(4+TRACE_CHUNK))==NULL)
+    return;
+  msg[0]=CMDtrace;
+  msg[1]=data[0];
+
+  switch(data[0]) {
+    case TRACEstart:
+    case TRACEstop:
+    case TRACEclear:
+      ccr=irq_save();
+      if(data[0]==TRACEclear) {
+        memset(trace_ring.entry,0,sizeof(trace_ring.entry));
+        trace_ring.count=0;
+        trace_ring.wrapped=0;
+      } else
+        trace_ring.stopped=(data[0]==TRACEstop);
+      irq_restore(ccr);
+
+      trace_put(trace_put(msg+2,trace_ring.count),sizeof(trace_ring));
+      lnp_addressing_write(msg,6,src,0);
+      break;
+
+    case TRACEread:
+      if(length<3)
+        break;
+      trace_read(msg,(data[1]<<8) | data[2],src);
+      break;
+  }
+
+  free(msg);
+}
+
+#endif // CONF_TRACE
@@ -40,6 +40,7 @@
 #define CONF_TM_DEBUG           //!< view key shows current instruction pointer
 #define CONF_SEMAPHORES         //!< POSIX semaphores
 #define CONF_PROGRAM          //!< dynamic program loading support
+#define CONF_PROGRAM_LZSS     //!< LZSS compressed program download
 
 // networking services
 //
@@ -48,6 +49,8 @@
 //#define CONF_LNP_FAST        //!< enable 4800 bps LNP
 #define CONF_LNP_HOSTADDR 0x8 //!< LNP host address
 #define CONF_LNP_HOSTMASK 0xf0  //!< LNP host mask
+#define CONF_LNP_TRANSPORT      //!< reliable sliding window transport
+#define CONF_RCX_PROTOCOL       //!< decode RCX remote frames (lnpcap)
 
 // drivers
 //
@@ -58,6 +58,7 @@ static const struct option long_options[]={
   {"stack"  ,required_argument,0,'s'},
   {"verbose",no_argument      ,0,'v'},
   {"display",no_argument      ,0,'d'},
+  {"compress",no_argument     ,0,'z'},
   {0        ,0                ,0,0  }
 };
 
@@ -103,7 +104,7 @@ void lx_from_images(lx_t *lx,image_t *img,unsigned short stack_size) {
 
   // create BrickOS executable header
   //
-  lx->version   =0;
+  lx->version   =LX_VERSION;
   lx->base      =img[0].base;
   lx->text_size =img[0].text_size;
   lx->data_size =img[0].data_size;
@@ -167,6 +168,7 @@ int main(int argc, char **argv) {
   lx_t lx;
   int opt;
   int display_flag = 0;
+  int compress_flag = 0;
   unsigned short stack_size=DEFAULT_STACK_SIZE;
 #ifdef HAVE_GETOPT_LONG
   int option_index;
@@ -174,7 +176,7 @@ int main(int argc, char **argv) {
       
   // read command-line options
   //  
-  while((opt=getopt_long(argc, argv, "s:vd",
+  while((opt=getopt_long(argc, argv, "s:vdz",
                         (struct option *)long_options, &option_index) )!=-1) {
     unsigned tmp;
     
@@ -188,14 +190,17 @@ int main(int argc, char **argv) {
   break;
       case 'd':
   display_flag=1;
+  break;
+      case 'z':
+  compress_flag=1;
   break;
     }
   }           
   
   if(argc-optind<3) {
     fprintf(stderr,"usage: %s file.ds1 file.ds2 file.lx\n"
-             "       [-s<stacksize>] [-v] [-d]\n"
-             "       size in hex, please.\n",
+             "       [-s<stacksize>] [-v] [-d] [-z]\n"
+             "       size in hex, please. -z stores text and data compressed.\n",
              argv[0]);
     exit(1);
   }
@@ -203,6 +208,8 @@ int main(int argc, char **argv) {
   image_load(img  , argv[optind++]);
   image_load(img+1, argv[optind++]);
   lx_from_images(&lx,img,stack_size);
+  if(compress_flag)
+    lx.version=LX_VERSION_LZSS;
     
   if(lx_write(&lx, argv[optind])) {
     fprintf(stderr,"error writing %s\n",argv[optind]);
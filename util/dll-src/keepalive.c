@@ -34,6 +34,9 @@
 
 #if defined(_WIN32)
   #include <windows.h>
+#else
+  #include <sys/lnp-logical.h>
+  #include "lnpevent.h"
 #endif
 
 #include "rcxtty.h"
@@ -50,15 +53,34 @@ extern int verbose_flag;
 //! the keepalive byte (same as tower power on)
 const static char keepaliveByte = KEEPALIVE_BYTE;
 
+#if !defined(_WIN32)
+//! runs out when the tower has been quiet for too long
+static lnp_ev_timer_t keepaliveTimer;
+
+static void keepaliveHandler(int arg);
+
+//! the keepalive timer ran out, in the event loop
+static void keepaliveExpired(void *arg)
+{
+  keepaliveHandler(0);
+}
+#endif
+
 //! renew keepalive timer because you sent something
 void keepaliveRenew()
 {
+#if defined(_WIN32)
   static struct itimerval it =
   {
     {KEEPALIVE_TIMEOUT_S, KEEPALIVE_TIMEOUT_US},
     {KEEPALIVE_TIMEOUT_S, KEEPALIVE_TIMEOUT_US}};
 
   setitimer(ITIMER_REAL, &it, NULL);
+#else
+  lnp_ev_arm(&keepaliveTimer,
+             1000000*KEEPALIVE_TIMEOUT_S + KEEPALIVE_TIMEOUT_US,
+             keepaliveExpired, NULL);
+#endif
 }
 
 //! send keepalive byte & renew keepalive
@@ -67,7 +89,12 @@ static void keepaliveSend(FILEDESCR fd)
   if (verbose_flag)
     fputs("\nKeepAliveSend: keeping the IR tower alive...",stderr);
 
+#if defined(_WIN32)
   if (mywrite(fd, &keepaliveByte, 1) != 1) {
+#else
+  // behind the frames still queued, not into the middle of one
+  if (lnp_logical_write(&keepaliveByte, 1)) {
+#endif
     myperror("sending keepalive");
     exit(-1);
   }
@@ -86,13 +113,16 @@ static void keepaliveHandler(int arg)
 void keepaliveInit(void)
 {
   if (verbose_flag) fputs("KeepAlive Init...", stderr);
+#if defined(_WIN32)
   signal(SIGALRM, keepaliveHandler);
+#endif
   keepaliveSend(rcxFD());
 }
 
 //! shutdown keepalive
 void keepaliveShutdown()
 {
+#if defined(_WIN32)
   static const struct itimerval it =
   {
     {0, 0},
@@ -100,4 +130,7 @@ void keepaliveShutdown()
 
   setitimer(ITIMER_REAL, &it, 0);
   signal(SIGALRM, SIG_DFL);
+#else
+  lnp_ev_disarm(&keepaliveTimer);
+#endif
 }
@@ -0,0 +1,113 @@
+-- lnp.lua - Wireshark dissector for the LNP captures of lnpcap
+--
+-- The contents of this file are subject to the Mozilla Public License
+-- Version 1.0 (the "License"); you may not use this file except in
+-- compliance with the License. You may obtain a copy of the License at
+-- http://www.mozilla.org/MPL/
+--
+-- Software distributed under the License is distributed on an "AS IS"
+-- basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+-- License for the specific language governing rights and limitations
+-- under the License.
+--
+-- usage: wireshark -X lua_script:lnp.lua capture.pcap
+--
+-- lnpcap writes one frame per record, link type USER0, from the header
+-- byte to the checksum. Addressing packets to or from port 0 are taken
+-- apart as the program protocol of sys/program.h. The port mask is the
+-- default one of config.h.
+
+local PORTMASK = 0x0f
+
+local lnp = Proto("lnp", "brickOS Link Networking Protocol")
+
+local commands = {
+  [0] = "acknowledge", [1] = "delete", [2] = "create", [3] = "offsets",
+  [4] = "data", [5] = "run", [6] = "irmode", [7] = "sethost",
+  [8] = "profile", [9] = "trace", [10] = "window", [11] = "sums",
+  [12] = "patch", [13] = "commit", [14] = "multicast", [15] = "missing"
+}
+
+local f = lnp.fields
+f.header   = ProtoField.uint8("lnp.header", "Header", base.HEX)
+f.length   = ProtoField.uint8("lnp.length", "Length", base.DEC)
+f.dest     = ProtoField.uint8("lnp.dest", "Destination", base.HEX)
+f.src      = ProtoField.uint8("lnp.src", "Source", base.HEX)
+f.command  = ProtoField.uint8("lnp.command", "Program command", base.DEC,
+                              commands)
+f.data     = ProtoField.bytes("lnp.data", "Data")
+f.checksum = ProtoField.uint8("lnp.checksum", "Checksum", base.HEX)
+f.remote   = ProtoField.uint16("lnp.remote", "Remote buttons", base.HEX)
+f.message  = ProtoField.uint8("lnp.message", "Message", base.DEC)
+
+-- standard firmware frames: 55 ff 00, then each byte and its complement
+local function rcx_frame(buf, pinfo, t)
+  local len = buf:len()
+
+  t:add(f.header, buf(0, 1))
+  if len >= 11 and buf(3, 1):uint() == 0xd2 then
+    local code = buf(5, 1):uint() * 256 + buf(7, 1):uint()
+    t:add(f.remote, buf(5, 3), code)
+    pinfo.cols.info = string.format("Remote 0x%04x", code)
+  elseif len >= 9 and buf(3, 1):uint() == 0xf7 then
+    t:add(f.message, buf(5, 1))
+    pinfo.cols.info = "Message " .. buf(5, 1):uint()
+  else
+    pinfo.cols.info = "RCX frame"
+  end
+  return len
+end
+
+function lnp.dissector(buf, pinfo, tree)
+  local len = buf:len()
+  if len < 3 then
+    return 0
+  end
+
+  pinfo.cols.protocol = "LNP"
+  local t = tree:add(lnp, buf())
+  local header = buf(0, 1):uint()
+  if header == 0x55 then
+    return rcx_frame(buf, pinfo, t)
+  end
+
+  t:add(f.header, buf(0, 1))
+  t:add(f.length, buf(1, 1))
+
+  local info, data = "Integrity", 2
+  if header == 0xf1 and len >= 5 then
+    local dest, src = buf(2, 1):uint(), buf(3, 1):uint()
+    t:add(f.dest, buf(2, 1))
+    t:add(f.src, buf(3, 1))
+    info = string.format("%02x > %02x", src, dest)
+    data = 4
+    if len > 5 and bit.band(dest, PORTMASK) == 0
+       and bit.band(src, PORTMASK) == 0 then
+      local cmd = buf(4, 1):uint()
+      t:add(f.command, buf(4, 1))
+      info = info .. " " .. (commands[cmd] or ("command " .. cmd))
+      data = 5
+    end
+  elseif header ~= 0xf0 then
+    info = string.format("Header 0x%02x", header)
+  end
+
+  if len - 1 > data then
+    t:add(f.data, buf(data, len - 1 - data))
+  end
+
+  local sum = 0xff
+  for i = 0, len - 2 do
+    sum = (sum + buf(i, 1):uint()) % 256
+  end
+  local c = t:add(f.checksum, buf(len - 1, 1))
+  if buf(len - 1, 1):uint() ~= sum then
+    c:append_text(string.format(" [incorrect, should be 0x%02x]", sum))
+    info = info .. " [bad checksum]"
+  end
+
+  pinfo.cols.info = info
+  return len
+end
+
+DissectorTable.get("wtap_encap"):add(wtap.USER0, lnp)
@@ -0,0 +1,530 @@
+/*! \file   lnpcap.c
+    \brief  Capture LNP traffic to pcap files and replay it
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The bytes come from the tower, from a file of raw tower bytes, or
+ *  from a capture written earlier, and go through the host's LNP
+ *  integrity layer; it hands every frame it takes apart, integrity,
+ *  addressing and RCX remote frames, to lnp_monitor_handler.
+ *  The frames are printed, or written to a pcap file with link type
+ *  USER0, one frame per record from the header to the checksum, with
+ *  the checksum errors included. lnp.lua makes Wireshark decode them.
+ *
+ *  Raw files have no timing; their frames are stamped with the time
+ *  their bytes take on the air. A capture is replayed into a new pty,
+ *  for a program reading it like a tower, or into a given device, at
+ *  its own timing, faster, or back to back.
+ */
+
+#define _GNU_SOURCE			// posix_openpt() and friends
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include <sys/lnp.h>
+#include <sys/lnp-logical.h>
+
+#include "rcxtty.h"
+#include "lnphost.h"
+
+#if (defined(__sun__) && defined(__svr4__)) || defined(BSD)	// Solaris||BSD
+#undef HAVE_GETOPT_LONG
+#else
+#define HAVE_GETOPT_LONG 1
+#endif
+
+#ifdef HAVE_GETOPT_LONG
+#include <getopt.h>
+
+static const struct option long_options[]={
+  {"tty",     required_argument,0,'t'},
+  {"file",    required_argument,0,'f'},
+  {"read",    required_argument,0,'r'},
+  {"output",  required_argument,0,'o'},
+  {"duration",required_argument,0,'d'},
+  {"replay",  no_argument      ,0,'R'},
+  {"device",  required_argument,0,'p'},
+  {"speed",   required_argument,0,'x'},
+  {"verbose", no_argument      ,0,'v'},
+  {0         ,0                ,0,0  }
+};
+
+#else // HAVE_GETOPT_LONG
+
+#define getopt_long(ac, av, opt, lopt, lidx) (getopt((ac), (av), (opt)))
+
+#endif // HAVE_GETOPT_LONG
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define PCAP_MAGIC	0xa1b2c3d4	//!< microsecond timestamps
+#define PCAP_SWAPPED	0xd4c3b2a1	//!< the same, other byte order
+#define PCAP_SNAPLEN	(256+3)		//!< longest LNP frame
+#define LINKTYPE_LNP	147		//!< LINKTYPE_USER0
+#define REPLAY_LINGER	1000000		//!< usecs to keep the pty open after
+
+//! pcap file header
+typedef struct {
+  unsigned magic;
+  unsigned short major,minor;
+  int zone;
+  unsigned sigfigs;
+  unsigned snaplen;
+  unsigned linktype;
+} pcap_header_t;
+
+//! pcap record header
+typedef struct {
+  unsigned sec,usec;
+  unsigned incl,orig;
+} pcap_record_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static FILE *pcap;			//!< capture being written
+static struct timeval stamp;		//!< time of the bytes being fed
+static int live;			//!< stamp frames with the clock
+static unsigned long frames,errors;
+static volatile int stop;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned swap32(unsigned x) {
+  return (x>>24) | ((x>>8) & 0xff00) | ((x<<8) & 0xff0000) | (x<<24);
+}
+
+//! print a frame in one line
+static void print_frame(const unsigned char *frame,unsigned length,
+                        int valid) {
+  unsigned i,data=2;
+
+  printf("%5lu.%06lu ",(unsigned long) stamp.tv_sec,
+         (unsigned long) stamp.tv_usec);
+
+  if(frame[0]==0x55) {
+    printf("remote     0x%04x",(frame[5]<<8) | frame[7]);
+    data=length;
+  } else if(frame[0]==0xf1 && frame[1]>=2) {
+    printf("addressing %02x > %02x %3u:",frame[3],frame[2],frame[1]-2);
+    data=4;
+  } else if(frame[0]==0xf0)
+    printf("integrity          %3u:",frame[1]);
+  else
+    printf("header %02x          %3u:",frame[0],frame[1]);
+
+  for(i=data; i+1<length; i++)
+    printf(" %02x",frame[i]);
+  puts(valid ? "" : "  checksum error");
+}
+
+//! write a frame to the capture
+static void write_frame(const unsigned char *frame,unsigned length) {
+  pcap_record_t rec;
+
+  rec.sec =stamp.tv_sec;
+  rec.usec=stamp.tv_usec;
+  rec.incl=rec.orig=length;
+  if(fwrite(&rec,sizeof(rec),1,pcap)!=1 || fwrite(frame,length,1,pcap)!=1
+     || fflush(pcap)) {
+    perror("writing the capture");
+    exit(1);
+  }
+}
+
+//! the integrity layer took a frame apart
+static void monitor(const unsigned char *frame,unsigned length,int valid) {
+  if(live)
+    gettimeofday(&stamp,0);
+  frames++;
+  if(!valid)
+    errors++;
+
+  if(pcap)
+    write_frame(frame,length);
+  else
+    print_frame(frame,length,valid);
+}
+
+static int write_header(void) {
+  pcap_header_t h;
+
+  h.magic   =PCAP_MAGIC;
+  h.major   =2;
+  h.minor   =4;
+  h.zone    =0;
+  h.sigfigs =0;
+  h.snaplen =PCAP_SNAPLEN;
+  h.linktype=LINKTYPE_LNP;
+  return fwrite(&h,sizeof(h),1,pcap)!=1;
+}
+
+//! open a capture and check its header
+/*! \return the file, NULL on error. *swapped is set if it was written
+    in the other byte order.
+*/
+static FILE *open_capture(const char *filename,int *swapped) {
+  pcap_header_t h;
+  FILE *f;
+
+  if(!strcmp(filename,"-"))
+    f=stdin;
+  else if((f=fopen(filename,"rb"))==NULL) {
+    perror(filename);
+    return NULL;
+  }
+  if(fread(&h,sizeof(h),1,f)!=1
+     || (h.magic!=PCAP_MAGIC && h.magic!=PCAP_SWAPPED)) {
+    fprintf(stderr,"%s: not a pcap file\n",filename);
+    return NULL;
+  }
+  *swapped=h.magic==PCAP_SWAPPED;
+  if(*swapped)
+    h.linktype=swap32(h.linktype);
+  if(h.linktype!=LINKTYPE_LNP) {
+    fprintf(stderr,"%s: link type %u is not LNP\n",filename,h.linktype);
+    return NULL;
+  }
+  return f;
+}
+
+//! read the next frame of a capture
+/*! \return its length, 0 at the end, -1 on error.
+*/
+static int read_frame(FILE *f,int swapped,pcap_record_t *rec,
+                      unsigned char *frame) {
+  if(fread(rec,sizeof(*rec),1,f)!=1)
+    return 0;
+  if(swapped) {
+    rec->sec =swap32(rec->sec);
+    rec->usec=swap32(rec->usec);
+    rec->incl=swap32(rec->incl);
+  }
+  if(rec->incl>PCAP_SNAPLEN || fread(frame,1,rec->incl,f)!=rec->incl)
+    return -1;
+  return rec->incl;
+}
+
+//! capture from the tower until interrupted or the time is up
+static void capture_tower(char *tty,unsigned long usecs) {
+  struct timeval start,now;
+
+  LNPinit(lnp_tty(tty));
+  live=1;
+  gettimeofday(&start,0);
+
+  while(!stop) {
+    lnp_wait(&stop,100000);
+    gettimeofday(&now,0);
+    if(usecs && 1000000*(now.tv_sec-start.tv_sec)
+                + now.tv_usec-start.tv_usec >= usecs)
+      break;
+  }
+}
+
+//! decode a file of raw tower bytes
+static int capture_file(const char *filename) {
+  unsigned char buffer[256];
+  unsigned long bytes=0, usecs;
+  size_t len,i;
+  FILE *f;
+
+  if(!strcmp(filename,"-"))
+    f=stdin;
+  else if((f=fopen(filename,"rb"))==NULL) {
+    perror(filename);
+    return -1;
+  }
+
+  while((len=fread(buffer,1,sizeof(buffer),f))>0)
+    for(i=0; i<len; i++) {
+      usecs=++bytes*BYTE_TIME;
+      stamp.tv_sec =usecs/1000000;
+      stamp.tv_usec=usecs%1000000;
+      lnp_integrity_byte(buffer[i]);
+    }
+
+  if(f!=stdin)
+    fclose(f);
+  return 0;
+}
+
+//! decode a capture again
+static int capture_pcap(const char *filename) {
+  unsigned char frame[PCAP_SNAPLEN];
+  pcap_record_t rec;
+  int swapped,len,i;
+  FILE *f;
+
+  if((f=open_capture(filename,&swapped))==NULL)
+    return -1;
+
+  while((len=read_frame(f,swapped,&rec,frame))>0) {
+    stamp.tv_sec =rec.sec;
+    stamp.tv_usec=rec.usec;
+    lnp_integrity_reset();
+    for(i=0; i<len; i++)
+      lnp_integrity_byte(frame[i]);
+  }
+
+  if(f!=stdin)
+    fclose(f);
+  if(len<0) {
+    fprintf(stderr,"%s: truncated\n",filename);
+    return -1;
+  }
+  return 0;
+}
+
+//! open a new pty and wait for a program to open its other side
+/*! \return the master side, -1 on error.
+*/
+static int open_pty(void) {
+  struct termios tio;
+  struct pollfd pfd;
+  char *name;
+  int fd,slave;
+
+  if((fd=posix_openpt(O_RDWR | O_NOCTTY))<0 || grantpt(fd) || unlockpt(fd)
+     || (name=ptsname(fd))==NULL) {
+    perror("opening a pty");
+    return -1;
+  }
+
+  // raw, so the replayed bytes aren't echoed or edited. the
+  // settings stay with the pty while the master is open.
+  //
+  if((slave=open(name,O_RDWR | O_NOCTTY))<0 || tcgetattr(slave,&tio)) {
+    perror(name);
+    return -1;
+  }
+  cfmakeraw(&tio);
+  tcsetattr(slave,TCSANOW,&tio);
+  close(slave);
+
+  fprintf(stderr,"waiting for a program to open %s\n",name);
+  pfd.fd=fd;
+  pfd.events=POLLIN;
+  do {
+    usleep(100000);
+    if(poll(&pfd,1,0)<0)
+      return -1;
+  } while((pfd.revents & POLLHUP) && !stop);
+
+  return fd;
+}
+
+//! read and drop what the other side sends, for up to usecs
+static void drain(int fd,unsigned long usecs) {
+  unsigned char buffer[256];
+  struct timeval tv;
+  fd_set fds;
+  int i,len;
+
+  tv.tv_sec =usecs/1000000;
+  tv.tv_usec=usecs%1000000;
+  FD_ZERO(&fds);
+  FD_SET(fd,&fds);
+  if(select(fd+1,&fds,NULL,NULL,&tv)>0
+     && (len=read(fd,buffer,sizeof(buffer)))>0 && verbose_flag) {
+    for(i=0; i<len; i++)
+      fprintf(stderr,"%02x ",buffer[i]);
+    fputc('\n',stderr);
+  }
+}
+
+//! replay a capture at speed times its timing, back to back if 0
+static int replay(const char *filename,const char *device,double speed) {
+  unsigned char frame[PCAP_SNAPLEN];
+  struct timeval start,now;
+  pcap_record_t rec;
+  double first=-1,at,elapsed;
+  int swapped,len,fd;
+  FILE *f;
+
+  if((f=open_capture(filename,&swapped))==NULL)
+    return -1;
+
+  if(!device)
+    fd=open_pty();
+  else if(!strcmp(device,"-"))
+    fd=STDOUT_FILENO;
+  else if((fd=open(device,O_RDWR | O_NOCTTY))<0)
+    perror(device);
+  if(fd<0)
+    return -1;
+
+  gettimeofday(&start,0);
+  while(!stop && (len=read_frame(f,swapped,&rec,frame))>0) {
+    at=rec.sec+rec.usec/1e6;
+    if(first<0)
+      first=at;
+
+    // wait for the frame's time, dropping what comes back
+    //
+    for(;;) {
+      gettimeofday(&now,0);
+      elapsed=now.tv_sec-start.tv_sec + (now.tv_usec-start.tv_usec)/1e6;
+      if(speed<=0 || elapsed>=(at-first)/speed)
+        break;
+      drain(fd,1e6*((at-first)/speed-elapsed));
+    }
+
+    if(mywrite(fd,frame,len)!=len) {
+      perror("replay");
+      return -1;
+    }
+    frames++;
+  }
+
+  if(fd!=STDOUT_FILENO) {
+    drain(fd,REPLAY_LINGER);
+    close(fd);
+  }
+  if(f!=stdin)
+    fclose(f);
+  return 0;
+}
+
+static void interrupted(int sig) {
+  stop=1;
+}
+
+static void usage(const char *progname) {
+  char *usage_string =
+	"Options:\n"
+	"  -t<comm>     , --tty=<comm>          capture from the tower at <comm>\n"
+	"  -f<file>     , --file=<file>         decode raw tower bytes from <file>\n"
+	"  -r<file>     , --read=<file>         read a capture\n"
+	"  -o<file>     , --output=<file>       write a capture to <file>\n"
+	"  -d<secs>     , --duration=<secs>     stop capturing after <secs>\n"
+	"  -R           , --replay              replay the capture into a new pty\n"
+	"  -p<device>   , --device=<device>     replay into <device>, - for stdout\n"
+	"  -x<speed>    , --speed=<speed>       replay <speed> times as fast, 0 back\n"
+	"                                       to back (1)\n"
+	"  -v           , --verbose             print the bytes\n"
+	"\n"
+	"Without -f or -r, the tower is captured until interrupted. Frames\n"
+	"are printed unless -o is given.\n"
+	"\n"
+	;
+
+  fprintf(stderr,"usage: %s [options]\n",progname);
+  fputs(usage_string,stderr);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  char *tty=NULL, *raw=NULL, *input=NULL, *output=NULL, *device=NULL;
+  unsigned long secs=0;
+  double speed=1;
+  int opt, replay_flag=0, status=0;
+#ifdef HAVE_GETOPT_LONG
+  int option_index;
+#endif
+
+  while((opt=getopt_long(argc, argv, "t:f:r:o:d:Rp:x:v",
+                        (struct option *)long_options, &option_index) )!=-1) {
+    switch(opt) {
+      case 't':
+        tty=optarg;
+        break;
+      case 'f':
+        raw=optarg;
+        break;
+      case 'r':
+        input=optarg;
+        break;
+      case 'o':
+        output=optarg;
+        break;
+      case 'd':
+        secs=strtoul(optarg,NULL,0);
+        break;
+      case 'p':
+        device=optarg;
+        // fall through
+      case 'R':
+        replay_flag=1;
+        break;
+      case 'x':
+        speed=atof(optarg);
+        break;
+      case 'v':
+        verbose_flag=1;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(optind<argc || (raw && input) || (replay_flag && (!input || output)))
+    usage(argv[0]);
+
+  signal(SIGINT,interrupted);
+  signal(SIGTERM,interrupted);
+
+  if(replay_flag) {
+    if(replay(input,device,speed))
+      return 1;
+    fprintf(stderr,"%lu frames replayed\n",frames);
+    return 0;
+  }
+
+  if(output) {
+    if(!strcmp(output,"-"))
+      pcap=stdout;
+    else if((pcap=fopen(output,"wb"))==NULL) {
+      perror(output);
+      return 1;
+    }
+    if(write_header()) {
+      perror(output);
+      return 1;
+    }
+  }
+  lnp_monitor_handler=monitor;
+
+  if(raw)
+    status=capture_file(raw);
+  else if(input)
+    status=capture_pcap(input);
+  else
+    capture_tower(tty,1000000*secs);
+
+  if(pcap && pcap!=stdout)
+    fclose(pcap);
+  fprintf(stderr,"%lu frames, %lu checksum errors\n",frames,errors);
+  return status ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+/*! \file   lnpd-client.c
+    \brief  Sharing the IR tower: the client library of lnpd
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Needs nothing of brickOS, so other programs can link it as is:
+ *  lnpd does the checksums' and the host address' part.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "lnpd.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! read exactly length bytes
+/*! \return 0 on success
+*/
+static int read_all(int fd, unsigned char *buf, unsigned length) {
+  ssize_t n;
+
+  while(length>0) {
+    n=read(fd,buf,length);
+    if(n<0 && errno==EINTR)
+      continue;
+    if(n<=0)
+      return -1;
+    buf+=n;
+    length-=n;
+  }
+  return 0;
+}
+
+int lnpd_connect(const char *where) {
+  struct sockaddr_un un;
+  struct sockaddr_in in;
+  const char *p;
+  int fd;
+
+  if(!where)
+    where=getenv("LNPD");
+  if(!where)
+    where=LNPD_SOCKET;
+
+  for(p=where; *p>='0' && *p<='9'; p++)
+    ;
+  if(*where && !*p) {
+    memset(&in,0,sizeof(in));
+    in.sin_family=AF_INET;
+    in.sin_port=htons(atoi(where));
+    in.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+    if((fd=socket(AF_INET,SOCK_STREAM,0))<0)
+      return -1;
+    if(connect(fd,(struct sockaddr *) &in,sizeof(in))) {
+      close(fd);
+      return -1;
+    }
+  } else {
+    if(strlen(where)>=sizeof(un.sun_path))
+      return -1;
+    memset(&un,0,sizeof(un));
+    un.sun_family=AF_UNIX;
+    strcpy(un.sun_path,where);
+    if((fd=socket(AF_UNIX,SOCK_STREAM,0))<0)
+      return -1;
+    if(connect(fd,(struct sockaddr *) &un,sizeof(un))) {
+      close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+int lnpd_send(int fd, unsigned char type,
+              const unsigned char *body, unsigned length) {
+  unsigned char msg[3+LNPD_MAX];
+  size_t done=0;
+  ssize_t n;
+
+  if(length>LNPD_MAX)
+    return -1;
+  msg[0]=type;
+  msg[1]=length>>8;
+  msg[2]=length;
+  memcpy(msg+3,body,length);
+
+  while(done<3+length) {
+    n=write(fd,msg+done,3+length-done);
+    if(n<0 && errno==EINTR)
+      continue;
+    if(n<=0)
+      return -1;
+    done+=n;
+  }
+  return 0;
+}
+
+int lnpd_recv(int fd, unsigned char *body, unsigned *length) {
+  unsigned char head[3];
+
+  if(read_all(fd,head,3))
+    return -1;
+  *length=(head[1]<<8) | head[2];
+  if(*length>LNPD_MAX || read_all(fd,body,*length))
+    return -1;
+  return head[0];
+}
+
+int lnpd_bind(int fd, unsigned char port) {
+  return lnpd_send(fd,LNPD_BIND,&port,1);
+}
+
+int lnpd_addressing_write(int fd, const void *data, unsigned char length,
+                          unsigned char dest, unsigned char srcport) {
+  unsigned char frame[LNPD_MAX];
+
+  // lnpd fills in the host address and the checksum
+  //
+  frame[0]=0xf1;
+  frame[1]=length+2;
+  frame[2]=dest;
+  frame[3]=srcport;
+  memcpy(frame+4,data,length);
+  frame[4+length]=0;
+  return lnpd_send(fd,LNPD_FRAME,frame,length+5);
+}
+
+int lnpd_read(int fd, unsigned char *data, unsigned char *src,
+              unsigned char *dest) {
+  unsigned char body[LNPD_MAX];
+  unsigned length;
+  int type;
+
+  for(;;) {
+    if((type=lnpd_recv(fd,body,&length))<0)
+      return -1;
+    if(type!=LNPD_FRAME || length<3 || length!=body[1]+3u)
+      continue;
+
+    if(body[0]==0xf1) {
+      if(body[1]<2)
+        continue;
+      *dest=body[2];
+      *src =body[3];
+      memcpy(data,body+4,body[1]-2);
+      return body[1]-2;
+    }
+    *dest=*src=0;
+    memcpy(data,body+2,body[1]);
+    return body[1];
+  }
+}
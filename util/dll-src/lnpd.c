@@ -0,0 +1,372 @@
+/*! \file   lnpd.c
+    \brief  Share the IR tower between host programs
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Owns the tower, keeps it alive and runs the host's LNP integrity
+ *  layer on it. Programs connect over a UNIX socket or a localhost TCP
+ *  port and take ports of the host address for themselves; each gets
+ *  the addressing packets sent to its ports, and the integrity layer
+ *  packets if it asks for them. What they send goes out with lnpd's
+ *  host address, in the order it arrives. The messages are in lnpd.h.
+ *  The tower, the clients and the keepalive all run in the event loop
+ *  of lnpevent.h.
+ *
+ *  dll, rcxprof and rcxtrace use lnpd when given lnpd:<socket> as
+ *  their tower, see lnphost.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <sys/lnp.h>
+#include <sys/lnp-logical.h>
+
+#include "rcxtty.h"
+#include "lnphost.h"
+#include "lnpd.h"
+#include "lnpevent.h"
+
+#if (defined(__sun__) && defined(__svr4__)) || defined(BSD)	// Solaris||BSD
+#undef HAVE_GETOPT_LONG
+#else
+#define HAVE_GETOPT_LONG 1
+#endif
+
+#ifdef HAVE_GETOPT_LONG
+#include <getopt.h>
+
+static const struct option long_options[]={
+  {"tty",    required_argument,0,'t'},
+  {"socket", required_argument,0,'s'},
+  {"tcp",    required_argument,0,'P'},
+  {"node",   required_argument,0,'n'},
+  {"verbose",no_argument      ,0,'v'},
+  {0        ,0                ,0,0  }
+};
+
+#else // HAVE_GETOPT_LONG
+
+#define getopt_long(ac, av, opt, lopt, lidx) (getopt((ac), (av), (opt)))
+
+#endif // HAVE_GETOPT_LONG
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define CLIENTS_MAX	16		//!< programs connected at once
+#define NO_CLIENT	(-1)
+
+//! a connected program
+typedef struct {
+  int fd;				//!< its connection, -1 if unused
+  int integrity;			//!< wants the integrity layer packets
+  unsigned char buf[3+LNPD_MAX];	//!< message being received
+  unsigned len;
+} client_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static client_t clients[CLIENTS_MAX];
+static int port_owner[LNP_PORTMASK+1];	//!< client of each port
+static volatile int stop;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static void drop_client(int c) {
+  unsigned port;
+
+  if(verbose_flag)
+    fprintf(stderr,"client %d gone\n",c);
+  lnp_ev_watch(clients[c].fd,0,NULL,NULL);
+  close(clients[c].fd);
+  clients[c].fd=-1;
+  for(port=0; port<=LNP_PORTMASK; port++)
+    if(port_owner[port]==c)
+      port_owner[port]=NO_CLIENT;
+}
+
+//! pass a frame to a client
+/*! a client that doesn't keep up is dropped, lnpd doesn't wait for it
+*/
+static void deliver(int c,const unsigned char *frame,unsigned length) {
+  unsigned char msg[3+LNPD_MAX];
+
+  msg[0]=LNPD_FRAME;
+  msg[1]=length>>8;
+  msg[2]=length;
+  memcpy(msg+3,frame,length);
+  if(send(clients[c].fd,msg,3+length,MSG_DONTWAIT)!=(ssize_t) (3+length))
+    drop_client(c);
+}
+
+//! the integrity layer took a frame apart
+static void monitor(const unsigned char *frame,unsigned length,int valid) {
+  int c;
+
+  if(!valid)
+    return;
+
+  if(frame[0]==0xf1) {
+    if(frame[1]<2 || (frame[2] & LNP_HOSTMASK)!=lnp_hostaddr)
+      return;
+    c=port_owner[frame[2] & LNP_PORTMASK];
+    if(c!=NO_CLIENT)
+      deliver(c,frame,length);
+  } else if(frame[0]==0xf0) {
+    for(c=0; c<CLIENTS_MAX; c++)
+      if(clients[c].fd>=0 && clients[c].integrity)
+        deliver(c,frame,length);
+  }
+}
+
+//! a client's frame goes on the air from this host
+static void transmit(int c,unsigned char *frame,unsigned length) {
+  if(length<3 || length!=frame[1]+3u
+     || (frame[0]!=0xf0 && (frame[0]!=0xf1 || frame[1]<2))) {
+    if(verbose_flag)
+      fprintf(stderr,"client %d: malformed frame\n",c);
+    return;
+  }
+
+  if(frame[0]==0xf1)
+    frame[3]=lnp_hostaddr | (frame[3] & LNP_PORTMASK);
+  frame[length-1]=lnp_checksum(0xff,frame,length-1);
+  lnp_logical_write(frame,length);
+}
+
+//! give a client a port
+static void bind_port(int c,unsigned char port) {
+  unsigned char reply[2];
+
+  reply[0]=port;
+  reply[1]=0;
+  if(port==LNPD_INTEGRITY)
+    clients[c].integrity=1;
+  else {
+    port&=LNP_PORTMASK;
+    if(port_owner[port]==NO_CLIENT || port_owner[port]==c)
+      port_owner[port]=c;
+    else
+      reply[1]=1;
+  }
+  if(verbose_flag)
+    fprintf(stderr,"client %d: port 0x%02x %s\n",c,port,
+            reply[1] ? "taken" : "bound");
+
+  if(lnpd_send(clients[c].fd,LNPD_BOUND,reply,2))
+    drop_client(c);
+}
+
+//! read what a client sent and act on the whole messages
+static void client_input(int fd,int events,void *arg) {
+  client_t *cl=arg;
+  int c=cl-clients;
+  unsigned length;
+  ssize_t n;
+
+  n=read(cl->fd,cl->buf+cl->len,sizeof(cl->buf)-cl->len);
+  if(n<=0) {
+    if(n<0 && (errno==EINTR || errno==EAGAIN))
+      return;
+    drop_client(c);
+    return;
+  }
+  cl->len+=n;
+
+  while(cl->fd>=0 && cl->len>=3) {
+    length=(cl->buf[1]<<8) | cl->buf[2];
+    if(length>LNPD_MAX) {
+      drop_client(c);
+      return;
+    }
+    if(cl->len<3+length)
+      return;
+
+    if(cl->buf[0]==LNPD_FRAME)
+      transmit(c,cl->buf+3,length);
+    else if(cl->buf[0]==LNPD_BIND && length==1)
+      bind_port(c,cl->buf[3]);
+
+    cl->len-=3+length;
+    memmove(cl->buf,cl->buf+3+length,cl->len);
+  }
+}
+
+static void new_client(int listener,int events,void *arg) {
+  int fd,c;
+
+  if((fd=accept(listener,NULL,NULL))<0)
+    return;
+  for(c=0; c<CLIENTS_MAX; c++)
+    if(clients[c].fd<0)
+      break;
+  if(c==CLIENTS_MAX) {
+    fputs("too many clients\n",stderr);
+    close(fd);
+    return;
+  }
+
+  // a descriptor can be reused while the loop still has events of the
+  // last one; reading must not block then
+  //
+  fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) | O_NONBLOCK);
+  if(lnp_ev_watch(fd,LNP_EV_READ,client_input,clients+c)) {
+    close(fd);
+    return;
+  }
+  clients[c].fd=fd;
+  clients[c].integrity=0;
+  clients[c].len=0;
+  if(verbose_flag)
+    fprintf(stderr,"client %d connected\n",c);
+}
+
+//! listen on a UNIX socket, or a localhost TCP port if tcp is nonzero
+static int listen_on(const char *path,int tcp) {
+  struct sockaddr_un un;
+  struct sockaddr_in in;
+  int fd,one=1;
+
+  if(tcp) {
+    memset(&in,0,sizeof(in));
+    in.sin_family=AF_INET;
+    in.sin_port=htons(tcp);
+    in.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+    if((fd=socket(AF_INET,SOCK_STREAM,0))<0)
+      return -1;
+    setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+    if(bind(fd,(struct sockaddr *) &in,sizeof(in)) || listen(fd,4)) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  if(strlen(path)>=sizeof(un.sun_path))
+    return -1;
+  memset(&un,0,sizeof(un));
+  un.sun_family=AF_UNIX;
+  strcpy(un.sun_path,path);
+  unlink(path);
+  if((fd=socket(AF_UNIX,SOCK_STREAM,0))<0)
+    return -1;
+  if(bind(fd,(struct sockaddr *) &un,sizeof(un)) || listen(fd,4)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void terminated(int sig) {
+  stop=1;
+}
+
+static void usage(const char *progname) {
+  char *usage_string =
+	"Options:\n"
+	"  -t<comm>     , --tty=<comm>          use the tower at <comm>\n"
+	"  -s<path>     , --socket=<path>       listen on <path> (" LNPD_SOCKET ")\n"
+	"  -P<port>     , --tcp=<port>          listen on localhost TCP <port>\n"
+	"                                       instead\n"
+	"  -n<hostaddr> , --node=<hostaddr>     LNP host address of the host\n"
+	"  -v           , --verbose             print clients and bytes\n"
+	"\n"
+	;
+
+  fprintf(stderr,"usage: %s [options]\n",progname);
+  fputs(usage_string,stderr);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  char *tty=NULL, *path=LNPD_SOCKET;
+  int opt, tcp=0, listener, c;
+#ifdef HAVE_GETOPT_LONG
+  int option_index;
+#endif
+
+  while((opt=getopt_long(argc, argv, "t:s:P:n:v",
+                        (struct option *)long_options, &option_index) )!=-1) {
+    switch(opt) {
+      case 't':
+        tty=optarg;
+        break;
+      case 's':
+        path=optarg;
+        break;
+      case 'P':
+        tcp=atoi(optarg);
+        break;
+      case 'n':
+        lnp_hostaddr=(atoi(optarg) << 4) & LNP_HOSTMASK;
+        break;
+      case 'v':
+        verbose_flag=1;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(optind<argc)
+    usage(argv[0]);
+
+  if((listener=listen_on(path,tcp))<0) {
+    perror(tcp ? "listening on the TCP port" : path);
+    return 1;
+  }
+
+  for(c=0; c<CLIENTS_MAX; c++)
+    clients[c].fd=-1;
+  for(c=0; c<=LNP_PORTMASK; c++)
+    port_owner[c]=NO_CLIENT;
+
+  signal(SIGPIPE,SIG_IGN);
+  signal(SIGINT,terminated);
+  signal(SIGTERM,terminated);
+
+  LNPinit(lnp_tty(tty));
+  lnp_monitor_handler=monitor;
+
+  lnp_ev_watch(listener,LNP_EV_READ,new_client,NULL);
+  lnp_ev_run(&stop,LNP_EV_FOREVER);
+
+  close(listener);
+  if(!tcp)
+    unlink(path);
+  return 0;
+}
@@ -0,0 +1,106 @@
+/*! \file   lnpd.h
+    \brief  Sharing the IR tower: lnpd's protocol and client library
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+#ifndef __lnpd_h__
+#define __lnpd_h__
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! where lnpd listens unless told otherwise
+#define LNPD_SOCKET     "/tmp/lnpd"
+
+//! prefix of a tower name that means lnpd, as in lnpd:/tmp/lnpd or
+//! lnpd:7001 for a localhost TCP port
+#define LNPD_PREFIX     "lnpd:"
+
+//! port number to bind for the integrity layer packets
+#define LNPD_INTEGRITY  0xff
+
+//! longest message body, a whole LNP frame
+#define LNPD_MAX        (256+3)
+
+//! messages, each b[type] s[length] body
+/*! frames are whole LNP frames, header to checksum. lnpd puts its
+    own host address into the source of addressing frames it sends.
+*/
+typedef enum {
+  LNPD_FRAME,       //!< both ways: frame
+  LNPD_BIND,        //!< to lnpd: b[port], deliver the port's packets
+  LNPD_BOUND        //!< from lnpd: b[port] b[0 if bound, 1 if taken]
+} lnpd_msg_t;
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! connect to lnpd
+/*! \param where a socket path or a localhost TCP port number, NULL
+           for $LNPD or LNPD_SOCKET
+    \return the connection, -1 on error
+*/
+extern int lnpd_connect(const char *where);
+
+//! send a message
+/*! \return 0 on success
+*/
+extern int lnpd_send(int fd, unsigned char type,
+                     const unsigned char *body, unsigned length);
+
+//! receive the next message, waiting for it
+/*! \param body room for LNPD_MAX bytes
+    \param length set to the length of body
+    \return its type, -1 on error or end of connection
+*/
+extern int lnpd_recv(int fd, unsigned char *body, unsigned *length);
+
+//! ask for the packets of a port of the host, or LNPD_INTEGRITY
+/*! the answer is a LNPD_BOUND message. a port belongs to one client
+    at a time, integrity packets go to all who asked.
+    \return 0 if sent
+*/
+extern int lnpd_bind(int fd, unsigned char port);
+
+//! send an addressing layer packet
+/*! \return 0 on success
+*/
+extern int lnpd_addressing_write(int fd, const void *data,
+                                 unsigned char length, unsigned char dest,
+                                 unsigned char srcport);
+
+//! receive the next packet, skipping other messages
+/*! \param data room for 255 bytes of payload
+    \param src set to the source address, 0 for integrity packets
+    \param dest set to the destination address, 0 for integrity packets
+    \return the payload length, -1 on error or end of connection
+*/
+extern int lnpd_read(int fd, unsigned char *data, unsigned char *src,
+                     unsigned char *dest);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif // __lnpd_h__
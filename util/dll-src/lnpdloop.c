@@ -0,0 +1,372 @@
+/*! \file   lnpdloop.c
+    \brief  Test lnpd on a pty pair standing in for the tower
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Starts lnpd with the slave side of a pty as its tower, and plays
+ *  the brick on the master side, echoing what lnpd sends like a serial
+ *  tower does. Two clients connect and bind ports. Checked are port
+ *  binding and conflicts, that frames from the brick reach the owner
+ *  of their port and nobody else, the integrity layer packets, and
+ *  that frames from the clients go on the air with lnpd's host address
+ *  as their source and a good checksum. Prints each check and exits
+ *  with 1 if any failed.
+ */
+
+#define _GNU_SOURCE			// posix_openpt() and friends
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "lnpd.h"
+
+#if (defined(__sun__) && defined(__svr4__)) || defined(BSD)	// Solaris||BSD
+#undef HAVE_GETOPT_LONG
+#else
+#define HAVE_GETOPT_LONG 1
+#endif
+
+#ifdef HAVE_GETOPT_LONG
+#include <getopt.h>
+
+static const struct option long_options[]={
+  {"lnpd",   required_argument,0,'d'},
+  {"verbose",no_argument      ,0,'v'},
+  {0        ,0                ,0,0  }
+};
+
+#else // HAVE_GETOPT_LONG
+
+#define getopt_long(ac, av, opt, lopt, lidx) (getopt((ac), (av), (opt)))
+
+#endif // HAVE_GETOPT_LONG
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOST		0x10		//!< lnpd's host address, -n 1
+#define BRICK		0x20		//!< the brick's
+#define QUIET_MS	300		//!< how long nothing must arrive
+#define WAIT_MS		2000		//!< how long something may take
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static int tower=-1;			//!< master side of the pty
+static unsigned char air[1024];		//!< bytes from lnpd not taken yet
+static unsigned air_len;
+
+static int verbose_flag;
+static int failures;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! report a check
+static void check(int ok,const char *what) {
+  printf("%-52s %s\n",what,ok ? "ok" : "FAILED");
+  fflush(stdout);
+  if(!ok)
+    failures++;
+}
+
+//! the LNP checksum of a frame without it, like lnp_checksum()
+static unsigned char checksum(const unsigned char *frame,unsigned length) {
+  unsigned char sum=0xff;
+
+  while(length-- > 0)
+    sum+=*frame++;
+  return sum;
+}
+
+//! the brick sends an addressing frame
+static void brick_send(unsigned char dest,unsigned char src,
+                       const char *data,int corrupt) {
+  unsigned char frame[260];
+  unsigned length=strlen(data);
+
+  frame[0]=0xf1;
+  frame[1]=length+2;
+  frame[2]=dest;
+  frame[3]=src;
+  memcpy(frame+4,data,length);
+  frame[4+length]=checksum(frame,4+length)+corrupt;
+  if(write(tower,frame,5+length)!=(ssize_t) (5+length))
+    perror("writing to the pty");
+}
+
+//! the brick sends an integrity layer frame
+static void brick_send_integrity(const char *data) {
+  unsigned char frame[260];
+  unsigned length=strlen(data);
+
+  frame[0]=0xf0;
+  frame[1]=length;
+  memcpy(frame+2,data,length);
+  frame[2+length]=checksum(frame,2+length);
+  if(write(tower,frame,3+length)!=(ssize_t) (3+length))
+    perror("writing to the pty");
+}
+
+//! wait for a frame from lnpd, echoing everything like the tower
+/*! keepalive bytes and anything else that isn't a whole frame with a
+    good checksum is skipped.
+    \param frame room for 260 bytes
+    \return its length, 0 if none came in ms
+*/
+static unsigned brick_recv(unsigned char *frame,int ms) {
+  struct pollfd pfd;
+  unsigned i,length;
+  ssize_t n;
+
+  for(;;) {
+    for(i=0; i<air_len; i++) {
+      if(air[i]!=0xf0 && air[i]!=0xf1)
+        continue;
+      if(i+2>air_len)
+        break;
+      length=air[i+1]+3;
+      if(i+length>air_len)
+        break;
+      if(checksum(air+i,length-1)==air[i+length-1]) {
+        memcpy(frame,air+i,length);
+        air_len-=i+length;
+        memmove(air,air+i+length,air_len);
+        return length;
+      }
+    }
+    if(i>0 && i==air_len)
+      air_len=0;			// nothing starts a frame
+
+    pfd.fd=tower;
+    pfd.events=POLLIN;
+    if(poll(&pfd,1,ms)<=0)
+      return 0;
+    n=read(tower,air+air_len,sizeof(air)-air_len);
+    if(n<=0)
+      return 0;
+    if(write(tower,air+air_len,n)!=n)	// the tower hears itself
+      perror("writing to the pty");
+    if(verbose_flag) {
+      for(i=0; i<(unsigned) n; i++)
+        fprintf(stderr,"%02x ",air[air_len+i]);
+      fputc('\n',stderr);
+    }
+    air_len+=n;
+  }
+}
+
+//! does a client have a message within ms?
+static int pending(int fd,int ms) {
+  struct pollfd pfd;
+
+  pfd.fd=fd;
+  pfd.events=POLLIN;
+  return poll(&pfd,1,ms)>0;
+}
+
+//! bind a port
+/*! \return 0 if bound, 1 if taken, -1 if lnpd didn't answer
+*/
+static int bind_port(int fd,unsigned char port) {
+  unsigned char body[LNPD_MAX];
+  unsigned length;
+
+  if(lnpd_bind(fd,port) || !pending(fd,WAIT_MS))
+    return -1;
+  if(lnpd_recv(fd,body,&length)!=LNPD_BOUND || length!=2 || body[0]!=port)
+    return -1;
+  return body[1];
+}
+
+//! does a client get this packet next?
+static int delivered(int fd,unsigned char src,unsigned char dest,const char *data) {
+  unsigned char got[256],s,d;
+  int length;
+
+  if(!pending(fd,WAIT_MS))
+    return 0;
+  length=lnpd_read(fd,got,&s,&d);
+  return length==(int) strlen(data) && !memcmp(got,data,length)
+         && s==src && d==dest;
+}
+
+//! start lnpd on the pty at the socket
+static pid_t start_lnpd(const char *lnpd,const char *tty,const char *path) {
+  pid_t pid=fork();
+
+  if(pid==0) {
+    execl(lnpd,lnpd,"-t",tty,"-s",path,"-n","1",
+          verbose_flag ? "-v" : NULL,NULL);
+    perror(lnpd);
+    _exit(127);
+  }
+  return pid;
+}
+
+//! connect to lnpd, waiting for it to listen
+static int connect_lnpd(const char *path) {
+  int fd,i;
+
+  for(i=0; i<WAIT_MS/50; i++) {
+    if((fd=lnpd_connect(path))>=0)
+      return fd;
+    usleep(50000);
+  }
+  return -1;
+}
+
+static void usage(const char *progname) {
+  char *usage_string =
+	"Options:\n"
+	"  -d<lnpd>     , --lnpd=<lnpd>         lnpd to test (lnpd next to this)\n"
+	"  -v           , --verbose             print the bytes on the air\n"
+	"\n"
+	;
+
+  fprintf(stderr,"usage: %s [options]\n",progname);
+  fputs(usage_string,stderr);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  char lnpd[1024], path[64], *tty, *slash;
+  unsigned char frame[260];
+  unsigned length;
+  int opt, a, b, status;
+  pid_t pid;
+#ifdef HAVE_GETOPT_LONG
+  int option_index;
+#endif
+
+  strcpy(lnpd,"lnpd");
+  if((slash=strrchr(argv[0],'/'))!=NULL && slash-argv[0]+6<(int) sizeof(lnpd))
+    sprintf(lnpd,"%.*slnpd",(int) (slash-argv[0]+1),argv[0]);
+
+  while((opt=getopt_long(argc, argv, "d:v",
+                        (struct option *)long_options, &option_index) )!=-1) {
+    switch(opt) {
+      case 'd':
+        if(strlen(optarg)>=sizeof(lnpd))
+          usage(argv[0]);
+        strcpy(lnpd,optarg);
+        break;
+      case 'v':
+        verbose_flag=1;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(optind<argc)
+    usage(argv[0]);
+
+  if((tower=posix_openpt(O_RDWR | O_NOCTTY))<0 || grantpt(tower)
+     || unlockpt(tower) || (tty=ptsname(tower))==NULL) {
+    perror("opening a pty");
+    return 1;
+  }
+  sprintf(path,"/tmp/lnpdloop.%d",(int) getpid());
+  signal(SIGPIPE,SIG_IGN);
+
+  pid=start_lnpd(lnpd,tty,path);
+  if(pid<0 || (a=connect_lnpd(path))<0 || (b=lnpd_connect(path))<0) {
+    fprintf(stderr,"%s didn't start\n",lnpd);
+    if(pid>0)
+      kill(pid,SIGTERM);
+    return 1;
+  }
+
+  // binding
+  //
+  check(bind_port(a,1)==0,"client a binds port 1");
+  check(bind_port(b,1)==1,"client b can't bind port 1");
+  check(bind_port(b,2)==0,"client b binds port 2");
+  check(bind_port(a,1)==0,"client a binds port 1 again");
+
+  // delivery
+  //
+  brick_send(HOST|1,BRICK|3,"to a",0);
+  check(delivered(a,BRICK|3,HOST|1,"to a"),"a gets a frame for port 1");
+  check(!pending(b,QUIET_MS),"b doesn't");
+
+  brick_send(HOST|2,BRICK|3,"to b",0);
+  check(delivered(b,BRICK|3,HOST|2,"to b"),"b gets a frame for port 2");
+  check(!pending(a,QUIET_MS),"a doesn't");
+
+  brick_send(HOST|5,BRICK|3,"unbound",0);
+  brick_send(0x30|1,BRICK|3,"another host",0);
+  brick_send(HOST|1,BRICK|3,"bad checksum",1);
+  check(!pending(a,QUIET_MS) && !pending(b,0),
+        "nobody gets frames for others or bad ones");
+
+  check(bind_port(b,LNPD_INTEGRITY)==0,"client b takes integrity packets");
+  brick_send_integrity("all");
+  check(delivered(b,0,0,"all"),"b gets an integrity packet");
+  check(!pending(a,QUIET_MS),"a doesn't");
+
+  // source address
+  //
+  lnpd_addressing_write(a,"from a",6,BRICK|3,1);
+  length=brick_recv(frame,WAIT_MS);
+  check(length==11 && frame[0]==0xf1 && frame[2]==(BRICK|3)
+        && frame[3]==(HOST|1) && !memcmp(frame+4,"from a",6),
+        "a's frame has the host address as source");
+
+  memcpy(frame,"\xf1\x04\x23\x51hi\x00",7);	// claims host 5
+  lnpd_send(b,LNPD_FRAME,frame,7);
+  length=brick_recv(frame,WAIT_MS);
+  check(length==7 && frame[3]==(HOST|1) && !memcmp(frame+4,"hi",2),
+        "b's frame claiming another host is rewritten");
+  check(!pending(a,QUIET_MS) && !pending(b,0),"nobody gets the echoes");
+
+  lnpd_send(a,LNPD_FRAME,(const unsigned char *) "\xf1\x09\x23\x01",4);
+  check(brick_recv(frame,QUIET_MS)==0,"a malformed frame isn't sent");
+
+  // a port is free again once its client is gone
+  //
+  close(a);
+  usleep(100000);
+  check(bind_port(b,1)==0,"client b binds port 1 after a is gone");
+  brick_send(HOST|1,BRICK|3,"to b now",0);
+  check(delivered(b,BRICK|3,HOST|1,"to b now"),"b gets port 1's frames");
+
+  close(b);
+  kill(pid,SIGTERM);
+  waitpid(pid,&status,0);
+  check(WIFEXITED(status) && WEXITSTATUS(status)==0,"lnpd exits on SIGTERM");
+
+  if(failures)
+    printf("%d checks failed\n",failures);
+  return failures!=0;
+}
@@ -0,0 +1,285 @@
+/*! \file   lnpevent.c
+    \brief  The event loop of the host utilities
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  One loop for the tower, lnpd's clients and the timers: receive
+ *  timeouts, keepalive, transmit pacing and the transport's
+ *  retransmits. Everything runs from lnp_ev_run(), never from a
+ *  signal handler. On Linux the descriptors are in an epoll set and
+ *  the soonest timer is a timerfd in it, good to the usec; elsewhere
+ *  select() waits with the timeout of the soonest timer.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#if defined(LINUX) || defined(linux)
+#define HAVE_EPOLL 1
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#else
+#include <sys/select.h>
+#endif
+
+#include "lnpevent.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! a watched descriptor
+typedef struct {
+  int fd;                       //!< -1 if the slot is free
+  int events;
+  lnp_ev_io_t io;
+  void *arg;
+} watch_t;
+
+#define TIMER_SLOT  LNP_EV_MAX  //!< epoll data of the timerfd
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static watch_t watches[LNP_EV_MAX];
+static int watch_count;               //!< slots in use or used before
+static lnp_ev_timer_t *timers;        //!< armed, soonest first
+
+#ifdef HAVE_EPOLL
+static int epfd=-1, tfd=-1;
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned long long lnp_ev_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return 1000000ULL*ts.tv_sec + ts.tv_nsec/1000;
+}
+
+#ifdef HAVE_EPOLL
+//! the epoll set, with the timerfd in it
+static int ev_init(void) {
+  struct epoll_event ev;
+
+  if(epfd>=0)
+    return 0;
+  if((epfd=epoll_create(LNP_EV_MAX+1))<0
+     || (tfd=timerfd_create(CLOCK_MONOTONIC,0))<0) {
+    perror("lnp_ev");
+    exit(1);
+  }
+  memset(&ev,0,sizeof(ev));
+  ev.events=EPOLLIN;
+  ev.data.u32=TIMER_SLOT;
+  return epoll_ctl(epfd,EPOLL_CTL_ADD,tfd,&ev);
+}
+#endif
+
+int lnp_ev_watch(int fd, int events, lnp_ev_io_t io, void *arg) {
+  int i,slot=-1;
+#ifdef HAVE_EPOLL
+  struct epoll_event ev;
+  int op;
+
+  ev_init();
+#endif
+
+  for(i=0; i<watch_count; i++)
+    if(watches[i].fd==fd)
+      break;
+    else if(watches[i].fd<0 && slot<0)
+      slot=i;
+
+  if(i<watch_count)
+    slot=i;
+  else if(!events)
+    return 0;
+  else if(slot<0) {
+    if(watch_count==LNP_EV_MAX)
+      return -1;
+    slot=watch_count++;
+    watches[slot].fd=-1;
+  }
+
+#ifdef HAVE_EPOLL
+  memset(&ev,0,sizeof(ev));
+  ev.events=((events & LNP_EV_READ) ? EPOLLIN : 0)
+          | ((events & LNP_EV_WRITE) ? EPOLLOUT : 0);
+  ev.data.u32=slot;
+  op=!events ? EPOLL_CTL_DEL
+     : watches[slot].fd<0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  if(epoll_ctl(epfd,op,fd,&ev) && events)
+    return -1;
+#endif
+
+  if(!events) {
+    watches[slot].fd=-1;
+    return 0;
+  }
+  watches[slot].fd    =fd;
+  watches[slot].events=events;
+  watches[slot].io    =io;
+  watches[slot].arg   =arg;
+  return 0;
+}
+
+void lnp_ev_disarm(lnp_ev_timer_t *timer) {
+  lnp_ev_timer_t **link;
+
+  if(!timer->armed)
+    return;
+  for(link=&timers; *link; link=&(*link)->next)
+    if(*link==timer) {
+      *link=timer->next;
+      break;
+    }
+  timer->armed=0;
+}
+
+void lnp_ev_arm(lnp_ev_timer_t *timer, unsigned long usecs,
+                lnp_ev_fire_t fire, void *arg) {
+  lnp_ev_timer_t **link;
+
+  lnp_ev_disarm(timer);
+  timer->due  =lnp_ev_now()+usecs;
+  timer->fire =fire;
+  timer->arg  =arg;
+  timer->armed=1;
+
+  for(link=&timers; *link && (*link)->due<=timer->due; link=&(*link)->next)
+    ;
+  timer->next=*link;
+  *link=timer;
+}
+
+//! fire the timers that ran out
+static void ev_expire(void) {
+  unsigned long long now=lnp_ev_now();
+  lnp_ev_timer_t *timer;
+
+  while(timers && timers->due<=now) {
+    timer=timers;
+    timers=timer->next;
+    timer->armed=0;
+    timer->fire(timer->arg);       // may arm it again
+  }
+}
+
+//! wait for events until the time given, and handle them
+static void ev_poll(unsigned long long until) {
+  unsigned long long now=lnp_ev_now();
+  int i;
+#ifdef HAVE_EPOLL
+  struct epoll_event evs[LNP_EV_MAX+1];
+  struct itimerspec its;
+  unsigned long long expired;
+  int n,events,timeout=0;
+  watch_t *w;
+
+  ev_init();
+  if(until>now) {
+    memset(&its,0,sizeof(its));
+    if(until!=~0ULL) {
+      its.it_value.tv_sec =until/1000000;
+      its.it_value.tv_nsec=(until%1000000)*1000;
+    }
+    timerfd_settime(tfd,TFD_TIMER_ABSTIME,&its,NULL);
+    timeout=-1;
+  }
+
+  n=epoll_wait(epfd,evs,LNP_EV_MAX+1,timeout);
+  for(i=0; i<n; i++) {
+    if(evs[i].data.u32==TIMER_SLOT) {
+      read(tfd,&expired,sizeof(expired));
+      continue;
+    }
+    w=watches+evs[i].data.u32;
+    events=((evs[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ? LNP_EV_READ : 0)
+         | ((evs[i].events & EPOLLOUT) ? LNP_EV_WRITE : 0);
+    if(w->fd>=0 && (events &= w->events))
+      w->io(w->fd,events,w->arg);
+  }
+#else
+  struct timeval tv;
+  fd_set rfds,wfds;
+  int max=-1,events;
+
+  FD_ZERO(&rfds);
+  FD_ZERO(&wfds);
+  for(i=0; i<watch_count; i++) {
+    if(watches[i].fd<0)
+      continue;
+    if(watches[i].events & LNP_EV_READ)
+      FD_SET(watches[i].fd,&rfds);
+    if(watches[i].events & LNP_EV_WRITE)
+      FD_SET(watches[i].fd,&wfds);
+    if(watches[i].fd>max)
+      max=watches[i].fd;
+  }
+  tv.tv_sec =until>now ? (until-now)/1000000 : 0;
+  tv.tv_usec=until>now ? (until-now)%1000000 : 0;
+
+  if(select(max+1,&rfds,&wfds,NULL,until==~0ULL ? NULL : &tv)<1)
+    return;
+  for(i=0; i<watch_count; i++) {
+    if(watches[i].fd<0)
+      continue;
+    events=(FD_ISSET(watches[i].fd,&rfds) ? LNP_EV_READ : 0)
+         | (FD_ISSET(watches[i].fd,&wfds) ? LNP_EV_WRITE : 0);
+    if(events)
+      watches[i].io(watches[i].fd,events,watches[i].arg);
+  }
+#endif
+}
+
+int lnp_ev_run(volatile int *flag, unsigned long usecs) {
+  unsigned long long end, until;
+  int polled=0;
+
+  end=usecs==LNP_EV_FOREVER ? ~0ULL : lnp_ev_now()+usecs;
+
+  for(;;) {
+    ev_expire();
+    if(flag && *flag)
+      break;
+    if(polled && lnp_ev_now()>=end)
+      break;
+
+    until=end;
+    if(timers && timers->due<until)
+      until=timers->due;
+    ev_poll(until);
+    polled=1;
+  }
+
+  return flag ? *flag : 0;
+}
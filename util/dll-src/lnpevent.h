@@ -0,0 +1,77 @@
+/*! \file   lnpevent.h
+    \brief  The event loop of the host utilities
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+#ifndef __lnpevent_h__
+#define __lnpevent_h__
+
+///////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////
+
+#define LNP_EV_READ     1         //!< the descriptor is readable
+#define LNP_EV_WRITE    2         //!< the descriptor is writable
+#define LNP_EV_MAX      32        //!< descriptors watched at once
+#define LNP_EV_FOREVER  (~0UL)    //!< lnp_ev_run() until the flag is set
+
+//! called for the events of a watched descriptor
+typedef void (*lnp_ev_io_t)(int fd, int events, void *arg);
+
+//! called when a timer runs out
+typedef void (*lnp_ev_fire_t)(void *arg);
+
+//! a one-shot timer, owned by the caller
+typedef struct lnp_ev_timer {
+  unsigned long long due;         //!< lnp_ev_now() when it fires
+  lnp_ev_fire_t fire;
+  void *arg;
+  int armed;
+  struct lnp_ev_timer *next;      //!< the armed timers, soonest first
+} lnp_ev_timer_t;
+
+///////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////
+
+//! the monotonic time in usecs
+unsigned long long lnp_ev_now(void);
+
+//! watch a descriptor
+/*! \param events LNP_EV_READ and/or LNP_EV_WRITE, 0 to stop watching.
+           a later call for the same descriptor replaces the earlier.
+    \return 0 on success, -1 if too many are watched
+*/
+int lnp_ev_watch(int fd, int events, lnp_ev_io_t io, void *arg);
+
+//! (re)arm a timer to fire once, usecs from now
+void lnp_ev_arm(lnp_ev_timer_t *timer, unsigned long usecs,
+                lnp_ev_fire_t fire, void *arg);
+
+//! disarm a timer, if it is armed
+void lnp_ev_disarm(lnp_ev_timer_t *timer);
+
+//! handle events and timers until *flag is set or usecs have passed
+/*! looks for events at least once, even if usecs is 0.
+    \param flag may be NULL to run for usecs
+    \param usecs or LNP_EV_FOREVER
+    \return the value of *flag
+*/
+int lnp_ev_run(volatile int *flag, unsigned long usecs);
+
+#endif // __lnpevent_h__
@@ -0,0 +1,568 @@
+/*! \file   lnphost.c
+    \brief  LNP over the IR tower for the host utilities
+    \author Markus L. Noga <markus@noga.de>
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ *
+ *  The Original Code is legOS code, released October 2, 1999.
+ *
+ *  The Initial Developer of the Original Code is Markus L. Noga.
+ *  Portions created by Markus L. Noga are Copyright (C) 1999
+ *  Markus L. Noga. All Rights Reserved.
+ *
+ *  Contributor(s): everyone discussing LNP at LUGNET
+ */
+
+/*
+ *  The tower side of dll's loader.c, shared by the host utilities
+ *  that talk LNP to a brick, and of the blocking calls of the
+ *  reliable transport in lnp-transport.h.
+ *
+ *  Outside Windows the tower is non-blocking and everything happens
+ *  in the event loop of lnpevent.h: its input, the frames queued for
+ *  it, the gaps between packets, the keepalive and the transport's
+ *  retransmits. lnp_wait() runs the loop.
+ *
+ *  Given lnpd:<socket> as the tower, the frames go through lnpd
+ *  instead, which shares the tower. The ports of the host this
+ *  program sends from are taken from lnpd as they are first used.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <errno.h>
+#endif
+
+#include <sys/lnp.h>
+#include <sys/lnp-logical.h>
+#include <lnp-transport.h>
+
+#include "rcxtty.h"
+#include "keepalive.h"
+#include "lnphost.h"
+#include "lnpd.h"
+#include "lnpevent.h"
+
+#define TX_BUFSIZE  4096                //!< bytes queued for the tower
+
+int verbose_flag=0;
+int tty_usb=0;
+
+static int lnpd_fd=-1;			//!< connection to lnpd, if any
+static unsigned char lnpd_bound[256];	//!< ports taken from lnpd
+
+static lnp_tp_t *lnp_tp_list;		//!< the open transports
+static volatile int lnp_tp_event;	//!< a transport got a frame
+
+#if !defined(_WIN32)
+static unsigned char tx_buf[TX_BUFSIZE];	//!< queued for the tower
+static size_t tx_len;
+static volatile int tx_room;		//!< the queue got shorter
+static lnp_ev_timer_t rx_timer;		//!< gap after the last input
+static lnp_ev_timer_t lnp_tp_timer;	//!< a transport's retransmit
+#endif
+
+/*! pass a frame to lnpd, taking its port first.
+ *! return 0 if OK, nonzero on error.
+ */
+static int lnpd_write(const unsigned char *frame, size_t length) {
+  unsigned char port;
+
+  if(length<3)
+    return -1;
+  port=frame[0]==0xf1 ? frame[3] & LNP_PORTMASK : LNPD_INTEGRITY;
+  if(!lnpd_bound[port]) {
+    if(lnpd_bind(lnpd_fd,port))
+      return -1;
+    lnpd_bound[port]=1;
+  }
+  return lnpd_send(lnpd_fd,LNPD_FRAME,frame,length);
+}
+
+#if !defined(_WIN32)
+static void tower_io(int fd, int events, void *arg);
+
+/*! write what the tower takes of the queue without blocking, and
+ *! watch for it to take more if anything is left.
+ *! return 0 if OK, nonzero on error.
+ */
+static int tx_pump(void) {
+  ssize_t n;
+
+  while(tx_len>0) {
+    n=write(rcxFD(), tx_buf, tx_len);
+    if(n<0 && errno==EINTR)
+      continue;
+    if(n<0 && errno!=EAGAIN)
+      return -1;
+    if(n<=0)
+      break;
+
+#if defined(LINUX) || defined(linux)
+    if (tty_usb == 0)
+#endif
+    keepaliveRenew();
+
+    tx_len-=n;
+    memmove(tx_buf, tx_buf+n, tx_len);
+    tx_room=1;
+  }
+  lnp_ev_watch(rcxFD(), tx_len ? LNP_EV_READ | LNP_EV_WRITE : LNP_EV_READ,
+               tower_io, NULL);
+  return 0;
+}
+
+/*! send what is still queued before the program exits.
+ */
+static void tx_flush(void) {
+  while(tx_len>0) {
+    tx_room=0;
+    if(!lnp_ev_run(&tx_room, REPLY_TIMEOUT+tx_len*BYTE_TIME))
+      break;
+  }
+}
+#endif
+
+/*! I/R write, queued behind the frames before it.
+ *! return 0 if OK, nonzero on error.
+ */
+int lnp_logical_write(const void *data, size_t length) {
+
+// With Win32 we are using Blocking Write by default
+#if !defined(_WIN32)
+  if(lnpd_fd>=0)
+    return lnpd_write(data, length);
+  if(length>sizeof(tx_buf))
+    return -1;
+
+  // wait for room in the queue
+  //
+  while(tx_len+length>sizeof(tx_buf)) {
+    tx_room=0;
+    if(!lnp_ev_run(&tx_room, REPLY_TIMEOUT+tx_len*BYTE_TIME))
+      return -1;
+  }
+
+  memcpy(tx_buf+tx_len, data, length);
+  tx_len+=length;
+  return tx_pump();
+#else
+  // transmit
+  //
+  keepaliveRenew();
+
+  return mywrite(rcxFD(), data, length)!=length;
+#endif
+}
+
+/*! blocking I/R write of a frame in segments.
+ *! the tower gets the frame in one piece, so it is gathered here.
+ *! return 0 if OK, nonzero on error.
+ */
+int lnp_logical_writev(const lnp_iovec_t *iov, unsigned char count) {
+  unsigned char buffer[2*256];
+  size_t length=0;
+
+  for(; count>0; iov++, count--) {
+    if(length+iov->len>sizeof(buffer))
+      return -1;
+    memcpy(buffer+length, iov->base, iov->len);
+    length+=iov->len;
+  }
+  return lnp_logical_write(buffer, length);
+}
+
+/*! a message from lnpd: a frame for the integrity layer, or the
+ *! answer for a port.
+ */
+static void lnpd_handler(int fd, int events, void *arg) {
+  unsigned char body[LNPD_MAX];
+  unsigned length,i;
+  int type;
+
+  type=lnpd_recv(lnpd_fd, body, &length);
+  if(type<0) {
+    fputs("lnpd closed the connection\n", stderr);
+    exit(1);
+  }
+  if(type==LNPD_BOUND && length==2 && body[1])
+    fprintf(stderr,"lnpd: port 0x%02x is taken by another program\n",body[0]);
+  if(type!=LNPD_FRAME)
+    return;
+
+  lnp_integrity_reset();
+  for(i=0; i<length; i++) {
+    if(verbose_flag)
+      fprintf(stderr,"%02x ",body[i]);
+    lnp_integrity_byte(body[i]);
+  }
+}
+
+#if !defined(_WIN32)
+/*! nothing came for a while, the next byte starts a new packet.
+ */
+static void rx_gap(void *arg) {
+  if(verbose_flag)
+    fputs("\n#gap ",stderr);
+  lnp_integrity_reset();
+}
+
+/*! the tower is readable or can take more.
+ */
+static void tower_io(int fd, int events, void *arg) {
+  if(events & LNP_EV_READ)
+    io_handler();
+  if((events & LNP_EV_WRITE) && tx_pump()) {
+    myperror("writing to the tower");
+    exit(1);
+  }
+}
+#endif
+
+void io_handler(void) {
+    unsigned char buffer[256];
+#if defined(_WIN32)
+    static struct timeval last={0,0};
+    struct timeval now;
+    unsigned long diff;
+    DWORD len=0;
+    int i;
+#else
+    int len,i;
+#endif
+
+#if !defined(_WIN32)
+    if(lnpd_fd>=0) {
+      lnpd_handler(lnpd_fd,LNP_EV_READ,NULL);
+      return;
+    }
+
+    len=read(rcxFD(),buffer,sizeof(buffer));
+    if(len<=0)
+      return;
+#else
+    gettimeofday(&now,0);
+    diff= 1000000*now .tv_sec + now .tv_usec - 
+	 (1000000*last.tv_sec + last.tv_usec);
+    
+    if(diff> 10000*LNP_BYTE_TIMEOUT) {
+      if(verbose_flag)
+        fprintf(stderr,"\n#time %lu ",diff);
+      lnp_integrity_reset();
+    }
+    // Remember, USB support only in WIN32 environments.
+    if (tty_usb == 0) {
+	ReadFile(rcxFD(), buffer, sizeof(buffer), &len, NULL);
+    } else {
+	struct timeval timeout, timenow;
+	unsigned long total, elapsed;
+	
+	gettimeofday(&timeout,0);
+	total = REPLY_TIMEOUT+(long)sizeof(buffer)*BYTE_TIME;
+	while(len == 0) {
+		ReadFile(rcxFD(), buffer, sizeof(buffer), &len, NULL);
+		gettimeofday(&timenow, 0);
+		// calculate elapsed time as usual
+		elapsed=1000000*(timenow.tv_sec - timeout.tv_sec ) + (timenow.tv_usec - timeout.tv_usec);
+		if(elapsed > total)
+			break;
+	}
+    }
+#endif
+    for(i=0; i<len; i++) {
+      if(verbose_flag)
+        fprintf(stderr,"%02x ",buffer[i]);
+      lnp_integrity_byte(buffer[i]);
+    }
+#if defined(_WIN32)
+    gettimeofday(&last,0);
+#else
+    lnp_ev_arm(&rx_timer,10000*LNP_BYTE_TIMEOUT,rx_gap,NULL);
+#endif
+}
+
+void LNPinit(const char *tty) {
+  struct timeval timeout,now;
+  long diff;
+
+#if !defined(_WIN32)
+  unsigned char buffer[256];
+#endif
+    
+  // or let lnpd do it
+  //
+  if (!strncmp(tty, LNPD_PREFIX, strlen(LNPD_PREFIX))) {
+    if (verbose_flag) fputs("connecting to lnpd...\n", stderr);
+    if ((lnpd_fd = lnpd_connect(tty + strlen(LNPD_PREFIX))) < 0) {
+      myperror("connecting to lnpd");
+      exit(1);
+    }
+    lnp_ev_watch(lnpd_fd, LNP_EV_READ, lnpd_handler, NULL);
+    return;
+  }
+
+  // initialize RCX communications
+  //
+  if (verbose_flag) fputs("opening tty...\n", stderr);
+#ifdef CONF_LNP_FAST
+  rcxInit(tty, 1);
+#else
+  rcxInit(tty, 0);
+#endif
+
+  if (rcxFD() == BADFILE) {
+    myperror("opening tty");
+    exit(1);
+  }
+
+#if defined(LINUX) || defined(linux)
+  if (tty_usb == 0) {
+#endif
+     
+  keepaliveInit();
+   
+  // wait for IR to settle
+  // 
+  gettimeofday(&timeout,0);
+  do {    
+    usleep(100000);
+    gettimeofday(&now,0);
+    diff=1000000*(now.tv_sec  - timeout.tv_sec ) +
+         	  now.tv_usec - timeout.tv_usec;
+      
+  } while(diff < 100000);
+#if defined(LINUX) || defined(linux)
+  }
+#endif
+#if defined(_WIN32)
+  PurgeComm(rcxFD(), PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR);
+#else
+#if defined(LINUX) || defined(linux)
+   if (tty_usb == 0)
+#endif
+  read(rcxFD(),buffer,256);
+
+  // from now on the event loop
+  //
+  fcntl(rcxFD(), F_SETFL, fcntl(rcxFD(), F_GETFL) | O_NONBLOCK);
+  lnp_ev_watch(rcxFD(), LNP_EV_READ, tower_io, NULL);
+  atexit(tx_flush);
+#endif
+}
+
+int lnp_wait(volatile int *flag, unsigned long usecs) {
+#if defined(_WIN32)
+  struct timeval timeout,now;
+  unsigned long elapsed=0;
+
+  gettimeofday(&timeout,0);
+  do {
+    io_handler();
+
+    gettimeofday(&now,0);
+    elapsed=1000000*(now.tv_sec  - timeout.tv_sec ) +
+                     now.tv_usec - timeout.tv_usec;
+
+  } while((!*flag) && (elapsed < usecs));
+
+  return *flag;
+#else
+  return lnp_ev_run(flag, usecs);
+#endif
+}
+
+char *lnp_tty(char *tty) {
+  if (!tty) tty = getenv(TTY_VARIABLE);
+  if (!tty) tty = DEFAULTTTY;
+  if (!strncmp(tty, LNPD_PREFIX, strlen(LNPD_PREFIX)))
+    return tty;
+
+  // Check if USB IR tower is selected.
+#if defined(_WIN32)
+  if (stricmp(tty, "usb")==0) {
+	tty_usb = 1;
+	if(verbose_flag)
+		fputs("\n\n Hary Mahesan - LEGO USB IR Tower Mode\n\n",stderr);
+	tty="\\\\.\\legotower1"; // Set the correct usb tower if you have more than one (unlikely).
+  }
+#elif defined(LINUX) || defined(linux)
+   /* If the tty string contains "usb", e.g. /dev/usb/lego0, we */
+   /* assume it is the USB tower.  /dev/usb/lego0 is the default name of */
+   /* the device in the LegoUSB (http://legousb.sourceforge.net) project. */
+   /* If yours doesn't contain the "usb" string, just link it. */
+   if (strstr(tty,"usb") !=0) {
+       tty_usb=1;
+       if (verbose_flag)
+          fputs("\nC.P. Chan & Tyler Akins - USB IR Tower Mode for Linux.\n",stderr);
+   }
+#endif
+
+  return tty;
+}
+
+/*! the time in ms, for the transport engine.
+ */
+static unsigned long lnp_msecs(void) {
+  struct timeval now;
+
+  gettimeofday(&now,0);
+  return 1000*now.tv_sec + now.tv_usec/1000;
+}
+
+/*! addressing layer handler of the transport ports.
+ */
+static void lnp_tp_handler(const unsigned char *data, unsigned char len,
+                           unsigned char src) {
+  lnp_tp_t *tp;
+
+  for(tp=lnp_tp_list; tp; tp=tp->next)
+    if(tp->peer==src) {
+      lnp_tp_input(tp,data,len,lnp_msecs());
+      lnp_tp_event=1;
+      break;
+    }
+}
+
+/*! transmit what the engine has to.
+ */
+static void lnp_tp_pump(lnp_tp_t *tp) {
+  unsigned char frame[2+LNP_TP_MTU];
+  int len;
+
+  while((len=lnp_tp_output(tp,frame,lnp_msecs()))>0)
+    lnp_addressing_write(frame,len,tp->peer,tp->port);
+}
+
+#if !defined(_WIN32)
+/*! the retransmit timer ran out.
+ */
+static void lnp_tp_expired(void *arg) {
+  lnp_tp_event=1;
+}
+#endif
+
+/*! handle input until a transport frame arrives, the retransmit
+ *! timer runs out, or a tenth of a second has passed.
+ */
+static void lnp_tp_poll(lnp_tp_t *tp) {
+  unsigned long usecs=100000;
+  long left;
+
+  lnp_tp_event=0;
+  if(tp->timer) {
+    left=(long) (tp->timer-lnp_msecs());
+#if defined(_WIN32)
+    if(left<=0)
+      usecs=0;
+    else if(1000*left<usecs)
+      usecs=1000*left;
+#else
+    lnp_ev_arm(&lnp_tp_timer, left>0 ? 1000*left : 0, lnp_tp_expired, NULL);
+#endif
+  }
+  lnp_wait(&lnp_tp_event,usecs);
+#if !defined(_WIN32)
+  lnp_ev_disarm(&lnp_tp_timer);
+#endif
+}
+
+int lnp_tp_open(lnp_tp_t *tp, unsigned char port, unsigned char peer,
+                unsigned char window, unsigned char size) {
+  unsigned char *buf;
+  lnp_tp_t *other;
+
+  if(size>LNP_TP_MTU)
+    return -1;
+  for(other=lnp_tp_list; other; other=other->next)
+    if(other->peer==peer)
+      return -1;
+  if(!window)
+    window=LNP_TP_WINDOW;
+  if((buf=malloc(LNP_TP_BUFSIZE(window,size)))==NULL)
+    return -1;
+
+  lnp_tp_init(tp,buf,window,size,(unsigned char) lnp_msecs());
+  tp->port=port & LNP_PORTMASK;
+  tp->peer=peer;
+  tp->next=lnp_tp_list;
+  lnp_tp_list=tp;
+  lnp_addressing_set_handler(tp->port,lnp_tp_handler);
+
+  return 0;
+}
+
+void lnp_tp_close(lnp_tp_t *tp) {
+  lnp_tp_t **link;
+
+  for(link=&lnp_tp_list; *link; link=&(*link)->next)
+    if(*link==tp) {
+      *link=tp->next;
+      break;
+    }
+  for(link=&lnp_tp_list; *link; link=&(*link)->next)
+    if((*link)->port==tp->port)
+      break;
+  if(!*link)
+    lnp_addressing_set_handler(tp->port,LNP_DUMMY_ADDRESSING);
+
+  free(tp->tx);
+}
+
+int lnp_tp_send(lnp_tp_t *tp, const void *data, unsigned char len) {
+  for(;;) {
+    lnp_tp_pump(tp);
+    if(lnp_tp_failed(tp))
+      return -1;
+    if(lnp_tp_space(tp))
+      break;
+    lnp_tp_poll(tp);
+  }
+
+  if(lnp_tp_queue(tp,data,len))
+    return -1;
+  lnp_tp_pump(tp);
+  return 0;
+}
+
+int lnp_tp_recv(lnp_tp_t *tp, void *buf) {
+  int len;
+
+  for(;;) {
+    lnp_tp_pump(tp);
+    if((len=lnp_tp_read(tp,buf))>=0) {
+      lnp_tp_pump(tp);			// window update
+      return len;
+    }
+    lnp_tp_poll(tp);
+  }
+}
+
+int lnp_tp_flush(lnp_tp_t *tp) {
+  for(;;) {
+    lnp_tp_pump(tp);
+    if(lnp_tp_done(tp))
+      return 0;
+    if(lnp_tp_failed(tp))
+      return -1;
+    lnp_tp_poll(tp);
+  }
+}
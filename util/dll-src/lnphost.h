@@ -0,0 +1,44 @@
+/*! \file   lnphost.h
+    \brief  LNP over the IR tower for the host utilities
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+#ifndef __lnphost_h__
+#define __lnphost_h__
+
+#define REPLY_TIMEOUT  750000 	  //!< timeout for reply
+#define BYTE_TIME      (1000*LNP_BYTE_TIME) //!< time to transmit a byte.
+
+extern int verbose_flag;	//!< dump received bytes to stderr
+extern int tty_usb;		//!< the tower is a USB tower
+
+//! pick the tower device
+/*! \param tty device from the command line, or NULL for $RCXTTY or
+               the default. sets tty_usb for USB towers.
+    \return the device to pass to LNPinit()
+*/
+char *lnp_tty(char *tty);
+
+//! open the tower and let the IR settle
+void LNPinit(const char *tty);
+
+//! read from the tower and feed the LNP integrity layer
+void io_handler(void);
+
+//! handle input until *flag is set or usecs have passed
+/*! \return the value of *flag
+*/
+int lnp_wait(volatile int *flag, unsigned long usecs);
+
+#endif // __lnphost_h__
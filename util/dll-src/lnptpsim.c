@@ -0,0 +1,246 @@
+/*! \file   lnptpsim.c
+    \brief  Measure the LNP transport's goodput over a simulated lossy link
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Runs two transport engines back to back on a simulated IR link and
+ *  prints the goodput of a transfer for each window size from 1, which
+ *  is stop-and-wait like dll, up to -w. The link is half duplex with
+ *  carrier sense, like the brick's logical layer: a frame takes its
+ *  bytes times the byte time, the sender may go on after LNP_WAIT_TXOK
+ *  while the other side has to wait LNP_BYTE_SAFE, and each frame is
+ *  lost with the given probability. The receiving side of a frame
+ *  answers no sooner than the reply delay, for the time a brick task
+ *  or the tower takes to turn around. Time is simulated in ms steps, so
+ *  the runs are quick and repeatable.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <sys/lnp.h>
+#include <sys/lnp-logical.h>
+#include <lnp-transport.h>
+
+#if (defined(__sun__) && defined(__svr4__)) || defined(BSD)	// Solaris||BSD
+#undef HAVE_GETOPT_LONG
+#else
+#define HAVE_GETOPT_LONG 1
+#endif
+
+#ifdef HAVE_GETOPT_LONG
+#include <getopt.h>
+
+static const struct option long_options[]={
+  {"bytes",  required_argument,0,'n'},
+  {"size",   required_argument,0,'s'},
+  {"window", required_argument,0,'w'},
+  {"loss",   required_argument,0,'l'},
+  {"seed",   required_argument,0,'x'},
+  {"delay",  required_argument,0,'d'},
+  {"verbose",no_argument      ,0,'v'},
+  {0        ,0                ,0,0  }
+};
+
+#else // HAVE_GETOPT_LONG
+
+#define getopt_long(ac, av, opt, lopt, lidx) (getopt((ac), (av), (opt)))
+
+#endif // HAVE_GETOPT_LONG
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define LNP_OVERHEAD	5	//!< f1, length, dest, src, checksum
+#define TIME_LIMIT	3600000	//!< give up after an hour of link time
+
+//! one end of the link
+typedef struct {
+  lnp_tp_t tp;			//!< its transport
+  unsigned char *buf;		//!< the transport's buffer
+  unsigned long allow;		//!< when it may transmit again
+} end_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned bytes=8192;	//!< bytes to transfer
+static unsigned char size=LNP_TP_MTU;	//!< payload per frame
+static double loss=0.1;		//!< probability of losing a frame
+static unsigned delay=50;	//!< ms before the receiving side may answer
+static int verbose_flag=0;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static void end_init(end_t *end,unsigned char window,unsigned char iss) {
+  end->buf=malloc(LNP_TP_BUFSIZE(window,size));
+  lnp_tp_init(&end->tp,end->buf,window,size,iss);
+  end->allow=0;
+}
+
+//! transfer the bytes from a to b with the given window
+/*! \return the link time it took in ms, 0 if the transport gave up
+*/
+static unsigned long run(unsigned char window,unsigned *frames,
+                         unsigned *resent) {
+  unsigned char frame[2+LNP_TP_MTU],data[LNP_TP_MTU];
+  unsigned queued=0,received=0,chunk;
+  unsigned long now,busy=0;
+  end_t ends[2],*from=NULL,*to;
+  int i,len=0;
+
+  end_init(ends,window,0x42);
+  end_init(ends+1,window,0x17);
+
+  for(now=0; now<TIME_LIMIT; now++) {
+    // the sender's and the receiver's program
+    //
+    while(queued<bytes && lnp_tp_space(&ends[0].tp)) {
+      chunk=bytes-queued<size ? bytes-queued : size;
+      memset(data,(unsigned char) queued,chunk);
+      lnp_tp_queue(&ends[0].tp,data,chunk);
+      queued+=chunk;
+    }
+    while((i=lnp_tp_read(&ends[1].tp,data))>=0)
+      received+=i;
+    if(queued==bytes && received==bytes && lnp_tp_done(&ends[0].tp))
+      break;
+    if(lnp_tp_failed(&ends[0].tp))
+      break;
+
+    // a frame on the air arrives, unless it's lost
+    //
+    if(from && now>=busy) {
+      to=from==ends ? ends+1 : ends;
+      if(rand()>=loss*RAND_MAX)
+        lnp_tp_input(&to->tp,frame,len,now);
+      else if(verbose_flag)
+        fprintf(stderr,"%7lu: lost %02x %02x\n",now,frame[0],frame[1]);
+
+      from->allow=now+LNP_WAIT_TXOK;
+      to->allow=now+(delay>LNP_BYTE_SAFE ? delay : LNP_BYTE_SAFE);
+      from=NULL;
+    }
+
+    // whoever may transmit first, the sender on ties
+    //
+    if(!from)
+      for(i=0; i<2; i++)
+        if(now>=ends[i].allow &&
+           (len=lnp_tp_output(&ends[i].tp,frame,now))>0) {
+          from=ends+i;
+          busy=now+(len+LNP_OVERHEAD)*LNP_BYTE_TIME;
+          break;
+        }
+  }
+
+  *frames=ends[0].tp.frames;
+  *resent=ends[0].tp.resent;
+  free(ends[0].buf);
+  free(ends[1].buf);
+
+  return received==bytes && lnp_tp_done(&ends[0].tp) ? now : 0;
+}
+
+static void usage(const char *progname) {
+  char *usage_string =
+	"Options:\n"
+	"  -n<bytes>    , --bytes=<bytes>       transfer <bytes> (8192)\n"
+	"  -s<size>     , --size=<size>         payload per frame (251)\n"
+	"  -w<window>   , --window=<window>     largest window to try (16)\n"
+	"  -l<percent>  , --loss=<percent>      frames lost (10)\n"
+	"  -x<seed>     , --seed=<seed>         random seed for the losses\n"
+	"  -d<ms>       , --delay=<ms>          reply delay (50)\n"
+	"  -v           , --verbose             print lost frames\n"
+	"\n"
+	;
+
+  fprintf(stderr,"usage: %s [options]\n",progname);
+  fputs(usage_string,stderr);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  unsigned window,max_window=LNP_TP_WINDOW_MAX,frames,resent,seed=1;
+  unsigned long ms;
+  int opt;
+#ifdef HAVE_GETOPT_LONG
+  int option_index;
+#endif
+
+  while((opt=getopt_long(argc, argv, "n:s:w:l:x:d:v",
+                        (struct option *)long_options, &option_index) )!=-1) {
+    switch(opt) {
+      case 'n':
+        bytes=atoi(optarg);
+        break;
+      case 's':
+        size=atoi(optarg);
+        if(size<1 || size>LNP_TP_MTU)
+          usage(argv[0]);
+        break;
+      case 'w':
+        max_window=atoi(optarg);
+        if(max_window<1 || max_window>LNP_TP_WINDOW_MAX)
+          usage(argv[0]);
+        break;
+      case 'l':
+        loss=atof(optarg)/100;
+        break;
+      case 'x':
+        seed=atoi(optarg);
+        break;
+      case 'd':
+        delay=atoi(optarg);
+        break;
+      case 'v':
+        verbose_flag=1;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(optind<argc)
+    usage(argv[0]);
+
+  printf("%u bytes, %u per frame, %.0f%% loss, %u ms per byte, "
+         "%u ms reply delay\n",
+         bytes,size,100*loss,(unsigned) LNP_BYTE_TIME,delay);
+  printf("window  time/ms  bytes/s  frames  resent\n");
+
+  for(window=1; window<=max_window; window<<=1) {
+    srand(seed);
+    ms=run(window,&frames,&resent);
+    if(ms)
+      printf("%6u %8lu %8.1f %7u %7u\n",
+             window,ms,1000.0*bytes/ms,frames,resent);
+    else
+      printf("%6u   failed\n",window);
+  }
+
+  return 0;
+}
@@ -80,12 +80,13 @@
 
 #include "rcxtty.h"
 #include "keepalive.h"
+#include "lnphost.h"
 #include <lx.h>
 
 #define MAX_DATA_CHUNK 0xf8   	  //!< maximum data bytes/packet for boot protocol
 #define XMIT_RETRIES   5      	  //!< number of packet transmit retries
-#define REPLY_TIMEOUT  750000 	  //!< timeout for reply
-#define BYTE_TIME      (1000*LNP_BYTE_TIME) //!< time to transmit a byte.
+#define WINDOW_MAX     16     	  //!< maximum data packets in flight
+#define DEFAULT_WINDOW 4      	  //!< data packets in flight, 1=stop-and-wait
 
 #define PROG_MIN	1
 #define PROG_MAX	8
@@ -107,9 +108,27 @@ typedef enum {
   CMDrun,     	      	//!< 1+ 1: b[nr]
   CMDirmode,			//!< 1+ 1: b[0=near/1=far]
   CMDsethost,			//!< 1+ 1: b[hostaddr]
+  CMDprofile,			//!< 1+>1: see rcxprof.c
+  CMDtrace,			//!< 1+>1: see rcxtrace.c
+  CMDwindow,			//!< 1+>3: b[nr|PROG_ACK] s[offset] array[data]
+  CMDsums,			//!< 1+ 3: b[nr] s[first block]
+  CMDpatch,			//!< 1+>3: b[nr] s[offset] array[data]
+  CMDcommit,			//!< 1+ 8: b[nr] s[stacksize] s[start] s[crc] b[prio]
+  CMDmulticast,			//!< 1+>19: b[nr] s[base] s[offset] array[b[relocs]] array[data]
+  CMDmissing,			//!< 1+ 1: b[nr]
   CMDlast     	      	//!< ?
 } packet_cmd_t;
 
+#define PROG_ACK	0x80	//!< CMDwindow: acknowledge with bytes downloaded
+#define PROG_LZSS	0x40	//!< CMDwindow: the data are LZSS tokens
+
+#define PROG_BLOCK	64	//!< CMDsums: bytes of the image per checksum
+#define PROG_SUMS	120	//!< CMDsums: max. checksums per reply
+
+#define PROG_CHUNK	0xe0	//!< CMDmulticast: bytes per chunk
+#define PROG_RELOCS	(PROG_CHUNK/16)	//!< CMDmulticast: bitmap of the words to relocate
+#define PROG_CHUNKS	((0x10000+PROG_CHUNK-1)/PROG_CHUNK)	//!< at most
+
 #if (defined(__sun__) && defined(__svr4__)) || defined(BSD)	// Solaris||BSD
 #undef HAVE_GETOPT_LONG
 #else
@@ -121,12 +140,17 @@ typedef enum {
 
 static const struct option long_options[]={
   {"rcxaddr",required_argument,0,'r'},
+  {"batch",  required_argument,0,'b'},
   {"program",required_argument,0,'p'},
   {"delete", required_argument,0,'d'},
   {"srcport",required_argument,0,'s'},
   {"tty",    required_argument,0,'t'},
   {"irmode", required_argument,0,'i'},
   {"node"  , required_argument,0,'n'},
+  {"window", required_argument,0,'w'},
+  {"compress",no_argument     ,0,'z'},
+  {"update", no_argument      ,0,'u'},
+  {"multicast",no_argument    ,0,'m'},
   {"execute",no_argument      ,0,'e'},
   {"verbose",no_argument      ,0,'v'},
   {0        ,0                ,0,0  }
@@ -142,87 +166,41 @@ volatile int receivedAck=0;
 
 volatile unsigned short relocate_to=0;
 
+volatile int downloaded=-1;	//!< bytes downloaded from a CMDwindow ack
+
+volatile int receivedSums=0;
+volatile int sums_first=-1;	//!< first block of the last CMDsums reply
+unsigned short slot_text,	//!< the program in the slot, from CMDsums
+               slot_text_size,
+               slot_data_size,
+               slot_bss_size,
+               slot_sums[0x10000/PROG_BLOCK];
+
 unsigned int  rcxaddr = DEFAULT_DEST,
               prog    = DEFAULT_PROGRAM,
               srcport = DEFAULT_SRCPORT,
               hostaddr = DEFAULT_DEST,
-		  irmode  = -1;
+		  irmode  = -1,
+              window  = DEFAULT_WINDOW;
   
 int run_flag=0;
-int verbose_flag=0;
-int tty_usb=0;
 int pdelete_flag=0;
 int hostaddr_flag=0;
-
-void io_handler(void);
-
-/*! blocking I/R write.
- *! return number of bytes written, or negative for error.
- */
-int lnp_logical_write(const void *data, size_t length) {
-
-// With Win32 we are using Blocking Write by default
-#if !defined(_WIN32)
-  fd_set fds;
-
-  // wait for transmission
-  //
-  do {
-    FD_ZERO(&fds);
-    FD_SET(rcxFD(),&fds);
-  } while(select(rcxFD()+1,NULL,&fds,NULL,NULL)<1);
-#endif
-
-  // transmit
-  //
-#if defined(LINUX) || defined(linux)
-   if (tty_usb == 0)
-#endif
-  keepaliveRenew();
-
-  return mywrite(rcxFD(), data, length)!=length;
-}
-
+int compress_flag=0;
+int update_flag=0;
+int multicast_flag=0;
 //! send a LNP layer 0 packet of given length
 /*! \return 0 on success.
 */
 int lnp_assured_write(const unsigned char *data, unsigned char length,
                       unsigned char dest, unsigned char srcport) {
   int i;
-  struct timeval timeout,now;
-  unsigned long total,elapsed;
   
   for(i=0; i<XMIT_RETRIES; i++) {
     receivedAck=0;
     
     lnp_addressing_write(data,length,dest,srcport);
-    
-    gettimeofday(&timeout,0);
-    total=REPLY_TIMEOUT+length*BYTE_TIME;
-    elapsed=0;
-
-    do {
-#if defined(_WIN32)
-      io_handler();
-#else
-      struct timeval tv;
-      fd_set fds;
-
-      FD_ZERO(&fds);
-      FD_SET(rcxFD(), &fds);
-
-      tv.tv_sec = (total - elapsed) / 1000000;
-      tv.tv_usec = (total - elapsed) % 1000000;
-      select(rcxFD() + 1, &fds, NULL, NULL, &tv);
-      if (FD_ISSET(rcxFD(), &fds))
-	io_handler();
-#endif
- 
-      gettimeofday(&now,0);
-      elapsed=1000000*(now.tv_sec  - timeout.tv_sec ) +
-	       	       now.tv_usec - timeout.tv_usec;
-      
-    } while((!receivedAck) && (elapsed < total));
+    lnp_wait(&receivedAck,REPLY_TIMEOUT+length*BYTE_TIME);
     
     if(i || !receivedAck)
       if(verbose_flag)
@@ -235,133 +213,278 @@ int lnp_assured_write(const unsigned char *data, unsigned char length,
   return -1;
 }
 
-void io_handler(void) {
-  
-    static struct timeval last={0,0};
-    struct timeval now;
-    unsigned long diff;
-    
-    unsigned char buffer[256];
-#if defined(_WIN32)
-    DWORD len=0;
-    int i;
-#else
-    int len,i;
-#endif
-    
-    gettimeofday(&now,0);
-    diff= 1000000*now .tv_sec + now .tv_usec - 
-	 (1000000*last.tv_sec + last.tv_usec);
+void ahandler(const unsigned char *data,unsigned char len,unsigned char src) {
+  if(*data==CMDsums && len>=12) {
+    unsigned first=(data[10]<<8)|data[11], i;
+
+    slot_text     =(data[2]<<8)|data[3];
+    slot_text_size=(data[4]<<8)|data[5];
+    slot_data_size=(data[6]<<8)|data[7];
+    slot_bss_size =(data[8]<<8)|data[9];
+    for(i=0; 12+2*i+1<len && first+i<0x10000/PROG_BLOCK; i++)
+      slot_sums[first+i]=(data[12+2*i]<<8)|data[13+2*i];
+    sums_first=first;
+    receivedSums=1;
+  } else if(*data==CMDacknowledge) {
+    receivedAck=1;
+    if(len==8) {
+      // offset packet
+      //
+      relocate_to=(data[2]<<8)|data[3];
+    } else if(len==4) {
+      // window acknowledgement
+      //
+      downloaded=(data[2]<<8)|data[3];
+    }
+  }
+}
     
-    if(diff> 10000*LNP_BYTE_TIMEOUT) {
-      if(verbose_flag)
-        fprintf(stderr,"\n#time %lu ",diff);
-      lnp_integrity_reset();
+//! send a burst of CMDwindow chunks from offset *i on
+/*! \param flags PROG_LZSS to send compressed chunks
+    \param ack to ask for an acknowledgement with the last chunk
+    \param i advanced past the chunks sent
+    \return bytes sent
+*/
+size_t window_burst(const lx_t *lx,unsigned nr,unsigned char flags,size_t *i,
+                    unsigned burst,int ack,unsigned char dest) {
+  unsigned char buffer[256+3];
+  size_t burstSize=0,totalSize=lx->text_size+lx->data_size;
+  unsigned n,chunkSize,chunkLength;
+
+  buffer[0]=CMDwindow;
+
+  for(n=0; n<burst && *i<totalSize; *i+=chunkSize,n++) {
+    if(flags & PROG_LZSS)
+      chunkLength=lx_compress(lx,*i,buffer+4,MAX_DATA_CHUNK,&chunkSize);
+    else {
+      chunkSize=totalSize-*i;
+      if(chunkSize>MAX_DATA_CHUNK)
+        chunkSize=MAX_DATA_CHUNK;
+      memcpy(buffer+4,lx->text + *i,chunkSize);
+      chunkLength=chunkSize;
     }
-#if defined(_WIN32)
-    // Remember, USB support only in WIN32 environments.
-    if (tty_usb == 0) {
-	ReadFile(rcxFD(), buffer, sizeof(buffer), &len, NULL);
+
+    buffer[1]=(nr-1) | flags;
+    if(ack && (n==burst-1 || *i+chunkSize==totalSize))
+      buffer[1]|=PROG_ACK;
+    buffer[2]= *i >> 8;
+    buffer[3]= *i &  0xff;
+    lnp_addressing_write(buffer,chunkLength+4,dest,srcport);
+    burstSize+=chunkLength+4;
+  }
+  return burstSize;
+}
+
+//! download with up to window data packets in flight
+/*! the brick takes chunks in order only and acknowledges the last of
+    each burst with the bytes downloaded, the next burst starts there.
+    the first burst is a single chunk, as a brick that doesn't know
+    CMDwindow or compression never answers.
+    \param flags PROG_LZSS to send compressed chunks
+    \return bytes downloaded
+*/
+size_t lnp_window_download(const lx_t *lx,unsigned char flags) {
+  size_t i,acked=0,burstSize,totalSize=lx->text_size+lx->data_size;
+  unsigned burst=1,tries=0;
+
+  while(acked<totalSize) {
+    receivedAck=0;
+    downloaded=-1;
+
+    i=acked;
+    burstSize=window_burst(lx,prog,flags,&i,burst,1,rcxaddr);
+    lnp_wait(&receivedAck,REPLY_TIMEOUT+burstSize*BYTE_TIME);
+
+    if(downloaded>(int) acked) {
+      acked=downloaded;
+      burst=window;
+      tries=0;
     } else {
-	struct timeval timeout, timenow;
-	unsigned long total, elapsed;
-	
-	gettimeofday(&timeout,0);
-	total = REPLY_TIMEOUT+(long)sizeof(buffer)*BYTE_TIME;
-	while(len == 0) {
-		ReadFile(rcxFD(), buffer, sizeof(buffer), &len, NULL);
-		gettimeofday(&timenow, 0);
-		// calculate elapsed time as usual
-		elapsed=1000000*(timenow.tv_sec - timeout.tv_sec ) + (timenow.tv_usec - timeout.tv_usec);
-		if(elapsed > total)
-			break;
-	}
-    }
-#else
-    len=read(rcxFD(),buffer,sizeof(buffer));
-#endif
-    for(i=0; i<len; i++) {
       if(verbose_flag)
-        fprintf(stderr,"%02x ",buffer[i]);
-      lnp_integrity_byte(buffer[i]);
+        fprintf(stderr,"try %u: offset:%u ack:%d\n",tries,(unsigned) acked,
+                downloaded);
+      if(++tries>=XMIT_RETRIES)
+        break;
     }
-    gettimeofday(&last,0);
-}
+  }
 
-void LNPinit(const char *tty) {
-  struct timeval timeout,now;
-  long diff;
+  return acked;
+}
 
-#if !defined(_WIN32)
-  unsigned char buffer[256];
-#endif
-    
-  // initialize RCX communications
-  //
-  if (verbose_flag) fputs("opening tty...\n", stderr);
-#ifdef CONF_LNP_FAST
-  rcxInit(tty, 1);
-#else
-  rcxInit(tty, 0);
-#endif
+//! CRC-16 (CCITT) of a part of the image, as the brick's CMDsums
+unsigned short image_crc(const unsigned char *data,size_t length) {
+  unsigned crc=0xffff,bit;
 
-  if (rcxFD() == BADFILE) {
-    myperror("opening tty");
-    exit(1);
+  while(length--) {
+    crc^=*data++<<8;
+    for(bit=0; bit<8; bit++)
+      crc=(crc & 0x8000) ? (crc<<1)^0x1021 : crc<<1;
+    crc&=0xffff;
   }
+  return crc;
+}
 
-#if defined(LINUX) || defined(linux)
-  if (tty_usb == 0) {
-#endif
-     
-  keepaliveInit();
-   
-  // wait for IR to settle
-  // 
-  gettimeofday(&timeout,0);
-  do {    
-    usleep(100000);
-    gettimeofday(&now,0);
-    diff=1000000*(now.tv_sec  - timeout.tv_sec ) +
-         	  now.tv_usec - timeout.tv_usec;
-      
-  } while(diff < 100000);
-#if defined(LINUX) || defined(linux)
+//! query the checksums of the program in the slot from block first on
+/*! \return 0 on success.
+*/
+int lnp_sums(unsigned first) {
+  unsigned char buffer[4];
+  int i;
+
+  buffer[0]=CMDsums;
+  buffer[1]=prog-1;
+  buffer[2]=first >> 8;
+  buffer[3]=first &  0xff;
+
+  for(i=0; i<XMIT_RETRIES; i++) {
+    receivedSums=0;
+    sums_first=-1;
+
+    lnp_addressing_write(buffer,4,rcxaddr,srcport);
+    lnp_wait(&receivedSums,REPLY_TIMEOUT+(12+2*PROG_SUMS)*BYTE_TIME);
+
+    if(sums_first==first)
+      return 0;
+    if(verbose_flag)
+      fprintf(stderr,"try %d: sums:%d\n",i,receivedSums);
   }
-#endif
-#if defined(_WIN32)
-  PurgeComm(rcxFD(), PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR);
-#else
-#if defined(LINUX) || defined(linux)
-   if (tty_usb == 0)
-#endif
-  read(rcxFD(),buffer,256);
-#endif
+  return -1;
 }
-    
-void ahandler(const unsigned char *data,unsigned char len,unsigned char src) {
-  if(*data==CMDacknowledge) {
-    receivedAck=1;
-    if(len==8) {
-      // offset packet
-      //
-      relocate_to=(data[2]<<8)|data[3];
+
+//! update the program in its slot, sending only the blocks that changed
+/*! the slot must hold a program with segments of the same sizes, the
+    new one is relocated to where it is. the brick checks the whole
+    image before the program may run again.
+    \return 0 if updated, -1 if it needs a full download
+*/
+int lnp_update(lx_t *lx) {
+  unsigned char buffer[256+3];
+  size_t size=lx->text_size+lx->data_size,offset,end,chunkSize,sent=0;
+  unsigned block,blocks=(size+PROG_BLOCK-1)/PROG_BLOCK;
+  unsigned short crc;
+
+  if(verbose_flag)
+    fputs("\nsums ",stderr);
+  if(lnp_sums(0))
+    return -1;
+  if(slot_text_size!=lx->text_size || slot_data_size!=lx->data_size ||
+     slot_bss_size!=lx->bss_size) {
+    if(verbose_flag)
+      fputs("segment sizes differ, full download\n",stderr);
+    return -1;
+  }
+  for(block=PROG_SUMS; block<blocks; block+=PROG_SUMS)
+    if(lnp_sums(block))
+      return -1;
+
+  lx_relocate(lx,slot_text);
+
+  // send each run of changed blocks
+  //
+  if(verbose_flag)
+    fputs("\npatch ",stderr);
+  buffer[0]=CMDpatch;
+  buffer[1]=prog-1;
+
+  for(block=0; block<blocks; ) {
+    for(offset=block*PROG_BLOCK; block<blocks; block++) {
+      end=(block+1)*PROG_BLOCK<size ? (block+1)*PROG_BLOCK : size;
+      if(image_crc(lx->text+block*PROG_BLOCK,end-block*PROG_BLOCK)==
+         slot_sums[block])
+        break;
+    }
+    end=block*PROG_BLOCK<size ? block*PROG_BLOCK : size;
+    block++;
+
+    for(; offset<end; offset+=chunkSize) {
+      chunkSize=end-offset;
+      if(chunkSize>MAX_DATA_CHUNK)
+        chunkSize=MAX_DATA_CHUNK;
+
+      buffer[2]=offset >> 8;
+      buffer[3]=offset &  0xff;
+      memcpy(buffer+4,lx->text+offset,chunkSize);
+      if(lnp_assured_write(buffer,chunkSize+4,rcxaddr,srcport))
+        return -1;
+      sent+=chunkSize;
     }
   }
+
+  if(verbose_flag)
+    fprintf(stderr,"%u of %u bytes\ncommit ",(unsigned) sent,(unsigned) size);
+  crc=image_crc(lx->text,size);
+  buffer[0]=CMDcommit;
+  buffer[1]=prog-1;
+  buffer[2]=lx->stack_size>>8;
+  buffer[3]=lx->stack_size & 0xff;
+  buffer[4]=lx->offset >> 8;
+  buffer[5]=lx->offset & 0xff;
+  buffer[6]=crc >> 8;
+  buffer[7]=crc & 0xff;
+  buffer[8]=DEFAULT_PRIORITY;
+  if(lnp_assured_write(buffer,9,rcxaddr,srcport))
+    return -1;
+
+  return 0;
 }
-    
+
+//! start the program
+/*! \return 0 on success.
+*/
+int lnp_run(void) {
+  unsigned char buffer[2];
+
+  if(verbose_flag)
+    fputs("\nrun ",stderr);
+  buffer[0]=CMDrun;
+  buffer[1]=prog-1; //       prog 0
+  if(lnp_assured_write(buffer,2,rcxaddr,srcport)) {
+    fputs("error running program\n",stderr);
+    return -1;
+  }
+  return 0;
+}
+
+//! the CMDcreate packet of a program, 13 bytes
+void create_command(unsigned char *buffer,const lx_t *lx,unsigned nr) {
+  buffer[ 0]=CMDcreate;
+  buffer[ 1]=nr-1; //       prog 0
+  buffer[ 2]=lx->text_size>>8;
+  buffer[ 3]=lx->text_size & 0xff;
+  buffer[ 4]=lx->data_size>>8;
+  buffer[ 5]=lx->data_size & 0xff;
+  buffer[ 6]=lx->bss_size>>8;
+  buffer[ 7]=lx->bss_size & 0xff;
+  buffer[ 8]=lx->stack_size>>8;
+  buffer[ 9]=lx->stack_size & 0xff;
+  buffer[10]=lx->offset >> 8;  	// start offset from text segment
+  buffer[11]=lx->offset & 0xff; 
+  buffer[12]=DEFAULT_PRIORITY;
+}
+
 void lnp_download(const lx_t *lx) {
   unsigned char buffer[256+3];
   
-  size_t i,chunkSize,totalSize=lx->text_size+lx->data_size;
+  size_t i=0,chunkSize,totalSize=lx->text_size+lx->data_size;
 
   if(verbose_flag)
     fputs("\ndata ",stderr);
 
+  if(compress_flag) {
+    i=lnp_window_download(lx,PROG_LZSS);
+    if(!i && verbose_flag)
+      fputs("no compressed download acknowledgement\n",stderr);
+  }
+  if(!i && window>1) {
+    i=lnp_window_download(lx,0);
+    if(!i && verbose_flag)
+      fputs("no window acknowledgement, stop-and-wait\n",stderr);
+  }
+
   buffer[0]=CMDdata;
   buffer[1]=prog-1;
 
-  for(i=0; i<totalSize; i+=chunkSize) {
+  for(; i<totalSize; i+=chunkSize) {
     chunkSize=totalSize-i;
     if(chunkSize>MAX_DATA_CHUNK)
       chunkSize=MAX_DATA_CHUNK;
@@ -376,6 +499,496 @@ void lnp_download(const lx_t *lx) {
   }
 }
 
+//! what a brick of a fleet download does next
+typedef enum {
+  STEPirmode,
+  STEPdelete,
+  STEPcreate,
+  STEPdata,
+  STEPrun,
+  STEPdone
+} step_t;
+
+const char *step_names[]={ "irmode", "delete", "create", "data", "run", "done" };
+
+//! how a brick of a fleet download takes the program
+typedef enum {
+  MODElzss,     	      	//!< CMDwindow, compressed
+  MODEwindow,   	      	//!< CMDwindow
+  MODEdata      	      	//!< CMDdata, stop-and-wait
+} data_mode_t;
+
+//! a brick of a fleet download
+typedef struct {
+  unsigned addr;      	      	//!< its host address, as rcxaddr
+  unsigned prog;      	      	//!< the program slot
+  const char *filename;
+  lx_t lx;    	      	      	//!< relocated for this brick
+  step_t step;
+  int failed; 	      	      	//!< gave up at step
+  data_mode_t mode;
+  size_t acked;       	      	//!< bytes of the program it has
+  size_t sent;        	      	//!< bytes of the program sent, CMDwindow
+  unsigned inflight;  	      	//!< CMDwindow chunks since the last ack
+  unsigned burst;     	      	//!< CMDwindow chunks it may have in flight
+  unsigned tries;
+  volatile int answered;
+  volatile int downloaded;    	//!< from a CMDwindow ack
+  volatile unsigned short relocate_to;
+  int parked; 	      	      	//!< waits for the multicast
+  int polled; 	      	      	//!< answered CMDmissing before
+  volatile int chunks;	      	//!< from a CMDmissing answer
+  unsigned multicast; 	      	//!< CMDmulticast chunks it has
+  unsigned char missing[(PROG_CHUNKS+7)/8];
+} brick_t;
+
+#define FLEET_MAX	(ADDR_MAX+1)	//!< one brick per host address
+
+brick_t fleet[FLEET_MAX];
+unsigned fleet_size=0;
+
+//! add a brick to the fleet
+/*! \return 0 on success.
+*/
+int fleet_add(unsigned addr,unsigned nr,const char *filename) {
+  brick_t *b=fleet+fleet_size;
+  unsigned i;
+
+  if (addr > ADDR_MAX) {
+    fprintf(stderr, "LNP host address not in range 0..15\n");
+    return -1;
+  }
+  if (nr > PROG_MAX || nr < PROG_MIN) {
+    fprintf(stderr, "Program not in range 1..8\n");
+    return -1;
+  }
+  addr = (addr << 4) & CONF_LNP_HOSTMASK;
+  for(i=0; i<fleet_size; i++)
+    if(fleet[i].addr==addr) {
+      fprintf(stderr, "RCX host address %u given twice\n", addr >> 4);
+      return -1;
+    }
+
+  memset(b,0,sizeof(*b));
+  if(lx_read(&b->lx,(const unsigned char *) filename)) {
+    fprintf(stderr,"unable to load brickOS executable from %s.\n",filename);
+    return -1;
+  }
+  b->addr=addr;
+  b->prog=nr;
+  b->filename=strdup(filename);
+  b->step=irmode!=-1 ? STEPirmode : STEPdelete;
+  fleet_size++;
+  return 0;
+}
+
+//! add the bricks of a batch file, lines of <rcxaddr> <prognum> <file.lx>
+/*! empty lines and lines starting with # are skipped.
+    \return 0 on success.
+*/
+int fleet_batch(const char *name) {
+  char line[512],filename[512],*p;
+  unsigned addr,nr,lineno=0;
+  FILE *f;
+
+  if((f=strcmp(name,"-") ? fopen(name,"r") : stdin)==NULL) {
+    perror(name);
+    return -1;
+  }
+  while(fgets(line,sizeof(line),f)) {
+    lineno++;
+    for(p=line; *p==' ' || *p=='\t'; p++)
+      ;
+    if(*p=='#' || *p=='\n' || *p=='\r' || !*p)
+      continue;
+    if(sscanf(p,"%u %u %511s",&addr,&nr,filename)!=3) {
+      fprintf(stderr,"%s:%u: expected <rcxaddr> <prognum> <file.lx>\n",
+              name,lineno);
+      return -1;
+    }
+    if(fleet_add(addr,nr,filename))
+      return -1;
+  }
+  if(f!=stdin)
+    fclose(f);
+  return 0;
+}
+
+//! answers of the bricks of a fleet, told apart by their address
+void fleet_handler(const unsigned char *data,unsigned char len,
+                   unsigned char src) {
+  unsigned i,n;
+
+  if(*data!=CMDacknowledge && (*data!=CMDmissing || len<4))
+    return;
+  for(i=0; i<fleet_size; i++)
+    if(fleet[i].addr==(src & LNP_HOSTMASK)) {
+      if(*data==CMDmissing) {
+        n=len-4<sizeof(fleet[i].missing) ? len-4 : sizeof(fleet[i].missing);
+        memcpy(fleet[i].missing,data+4,n);
+        fleet[i].chunks=(data[2]<<8)|data[3];
+      } else if(len==8)
+        fleet[i].relocate_to=(data[2]<<8)|data[3];
+      else if(len==4)
+        fleet[i].downloaded=(data[2]<<8)|data[3];
+      fleet[i].answered=1;
+      break;
+    }
+}
+
+//! send a brick the CMDwindow chunks its window has room for
+/*! \param ask to ask for an acknowledgement with the last chunk, or
+           with an empty one if there is no room
+    \return bytes sent
+*/
+size_t fleet_stream(brick_t *b,int ask) {
+  unsigned char buffer[4],flags=b->mode==MODElzss ? PROG_LZSS : 0;
+  size_t length=0,totalSize=b->lx.text_size+b->lx.data_size;
+  int asked=0;
+
+  while(b->inflight<b->burst && b->sent<totalSize) {
+    asked=ask && b->inflight+1==b->burst;
+    length+=window_burst(&b->lx,b->prog,flags,&b->sent,1,asked,b->addr);
+    b->inflight++;
+  }
+
+  if(ask && !asked) {
+    buffer[0]=CMDwindow;
+    buffer[1]=(b->prog-1) | PROG_ACK;
+    buffer[2]=b->sent >> 8;
+    buffer[3]=b->sent &  0xff;
+    lnp_addressing_write(buffer,4,b->addr,srcport);
+    length+=4;
+  }
+  return length;
+}
+
+//! send a brick what its step needs, asking for an answer
+/*! \return bytes sent
+*/
+size_t fleet_ask(brick_t *b) {
+  unsigned char buffer[256+3];
+  size_t length=2,chunkSize,totalSize=b->lx.text_size+b->lx.data_size;
+
+  b->answered=0;
+  b->downloaded=-1;
+  buffer[1]=b->prog-1;
+
+  switch(b->step) {
+    case STEPirmode:
+      buffer[0]=CMDirmode;
+      buffer[1]=irmode;
+      break;
+    case STEPdelete:
+      buffer[0]=CMDdelete;
+      break;
+    case STEPcreate:
+      create_command(buffer,&b->lx,b->prog);
+      length=13;
+      break;
+    case STEPdata:
+      if(b->mode!=MODEdata)
+        return fleet_stream(b,1);
+      chunkSize=totalSize-b->acked;
+      if(chunkSize>MAX_DATA_CHUNK)
+        chunkSize=MAX_DATA_CHUNK;
+      buffer[0]=CMDdata;
+      buffer[2]=b->acked >> 8;
+      buffer[3]=b->acked &  0xff;
+      memcpy(buffer+4,b->lx.text + b->acked,chunkSize);
+      length=chunkSize+4;
+      break;
+    case STEPrun:
+      buffer[0]=CMDrun;
+      break;
+    default:
+      return 0;
+  }
+  lnp_addressing_write(buffer,length,b->addr,srcport);
+  return length;
+}
+
+//! a brick didn't answer, or its chunks got nowhere
+/*! after XMIT_RETRIES tries a download falls back as lnp_download()
+    does, anything else fails.
+*/
+void fleet_late(brick_t *b) {
+  if(verbose_flag)
+    fprintf(stderr,"\nrcx %u %s: try %u\n",b->addr >> 4,step_names[b->step],
+            b->tries);
+  if(++b->tries<XMIT_RETRIES)
+    return;
+
+  b->tries=0;
+  if(b->step==STEPdata && b->mode==MODElzss && !b->acked && window>1) {
+    b->mode=MODEwindow;
+    b->sent=0;
+    b->inflight=0;
+    b->burst=1;
+  } else if(b->step==STEPdata && b->mode!=MODEdata)
+    b->mode=MODEdata;
+  else
+    b->failed=1;
+}
+
+//! a brick answered, on to what comes next
+void fleet_next(brick_t *b) {
+  size_t chunkSize,totalSize=b->lx.text_size+b->lx.data_size;
+
+  switch(b->step) {
+    case STEPirmode:
+    case STEPdelete:
+      b->step++;
+      break;
+    case STEPcreate:
+      lx_relocate(&b->lx,b->relocate_to);
+      b->step=STEPdata;
+      b->mode=compress_flag ? MODElzss : window>1 ? MODEwindow : MODEdata;
+      b->acked=b->sent=0;
+      b->inflight=0;
+      b->burst=1;
+      b->parked=multicast_flag;
+      b->multicast=0;
+      break;
+    case STEPdata:
+      if(b->mode==MODEdata) {
+        chunkSize=totalSize-b->acked;
+        b->acked+=chunkSize>MAX_DATA_CHUNK ? MAX_DATA_CHUNK : chunkSize;
+      } else {
+        // all its chunks went before the question, so what it doesn't
+        // have is lost. the window goes on from there.
+        //
+        if(b->downloaded<0) {
+          fleet_late(b);
+          return;
+        }
+        b->sent=b->downloaded;
+        b->inflight=0;
+        if(b->downloaded<=(int) b->acked) {
+          fleet_late(b);
+          return;
+        }
+        b->acked=b->downloaded;
+        b->burst=window;
+      }
+      if(b->acked>=totalSize)
+        b->step=run_flag ? STEPrun : STEPdone;
+      break;
+    case STEPrun:
+      b->step=STEPdone;
+      break;
+    default:
+      break;
+  }
+  b->tries=0;
+}
+
+//! one line of how far each brick is
+void fleet_progress(void) {
+  brick_t *b;
+
+  fputc('\r',stderr);
+  for(b=fleet; b<fleet+fleet_size; b++)
+    if(b->failed)
+      fprintf(stderr," %u:failed",b->addr >> 4);
+    else if(b->step==STEPdata && b->parked)
+      fprintf(stderr," %u:%u%%",b->addr >> 4,(unsigned) (100*b->multicast/
+              ((b->lx.text_size+b->lx.data_size+PROG_CHUNK-1)/PROG_CHUNK)));
+    else if(b->step==STEPdata)
+      fprintf(stderr," %u:%u%%",b->addr >> 4,(unsigned) (100*b->acked/
+              (b->lx.text_size+b->lx.data_size)));
+    else
+      fprintf(stderr," %u:%s",b->addr >> 4,step_names[b->step]);
+}
+
+//! bricks that take the same program into the same slot
+static int fleet_group(const brick_t *a,const brick_t *b) {
+  return b->parked && !b->failed && a->prog==b->prog &&
+         !strcmp(a->filename,b->filename);
+}
+
+//! ask a brick which CMDmulticast chunks it misses, and add them to want
+/*! \param length bytes sent before the question
+    \return 0 if it answered
+*/
+int multicast_poll(brick_t *b,unsigned char *want,size_t length) {
+  size_t totalSize=b->lx.text_size+b->lx.data_size;
+  unsigned chunks=(totalSize+PROG_CHUNK-1)/PROG_CHUNK,chunk,missed=0,i;
+  unsigned char buffer[2];
+
+  buffer[0]=CMDmissing;
+  buffer[1]=b->prog-1;
+  for(i=0; i<XMIT_RETRIES; i++, length=0) {
+    b->answered=0;
+    b->chunks=-1;
+    lnp_addressing_write(buffer,2,b->addr,srcport);
+    lnp_wait(&b->answered,REPLY_TIMEOUT+(length+2)*BYTE_TIME);
+    if(b->chunks==(int) chunks)
+      break;
+    if(verbose_flag)
+      fprintf(stderr,"\nrcx %u missing: try %u\n",b->addr >> 4,i);
+  }
+  if(i==XMIT_RETRIES)
+    return -1;
+
+  b->polled=1;
+  for(chunk=0; chunk<chunks; chunk++)
+    if(b->missing[chunk/8] & (1<<(chunk%8))) {
+      want[chunk/8]|=1<<(chunk%8);
+      missed++;
+    }
+  b->multicast=chunks-missed;
+  if(!missed) {
+    b->acked=totalSize;
+    b->parked=0;
+    b->step=run_flag ? STEPrun : STEPdone;
+  }
+  return 0;
+}
+
+//! a brick takes the program on its own after all
+/*! the chunks it has from the multicast are scattered, and the brick
+    counts a download from offset 0 on, so it starts over.
+*/
+static void multicast_unpark(brick_t *b) {
+  b->parked=0;
+  b->acked=b->sent=0;
+  b->inflight=0;
+  b->burst=1;
+}
+
+//! multicast the program to a group of bricks waiting for it
+/*! each chunk goes once to LNP_BROADCAST, relocated for the first
+    brick and with a bitmap of the words the others relocate to their
+    own address. then the bricks are asked in turn which chunks they
+    miss, and those missed by any go again. a
+    brick that never answers has a kernel without
+    CONF_PROGRAM_MULTICAST and takes the program as if not parked, as
+    do all that still miss chunks after XMIT_RETRIES rounds without
+    progress.
+*/
+void multicast_group(brick_t *lead) {
+  unsigned char want[(PROG_CHUNKS+7)/8],relocs[0x10000/16];
+  unsigned char buffer[6+PROG_RELOCS+PROG_CHUNK];
+  size_t totalSize=lead->lx.text_size+lead->lx.data_size,offset,chunkSize;
+  unsigned chunks=(totalSize+PROG_CHUNK-1)/PROG_CHUNK,chunk;
+  unsigned wanted=chunks,last,tries=0,i;
+  unsigned long length;
+  brick_t *b;
+
+  // relocations are words, and words are even on the H8/300, so a
+  // chunk holds its words whole. a program with an odd one isn't
+  // multicast.
+  //
+  memset(relocs,0,sizeof(relocs));
+  for(i=0; i<lead->lx.num_relocs; i++) {
+    if(lead->lx.reloc[i] & 1)
+      wanted=0;
+    relocs[lead->lx.reloc[i]/16]|=1<<(lead->lx.reloc[i]/2%8);
+  }
+
+  memset(want,0xff,sizeof(want));
+  buffer[0]=CMDmulticast;
+  buffer[1]=lead->prog-1;
+  buffer[2]=lead->lx.base >> 8;
+  buffer[3]=lead->lx.base &  0xff;
+
+  while(wanted && tries<XMIT_RETRIES) {
+    length=0;
+    for(chunk=0; chunk<chunks; chunk++)
+      if(want[chunk/8] & (1<<(chunk%8))) {
+        offset=chunk*PROG_CHUNK;
+        chunkSize=totalSize-offset;
+        if(chunkSize>PROG_CHUNK)
+          chunkSize=PROG_CHUNK;
+        buffer[4]=offset >> 8;
+        buffer[5]=offset &  0xff;
+        memcpy(buffer+6,relocs+offset/16,PROG_RELOCS);
+        memcpy(buffer+6+PROG_RELOCS,lead->lx.text+offset,chunkSize);
+        lnp_addressing_write(buffer,6+PROG_RELOCS+chunkSize,LNP_BROADCAST,
+                             srcport);
+        length+=6+PROG_RELOCS+chunkSize;
+      }
+
+    memset(want,0,sizeof(want));
+    for(b=lead; b<fleet+fleet_size; b++)
+      if(fleet_group(lead,b)) {
+        if(multicast_poll(b,want,length) && !b->polled)
+          multicast_unpark(b);
+        length=0;
+      }
+    fleet_progress();
+
+    last=wanted;
+    for(wanted=chunk=0; chunk<chunks; chunk++)
+      wanted+=(want[chunk/8] >> (chunk%8)) & 1;
+    tries=wanted<last ? 0 : tries+1;
+  }
+
+  for(b=lead; b<fleet+fleet_size; b++)
+    if(fleet_group(lead,b))
+      multicast_unpark(b);
+}
+
+//! download to all bricks of the fleet at once
+/*! a brick sends its answer once, right when the air is free, so only
+    one brick may be asked a question at a time, or the answers
+    collide. in each round the bricks downloading get the chunks their
+    windows have room for without being asked, and the brick whose
+    turn it is gets its question last. so the IR link carries the
+    others' chunks instead of being idle for each answer. with
+    --multicast the bricks wait after CMDcreate until all are there,
+    and get the program by multicast_group().
+    \return the number of bricks that failed
+*/
+unsigned fleet_download(void) {
+  unsigned long length;
+  unsigned failed=0,turn=0,n;
+  brick_t *b,*asker;
+
+  lnp_addressing_set_handler(0,fleet_handler);
+
+  for(;;) {
+    for(n=0; n<fleet_size; n++) {
+      asker=fleet+(turn+n)%fleet_size;
+      if(!asker->failed && asker->step!=STEPdone && !asker->parked)
+        break;
+    }
+    if(n==fleet_size) {
+      for(b=fleet; b<fleet+fleet_size; b++)
+        if(b->parked && !b->failed)
+          break;
+      if(b==fleet+fleet_size)
+        break;
+      multicast_group(b);
+      continue;
+    }
+    turn=asker-fleet+1;
+
+    length=0;
+    for(b=fleet; b<fleet+fleet_size; b++)
+      if(b!=asker && !b->failed && b->step==STEPdata && !b->parked &&
+         b->mode!=MODEdata)
+        length+=fleet_stream(b,0);
+    length+=fleet_ask(asker);
+
+    lnp_wait(&asker->answered,REPLY_TIMEOUT+length*BYTE_TIME);
+    if(asker->answered)
+      fleet_next(asker);
+    else
+      fleet_late(asker);
+    fleet_progress();
+  }
+
+  fputc('\n',stderr);
+  for(b=fleet; b<fleet+fleet_size; b++) {
+    fprintf(stderr,"rcx %u P%u %s: %s%s\n",b->addr >> 4,b->prog,b->filename,
+            b->failed ? "failed at " : "",step_names[b->step]);
+    failed+=b->failed;
+  }
+  return failed;
+}
+
 int main(int argc, char **argv) {
   lx_t lx;    	    // the brickOS executable
   char *filename;
@@ -384,15 +997,20 @@ int main(int argc, char **argv) {
   int option_index;
 #endif
   unsigned char buffer[256+3]="";
-  char *tty=NULL;
+  char *tty=NULL, *batch=NULL, *addrs=NULL, *next;
+  unsigned addr;
 
-  while((opt=getopt_long(argc, argv, "r:p:d:s:t:i:n:ev",
+  while((opt=getopt_long(argc, argv, "r:b:p:d:s:t:i:n:w:zumev",
                         (struct option *)long_options, &option_index) )!=-1) {
     switch(opt) {
       case 'e':
         run_flag=1;
         break;
       case 'r':
+        if (strchr(optarg, ',')) {
+          addrs=optarg;		// several bricks, see below
+          break;
+        }
         sscanf(optarg,"%d",&rcxaddr);
 		if (rcxaddr > ADDR_MAX || rcxaddr < ADDR_MIN) {
 			fprintf(stderr, "LNP host address not in range 0..15\n");
@@ -400,6 +1018,9 @@ int main(int argc, char **argv) {
 		}
 		rcxaddr = (rcxaddr << 4) & CONF_LNP_HOSTMASK;
         break;
+      case 'b':
+        batch=optarg;
+        break;
       case 'p':
         sscanf(optarg,"%d",&prog);
         break;
@@ -428,6 +1049,22 @@ int main(int argc, char **argv) {
 		}
         hostaddr_flag=1;
         break;
+      case 'w':
+        sscanf(optarg,"%d",&window);
+		if (window > WINDOW_MAX || window < 1) {
+			fprintf(stderr, "Window not in range 1..%d\n", WINDOW_MAX);
+			return -1;
+		}
+        break;
+      case 'z':
+        compress_flag=1;
+        break;
+      case 'u':
+        update_flag=1;
+        break;
+      case 'm':
+        multicast_flag=1;
+        break;
       case 'v':
         verbose_flag=1;
         break;
@@ -441,13 +1078,19 @@ int main(int argc, char **argv) {
 
   // load executable
   //      
-  if(((argc-optind < 1) && !(pdelete_flag || hostaddr_flag)) ||
-	 ((argc-optind > 0 ) && (pdelete_flag || hostaddr_flag)))
+  if(((argc-optind < 1) && !(pdelete_flag || hostaddr_flag || batch)) ||
+	 ((argc-optind > 0 ) && (pdelete_flag || hostaddr_flag || batch)))
   {
     char *usage_string =
 	"Options:\n"
 	"  -p<prognum>  , --program=<prognum>   set destination program to <prognum>\n"
 	"  -r<rcxaddr>  , --rcxaddr=<rcxaddr>   send to RCX host address <rcxaddr>\n"
+	"  -r<a>,<b>,.. , --rcxaddr=<a>,<b>,..  send to several RCX at once\n"
+	"  -b<file>     , --batch=<file>        send to the RCX listed in <file> at\n"
+	"                                       once, lines of <rcxaddr> <prognum>\n"
+	"                                       <file.lx>\n"
+	"  -m           , --multicast           send each program once to all the\n"
+	"                                       RCX taking it, then what they missed\n"
 	"  -s<srcport>  , --srcport=<srcport>   send to RCX source port <srcport>\n"
 	"  -t<comport>  , --tty=<comport>       set IR Tower com port <comport>\n"
 #if defined(_WIN32)
@@ -456,6 +1099,10 @@ int main(int argc, char **argv) {
         "                                       (if \"usb\" is in the port, use USB mode)\n"
 #endif
 	"  -i<0/1>      , --irmode=<0/1>        set IR mode near(0)/far(1) on RCX\n"
+	"  -w<packets>  , --window=<packets>    data packets in flight (4), 1=stop-and-wait\n"
+	"  -z           , --compress            send the program LZSS compressed\n"
+	"  -u           , --update              send only what changed since the\n"
+	"                                       last download to the program slot\n"
 	"  -e           , --execute             execute program after download\n"
 	"  -v           , --verbose             verbose mode\n"
 	"\nCommands:\n"
@@ -474,8 +1121,34 @@ int main(int argc, char **argv) {
     return -1;
   }
 
+  // several bricks at once
+  //
+  if (batch || addrs) {
+    if (pdelete_flag || hostaddr_flag || update_flag) {
+      fputs("-d, -n and -u work on one RCX only\n", stderr);
+      return -1;
+    }
+    if (batch && addrs) {
+      fputs("either -b or several -r addresses\n", stderr);
+      return -1;
+    }
+    if (batch && fleet_batch(batch))
+      return -1;
+    for (next=addrs; next; next=strchr(next, ',')) {
+      if (*next==',')
+        next++;
+      if (sscanf(next, "%u", &addr)!=1 || fleet_add(addr, prog, argv[optind]))
+        return -1;
+    }
+  }
+
+  if (multicast_flag && !fleet_size) {
+    fputs("-m needs -b or several -r addresses\n", stderr);
+    return -1;
+  }
+
   // Ignore filename if -dn or -na given
-  if (!(pdelete_flag || hostaddr_flag)) {
+  if (!(pdelete_flag || hostaddr_flag || fleet_size)) {
     filename=argv[optind++];
     if(lx_read(&lx,filename)) {
       fprintf(stderr,"unable to load brickOS executable from %s.\n",filename);
@@ -485,28 +1158,7 @@ int main(int argc, char **argv) {
 
   // Moved tty device setting for a new option on command line
   if (buffer[0]) tty=buffer;
-  if (!tty) tty = getenv(TTY_VARIABLE);
-  if (!tty) tty = DEFAULTTTY;
-
-  // Check if USB IR tower is selected.
-#if defined(_WIN32)
-  if (stricmp(tty, "usb")==0) {
-	tty_usb = 1;
-	if(verbose_flag)
-		fputs("\n\n Hary Mahesan - LEGO USB IR Tower Mode\n\n",stderr);
-	tty="\\\\.\\legotower1"; // Set the correct usb tower if you have more than one (unlikely).
-  }
-#elif defined(LINUX) || defined(linux)
-   /* If the tty string contains "usb", e.g. /dev/usb/lego0, we */
-   /* assume it is the USB tower.  /dev/usb/lego0 is the default name of */
-   /* the device in the LegoUSB (http://legousb.sourceforge.net) project. */
-   /* If yours doesn't contain the "usb" string, just link it. */
-   if (strstr(tty,"usb") !=0) {
-       tty_usb=1;
-       if (verbose_flag)
-          fputs("\nC.P. Chan & Tyler Akins - USB IR Tower Mode for Linux.\n",stderr);
-   }
-#endif
+  tty = lnp_tty(tty);
 
   LNPinit(tty);
 
@@ -515,6 +1167,9 @@ int main(int argc, char **argv) {
 
   lnp_addressing_set_handler(0,ahandler);
 
+  if (fleet_size)
+    return fleet_download() ? -1 : 0;
+
   if(verbose_flag)  
     fprintf(stderr,"loader hostaddr=0x%02x hostmask=0x%02x portmask=0x%02x\n",
             rcxaddr & 0x00ff, LNP_HOSTMASK & 0x00ff, srcport & 0x00ff);
@@ -543,6 +1198,13 @@ int main(int argc, char **argv) {
 	return 0;
   }
   
+  // patch the program in its slot if only some blocks changed
+  //
+  if (update_flag && !pdelete_flag && !lnp_update(&lx)) {
+    fprintf(stderr, "\n");
+    return run_flag ? lnp_run() : 0;
+  }
+
   if(verbose_flag)
     fputs("\ndelete",stderr);
   buffer[0]=CMDdelete;
@@ -560,19 +1222,7 @@ int main(int argc, char **argv) {
 
   if(verbose_flag)
     fputs("\ncreate ",stderr);
-  buffer[ 0]=CMDcreate;
-  buffer[ 1]=prog-1; //       prog 0
-  buffer[ 2]=lx.text_size>>8;
-  buffer[ 3]=lx.text_size & 0xff;
-  buffer[ 4]=lx.data_size>>8;
-  buffer[ 5]=lx.data_size & 0xff;
-  buffer[ 6]=lx.bss_size>>8;
-  buffer[ 7]=lx.bss_size & 0xff;
-  buffer[ 8]=lx.stack_size>>8;
-  buffer[ 9]=lx.stack_size & 0xff;
-  buffer[10]=lx.offset >> 8;  	// start offset from text segment
-  buffer[11]=lx.offset & 0xff; 
-  buffer[12]=DEFAULT_PRIORITY;
+  create_command(buffer,&lx,prog);
   if(lnp_assured_write(buffer,13,rcxaddr,srcport)) {
     fputs("error creating program\n",stderr);
     return -1;
@@ -586,16 +1236,8 @@ int main(int argc, char **argv) {
 
   fprintf(stderr, "\n");
 
-  if (run_flag) {
-    if(verbose_flag)
-      fputs("\nrun ",stderr);
-    buffer[0]=CMDrun;
-    buffer[1]=prog-1; //       prog 0
-    if(lnp_assured_write(buffer,2,rcxaddr,srcport)) {
-      fputs("error running program\n",stderr);
-      return -1;
-    }
-  }
+  if (run_flag)
+    return lnp_run();
       
   return 0;
 }
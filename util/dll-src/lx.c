@@ -33,6 +33,7 @@
 #include <string.h>
 
 #include <lx.h>
+#include <lzss.h>
 
 
 #define ASSURED_WRITE(fd,buf,len) \
@@ -48,6 +49,51 @@
   }
   
   
+unsigned lx_compress(const lx_t *lx,unsigned pos,unsigned char *dst,
+                     unsigned max,unsigned *len) {
+  const unsigned char *text=lx->text;
+  unsigned size=lx->text_size + lx->data_size, start=pos, out=0, flag=0;
+  unsigned i,n,low,best,distance,need;
+  int bit=8;
+
+  while(pos<size) {
+    // find the longest match, the nearest one of its length
+    //
+    low=pos>LZSS_WINDOW ? pos-LZSS_WINDOW : 0;
+    best=distance=0;
+    for(i=pos; i-- > low && best<LZSS_MAX; ) {
+      for(n=0; n<LZSS_MAX && pos+n<size && text[i+n]==text[pos+n]; n++)
+        ;
+      if(n>best) {
+        best=n;
+        distance=pos-i;
+      }
+    }
+
+    need=(bit==8) + (best>=LZSS_MIN ? 2 : 1);
+    if(out+need>max)
+      break;
+    if(bit==8) {
+      flag=out++;
+      dst[flag]=0;
+      bit=0;
+    }
+
+    if(best>=LZSS_MIN) {
+      dst[out++]=((best-LZSS_MIN)<<4) | ((distance-1)>>8);
+      dst[out++]=(distance-1) & 0xff;
+      pos+=best;
+    } else {
+      dst[flag]|=1<<bit;
+      dst[out++]=text[pos++];
+    }
+    bit++;
+  }
+
+  *len=pos-start;
+  return out;
+}
+
 int lx_write(const lx_t *lx,const unsigned char *filename) {
 #if defined(_WIN32)
   int i,rc,fd=open(filename,O_WRONLY | O_CREAT | O_TRUNC | O_BINARY,S_IRUSR | S_IWUSR | S_IRGRP);
@@ -55,10 +101,27 @@ int lx_write(const lx_t *lx,const unsigned char *filename) {
   int i,rc,fd=creat(filename,S_IRUSR | S_IWUSR | S_IRGRP);
 #endif
   unsigned short tmp;
+  unsigned size=lx->text_size + lx->data_size, len, zsize=0;
+  unsigned char *ztext=NULL;
   
   if(fd<0)
     return fd;
 
+  // compress program text, at worst it grows by a flag byte per 8 bytes
+  //
+  if(lx->version==LX_VERSION_LZSS) {
+    if((ztext=malloc(size+size/8+1))==NULL) {
+      close(fd);
+      return -1;
+    }
+    zsize=lx_compress(lx,0,ztext,size+size/8+1,&len);
+    if(len!=size || zsize>0xffff) {
+      free(ztext);
+      close(fd);
+      return -1;
+    }
+  }
+
   // write ID
   //
   ASSURED_WRITE(fd,"brickOS",8);
@@ -71,7 +134,13 @@ int lx_write(const lx_t *lx,const unsigned char *filename) {
 
   // write program text (is MSB, because H8 is MSB)
   //
-  ASSURED_WRITE(fd,lx->text,lx->text_size + lx->data_size);
+  if(ztext) {
+    tmp=htons(zsize);
+    ASSURED_WRITE(fd,&tmp,2);
+    ASSURED_WRITE(fd,ztext,zsize);
+    free(ztext);
+  } else
+    ASSURED_WRITE(fd,lx->text,size);
   
   // write relocation data in MSB
   //
@@ -92,6 +161,8 @@ int lx_read(lx_t *lx,const unsigned char *filename) {
 #endif
   unsigned char buffer[8];
   unsigned short tmp;
+  unsigned size;
+  unsigned char *ztext;
     
   if(fd<0)
     return fd;
@@ -110,14 +181,40 @@ int lx_read(lx_t *lx,const unsigned char *filename) {
     ASSURED_READ(fd,&tmp,2);
     ((unsigned short*)lx)[i]= ntohs(tmp);
   }
+  if(lx->version>LX_VERSION_LZSS) {
+    close(fd);
+    return -1;
+  }
+  size=lx->text_size + lx->data_size;
   
   // read program text (is MSB, because H8 is MSB)
   //
-  if((lx->text=malloc(lx->text_size + lx->data_size))==0) {
+  if((lx->text=malloc(size))==0) {
     close(fd);
     return -1;
   }
-  ASSURED_READ(fd,lx->text,lx->text_size + lx->data_size);
+  if(lx->version==LX_VERSION_LZSS) {
+    if((rc=read(fd,&tmp,2))!=2) {
+      free(lx->text);
+      close(fd);
+      return -1;
+    }
+    tmp=ntohs(tmp);
+    if((ztext=malloc(tmp))==0) {
+      free(lx->text);
+      close(fd);
+      return -1;
+    }
+    if((rc=read(fd,ztext,tmp))!=tmp ||
+       lzss_decode(lx->text,0,size,ztext,tmp)!=size) {
+      free(ztext);
+      free(lx->text);
+      close(fd);
+      return -1;
+    }
+    free(ztext);
+  } else
+    ASSURED_READ(fd,lx->text,size);
 
   // read relocation data in MSB
   //
@@ -28,6 +28,10 @@
 
 #define HEADER_FIELDS 8       //!< number of header fields stored on disk
 
+#define LX_VERSION      0     //!< text and data stored as they are
+#define LX_VERSION_LZSS 1     //!< text and data stored LZSS compressed,
+                              //!< preceded by their compressed size
+
 typedef struct {
   unsigned short version;     //!< version number
   unsigned short base;        //!< current text segment base address
@@ -53,5 +57,13 @@ int lx_read(lx_t *lx,const unsigned char *filename);
 //! relocate a BrickOS executable to a new base address (may be called repeatedly).
 void lx_relocate(lx_t *lx,unsigned short base);
 
+//! LZSS compress text and data from pos on into at most max bytes of tokens
+/*! matches reach back before pos, as the RCX expands the chunks in order.
+    \param len is set to the bytes of text and data compressed
+    \return bytes of tokens
+*/
+unsigned lx_compress(const lx_t *lx,unsigned pos,unsigned char *dst,
+                     unsigned max,unsigned *len);
+
 #endif // __lx_h__
 
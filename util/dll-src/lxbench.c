@@ -0,0 +1,200 @@
+/*! \file   lxbench.c
+    \brief  Measure how well brickOS executables compress for download
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  For each executable, prints the size of text and data, their size
+ *  LZSS compressed as makelx -z stores them and the ratio, then the
+ *  data packets dll sends plain and compressed and the time they take
+ *  on the air with their acknowledgements, stop-and-wait. The tokens
+ *  are what the kernel's decoder works through: a flag byte per 8,
+ *  literals copied and matches expanded. The states the decoder takes
+ *  on the RCX come from h8sim -z, see the demo Makefile's bench target.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <sys/lnp-logical.h>
+#include <lzss.h>
+#include <lx.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define MAX_DATA_CHUNK	0xf8	//!< data bytes per packet, as dll's
+#define LNP_OVERHEAD	5	//!< f1, length, dest, src, checksum
+#define CMD_OVERHEAD	4	//!< command, program, offset
+#define ACK_PLAIN	1	//!< CMDacknowledge
+#define ACK_WINDOW	4	//!< CMDacknowledge, program, bytes expanded
+
+//! what a download takes
+typedef struct {
+  unsigned packets;		//!< data packets
+  unsigned long bytes;		//!< bytes on the air, both ways
+  unsigned flags;		//!< flag bytes
+  unsigned literals;		//!< literal tokens
+  unsigned matches;		//!< match tokens
+} cost_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static int verbose_flag=0;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! count the tokens of a chunk
+static void count_tokens(cost_t *cost,const unsigned char *src,unsigned len) {
+  const unsigned char *end=src+len;
+  unsigned flags=0;
+
+  while(src<end) {
+    flags>>=1;
+    if(!(flags & 0x100)) {
+      flags=*src++ | 0xff00;
+      cost->flags++;
+      if(src==end)
+        break;
+    }
+    if(flags & 1) {
+      cost->literals++;
+      src++;
+    } else {
+      cost->matches++;
+      src+=2;
+    }
+  }
+}
+
+//! the packets of a compressed download, checked by expanding them
+/*! \return 0 if they expand to the program
+*/
+static int lzss_download(const lx_t *lx,cost_t *cost) {
+  unsigned char chunk[MAX_DATA_CHUNK], *text;
+  unsigned pos, size=lx->text_size+lx->data_size, len, n;
+  int expanded;
+
+  if((text=malloc(size+1))==NULL)
+    return -1;
+
+  for(pos=0; pos<size; pos+=len) {
+    n=lx_compress(lx,pos,chunk,MAX_DATA_CHUNK,&len);
+    count_tokens(cost,chunk,n);
+    cost->packets++;
+    cost->bytes+=n+CMD_OVERHEAD+LNP_OVERHEAD + ACK_WINDOW+LNP_OVERHEAD;
+
+    expanded=lzss_decode(text+pos,pos,size-pos,chunk,n);
+    if(expanded!=(int) len || !len)
+      break;
+    if(verbose_flag)
+      fprintf(stderr,"  0x%04x: %3u -> %4u\n",pos,n,len);
+  }
+
+  n=pos==size && !memcmp(text,lx->text,size);
+  free(text);
+  return n ? 0 : -1;
+}
+
+static void usage(const char *progname) {
+  fprintf(stderr,"usage: %s [-v] file.lx ...\n"
+          "  -v           , --verbose             print each packet\n",
+          progname);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  lx_t lx;
+  cost_t plain,lzss;
+  unsigned size,zsize,len;
+  unsigned char *ztext;
+  int opt,status=0;
+
+  while((opt=getopt(argc, argv, "v"))!=-1) {
+    switch(opt) {
+      case 'v':
+        verbose_flag=1;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(optind==argc)
+    usage(argv[0]);
+
+  printf("%u ms per byte, stop-and-wait\n",(unsigned) LNP_BYTE_TIME);
+  printf("%-20s %6s %6s %6s %7s %7s %8s %8s %6s %6s %7s\n",
+         "program","bytes","lzss","ratio","packets","lzss","time/s","lzss",
+         "flags","liter.","matches");
+
+  for(; optind<argc; optind++) {
+    if(lx_read(&lx,(const unsigned char *) argv[optind])) {
+      fprintf(stderr,"unable to load brickOS executable from %s.\n",
+              argv[optind]);
+      status=1;
+      continue;
+    }
+    size=lx.text_size+lx.data_size;
+
+    // the whole image, as makelx -z stores it
+    //
+    if((ztext=malloc(size+size/8+1))==NULL) {
+      fputs("out of memory\n",stderr);
+      return 1;
+    }
+    zsize=lx_compress(&lx,0,ztext,size+size/8+1,&len);
+    free(ztext);
+
+    // the download, plain and compressed
+    //
+    memset(&plain,0,sizeof(plain));
+    plain.packets=(size+MAX_DATA_CHUNK-1)/MAX_DATA_CHUNK;
+    plain.bytes=size+plain.packets*
+      (CMD_OVERHEAD+LNP_OVERHEAD + ACK_PLAIN+LNP_OVERHEAD);
+
+    if(verbose_flag)
+      fprintf(stderr,"%s:\n",argv[optind]);
+    memset(&lzss,0,sizeof(lzss));
+    if(lzss_download(&lx,&lzss)) {
+      fprintf(stderr,"%s: compressed packets don't expand to the program\n",
+              argv[optind]);
+      status=1;
+    }
+
+    printf("%-20s %6u %6u %5.1f%% %7u %7u %8.1f %8.1f %6u %6u %7u\n",
+           argv[optind],size,zsize,size ? 100.0*zsize/size : 0.0,
+           plain.packets,lzss.packets,
+           plain.bytes*LNP_BYTE_TIME/1000.0,lzss.bytes*LNP_BYTE_TIME/1000.0,
+           lzss.flags,lzss.literals,lzss.matches);
+
+    free(lx.text);
+    if(lx.num_relocs)
+      free(lx.reloc);
+  }
+
+  return status;
+}
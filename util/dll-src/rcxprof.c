@@ -0,0 +1,477 @@
+/*! \file   rcxprof.c
+    \brief  Read the kernel's PC sampling profile over LNP
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Talks to a kernel built with CONF_PROFILE: starts sampling, stops
+ *  it and reads the histogram, then prints a flat profile. Bins are
+ *  split between the symbols they overlap. Kernel bins are looked up
+ *  in brickOS.map, program bins in the program's map moved from the
+ *  .lx link base to where the kernel loaded the text.
+ *
+ *  For an untethered run, start with -B, let the robot go, then read
+ *  with -R.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <sys/lnp.h>
+#include <sys/lnp-logical.h>
+
+#include "rcxtty.h"
+#include "lnphost.h"
+#include <lx.h>
+
+#if (defined(__sun__) && defined(__svr4__)) || defined(BSD)	// Solaris||BSD
+#undef HAVE_GETOPT_LONG
+#else
+#define HAVE_GETOPT_LONG 1
+#endif
+
+#ifdef HAVE_GETOPT_LONG
+#include <getopt.h>
+
+static const struct option long_options[]={
+  {"rcxaddr",required_argument,0,'r'},
+  {"srcport",required_argument,0,'s'},
+  {"tty",    required_argument,0,'t'},
+  {"shift",  required_argument,0,'g'},
+  {"time",   required_argument,0,'d'},
+  {"begin",  no_argument      ,0,'B'},
+  {"read",   no_argument      ,0,'R'},
+  {"verbose",no_argument      ,0,'v'},
+  {0        ,0                ,0,0  }
+};
+
+#else // HAVE_GETOPT_LONG
+
+#define getopt_long(ac, av, opt, lopt, lidx) (getopt((ac), (av), (opt)))
+
+#endif // HAVE_GETOPT_LONG
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define XMIT_RETRIES	5	//!< number of packet transmit retries
+#define CMDprofile	8	//!< program port command (sys/program.h)
+
+#define RANGE_MAX	10	//!< kernel .text, .text.hi, 8 programs
+#define RANGE_PROGRAM	2	//!< range id of program 0
+#define PROG_MAX	8
+
+#define DEFAULT_SHIFT	4	//!< 16 bytes per bin
+#define DEFAULT_TIME	10	//!< seconds to sample
+
+//! profiler commands (sys/profile.h)
+typedef enum {
+  PROFstart,
+  PROFstop,
+  PROFread,
+  PROFdata,
+  PROFend
+} profile_cmd_t;
+
+//! a text range of the histogram
+typedef struct {
+  unsigned id,base,size,bin;
+} range_t;
+
+//! a code symbol
+typedef struct {
+  unsigned long addr;
+  char *name;
+  double samples;
+} symbol_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned rcxaddr=0, srcport=0;
+
+static volatile int received;           //!< reply to the last command
+static unsigned long samples;           //!< from PROFstop / PROFend
+static unsigned shift, nranges, nbins;
+static range_t ranges[RANGE_MAX];
+
+static unsigned *bins;                  //!< the histogram
+static unsigned char *have;             //!< bins received
+
+static symbol_t *symbols;
+static int nsymbols;
+
+static const char *prog_lx[PROG_MAX];   //!< program files by number
+static const char *prog_map[PROG_MAX];
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned word(const unsigned char *p) {
+  return (p[0]<<8) | p[1];
+}
+
+//! addressing layer handler for the replies
+static void phandler(const unsigned char *data,unsigned char len,
+                     unsigned char src) {
+  unsigned i,bin;
+
+  if(len<2 || data[0]!=CMDprofile)
+    return;
+
+  switch(data[1]) {
+    case PROFstart:
+    case PROFstop:
+      if(len<10)
+        return;
+      samples=((unsigned long) word(data+2)<<16) | word(data+4);
+      shift  =data[6];
+      nranges=data[7];
+      nbins  =word(data+8);
+      if(nranges>RANGE_MAX || len<10+7*nranges)
+        return;
+      for(i=0; i<nranges; i++) {
+        const unsigned char *r=data+10+7*i;
+
+        ranges[i].id  =r[0];
+        ranges[i].base=word(r+1);
+        ranges[i].size=word(r+3);
+        ranges[i].bin =word(r+5);
+      }
+      received=1;
+      break;
+
+    case PROFdata:
+      if(len<4 || !bins)
+        return;
+      bin=word(data+2);
+      for(i=4; i+1<len && bin<nbins; i+=2, bin++) {
+        bins[bin]=word(data+i);
+        have[bin]=1;
+      }
+      break;
+
+    case PROFend:
+      if(len<8)
+        return;
+      samples=((unsigned long) word(data+4)<<16) | word(data+6);
+      received=1;
+      break;
+  }
+}
+
+//! send a command and wait for its reply
+/*! \return 0 on success.
+*/
+static int command(const unsigned char *data,unsigned char length) {
+  int i;
+
+  for(i=0; i<XMIT_RETRIES; i++) {
+    received=0;
+    lnp_addressing_write(data,length,rcxaddr,srcport);
+    if(lnp_wait(&received,REPLY_TIMEOUT+length*BYTE_TIME))
+      return 0;
+    if(verbose_flag)
+      fprintf(stderr,"try %d: no reply\n",i);
+  }
+  return -1;
+}
+
+//! read the histogram, asking again for lost bins
+/*! \return 0 on success.
+*/
+static int read_bins(void) {
+  unsigned char buffer[4];
+  unsigned first=0;
+  int i;
+
+  bins=calloc(nbins+1,sizeof(unsigned));
+  have=calloc(nbins+1,1);
+  if(!bins || !have) {
+    fputs("out of memory\n",stderr);
+    exit(1);
+  }
+
+  for(i=0; i<XMIT_RETRIES; i++) {
+    buffer[0]=CMDprofile;
+    buffer[1]=PROFread;
+    buffer[2]=first>>8;
+    buffer[3]=first & 0xff;
+    received=0;
+    lnp_addressing_write(buffer,4,rcxaddr,srcport);
+
+    // a packet of 120 bins is on the air for about 1/4 sec.
+    //
+    lnp_wait(&received,REPLY_TIMEOUT+(nbins-first+4)*2*BYTE_TIME);
+
+    while(first<nbins && have[first])
+      first++;
+    if(first==nbins && received)
+      return 0;
+    if(verbose_flag)
+      fprintf(stderr,"try %d: missing bins from %u\n",i,first);
+  }
+  return -1;
+}
+
+//! read an nm map, code symbols only
+/*! \param offset is added to each address
+*/
+static int read_map(const char *filename,long offset) {
+  FILE *file;
+  char line[256],name[256],type;
+  unsigned long addr;
+
+  if((file=fopen(filename,"r"))==NULL) {
+    perror(filename);
+    return -1;
+  }
+  while(fgets(line,sizeof(line),file)) {
+    if(sscanf(line,"%lx %c %255s",&addr,&type,name)!=3)
+      continue;
+    if(!strchr("Tt",type) || name[0]!='_')
+      continue;                         // data or local asm label
+
+    symbols=realloc(symbols,(nsymbols+1)*sizeof(symbol_t));
+    if(!symbols) {
+      fputs("out of memory\n",stderr);
+      exit(1);
+    }
+    symbols[nsymbols].addr=(addr+offset) & 0xffff;
+    symbols[nsymbols].name=strdup(name);
+    symbols[nsymbols].samples=0;
+    nsymbols++;
+  }
+  fclose(file);
+  return 0;
+}
+
+static int symbol_addr_cmp(const void *a,const void *b) {
+  const symbol_t *x=a, *y=b;
+
+  return x->addr<y->addr ? -1 : x->addr>y->addr;
+}
+
+static int symbol_samples_cmp(const void *a,const void *b) {
+  const symbol_t *x=a, *y=b;
+
+  return x->samples>y->samples ? -1 : x->samples<y->samples;
+}
+
+//! spread count over the symbols that overlap [start,end)
+/*! \return the part that fell before the first symbol
+*/
+static double spread(unsigned long start,unsigned long end,unsigned count) {
+  double outside=0, per_byte=(double) count/(end-start);
+  int i;
+
+  for(i=0; i<nsymbols && symbols[i].addr<end; i++) {
+    unsigned long from=symbols[i].addr, to=(i+1<nsymbols) ?
+                                           symbols[i+1].addr : end;
+
+    if(to<=start)
+      continue;
+    if(from<start)
+      from=start;
+    if(to>end)
+      to=end;
+    symbols[i].samples+=per_byte*(to-from);
+  }
+  if(!nsymbols || symbols[0].addr>start)
+    outside=per_byte*((nsymbols && symbols[0].addr<end ?
+                       symbols[0].addr : end)-start);
+  return outside;
+}
+
+//! symbolize the histogram and print the flat profile
+static void report(void) {
+  double outside=bins[0], total=0;
+  unsigned i,b;
+  int j;
+
+  for(i=0; i<nranges; i++) {
+    range_t *r=ranges+i;
+    unsigned n=(r->size+(1<<shift)-1)>>shift;
+
+    if(r->id>=RANGE_PROGRAM && r->id<RANGE_PROGRAM+PROG_MAX) {
+      unsigned nr=r->id-RANGE_PROGRAM;
+      lx_t lx;
+
+      if(!prog_map[nr])
+        fprintf(stderr,"no symbols for program %u\n",nr+1);
+      else if(lx_read(&lx,(unsigned char*) prog_lx[nr]))
+        fprintf(stderr,"unable to load %s\n",prog_lx[nr]);
+      else
+        read_map(prog_map[nr],(long) r->base-lx.base);
+    }
+    for(b=0; b<n && r->bin+b<nbins; b++)
+      total+=bins[r->bin+b];
+  }
+  total+=bins[0];
+  qsort(symbols,nsymbols,sizeof(symbol_t),symbol_addr_cmp);
+
+  for(i=0; i<nranges; i++) {
+    range_t *r=ranges+i;
+    unsigned long end=(unsigned long) r->base+r->size;
+
+    for(b=0; r->bin+b<nbins; b++) {
+      unsigned long start=r->base+((unsigned long) b<<shift);
+      unsigned long stop=start+(1UL<<shift);
+
+      if(start>=end)
+        break;
+      if(bins[r->bin+b])
+        outside+=spread(start,stop<end ? stop : end,bins[r->bin+b]);
+    }
+  }
+  qsort(symbols,nsymbols,sizeof(symbol_t),symbol_samples_cmp);
+
+  printf("# %lu samples, %u bytes per bin\n",samples,1U<<shift);
+  printf("#%10s %7s  %s\n","samples","%","symbol");
+  if(outside>0)
+    printf("%11.1f %7.2f  %s\n",outside,
+           total ? 100*outside/total : 0,"<outside>");
+  for(j=0; j<nsymbols && symbols[j].samples>0; j++)
+    printf("%11.1f %7.2f  %s\n",symbols[j].samples,
+           total ? 100*symbols[j].samples/total : 0,symbols[j].name);
+}
+
+static void usage(const char *progname) {
+  char *usage_string =
+	"Options:\n"
+	"  -r<rcxaddr>  , --rcxaddr=<rcxaddr>   send to RCX host address <rcxaddr>\n"
+	"  -s<srcport>  , --srcport=<srcport>   send to RCX source port <srcport>\n"
+	"  -t<comport>  , --tty=<comport>       set IR Tower com port <comport>\n"
+	"  -g<shift>    , --shift=<shift>       2^<shift> bytes per bin (default 4)\n"
+	"  -d<secs>     , --time=<secs>         sample for <secs> (default 10)\n"
+	"  -B           , --begin               start sampling and exit\n"
+	"  -R           , --read                stop sampling and read the profile\n"
+	"  -v           , --verbose             verbose mode\n"
+	"\n"
+	"Programs are given as <prognum>:<file.lx>[:<file.dmap>], the map\n"
+	"defaults to the .lx name with .dmap.\n"
+	;
+
+  fprintf(stderr,"usage: %s [options] brickOS.map [program ...]\n",progname);
+  fputs(usage_string,stderr);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  unsigned char buffer[4];
+  unsigned secs=DEFAULT_TIME, nr;
+  char *tty=NULL, *p;
+  int opt, begin_flag=0, read_flag=0;
+#ifdef HAVE_GETOPT_LONG
+  int option_index;
+#endif
+
+  shift=DEFAULT_SHIFT;
+  while((opt=getopt_long(argc, argv, "r:s:t:g:d:BRv",
+                        (struct option *)long_options, &option_index) )!=-1) {
+    switch(opt) {
+      case 'r':
+        rcxaddr=(atoi(optarg) << 4) & CONF_LNP_HOSTMASK;
+        break;
+      case 's':
+        srcport=atoi(optarg) & LNP_PORTMASK;
+        break;
+      case 't':
+        tty=optarg;
+        break;
+      case 'g':
+        shift=atoi(optarg) & 0x0f;
+        break;
+      case 'd':
+        secs=atoi(optarg);
+        break;
+      case 'B':
+        begin_flag=1;
+        break;
+      case 'R':
+        read_flag=1;
+        break;
+      case 'v':
+        verbose_flag=1;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(optind>=argc || (begin_flag && read_flag))
+    usage(argv[0]);
+
+  // maps are read now to fail early, programs once the text is known
+  //
+  if(!begin_flag && read_map(argv[optind],0))
+    return 1;
+  for(optind++; optind<argc; optind++) {
+    nr=strtoul(argv[optind],&p,10)-1;
+    if(*p!=':' || nr>=PROG_MAX)
+      usage(argv[0]);
+    prog_lx[nr]=strdup(p+1);
+    if((p=strchr(prog_lx[nr],':'))!=NULL) {
+      *(p++)=0;
+      prog_map[nr]=p;
+    } else if((p=strstr(prog_lx[nr],".lx"))!=NULL) {
+      prog_map[nr]=malloc(strlen(prog_lx[nr])+3);
+      strcpy((char*) prog_map[nr],prog_lx[nr]);
+      strcpy((char*) prog_map[nr]+(p-prog_lx[nr]),".dmap");
+    }
+  }
+
+  LNPinit(lnp_tty(tty));
+  lnp_addressing_set_handler(srcport,phandler);
+
+  buffer[0]=CMDprofile;
+  if(!read_flag) {
+    buffer[1]=PROFstart;
+    buffer[2]=shift;
+    if(command(buffer,3)) {
+      fputs("no reply, is the kernel built with CONF_PROFILE?\n",stderr);
+      return 1;
+    }
+    if(!nranges) {
+      fputs("not enough memory on the RCX, try a larger shift\n",stderr);
+      return 1;
+    }
+    if(begin_flag)
+      return 0;
+    sleep(secs);
+  }
+
+  buffer[1]=PROFstop;
+  if(command(buffer,2)) {
+    fputs("error stopping the profiler\n",stderr);
+    return 1;
+  }
+  if(read_bins()) {
+    fputs("error reading the profile\n",stderr);
+    return 1;
+  }
+
+  report();
+  return 0;
+}
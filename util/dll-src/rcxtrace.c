@@ -0,0 +1,608 @@
+/*! \file   rcxtrace.c
+    \brief  Read the kernel's event trace and convert it for a trace viewer
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Talks to a kernel built with CONF_TRACE: stops recording, reads the
+ *  trace ring and resumes recording. With -f, the ring is taken from a
+ *  memory image instead, as written by h8sim -d; the kernel map tells
+ *  where it is. The events are written as Chrome trace event JSON, to
+ *  be loaded into chrome://tracing or Perfetto: one row per task with
+ *  the times it ran, and rows for LNP transmit and receive.
+ *
+ *  Timestamps are the low 16 bits of the system time in ms, so a trace
+ *  must not have gaps of a minute or more between events.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <sys/lnp.h>
+#include <sys/lnp-logical.h>
+
+#include "rcxtty.h"
+#include "lnphost.h"
+
+#if (defined(__sun__) && defined(__svr4__)) || defined(BSD)	// Solaris||BSD
+#undef HAVE_GETOPT_LONG
+#else
+#define HAVE_GETOPT_LONG 1
+#endif
+
+#ifdef HAVE_GETOPT_LONG
+#include <getopt.h>
+
+static const struct option long_options[]={
+  {"rcxaddr",required_argument,0,'r'},
+  {"srcport",required_argument,0,'s'},
+  {"tty",    required_argument,0,'t'},
+  {"file",   required_argument,0,'f'},
+  {"output", required_argument,0,'o'},
+  {"clear",  no_argument      ,0,'c'},
+  {"keep",   no_argument      ,0,'k'},
+  {"verbose",no_argument      ,0,'v'},
+  {0        ,0                ,0,0  }
+};
+
+#else // HAVE_GETOPT_LONG
+
+#define getopt_long(ac, av, opt, lopt, lidx) (getopt((ac), (av), (opt)))
+
+#endif // HAVE_GETOPT_LONG
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define XMIT_RETRIES	5	//!< number of packet transmit retries
+#define CMDtrace	9	//!< program port command (sys/program.h)
+
+#define RING_SYMBOL	"_trace_ring"	//!< the ring in the kernel map
+#define HEADER_SIZE	6	//!< s[count] s[size] b[wrapped] b[stopped]
+#define ENTRY_SIZE	6	//!< s[time] b[type] b[data] s[arg]
+#define IMAGE_MAX	(HEADER_SIZE+ENTRY_SIZE*4096)
+
+#define PID_TASKS	1	//!< trace viewer process of the tasks
+#define PID_LNP		2	//!< trace viewer process of the LNP rows
+#define TID_TX		1
+#define TID_RX		2
+
+//! trace commands (sys/trace.h)
+typedef enum {
+  TRACEstart,
+  TRACEstop,
+  TRACEclear,
+  TRACEread,
+  TRACEdata,
+  TRACEend
+} trace_cmd_t;
+
+//! trace event types (sys/trace.h)
+typedef enum {
+  TRACE_NONE,
+  TRACE_SWITCH,
+  TRACE_BLOCK,
+  TRACE_WAKE,
+  TRACE_SEM_WAIT,
+  TRACE_SEM_POST,
+  TRACE_TX_START,
+  TRACE_TX_END,
+  TRACE_COLLISION,
+  TRACE_RX_START,
+  TRACE_RX_END,
+  TRACE_RX_ERROR
+} trace_type_t;
+
+//! a symbol of the kernel map
+typedef struct {
+  unsigned long addr;
+  char *name;
+} symbol_t;
+
+//! a task seen in the trace
+typedef struct {
+  unsigned addr;
+  int priority;
+} task_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned rcxaddr=0, srcport=0;
+
+static volatile int received;           //!< reply to the last command
+static unsigned image_size;             //!< from TRACEstop / TRACEend
+
+static unsigned char image[IMAGE_MAX];  //!< the ring as in RCX memory
+static unsigned char have[IMAGE_MAX];   //!< bytes received
+
+static symbol_t *symbols;
+static int nsymbols;
+
+static task_t *tasks;
+static int ntasks;
+
+static FILE *out;
+static int first_event=1;               //!< no comma before it
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned word(const unsigned char *p) {
+  return (p[0]<<8) | p[1];
+}
+
+//! addressing layer handler for the replies
+static void phandler(const unsigned char *data,unsigned char len,
+                     unsigned char src) {
+  unsigned i,offset;
+
+  if(len<2 || data[0]!=CMDtrace)
+    return;
+
+  switch(data[1]) {
+    case TRACEstart:
+    case TRACEstop:
+    case TRACEclear:
+      if(len<6)
+        return;
+      image_size=word(data+4);
+      received=1;
+      break;
+
+    case TRACEdata:
+      if(len<4)
+        return;
+      offset=word(data+2);
+      for(i=4; i<len && offset<IMAGE_MAX; i++, offset++) {
+        image[offset]=data[i];
+        have[offset]=1;
+      }
+      break;
+
+    case TRACEend:
+      if(len<4)
+        return;
+      image_size=word(data+2);
+      received=1;
+      break;
+  }
+}
+
+//! send a command and wait for its reply
+/*! \return 0 on success.
+*/
+static int command(unsigned char cmd) {
+  unsigned char buffer[2];
+  int i;
+
+  buffer[0]=CMDtrace;
+  buffer[1]=cmd;
+  for(i=0; i<XMIT_RETRIES; i++) {
+    received=0;
+    lnp_addressing_write(buffer,2,rcxaddr,srcport);
+    if(lnp_wait(&received,REPLY_TIMEOUT+2*BYTE_TIME))
+      return 0;
+    if(verbose_flag)
+      fprintf(stderr,"try %d: no reply\n",i);
+  }
+  return -1;
+}
+
+//! read the ring image, asking again for lost bytes
+/*! \return 0 on success.
+*/
+static int read_image(void) {
+  unsigned char buffer[4];
+  unsigned first=0;
+  int i;
+
+  for(i=0; i<XMIT_RETRIES; i++) {
+    buffer[0]=CMDtrace;
+    buffer[1]=TRACEread;
+    buffer[2]=first>>8;
+    buffer[3]=first & 0xff;
+    received=0;
+    lnp_addressing_write(buffer,4,rcxaddr,srcport);
+
+    lnp_wait(&received,REPLY_TIMEOUT+(image_size-first+16)*BYTE_TIME);
+
+    while(first<image_size && have[first])
+      first++;
+    if(first==image_size && received)
+      return 0;
+    if(verbose_flag)
+      fprintf(stderr,"try %d: missing bytes from %u\n",i,first);
+  }
+  return -1;
+}
+
+//! read an nm map
+static int read_map(const char *filename) {
+  FILE *file;
+  char line[256],name[256],type;
+  unsigned long addr;
+
+  if((file=fopen(filename,"r"))==NULL) {
+    perror(filename);
+    return -1;
+  }
+  while(fgets(line,sizeof(line),file)) {
+    if(sscanf(line,"%lx %c %255s",&addr,&type,name)!=3)
+      continue;
+    if(name[0]!='_')
+      continue;                         // local asm label
+
+    symbols=realloc(symbols,(nsymbols+1)*sizeof(symbol_t));
+    if(!symbols) {
+      fputs("out of memory\n",stderr);
+      exit(1);
+    }
+    symbols[nsymbols].addr=addr & 0xffff;
+    symbols[nsymbols].name=strdup(name);
+    nsymbols++;
+  }
+  fclose(file);
+  return 0;
+}
+
+//! look up a symbol by name
+/*! \return its address, or -1 if it is not in the map
+*/
+static long symbol_addr(const char *name) {
+  int i;
+
+  for(i=0; i<nsymbols; i++)
+    if(!strcmp(symbols[i].name,name))
+      return symbols[i].addr;
+  return -1;
+}
+
+//! name an address: symbol, symbol+offset or just the number
+/*! offsets are only taken within 256 bytes, heap addresses stay numbers.
+*/
+static const char *symbolize(unsigned addr) {
+  static char name[300];
+  const symbol_t *best=NULL;
+  int i;
+
+  for(i=0; i<nsymbols; i++)
+    if(symbols[i].addr<=addr && (!best || symbols[i].addr>best->addr))
+      best=symbols+i;
+
+  if(best && best->addr==addr)
+    snprintf(name,sizeof(name),"%s",best->name);
+  else if(best && addr-best->addr<256)
+    snprintf(name,sizeof(name),"%s+0x%lx",best->name,addr-best->addr);
+  else
+    snprintf(name,sizeof(name),"0x%04x",addr);
+  return name;
+}
+
+//! take the ring image from a memory image
+/*! \return 0 on success.
+*/
+static int read_dump(const char *filename) {
+  FILE *file;
+  long addr;
+  unsigned char header[HEADER_SIZE];
+
+  if((addr=symbol_addr(RING_SYMBOL))<0) {
+    fprintf(stderr,"%s not in the map, is the kernel built with CONF_TRACE?\n",
+            RING_SYMBOL);
+    return -1;
+  }
+  if((file=fopen(filename,"rb"))==NULL) {
+    perror(filename);
+    return -1;
+  }
+  if(fseek(file,addr,SEEK_SET) || fread(header,1,HEADER_SIZE,file)!=HEADER_SIZE) {
+    fprintf(stderr,"%s: too short\n",filename);
+    fclose(file);
+    return -1;
+  }
+  image_size=HEADER_SIZE+ENTRY_SIZE*word(header+2);
+  if(image_size>IMAGE_MAX || fseek(file,addr,SEEK_SET) ||
+     fread(image,1,image_size,file)!=image_size) {
+    fprintf(stderr,"%s: no trace ring at 0x%04lx\n",filename,addr);
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+  return 0;
+}
+
+//! the task at a tdata address, added when first seen
+static task_t *task(unsigned addr) {
+  int i;
+
+  for(i=0; i<ntasks; i++)
+    if(tasks[i].addr==addr)
+      return tasks+i;
+
+  tasks=realloc(tasks,(ntasks+1)*sizeof(task_t));
+  if(!tasks) {
+    fputs("out of memory\n",stderr);
+    exit(1);
+  }
+  tasks[ntasks].addr=addr;
+  tasks[ntasks].priority=-1;
+  return tasks+ntasks++;
+}
+
+//! start an event object, ph is the phase
+static void event(const char *name,char ph,int pid,unsigned tid,
+                  unsigned long ms) {
+  fprintf(out,"%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%d,\"tid\":%u,"
+          "\"ts\":%lu",first_event ? "" : ",",name,ph,pid,tid,ms*1000);
+  if(ph=='i')
+    fputs(",\"s\":\"t\"",out);
+  first_event=0;
+}
+
+//! a slice of the time from start to end
+static void slice(const char *name,int pid,unsigned tid,
+                  unsigned long start,unsigned long end) {
+  event(name,'X',pid,tid,start);
+  fprintf(out,",\"dur\":%lu",(end-start)*1000);
+}
+
+//! a viewer row name
+static void row(int pid,unsigned tid,const char *name) {
+  fprintf(out,"%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+          "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+          first_event ? "" : ",",pid,tid,name);
+  first_event=0;
+}
+
+//! convert the ring to trace event JSON
+static void convert(void) {
+  unsigned count=word(image), size=word(image+2), wrapped=image[4];
+  unsigned first,n,i,last_time,current=0;
+  unsigned long now=0,run_start=0,tx_start=0,rx_start=0;
+  int running=0,tx_open=0,rx_open=0;
+  char name[64];
+
+  if(wrapped) {
+    first=count % size;
+    n=size;
+  } else {
+    first=0;
+    n=count<size ? count : size;
+  }
+  last_time=word(image+HEADER_SIZE+ENTRY_SIZE*first);
+
+  fputs("{\"traceEvents\":[",out);
+  for(i=0; i<n; i++) {
+    const unsigned char *e=image+HEADER_SIZE+ENTRY_SIZE*((first+i) % size);
+    unsigned time=word(e), type=e[2], data=e[3], arg=word(e+4);
+
+    now+=(time-last_time) & 0xffff;
+    last_time=time;
+
+    switch(type) {
+      case TRACE_SWITCH:
+        if(running) {
+          slice("run",PID_TASKS,current,run_start,now);
+          fputs("}",out);
+        }
+        current=arg;
+        task(current)->priority=data;
+        run_start=now;
+        running=1;
+        continue;
+
+      case TRACE_BLOCK:
+        event("wait",'i',PID_TASKS,current,now);
+        fprintf(out,",\"args\":{\"%s\":\"%s\"}",data ? "on" : "until",
+                symbolize(arg));
+        break;
+
+      case TRACE_WAKE:
+        task(arg)->priority=data;
+        event("wakeup",'i',PID_TASKS,arg,now);
+        break;
+
+      case TRACE_SEM_WAIT:
+      case TRACE_SEM_POST:
+        event(type==TRACE_SEM_WAIT ? "sem_wait" : "sem_post",'i',
+              PID_TASKS,current,now);
+        fprintf(out,",\"args\":{\"sem\":\"%s\",\"count\":%u}",
+                symbolize(arg),data);
+        break;
+
+      case TRACE_TX_START:
+        tx_start=now;
+        tx_open=1;
+        continue;
+
+      case TRACE_TX_END:
+        slice(data ? "tx collision" : "tx",PID_LNP,TID_TX,
+              tx_open ? tx_start : now,now);
+        fprintf(out,",\"args\":{\"length\":%u}",arg);
+        tx_open=0;
+        break;
+
+      case TRACE_COLLISION:
+        event("collision",'i',PID_LNP,TID_TX,now);
+        fprintf(out,",\"args\":{\"left\":%u,\"status\":\"0x%02x\"}",
+                arg,data);
+        break;
+
+      case TRACE_RX_START:
+        if(rx_open) {                   // the last one timed out
+          slice("rx timeout",PID_LNP,TID_RX,rx_start,now);
+          fputs("}",out);
+        }
+        rx_start=now;
+        rx_open=1;
+        snprintf(name,sizeof(name),"0x%02x",data);
+        continue;
+
+      case TRACE_RX_END:
+        slice("rx",PID_LNP,TID_RX,rx_open ? rx_start : now,now);
+        fprintf(out,",\"args\":{\"header\":\"%s\"}",rx_open ? name : "?");
+        rx_open=0;
+        break;
+
+      case TRACE_RX_ERROR:
+        event("rx error",'i',PID_LNP,TID_RX,now);
+        fprintf(out,",\"args\":{\"status\":\"0x%02x\"}",data);
+        break;
+
+      default:
+        continue;
+    }
+    fputs("}",out);
+  }
+  if(running) {
+    slice("run",PID_TASKS,current,run_start,now);
+    fputs("}",out);
+  }
+
+  // name the rows
+  //
+  for(i=0; i<(unsigned) ntasks; i++) {
+    if(tasks[i].priority==0)
+      snprintf(name,sizeof(name),"idle 0x%04x",tasks[i].addr);
+    else if(tasks[i].priority>0)
+      snprintf(name,sizeof(name),"task 0x%04x prio %d",
+               tasks[i].addr,tasks[i].priority);
+    else
+      snprintf(name,sizeof(name),"task 0x%04x",tasks[i].addr);
+    row(PID_TASKS,tasks[i].addr,name);
+  }
+  row(PID_TASKS,0,"before the first switch");
+  row(PID_LNP,TID_TX,"LNP tx");
+  row(PID_LNP,TID_RX,"LNP rx");
+
+  fprintf(out,"\n],\"displayTimeUnit\":\"ms\",\"otherData\":"
+          "{\"recorded\":%u,\"kept\":%u}}\n",count,n);
+}
+
+static void usage(const char *progname) {
+  char *usage_string =
+	"Options:\n"
+	"  -r<rcxaddr>  , --rcxaddr=<rcxaddr>   send to RCX host address <rcxaddr>\n"
+	"  -s<srcport>  , --srcport=<srcport>   send to RCX source port <srcport>\n"
+	"  -t<comport>  , --tty=<comport>       set IR Tower com port <comport>\n"
+	"  -f<file>     , --file=<file>         read a memory image instead (h8sim -d)\n"
+	"  -o<file>     , --output=<file>       write the JSON to <file>\n"
+	"  -c           , --clear               empty the ring after reading\n"
+	"  -k           , --keep                leave recording stopped\n"
+	"  -v           , --verbose             verbose mode\n"
+	"\n"
+	"The kernel map is used to name event objects and wakeup functions,\n"
+	"and is needed to find the ring in a memory image.\n"
+	;
+
+  fprintf(stderr,"usage: %s [options] [brickOS.map]\n",progname);
+  fputs(usage_string,stderr);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  char *tty=NULL, *dump=NULL, *output=NULL;
+  int opt, clear_flag=0, keep_flag=0;
+#ifdef HAVE_GETOPT_LONG
+  int option_index;
+#endif
+
+  while((opt=getopt_long(argc, argv, "r:s:t:f:o:ckv",
+                        (struct option *)long_options, &option_index) )!=-1) {
+    switch(opt) {
+      case 'r':
+        rcxaddr=(atoi(optarg) << 4) & CONF_LNP_HOSTMASK;
+        break;
+      case 's':
+        srcport=atoi(optarg) & LNP_PORTMASK;
+        break;
+      case 't':
+        tty=optarg;
+        break;
+      case 'f':
+        dump=optarg;
+        break;
+      case 'o':
+        output=optarg;
+        break;
+      case 'c':
+        clear_flag=1;
+        break;
+      case 'k':
+        keep_flag=1;
+        break;
+      case 'v':
+        verbose_flag=1;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(optind<argc-1 || (dump && optind==argc))
+    usage(argv[0]);
+  if(optind<argc && read_map(argv[optind]))
+    return 1;
+
+  if(dump) {
+    if(read_dump(dump))
+      return 1;
+  } else {
+    LNPinit(lnp_tty(tty));
+    lnp_addressing_set_handler(srcport,phandler);
+
+    if(command(TRACEstop)) {
+      fputs("no reply, is the kernel built with CONF_TRACE?\n",stderr);
+      return 1;
+    }
+    if(image_size<HEADER_SIZE || image_size>IMAGE_MAX) {
+      fprintf(stderr,"unexpected trace size %u\n",image_size);
+      return 1;
+    }
+    if(read_image()) {
+      fputs("error reading the trace\n",stderr);
+      return 1;
+    }
+    if(clear_flag && command(TRACEclear))
+      fputs("error clearing the trace\n",stderr);
+    if(!keep_flag && command(TRACEstart))
+      fputs("error restarting the trace\n",stderr);
+  }
+  if(image_size!=HEADER_SIZE+ENTRY_SIZE*word(image+2) || !word(image+2)) {
+    fputs("malformed trace ring\n",stderr);
+    return 1;
+  }
+
+  if(!output)
+    out=stdout;
+  else if((out=fopen(output,"w"))==NULL) {
+    perror(output);
+    return 1;
+  }
+  convert();
+  if(out!=stdout)
+    fclose(out);
+  return 0;
+}
@@ -0,0 +1,862 @@
+/*! \file   fakercx.c
+    \brief  A fake RCX behind a fake IR tower, on a pty
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Opens a pty and answers on it the way a serial tower and an RCX in
+ *  its ROM would: every byte written is echoed, as the tower hears
+ *  itself, at the speed the downloader set on the line, and the ROM
+ *  answers the messages it understands after a delay. The line's speed
+ *  and parity must be the ROM's, 2400 baud odd parity with complements
+ *  until the fast download stub of firmdl has run, 4800 baud without
+ *  parity or complements after it; otherwise the ROM hears garbage.
+ *
+ *  The ROM takes the firmware opcodes of firmdl: alive, delete
+ *  firmware, start download, transfer and unlock. A repeated opcode,
+ *  the same toggle bit and all, is answered again but not executed.
+ *
+ *  A firmware other than the stub is taken to be brickOS. Once it is
+ *  unlocked, or from the start with -b, the RCX answers the program
+ *  protocol of dll on port 0 of its LNP address instead, as the
+ *  packet_consumer() of kernel/program.c with CONF_PROGRAM_LZSS does:
+ *  delete, create, data, window, run, irmode and sethost.
+ *
+ *  Messages and replies can be lost or have bytes corrupted at random,
+ *  the echo of the tower never is.
+ */
+
+#define _GNU_SOURCE			// posix_openpt() and friends
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+
+#include <lzss.h>
+
+#if (defined(__sun__) && defined(__svr4__)) || defined(BSD)	// Solaris||BSD
+#undef HAVE_GETOPT_LONG
+#else
+#define HAVE_GETOPT_LONG 1
+#endif
+
+#ifdef HAVE_GETOPT_LONG
+#include <getopt.h>
+
+static const struct option long_options[]={
+  {"link",     required_argument,0,'l'},
+  {"delay",    required_argument,0,'d'},
+  {"no-pacing",no_argument      ,0,'n'},
+  {"output",   required_argument,0,'o'},
+  {"brickos",  no_argument      ,0,'b'},
+  {"address",  required_argument,0,'a'},
+  {"lnp-fast", no_argument      ,0,'f'},
+  {"program",  required_argument,0,'p'},
+  {"loss",     required_argument,0,'L'},
+  {"corrupt",  required_argument,0,'c'},
+  {"seed",     required_argument,0,'s'},
+  {"verbose",  no_argument      ,0,'v'},
+  {0          ,0                ,0,0  }
+};
+
+#else // HAVE_GETOPT_LONG
+
+#define getopt_long(ac, av, opt, lopt, lidx) (getopt((ac), (av), (opt)))
+
+#endif // HAVE_GETOPT_LONG
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define BUFFERSIZE	4096		//!< largest frame on the air
+#define IDLE_BYTES	4		//!< silence that ends a frame, in bytes
+
+#define IMAGE_START	0x8000		//!< where firmware goes
+#define IMAGE_MAXLEN	0x7000
+#define CKSUM_END	0xcc00		//!< the ROM checksums firmware up to here
+
+#define OP_ALIVE	0x10
+#define OP_DELETE	0x65
+#define OP_START	0x75
+#define OP_TRANSFER	0x45
+#define OP_UNLOCK	0xa5
+#define OP_TOGGLE	0x08		//!< set on every other message
+
+#define STATUS_REFUSED	3		//!< transfer status of a bad block
+
+#define PROG_MAX	8		//!< program slots of brickOS
+#define PROG_ACK	0x80		//!< CMDwindow: acknowledge
+#define PROG_LZSS	0x40		//!< CMDwindow: LZSS tokens
+#define SLOT_TEXT(nr)	(0xa000+0x0800*(nr))	//!< text of a slot, on the RCX
+
+#define LNP_HOSTMASK	0xf0
+#define LNP_PROGRAM	0		//!< port of the program protocol
+
+//! the program protocol, as in kernel/program.c
+typedef enum {
+  CMDacknowledge,     	      	//!< 1:
+  CMDdelete, 	      	      	//!< 1+ 1: b[nr]
+  CMDcreate, 	      	      	//!< 1+12: b[nr] s[textsize] s[datasize] s[bsssize] s[stacksize] s[start] b[prio]
+  CMDoffsets, 	      	      	//!< 1+ 7: b[nr] s[text] s[data] s[bss]
+  CMDdata,   	      	      	//!< 1+>3: b[nr] s[offset] array[data]
+  CMDrun,     	      	      	//!< 1+ 1: b[nr]
+  CMDirmode,	      	      	//!< 1+ 1: b[0=near/1=far]
+  CMDsethost,	      	      	//!< 1+ 1: b[hostaddr]
+  CMDprofile,
+  CMDtrace,
+  CMDwindow,	      	      	//!< 1+>3: b[nr|PROG_ACK|PROG_LZSS] s[offset] array[data]
+  CMDlast
+} packet_cmd_t;
+
+static const unsigned char min_length[]={ 1,2,13,8,4,2,2,2,2,2,4 };
+
+//! a program slot of brickOS
+typedef struct {
+  unsigned char *text;			//!< text and data, NULL if empty
+  unsigned text_size,data_size,bss_size;
+  unsigned downloaded;
+} slot_t;
+
+static const char unlock_key[]={ 'L','E','G','O',(char) 174 };
+static const char unlock_reply[]="Just a bit off the block!";
+static const char fastdl_sign[]="Do you byte, when I knock?";
+
+//! the RCX's ROM
+typedef struct {
+  int fast;				//!< the fast download stub ran
+  int started;				//!< a download was started
+  unsigned short start;			//!< its entry point
+  unsigned short cksum;			//!< and checksum
+  unsigned next;			//!< index of the next block
+  unsigned len;				//!< bytes of it so far
+  unsigned char image[IMAGE_MAXLEN];
+  int last_op;				//!< opcode of the last message, -1
+  unsigned char reply[BUFFERSIZE];	//!< and its reply, for repeats
+  unsigned reply_len;
+} rom_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static int master=-1;			//!< our side of the pty
+static int slave=-1;			//!< the other side, held open
+static char *link_name;
+static char *output;
+
+static int verbose_flag;
+static int pacing=1;			//!< bytes take their time on the air
+static unsigned delay=5;		//!< ms the ROM takes to answer
+
+static double loss;			//!< chance of a message or reply lost
+static double corrupt;			//!< chance of a byte corrupted
+
+static rom_t rom;
+
+static int brickos;			//!< brickOS runs, not the ROM
+static int lnp_fast;			//!< at 4800 baud, CONF_LNP_FAST
+static unsigned char brick_addr;	//!< its LNP host address
+static slot_t slots[PROG_MAX];
+static char *program_file;
+
+//! what happened on the air, for the summary
+static unsigned long messages,messages_lost,replies,replies_lost,corrupted;
+
+static unsigned char raw[BUFFERSIZE];	//!< frame being received
+static unsigned raw_len;
+
+static volatile int stop;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! the line as the downloader set it up
+/*! \param fast set to 1 at the ROM's fast settings, 0 at its slow
+           ones, -1 at others
+    \return usecs per byte
+*/
+static unsigned line(int *fast) {
+  struct termios tio;
+  unsigned baud;
+
+  if(tcgetattr(slave,&tio)) {
+    *fast=0;
+    return 11*1000000/2400;
+  }
+  switch(cfgetospeed(&tio)) {
+    case B1200: baud=1200; break;
+    case B2400: baud=2400; break;
+    case B4800: baud=4800; break;
+    case B9600: baud=9600; break;
+    default:    baud=38400;
+  }
+  // a pty drops the parity setting, so the speed alone tells: 2400
+  // baud is the ROM's with odd parity, 4800 the fast stub's without.
+  //
+  *fast=baud==4800 ? 1 : baud==2400 ? 0 : -1;
+  return (baud==2400 ? 11 : 10)*1000000/baud;
+}
+
+//! the monotonic time in usecs
+static unsigned long long now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return 1000000ULL*ts.tv_sec + ts.tv_nsec/1000;
+}
+
+//! put bytes on the air from our side, each once it is through
+static void air(const unsigned char *data,unsigned len) {
+  unsigned long long due=now(),t;
+  unsigned i,usecs;
+  int fast;
+
+  if(!pacing) {
+    if(write(master,data,len)!=(ssize_t) len && verbose_flag)
+      perror("write");
+    return;
+  }
+
+  usecs=line(&fast);
+  for(i=0; i<len; i++) {
+    due+=usecs;
+    if((t=now())<due)
+      usleep(due-t);
+    if(write(master,data+i,1)!=1 && verbose_flag)
+      perror("write");
+  }
+}
+
+//! a message or reply makes it, with the chance given by --loss
+static int delivered(void) {
+  return loss<=0 || drand48()>=loss;
+}
+
+//! a byte, maybe with a bit flipped as --corrupt says
+static unsigned char impair(unsigned char b) {
+  if(corrupt>0 && drand48()<corrupt) {
+    corrupted++;
+    b^=1<<(lrand48() & 7);
+  }
+  return b;
+}
+
+//! send a reply of the RCX, unless it is lost
+static void transmit(const unsigned char *data,unsigned len) {
+  unsigned char buf[BUFFERSIZE];
+  unsigned i;
+
+  replies++;
+  if(!delivered()) {
+    replies_lost++;
+    if(verbose_flag)
+      fputs("reply lost\n",stderr);
+    return;
+  }
+  for(i=0; i<len; i++)
+    buf[i]=impair(data[i]);
+  air(buf,len);
+}
+
+static void dump(const char *what,const unsigned char *data,unsigned len) {
+  unsigned i;
+
+  fprintf(stderr,"%s",what);
+  for(i=0; i<len; i++)
+    fprintf(stderr," %02x",data[i]);
+  fputc('\n',stderr);
+}
+
+//! frame a ROM reply as the ROM does in its mode, and send it
+static void rom_reply(const unsigned char *data,unsigned len) {
+  unsigned char *r=rom.reply;
+  unsigned i,n=0,sum=0;
+
+  r[n++]=0x55;
+  r[n++]=0xff;
+  r[n++]=0x00;
+  for(i=0; i<len; i++) {
+    r[n++]=data[i];
+    if(!rom.fast)
+      r[n++]=~data[i];
+    sum+=data[i];
+  }
+  r[n++]=sum;
+  if(!rom.fast)
+    r[n++]=~sum;
+  rom.reply_len=n;
+
+  usleep(delay*1000);
+  if(verbose_flag)
+    dump("reply",r,n);
+  transmit(r,n);
+}
+
+//! the unlocked firmware takes over
+static void rom_run(void) {
+  FILE *f;
+
+  if(memmem(rom.image,rom.len,fastdl_sign,sizeof(fastdl_sign)-1)) {
+    fprintf(stderr,"fast download stub of %u bytes runs\n",rom.len);
+    rom.fast=1;
+    rom.last_op=-1;
+    return;
+  }
+
+  fprintf(stderr,"firmware of %u bytes at 0x%04x unlocked, entry 0x%04x\n",
+          rom.len,IMAGE_START,rom.start);
+  if(output) {
+    if((f=fopen(output,"wb"))==NULL
+       || fwrite(rom.image,1,rom.len,f)!=rom.len || fclose(f))
+      perror(output);
+  }
+  fprintf(stderr,"brickOS runs at LNP address 0x%02x\n",brick_addr);
+  brickos=1;
+}
+
+//! the ROM acts on a message with a valid checksum
+static void rom_execute(const unsigned char *msg,unsigned len) {
+  unsigned char reply[1+sizeof(unlock_reply)];
+  unsigned i,index,size,cksum,cksum_len,reply_len=1;
+
+  if(verbose_flag)
+    dump("message",msg,len);
+
+  if(msg[0]==rom.last_op) {
+    usleep(delay*1000);
+    transmit(rom.reply,rom.reply_len);
+    return;
+  }
+
+  reply[0]=~msg[0];
+  switch(msg[0] & ~OP_TOGGLE) {
+    case OP_ALIVE:
+      break;
+
+    case OP_DELETE:
+      rom.started=0;
+      rom.len=0;
+      break;
+
+    case OP_START:
+      rom.start=msg[1] | (msg[2]<<8);
+      rom.cksum=msg[3] | (msg[4]<<8);
+      rom.started=1;
+      rom.next=1;
+      rom.len=0;
+      reply[reply_len++]=0;
+      break;
+
+    case OP_TRANSFER:
+      index=msg[1] | (msg[2]<<8);
+      size =msg[3] | (msg[4]<<8);
+      for(i=0, cksum=0; i<size; i++)
+        cksum+=msg[5+i];
+      if(!rom.started || (index!=rom.next && index!=0)
+         || (cksum & 0xff)!=msg[5+size] || rom.len+size>IMAGE_MAXLEN)
+        reply[reply_len++]=STATUS_REFUSED;
+      else {
+        memcpy(rom.image+rom.len,msg+5,size);
+        rom.len+=size;
+        rom.next++;
+        reply[reply_len++]=0;
+      }
+      break;
+
+    case OP_UNLOCK:
+      if(memcmp(msg+1,unlock_key,sizeof(unlock_key)) || !rom.started)
+        return;
+      cksum_len=rom.start+rom.len<CKSUM_END ? rom.len
+                                            : (unsigned) (CKSUM_END-rom.start);
+      for(i=0, cksum=0; i<cksum_len && i<rom.len; i++)
+        cksum+=rom.image[i];
+      if((cksum & 0xffff)!=rom.cksum) {
+        fprintf(stderr,"firmware checksum 0x%04x, expected 0x%04x\n",
+                cksum & 0xffff,rom.cksum);
+        return;
+      }
+      memcpy(reply+1,unlock_reply,sizeof(unlock_reply)-1);
+      reply_len+=sizeof(unlock_reply)-1;
+      rom.started=0;
+      rom.last_op=msg[0];
+      rom_reply(reply,reply_len);
+      rom_run();
+      return;
+
+    default:
+      return;
+  }
+  rom.last_op=msg[0];
+  rom_reply(reply,reply_len);
+}
+
+//! length of the message starting with an opcode
+/*! \return 0 if more of it is needed to tell, -1 if the ROM doesn't
+            know it
+*/
+static int rom_length(const unsigned char *msg,unsigned have) {
+  switch(msg[0] & ~OP_TOGGLE) {
+    case OP_ALIVE:
+      return 1;
+    case OP_DELETE:
+    case OP_START:
+    case OP_UNLOCK:
+      return 6;
+    case OP_TRANSFER:
+      if(have<5)
+        return 0;
+      return 6+(msg[3] | (msg[4]<<8))<BUFFERSIZE/2 ?
+             6+(msg[3] | (msg[4]<<8)) : -1;
+  }
+  return -1;
+}
+
+//! take apart the frame received so far
+/*! \return 1 if it was a whole message, 0 if more is needed, -1 if
+            it isn't a message
+*/
+static int rom_frame(void) {
+  static const unsigned char head[]={ 0x55,0xff,0x00 };
+  unsigned char msg[BUFFERSIZE];
+  unsigned pos,n=0,sum=0,step;
+  int need=0;
+
+  if(rom.fast) {
+    if(raw[0]!=0xff)
+      return -1;
+    pos=1;
+    step=1;
+  } else {
+    for(pos=0; pos<3; pos++)
+      if(pos<raw_len && raw[pos]!=head[pos])
+        return -1;
+    step=2;
+  }
+
+  for(; pos+step<=raw_len; pos+=step) {
+    if(step==2 && raw[pos]!=(unsigned char) ~raw[pos+1])
+      return -1;
+    if(need>0 && n==(unsigned) need) {
+      if((sum & 0xff)!=raw[pos])
+        return -1;
+      messages++;
+      if(delivered())
+        rom_execute(msg,n);
+      else
+        messages_lost++;
+      return 1;
+    }
+    msg[n++]=raw[pos];
+    sum+=raw[pos];
+    if((need=rom_length(msg,n))<0)
+      return -1;
+  }
+  return 0;
+}
+
+//! send an LNP addressing packet from port 0 of the brick
+static void lnp_write(const unsigned char *data,unsigned len,
+                      unsigned char dest) {
+  unsigned char frame[BUFFERSIZE];
+  unsigned i;
+
+  frame[0]=0xf1;
+  frame[1]=len+2;
+  frame[2]=dest;
+  frame[3]=brick_addr | LNP_PROGRAM;
+  memcpy(frame+4,data,len);
+  frame[4+len]=0xff;
+  for(i=0; i<4+len; i++)
+    frame[4+len]+=frame[i];
+
+  usleep(delay*1000);
+  if(verbose_flag)
+    dump("reply",frame,5+len);
+  transmit(frame,5+len);
+}
+
+static void acknowledge(unsigned char dest) {
+  static const unsigned char ack=CMDacknowledge;
+
+  lnp_write(&ack,1,dest);
+}
+
+//! a slot has all of its program
+static int slot_valid(const slot_t *slot) {
+  return slot->text && slot->downloaded==slot->text_size+slot->data_size;
+}
+
+static void slot_advance(unsigned nr,slot_t *slot,unsigned length) {
+  unsigned crc=0xffff,i,bit;
+  FILE *f;
+
+  slot->downloaded+=length;
+  if(!slot_valid(slot))
+    return;
+
+  // the CRC of dll's update mode, to compare with the relocated image
+  //
+  for(i=0; i<slot->downloaded; i++) {
+    crc^=slot->text[i]<<8;
+    for(bit=0; bit<8; bit++)
+      crc=(crc & 0x8000) ? (crc<<1)^0x1021 : crc<<1;
+    crc&=0xffff;
+  }
+  fprintf(stderr,"program %u of %u bytes at 0x%04x complete, crc 0x%04x\n",
+          nr+1,slot->downloaded,SLOT_TEXT(nr),crc);
+  if(program_file) {
+    if((f=fopen(program_file,"wb"))==NULL
+       || fwrite(slot->text,1,slot->downloaded,f)!=slot->downloaded
+       || fclose(f))
+      perror(program_file);
+  }
+}
+
+//! brickOS acts on a program protocol packet
+static void brick_packet(const unsigned char *data,unsigned len,
+                         unsigned char src) {
+  unsigned char msg[8];
+  unsigned nr,offset,room;
+  slot_t *slot;
+  int length;
+
+  if(verbose_flag)
+    dump("packet",data,len);
+
+  if(data[0]>=CMDlast || len<min_length[data[0]])
+    return;
+
+  switch(data[0]) {
+    case CMDirmode:
+      acknowledge(src);
+      return;
+
+    case CMDsethost:
+      acknowledge(src);
+      brick_addr=(data[1]<<4) & LNP_HOSTMASK;
+      return;
+
+    case CMDwindow:
+      nr=data[1] & ~(PROG_ACK | PROG_LZSS);
+      break;
+
+    default:
+      nr=data[1];
+  }
+  if(nr>=PROG_MAX)
+    return;
+  slot=slots+nr;
+
+  switch(data[0]) {
+    case CMDdelete:
+      free(slot->text);
+      memset(slot,0,sizeof(slot_t));
+      acknowledge(src);
+      break;
+
+    case CMDcreate:
+      if(slot->text)
+        break;
+      slot->text_size=(data[2]<<8) | data[3];
+      slot->data_size=(data[4]<<8) | data[5];
+      slot->bss_size =(data[6]<<8) | data[7];
+      if((slot->text=malloc(slot->text_size+slot->data_size+1))==NULL)
+        break;
+      slot->downloaded=0;
+
+      msg[0]=CMDacknowledge;
+      msg[1]=nr;
+      msg[2]=SLOT_TEXT(nr)>>8;
+      msg[3]=SLOT_TEXT(nr) & 0xff;
+      msg[4]=(SLOT_TEXT(nr)+slot->text_size)>>8;
+      msg[5]=(SLOT_TEXT(nr)+slot->text_size) & 0xff;
+      msg[6]=(SLOT_TEXT(nr)+slot->text_size+slot->data_size)>>8;
+      msg[7]=(SLOT_TEXT(nr)+slot->text_size+slot->data_size) & 0xff;
+      lnp_write(msg,8,src);
+      break;
+
+    case CMDdata:
+      if(!slot->text || slot_valid(slot))
+        break;
+      offset=(data[2]<<8) | data[3];
+      room=slot->text_size+slot->data_size-slot->downloaded;
+      if(offset>slot->downloaded)
+        break;
+      if(offset==slot->downloaded && len-4<=room) {
+        memcpy(slot->text+offset,data+4,len-4);
+        slot_advance(nr,slot,len-4);
+      }
+      acknowledge(src);
+      break;
+
+    case CMDwindow:
+      if(!slot->text)
+        break;
+      offset=(data[2]<<8) | data[3];
+      room=slot->text_size+slot->data_size-slot->downloaded;
+
+      // chunks in order only, the host goes back to the offset acked
+      //
+      if(offset==slot->downloaded && !slot_valid(slot)) {
+        if(data[1] & PROG_LZSS) {
+          length=lzss_decode(slot->text+offset,offset,room,data+4,len-4);
+          if(length>0)
+            slot_advance(nr,slot,length);
+        } else if(len-4<=room) {
+          memcpy(slot->text+offset,data+4,len-4);
+          slot_advance(nr,slot,len-4);
+        }
+      }
+      if(data[1] & PROG_ACK) {
+        msg[0]=CMDacknowledge;
+        msg[1]=nr;
+        msg[2]=slot->downloaded>>8;
+        msg[3]=slot->downloaded & 0xff;
+        lnp_write(msg,4,src);
+      }
+      break;
+
+    case CMDrun:
+      if(!slot_valid(slot))
+        break;
+      fprintf(stderr,"program %u runs\n",nr+1);
+      acknowledge(src);
+      break;
+  }
+}
+
+//! take apart the LNP frame received so far, as rom_frame()
+static int lnp_frame(void) {
+  unsigned char sum=0xff;
+  unsigned i,len;
+
+  if(raw[0]!=0xf0 && raw[0]!=0xf1)
+    return -1;
+  if(raw_len<2 || raw_len<raw[1]+3u)
+    return 0;
+
+  len=raw[1]+3;
+  for(i=0; i<len-1; i++)
+    sum+=raw[i];
+  if(sum!=raw[len-1])
+    return -1;
+
+  // integrity layer frames and other addresses aren't for us
+  //
+  if(raw[0]!=0xf1 || raw[1]<2 || raw[2]!=(brick_addr | LNP_PROGRAM))
+    return 1;
+  messages++;
+  if(delivered())
+    brick_packet(raw+4,raw[1]-2,raw[3]);
+  else
+    messages_lost++;
+  return 1;
+}
+
+//! a byte reaches the RCX
+static void rcx_byte(unsigned char b) {
+  int status;
+
+  raw[raw_len++]=b;
+  while(raw_len && (status=brickos ? lnp_frame() : rom_frame())!=0) {
+    if(status>0)
+      raw_len=0;
+    else
+      memmove(raw,raw+1,--raw_len);	// look for the next frame
+  }
+  if(raw_len==BUFFERSIZE)
+    raw_len=0;
+}
+
+//! bytes from the host
+static void received(const unsigned char *data,unsigned len) {
+  unsigned i;
+  int fast;
+
+  air(data,len);			// the tower hears itself
+
+  line(&fast);
+  if(fast!=(brickos ? lnp_fast : rom.fast)) {
+    raw_len=0;
+    return;
+  }
+  for(i=0; i<len; i++)
+    rcx_byte(impair(data[i]));
+}
+
+//! open the pty and hold its other side, so downloaders can come and go
+static int open_pty(void) {
+  struct termios tio;
+  char *name;
+
+  if((master=posix_openpt(O_RDWR | O_NOCTTY))<0 || grantpt(master)
+     || unlockpt(master) || (name=ptsname(master))==NULL) {
+    perror("opening a pty");
+    return -1;
+  }
+  if((slave=open(name,O_RDWR | O_NOCTTY))<0 || tcgetattr(slave,&tio)) {
+    perror(name);
+    return -1;
+  }
+  cfmakeraw(&tio);
+  tcsetattr(slave,TCSANOW,&tio);
+
+  if(link_name) {
+    unlink(link_name);
+    if(symlink(name,link_name)) {
+      perror(link_name);
+      return -1;
+    }
+  }
+  printf("%s\n",name);
+  fflush(stdout);
+  return 0;
+}
+
+static void terminated(int sig) {
+  stop=1;
+}
+
+static void usage(const char *progname) {
+  char *usage_string =
+	"Options:\n"
+	"  -l<path>     , --link=<path>         make <path> a link to the pty\n"
+	"  -d<ms>       , --delay=<ms>          the RCX answers after <ms> (5)\n"
+	"  -n           , --no-pacing           bytes take no time on the air\n"
+	"  -o<file>     , --output=<file>       write unlocked firmware to <file>\n"
+	"  -b           , --brickos             brickOS runs from the start\n"
+	"  -a<host>     , --address=<host>      LNP host address of brickOS (0)\n"
+	"  -f           , --lnp-fast            brickOS takes LNP at 4800 baud\n"
+	"  -p<file>     , --program=<file>      write complete programs to <file>\n"
+	"  -L<p>        , --loss=<p>            lose messages and replies with\n"
+	"                                       probability <p>\n"
+	"  -c<p>        , --corrupt=<p>         flip a bit of a byte with\n"
+	"                                       probability <p>\n"
+	"  -s<n>        , --seed=<n>            seed of the losses (1)\n"
+	"  -v           , --verbose             print the messages and replies\n"
+	"\n"
+	;
+
+  fprintf(stderr,"usage: %s [options]\n",progname);
+  fputs(usage_string,stderr);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  unsigned char buf[BUFFERSIZE];
+  struct pollfd pfd;
+  unsigned usecs;
+  long seed=1;
+  ssize_t n;
+  int opt,fast;
+#ifdef HAVE_GETOPT_LONG
+  int option_index;
+#endif
+
+  while((opt=getopt_long(argc, argv, "l:d:no:ba:fp:L:c:s:v",
+                        (struct option *)long_options, &option_index) )!=-1) {
+    switch(opt) {
+      case 'l':
+        link_name=optarg;
+        break;
+      case 'd':
+        delay=atoi(optarg);
+        break;
+      case 'n':
+        pacing=0;
+        break;
+      case 'o':
+        output=optarg;
+        break;
+      case 'b':
+        brickos=1;
+        break;
+      case 'a':
+        brick_addr=(atoi(optarg)<<4) & LNP_HOSTMASK;
+        break;
+      case 'f':
+        lnp_fast=1;
+        break;
+      case 'p':
+        program_file=optarg;
+        break;
+      case 'L':
+        loss=atof(optarg);
+        break;
+      case 'c':
+        corrupt=atof(optarg);
+        break;
+      case 's':
+        seed=atol(optarg);
+        break;
+      case 'v':
+        verbose_flag=1;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  if(optind<argc)
+    usage(argv[0]);
+
+  if(open_pty())
+    return 1;
+
+  signal(SIGINT,terminated);
+  signal(SIGTERM,terminated);
+  srand48(seed);
+
+  rom.last_op=-1;
+  pfd.fd=master;
+  pfd.events=POLLIN;
+
+  while(!stop) {
+    // a silence ends what the ROM was receiving
+    //
+    usecs=line(&fast);
+    if(poll(&pfd,1,raw_len ? (IDLE_BYTES*usecs+999)/1000 : -1)<=0) {
+      raw_len=0;
+      continue;
+    }
+    if((n=read(master,buf,sizeof(buf)))<0) {
+      if(errno==EINTR || errno==EAGAIN)
+        continue;
+      perror("read");
+      break;
+    }
+    received(buf,n);
+  }
+
+  if(link_name)
+    unlink(link_name);
+  fprintf(stderr,"%lu messages, %lu lost; %lu replies, %lu lost; "
+          "%lu bytes corrupted\n",messages,messages_lost,replies,
+          replies_lost,corrupted);
+  return 0;
+}
@@ -116,6 +116,12 @@ extern int __comm_debug;
 #define IMAGE_START     0x8000
 #define IMAGE_MAXLEN    0x7000
 #define TRANSFER_SIZE   200
+#define TRANSFER_MAX    ((BUFFERSIZE - 5) / 2 - 6)  /* fits with complements */
+
+#define FASTDL_MIN      2   /* smaller images, in stub sizes, go slow */
+
+int timing = 0;
+int transfer_size = TRANSFER_SIZE;
 
 /* Stripping zeros is not entirely legal if firmware expects trailing zeros */
 /* Define FORCE_ZERO_STRIPPING to force zero stripping for all files */
@@ -218,6 +224,29 @@ int srec_load (char *name, unsigned char *image, int maxlen, unsigned short *sta
     return length;
 }
 
+float elapsed (struct timeval *since)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - since->tv_sec) + (now.tv_usec - since->tv_usec) * 1e-6;
+}
+
+/* Print what a download took, for --timing */
+void timing_report (char *filename, int len, struct timeval *since)
+{
+    float secs = elapsed(since);
+
+    fprintf(stderr, "%s: %d bytes in %.2f s, %.0f bytes/s, %d exchanges, "
+	    "%d retries\n", filename, len, secs, len / secs,
+	    rcx_stats.exchanges, rcx_stats.retries);
+    if (rcx_stats.exchanges)
+	fprintf(stderr, "%s: %ld bytes sent, %ld received, round trip "
+		"%.1f/%.1f/%.1f ms min/avg/max\n", filename,
+		rcx_stats.sent, rcx_stats.received, rcx_stats.rtt_min,
+		rcx_stats.rtt_sum / rcx_stats.exchanges, rcx_stats.rtt_max);
+}
+
 void image_dl(FILEDESCR fd, unsigned char *image, int len, unsigned short start,
 	      int use_comp, char *filename)
 {
@@ -225,6 +254,10 @@ void image_dl(FILEDESCR fd, unsigned char *image, int len, unsigned short start,
     unsigned char send[BUFFERSIZE];
     unsigned char recv[BUFFERSIZE];
     int addr, index, size, i;
+    struct timeval since;
+
+    gettimeofday(&since, NULL);
+    memset(&rcx_stats, 0, sizeof(rcx_stats));
 
     /* Compute image checksum */
     int cksumlen = (start + len < 0xcc00) ? len : 0xcc00 - start;
@@ -268,8 +301,8 @@ void image_dl(FILEDESCR fd, unsigned char *image, int len, unsigned short start,
 	send[0] = 0x45;
 	if (index & 1)
 	    send[0] |= 0x08;
-	if (size > TRANSFER_SIZE)
-	    size = TRANSFER_SIZE;
+	if (size > transfer_size)
+	    size = transfer_size;
 	else if (0)
 	    /* Set index to zero to make sound after last transfer */
 	    index = 0;
@@ -303,6 +336,9 @@ void image_dl(FILEDESCR fd, unsigned char *image, int len, unsigned short start,
 	fprintf(stderr, "%s: unlock firmware failed\n", progname);
 	exit(1);
     }
+
+    if (timing)
+	timing_report(filename, len, &since);
 }
 
 int main (int argc, char **argv)
@@ -315,8 +351,10 @@ int main (int argc, char **argv)
     int usage = 0;
     FILEDESCR fd;
     int status;
+    struct timeval since;
 
     progname = argv[0];
+    gettimeofday(&since, NULL);
 
     /* Parse command line */
 
@@ -336,6 +374,17 @@ int main (int argc, char **argv)
 	    else if (!strcmp(argv[0], "--slow")) {
 		use_fast = 0;
 	    }
+	    else if (!strcmp(argv[0], "--timing")) {
+		timing = 1;
+	    }
+	    else if (!strncmp(argv[0], "--block=", 8)) {
+		transfer_size = atoi(&argv[0][8]);
+		if (transfer_size < 1 || transfer_size > TRANSFER_MAX) {
+		    fprintf(stderr, "%s: block size must be 1 to %d\n",
+			    progname, TRANSFER_MAX);
+		    exit(1);
+		}
+	    }
 	    else if (!strncmp(argv[0], "--tty", 5)) {
 		if (argv[0][5] == '=') {
 		    tty = &argv[0][6];
@@ -386,6 +435,8 @@ int main (int argc, char **argv)
 	    "      --debug      show debug output, mostly raw bytes\n"
 	    "  -f, --fast       use fast 4x downloading (default)\n"
 	    "  -s, --slow       use slow 1x downloading\n"
+	    "      --block=N    transfer N bytes per message (200)\n"
+	    "      --timing     report the time and round trips of downloads\n"
 	    "      --tty=TTY    assume tower connected to TTY\n"
 #if defined(_WIN32)
 	    "      --tty=usb    assume tower connected to USB\n"
@@ -458,16 +509,21 @@ int main (int argc, char **argv)
 		exit(1);
 	    }
 
-	    image_dl(fd, fastdl_image, fastdl_len, fastdl_start, 1, "Fast Download Image");
+	    /* The stub costs more time than it saves on tiny images */
+	    if (image_len < FASTDL_MIN * fastdl_len)
+		use_fast = 0;
+	    else {
+		image_dl(fd, fastdl_image, fastdl_len, fastdl_start, 1, "Fast Download Image");
 
-	    /* Go back to fast mode */
-	    rcx_close(fd);
-	    fd = rcx_init(tty, 1);
+		/* Go back to fast mode */
+		rcx_close(fd);
+		fd = rcx_init(tty, 1);
+	    }
 	}
 
-	/* Download image in fast mode */
+	/* Download image, in fast mode unless the stub was skipped */
 
-	image_dl(fd, image, image_len, image_start, 0, argv[0]);
+	image_dl(fd, image, image_len, image_start, !use_fast, argv[0]);
 	rcx_close(fd);
     } else {
 	/* Try to wake up the tower in slow mode */
@@ -505,5 +561,8 @@ int main (int argc, char **argv)
 	rcx_close(fd);
     }
 
+    if (timing)
+	fprintf(stderr, "%s: %.2f s in all\n", progname, elapsed(&since));
+
     return 0;
 }
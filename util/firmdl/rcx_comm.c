@@ -60,11 +60,27 @@
 
 #define BUFFERSIZE  4096
 
+#define GAP_BYTES   4     /* silence that ends a reply, in byte times */
+#define GAP_MIN     10    /* ... but never less than this many ms */
+#define RTT_SAMPLES 4     /* round trips measured before timeouts adapt */
+#define RTO_MIN     10    /* adapted timeouts are at least this many ms */
+
 /* Globals */
 
 int __comm_debug = 0;
 extern int tty_usb; 
 
+rcx_stats_t rcx_stats;
+
+static int byte_usec = 4583;	/* a byte on the air, 11 bits at 2400 baud */
+static int flush_ms = 200;	/* quiet time that ends rx_flush */
+
+/* Round trip estimates, per opcode without its toggle bit */
+static struct {
+    int samples;
+    float srtt, rttvar;
+} rtt[256];
+
 /* Timer routines */
 
 typedef struct timeval timeval_t;
@@ -211,19 +227,42 @@ static int nbread (FILEDESCR fd, void *buf, int maxlen, int timeout)
     return len;
 }
 
-/* discard all characters in the input queue of tty */
-static void rx_flush(FILEDESCR fd)
+/* Silence in ms that ends a reply: a few byte times on a serial tower, */
+/* the timeout on the USB tower, which hands over its data in packets */
+static int reply_gap(int timeout)
+{
+    int gap = GAP_BYTES * byte_usec / 1000;
+
+    if (tty_usb)
+	return timeout;
+    return gap < GAP_MIN ? GAP_MIN : gap;
+}
+
+/* Read up to maxlen bytes, the first within timeout ms and the others */
+/* no more than gap ms apart */
+static int nbread_reply (FILEDESCR fd, void *buf, int maxlen, int timeout, int gap)
+{
+    int len = nbread(fd, buf, 1, timeout);
+
+    if (len)
+	len += nbread(fd, (char *)buf + 1, maxlen - 1, gap);
+    return len;
+}
+
+/* discard all characters in the input queue of tty, until it is quiet */
+/* for quiet ms */
+static void rx_flush(FILEDESCR fd, int quiet)
 {
 #if defined(_WIN32)
     if (tty_usb == 0) {
 	  PurgeComm(fd, PURGE_RXABORT | PURGE_RXCLEAR);
     } else {
       char echo[BUFFERSIZE];
-      nbread(fd, echo, BUFFERSIZE, 200);
+      nbread(fd, echo, BUFFERSIZE, quiet);
     }
 #else
     char echo[BUFFERSIZE];
-    nbread(fd, echo, BUFFERSIZE, 200);
+    nbread(fd, echo, BUFFERSIZE, quiet);
 #endif
 }
 
@@ -275,6 +314,9 @@ FILEDESCR rcx_init(char *tty, int is_fast)
 
     if (__comm_debug) printf("mode = %s\n", is_fast ? "fast" : "slow");
 
+    /* 8 data bits, a start and a stop bit, and parity in slow mode */
+    byte_usec = is_fast ? 10 * 1000000 / 4800 : 11 * 1000000 / 2400;
+
 #if defined(_WIN32)
 	// have windows platform I/O
     if ((fd = CreateFile(tty, GENERIC_READ | GENERIC_WRITE,
@@ -364,7 +406,7 @@ int rcx_wakeup_tower (FILEDESCR fd, int timeout)
     // First, I send a KeepAlive Byte to settle IR Tower...
     mywrite(fd, &keepalive, 1);
     usleep(20000);
-    rx_flush(fd);
+    rx_flush(fd, reply_gap(200));
 
     timer_reset(&timer);
 
@@ -384,7 +426,7 @@ int rcx_wakeup_tower (FILEDESCR fd, int timeout)
 	    printf("recvlen = %d\n", len);
 	    hexdump("R", buf, len);
 	}
-	rx_flush(fd);
+	rx_flush(fd, reply_gap(200));
     } while (timer_read(&timer) < (float)timeout / 1000.0f);
 
     if (!count)
@@ -424,7 +466,7 @@ void hexdump(char *prefix, void *buf, int len)
 int rcx_send (FILEDESCR fd, void *buf, int len, int use_comp)
 {
     char *bufp = (char *)buf;
-    char buflen = len;
+    int buflen = len;
     char msg[BUFFERSIZE];
     char echo[BUFFERSIZE];
     int msglen, echolen;
@@ -463,6 +505,7 @@ int rcx_send (FILEDESCR fd, void *buf, int len, int use_comp)
 	myperror("write");
 	exit(1);
     }
+    rcx_stats.sent += msglen;
 
     /* Receive echo */
 
@@ -481,7 +524,7 @@ int rcx_send (FILEDESCR fd, void *buf, int len, int use_comp)
 
       if (echolen != msglen /* || memcmp(echo, msg, msglen) */ ) {
 	  /* Flush connection if echo is bad */
-	  rx_flush(fd);
+	  rx_flush(fd, flush_ms);
 	  return RCX_BAD_ECHO;
       }
     } // USB
@@ -489,31 +532,14 @@ int rcx_send (FILEDESCR fd, void *buf, int len, int use_comp)
     return len;
 }
 
-int rcx_recv (FILEDESCR fd, void *buf, int maxlen, int timeout, int use_comp)
+/* Check a reply and copy up to maxlen bytes of its data to buf */
+static int reply_decode (unsigned char *msg, int msglen, void *buf, int maxlen, int use_comp)
 {
     char *bufp = (char *)buf;
-    unsigned char msg[BUFFERSIZE];
-    int msglen;
     int sum;
     int pos;
     int len;
 
-    /* Receive message */
-
-    msglen = nbread(fd, msg, BUFFERSIZE, timeout);
-
-    if (__comm_debug) {
-	printf("recvlen = %d\n", msglen);
-	hexdump("R", msg, msglen);
-    }
-
-    /* Check for message */
-
-    if (!msglen)
-	return RCX_NO_RESPONSE;
-
-    /* Verify message */
-
     if (use_comp) {
 	if (msglen < 5 || (msglen - 3) % 2 != 0)
 	    return RCX_BAD_RESPONSE;
@@ -589,24 +615,115 @@ int rcx_recv (FILEDESCR fd, void *buf, int maxlen, int timeout, int use_comp)
     }
 }
 
+int rcx_recv (FILEDESCR fd, void *buf, int maxlen, int timeout, int use_comp)
+{
+    unsigned char msg[BUFFERSIZE];
+    int msglen, expect, gap;
+    int len = RCX_NO_RESPONSE;
+
+    /* Receive message */
+    /* Replies of the usual shape are complete once they have their */
+    /* length, the others once the line goes quiet */
+
+    expect = use_comp ? 3 + 2 * maxlen + 2 : 3 + maxlen + 1;
+    if (expect > BUFFERSIZE)
+	expect = BUFFERSIZE;
+    gap = reply_gap(timeout);
+
+    msglen = nbread_reply(fd, msg, expect, timeout, gap);
+    if (msglen == expect)
+	len = reply_decode(msg, msglen, buf, maxlen, use_comp);
+    if (msglen && len < 0) {
+	msglen += nbread(fd, msg + msglen, BUFFERSIZE - msglen, gap);
+	len = reply_decode(msg, msglen, buf, maxlen, use_comp);
+    }
+    rcx_stats.received += msglen;
+
+    if (__comm_debug) {
+	printf("recvlen = %d\n", msglen);
+	hexdump("R", msg, msglen);
+    }
+
+    /* Check for message */
+
+    if (!msglen)
+	return RCX_NO_RESPONSE;
+
+    return len;
+}
+
+/* Timeout in ms for the reply to a message, from its round trip estimate */
+/* Never longer than the caller's timeout, which also covers a retry */
+static int reply_timeout (int op, int timeout)
+{
+    int rto;
+
+    if (rtt[op].samples < RTT_SAMPLES)
+	return timeout;
+
+    rto = rtt[op].srtt + 4 * rtt[op].rttvar + 0.5f;
+    if (rto < RTO_MIN)
+	rto = RTO_MIN;
+    return rto < timeout ? rto : timeout;
+}
+
+/* Update the round trip estimate of an opcode with ms, as TCP does */
+static void rtt_sample (int op, float ms)
+{
+    float err;
+
+    if (!rtt[op].samples++) {
+	rtt[op].srtt = ms;
+	rtt[op].rttvar = ms / 2;
+	return;
+    }
+    err = ms - rtt[op].srtt;
+    rtt[op].srtt += err / 8;
+    rtt[op].rttvar += ((err < 0 ? -err : err) - rtt[op].rttvar) / 4;
+}
+
 int rcx_sendrecv (FILEDESCR fd, void *send, int slen, void *recv, int rlen,
 		  int timeout, int retries, int use_comp)
 {
+    int op = ((unsigned char *)send)[0] & ~0x08;
     int status = 0;
+    int tries = 0;
+    int wait;
+    timeval_t timer;
+    float ms;
 
     if (__comm_debug) printf("sendrecv %d:\n", slen);
 
-    while (retries--) {
+    while (tries < retries) {
+	/* Retries wait the full timeout; a late reply tells nothing */
+	/* about the round trip, so only first tries are measured */
+	wait = tries ? timeout : reply_timeout(op, timeout);
+	flush_ms = wait;
+	if (tries++)
+	    rcx_stats.retries++;
+
 	if ((status = rcx_send(fd, send, slen, use_comp)) < 0) {
 	    if (__comm_debug) printf("status = %s\n", rcx_strerror(status));
 	    continue;
 	}
-	if ((status = rcx_recv(fd, recv, rlen, timeout, use_comp)) < 0) {
+	timer_reset(&timer);
+	if ((status = rcx_recv(fd, recv, rlen, wait, use_comp)) < 0) {
 	    if (__comm_debug) printf("status = %s\n", rcx_strerror(status));
 	    continue;
 	}
+	ms = timer_read(&timer) * 1000;
+	if (tries == 1)
+	    rtt_sample(op, ms);
+
+	if (!rcx_stats.exchanges || ms < rcx_stats.rtt_min)
+	    rcx_stats.rtt_min = ms;
+	if (ms > rcx_stats.rtt_max)
+	    rcx_stats.rtt_max = ms;
+	rcx_stats.rtt_sum += ms;
+	rcx_stats.exchanges++;
 	break;
     }
+    flush_ms = 200;
 
     if (__comm_debug) {
 	if (status > 0)
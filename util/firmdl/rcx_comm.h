@@ -32,6 +32,19 @@
 #define RCX_NO_RESPONSE   -4
 #define RCX_BAD_RESPONSE  -5
 
+/* Counters of rcx_send, rcx_recv and rcx_sendrecv, for timing reports */
+typedef struct {
+    int exchanges;	/* messages answered */
+    int retries;	/* messages sent again */
+    long sent;		/* bytes written, with framing */
+    long received;	/* bytes of replies read, with framing */
+    float rtt_min;	/* ms from a message to the end of its reply */
+    float rtt_max;
+    float rtt_sum;
+} rcx_stats_t;
+
+extern rcx_stats_t rcx_stats;
+
 #if defined(_WIN32)
   #define FILEDESCR	HANDLE
   #define BADFILE	NULL
@@ -56,12 +69,13 @@ extern int rcx_send (FILEDESCR fd, void *buf, int len, int use_comp);
 
 /* Try to receive a message, returns error code */
 /* Set use_comp=1 to expect complements */
-/* Waits for timeout ms before detecting end of response */
+/* Waits up to timeout ms for the response, returns once it is complete */
 extern int rcx_recv (FILEDESCR fd, void *buf, int maxlen, int timeout, int use_comp);
 
 /* Try to send a message and receive its response, returns error code */
 /* Set use_comp=1 to send and receive complements, use_comp=0 otherwise */
-/* Waits for timeout ms before detecting end of response */
+/* Waits up to timeout ms for the response; once the round trip of the */
+/* opcode is known, first tries wait for little more than that */
 extern int rcx_sendrecv (FILEDESCR fd, void *send, int slen, void *recv, int rlen, int timeout, int retries, int use_comp);
 
 /* Test whether or not the rcx is alive, returns 1=yes, 0=no */
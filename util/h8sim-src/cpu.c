@@ -0,0 +1,815 @@
+/*! \file   cpu.c
+    \brief  H8/300 simulator: instruction set
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Execution states follow the H8/300 programming manual: every
+ *  instruction fetch (I), branch address read (J), stack access (K),
+ *  byte (L) and word (M) data access is charged with the states of
+ *  the area it touches (mem_states()), internal operations (N) are
+ *  added explicitly. Branches, jumps and returns count one extra
+ *  fetch at their destination, as the manual's I column does.
+ */
+
+#include "h8sim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+cpu_t cpu;				//!< the CPU
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Internal Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned st;			//!< states of the current instruction
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// registers and bus
+//
+
+//! 8 bit register: 0-7 are r0h-r7h, 8-15 are r0l-r7l
+static unsigned char reg8(int n) {
+  return (n & 8) ? cpu.r[n & 7] : cpu.r[n & 7]>>8;
+}
+
+static void set8(int n,unsigned char v) {
+  if(n & 8)
+    cpu.r[n & 7]=(cpu.r[n & 7] & 0xff00) | v;
+  else
+    cpu.r[n & 7]=(cpu.r[n & 7] & 0x00ff) | (v<<8);
+}
+
+static unsigned char rd8(unsigned short a) {
+  st+=mem_states(a,0);
+  return mem_read8(a);
+}
+
+static void wr8(unsigned short a,unsigned char v) {
+  st+=mem_states(a,0);
+  mem_write8(a,v);
+}
+
+static unsigned short rd16(unsigned short a) {
+  st+=mem_states(a & ~1,1);
+  return mem_read16(a);
+}
+
+static void wr16(unsigned short a,unsigned short v) {
+  st+=mem_states(a & ~1,1);
+  mem_write16(a,v);
+}
+
+//! next instruction word
+static unsigned short fetch(void) {
+  unsigned short w=rd16(cpu.pc);
+
+  cpu.pc+=2;
+  return w;
+}
+
+//! the fetch at a branch destination
+static void prefetch(unsigned short a) {
+  st+=mem_states(a & ~1,1);
+}
+
+static void push(unsigned short v) {
+  cpu.r[7]-=2;
+  wr16(cpu.r[7],v);
+}
+
+static unsigned short pop(void) {
+  unsigned short v=rd16(cpu.r[7]);
+
+  cpu.r[7]+=2;
+  return v;
+}
+
+//
+// flags
+//
+
+static void flags8(unsigned char v) {
+  cpu.ccr&=~(CCR_N | CCR_Z | CCR_V);
+  if(v & 0x80)
+    cpu.ccr|=CCR_N;
+  if(!v)
+    cpu.ccr|=CCR_Z;
+}
+
+static void flags16(unsigned short v) {
+  cpu.ccr&=~(CCR_N | CCR_Z | CCR_V);
+  if(v & 0x8000)
+    cpu.ccr|=CCR_N;
+  if(!v)
+    cpu.ccr|=CCR_Z;
+}
+
+//! a+b+c; with keepz, Z is only ever cleared (ADDX)
+static unsigned char add8(unsigned char a,unsigned char b,int c,int keepz) {
+  unsigned r=a+b+c;
+  unsigned char v=r;
+
+  cpu.ccr&=~(CCR_H | CCR_N | CCR_V | CCR_C | (keepz ? 0 : CCR_Z));
+  if((a & 0xf)+(b & 0xf)+c>0xf)
+    cpu.ccr|=CCR_H;
+  if(v & 0x80)
+    cpu.ccr|=CCR_N;
+  if(v)
+    cpu.ccr&=~CCR_Z;
+  else if(!keepz)
+    cpu.ccr|=CCR_Z;
+  if(~(a ^ b) & (a ^ v) & 0x80)
+    cpu.ccr|=CCR_V;
+  if(r>0xff)
+    cpu.ccr|=CCR_C;
+  return v;
+}
+
+//! a-b-c; with keepz, Z is only ever cleared (SUBX)
+static unsigned char sub8(unsigned char a,unsigned char b,int c,int keepz) {
+  unsigned char v=a-b-c;
+
+  cpu.ccr&=~(CCR_H | CCR_N | CCR_V | CCR_C | (keepz ? 0 : CCR_Z));
+  if((a & 0xf)<(b & 0xf)+c)
+    cpu.ccr|=CCR_H;
+  if(v & 0x80)
+    cpu.ccr|=CCR_N;
+  if(v)
+    cpu.ccr&=~CCR_Z;
+  else if(!keepz)
+    cpu.ccr|=CCR_Z;
+  if((a ^ b) & (a ^ v) & 0x80)
+    cpu.ccr|=CCR_V;
+  if(a<b+c)
+    cpu.ccr|=CCR_C;
+  return v;
+}
+
+static unsigned short add16(unsigned short a,unsigned short b) {
+  unsigned long r=(unsigned long) a+b;
+  unsigned short v=r;
+
+  flags16(v);
+  cpu.ccr&=~(CCR_H | CCR_C);
+  if((a & 0xfff)+(b & 0xfff)>0xfff)
+    cpu.ccr|=CCR_H;
+  if(~(a ^ b) & (a ^ v) & 0x8000)
+    cpu.ccr|=CCR_V;
+  if(r>0xffff)
+    cpu.ccr|=CCR_C;
+  return v;
+}
+
+static unsigned short sub16(unsigned short a,unsigned short b) {
+  unsigned short v=a-b;
+
+  flags16(v);
+  cpu.ccr&=~(CCR_H | CCR_C);
+  if((a & 0xfff)<(b & 0xfff))
+    cpu.ccr|=CCR_H;
+  if((a ^ b) & (a ^ v) & 0x8000)
+    cpu.ccr|=CCR_V;
+  if(a<b)
+    cpu.ccr|=CCR_C;
+  return v;
+}
+
+//! shifts and rotates, op 0x10-0x13, sub 0 or 8
+static unsigned char shift(int op,int sub,unsigned char v) {
+  int c=cpu.ccr & CCR_C;
+  unsigned char r;
+
+  cpu.ccr&=~CCR_C;
+  switch((op<<4) | sub) {
+    case 0x100:				// shll
+    case 0x108:				// shal
+      if(v & 0x80)
+	cpu.ccr|=CCR_C;
+      r=v<<1;
+      flags8(r);
+      if(sub && ((v ^ r) & 0x80))
+	cpu.ccr|=CCR_V;
+      return r;
+    case 0x110:				// shlr
+      r=v>>1;
+      break;
+    case 0x118:				// shar
+      r=(v>>1) | (v & 0x80);
+      break;
+    case 0x120:				// rotxl
+      r=(v<<1) | c;
+      if(v & 0x80)
+	cpu.ccr|=CCR_C;
+      flags8(r);
+      return r;
+    case 0x128:				// rotl
+      r=(v<<1) | (v>>7);
+      if(v & 0x80)
+	cpu.ccr|=CCR_C;
+      flags8(r);
+      return r;
+    case 0x130:				// rotxr
+      r=(v>>1) | (c ? 0x80 : 0);
+      break;
+    default:				// rotr
+      r=(v>>1) | (v<<7);
+      break;
+  }
+  if(v & 1)
+    cpu.ccr|=CCR_C;
+  flags8(r);
+  return r;
+}
+
+//! condition of Bcc
+static int condition(int cc) {
+  int c=(cpu.ccr & CCR_C)!=0, z=(cpu.ccr & CCR_Z)!=0;
+  int n=(cpu.ccr & CCR_N)!=0, v=(cpu.ccr & CCR_V)!=0;
+  int r;
+
+  switch(cc>>1) {
+    case 0:  r=1;		break;	// bra / brn
+    case 1:  r=!(c | z);	break;	// bhi / bls
+    case 2:  r=!c;		break;	// bcc / bcs
+    case 3:  r=!z;		break;	// bne / beq
+    case 4:  r=!v;		break;	// bvc / bvs
+    case 5:  r=!n;		break;	// bpl / bmi
+    case 6:  r=!(n ^ v);	break;	// bge / blt
+    default: r=!(z | (n ^ v));	break;	// bgt / ble
+  }
+  return (cc & 1) ? !r : r;
+}
+
+//! bit manipulation
+/*! \param op   0x60-0x63 (bit number in register spec), 0x67, 0x70-0x77
+    \param spec register or 3 bit immediate, bit 3 inverts for 0x67, 0x74-0x77
+    \return the operand, modified for bset, bnot, bclr, bst
+*/
+static unsigned char bit_op(int op,int spec,unsigned char v) {
+  unsigned char mask=1<<((op<0x64 ? reg8(spec) : spec) & 7);
+  int bit=(v & mask)!=0, inv=(op>=0x67 && (spec & 8)) ? 1 : 0;
+  int c=cpu.ccr & CCR_C;
+
+  switch(op) {
+    case 0x60: case 0x70:		// bset
+      return v | mask;
+    case 0x61: case 0x71:		// bnot
+      return v ^ mask;
+    case 0x62: case 0x72:		// bclr
+      return v & ~mask;
+    case 0x63: case 0x73:		// btst
+      if(bit)
+	cpu.ccr&=~CCR_Z;
+      else
+	cpu.ccr|=CCR_Z;
+      return v;
+    case 0x67:				// bst / bist
+      return (c ^ inv) ? (v | mask) : (v & ~mask);
+    case 0x74:				// bor / bior
+      c|=bit ^ inv;
+      break;
+    case 0x75:				// bxor / bixor
+      c^=bit ^ inv;
+      break;
+    case 0x76:				// band / biand
+      c&=bit ^ inv;
+      break;
+    default:				// bld / bild
+      c=bit ^ inv;
+      break;
+  }
+  cpu.ccr=(cpu.ccr & ~CCR_C) | c;
+  return v;
+}
+
+//! bit manipulation on memory (0x7c-0x7f prefixes)
+/*! \return 0 for an undefined second opcode
+*/
+static int bit_mem(unsigned short addr,unsigned short w2,int write) {
+  int op=w2>>8, spec=(w2>>4) & 0xf;
+  unsigned char v,r;
+
+  if(write ? !(op>=0x60 && op<=0x62) && op!=0x67 && !(op>=0x70 && op<=0x72)
+           : op!=0x63 && !(op>=0x73 && op<=0x77))
+    return 0;
+
+  v=rd8(addr);
+  r=bit_op(op,spec,v);
+  if(write)
+    wr8(addr,r);
+  return 1;
+}
+
+//! decimal adjust after add
+static unsigned char daa(unsigned char v) {
+  unsigned char adj=0;
+
+  if((cpu.ccr & CCR_H) || (v & 0xf)>9)
+    adj|=0x06;
+  if((cpu.ccr & CCR_C) || v>0x99) {
+    adj|=0x60;
+    cpu.ccr|=CCR_C;
+  }
+  v+=adj;
+  cpu.ccr=(cpu.ccr & ~(CCR_N | CCR_Z)) | (v & 0x80 ? CCR_N : 0) | (v ? 0 : CCR_Z);
+  return v;
+}
+
+//! decimal adjust after subtract
+static unsigned char das(unsigned char v) {
+  if(cpu.ccr & CCR_H)
+    v-=0x06;
+  if(cpu.ccr & CCR_C)
+    v-=0x60;
+  cpu.ccr=(cpu.ccr & ~(CCR_N | CCR_Z)) | (v & 0x80 ? CCR_N : 0) | (v ? 0 : CCR_Z);
+  return v;
+}
+
+void cpu_reset(unsigned short entry) {
+  int i;
+
+  for(i=0; i<8; i++)
+    cpu.r[i]=0;
+  cpu.r[7]=MEM_STACK_TOP;
+  cpu.pc=entry;
+  cpu.ccr=0;
+  cpu.sleeping=0;
+  cpu.irq_hold=0;
+}
+
+//! take the interrupt for vector
+static void interrupt(int vector) {
+  cpu.sleeping=0;
+  push(cpu.pc);
+  push((cpu.ccr<<8) | cpu.ccr);
+  cpu.ccr|=CCR_I;
+  cpu.pc=rd16(2*vector);
+  prefetch(cpu.pc);
+  prefetch(cpu.pc);
+  st+=4;
+  io_irq_taken(vector);
+}
+
+//! execute one instruction
+static cpu_status_t execute(void) {
+  unsigned short w=fetch(), a, w2;
+  int op=w>>8, b=w & 0xff, hi=b>>4, lo=b & 0xf;
+  unsigned char v;
+  unsigned short x;
+
+  switch(op) {
+    case 0x00:				// nop
+      if(b)
+	return CPU_ILLEGAL;
+      break;
+
+    case 0x01:				// sleep
+      if(b!=0x80)
+	return CPU_ILLEGAL;
+      cpu.sleeping=1;
+      break;
+
+    case 0x02:				// stc ccr,rd
+      set8(lo,cpu.ccr);
+      break;
+    case 0x03:				// ldc rs,ccr
+      cpu.ccr=reg8(lo);
+      cpu.irq_hold=1;
+      break;
+    case 0x04:				// orc
+      cpu.ccr|=b;
+      cpu.irq_hold=1;
+      break;
+    case 0x05:				// xorc
+      cpu.ccr^=b;
+      cpu.irq_hold=1;
+      break;
+    case 0x06:				// andc
+      cpu.ccr&=b;
+      cpu.irq_hold=1;
+      break;
+    case 0x07:				// ldc #xx
+      cpu.ccr=b;
+      cpu.irq_hold=1;
+      break;
+
+    case 0x08:				// add.b rs,rd
+      set8(lo,add8(reg8(lo),reg8(hi),0,0));
+      break;
+    case 0x09:				// add.w rs,rd
+      cpu.r[lo & 7]=add16(cpu.r[lo & 7],cpu.r[hi & 7]);
+      break;
+    case 0x0a:				// inc.b
+      v=reg8(lo);
+      set8(lo,v+1);
+      flags8(v+1);
+      if(v==0x7f)
+	cpu.ccr|=CCR_V;
+      break;
+    case 0x0b:				// adds #1 / #2
+      cpu.r[lo & 7]+=(hi & 8) ? 2 : 1;
+      break;
+    case 0x0c:				// mov.b rs,rd
+      v=reg8(hi);
+      set8(lo,v);
+      flags8(v);
+      break;
+    case 0x0d:				// mov.w rs,rd
+      cpu.r[lo & 7]=cpu.r[hi & 7];
+      flags16(cpu.r[lo & 7]);
+      break;
+    case 0x0e:				// addx rs,rd
+      set8(lo,add8(reg8(lo),reg8(hi),cpu.ccr & CCR_C,1));
+      break;
+    case 0x0f:				// daa
+      set8(lo,daa(reg8(lo)));
+      break;
+
+    case 0x10: case 0x11: case 0x12: case 0x13:
+      set8(lo,shift(op,hi & 8,reg8(lo)));
+      break;
+
+    case 0x14:				// or.b rs,rd
+      v=reg8(lo) | reg8(hi);
+      set8(lo,v);
+      flags8(v);
+      break;
+    case 0x15:				// xor.b rs,rd
+      v=reg8(lo) ^ reg8(hi);
+      set8(lo,v);
+      flags8(v);
+      break;
+    case 0x16:				// and.b rs,rd
+      v=reg8(lo) & reg8(hi);
+      set8(lo,v);
+      flags8(v);
+      break;
+    case 0x17:
+      if(hi & 8)			// neg
+	set8(lo,sub8(0,reg8(lo),0,0));
+      else {				// not
+	v=~reg8(lo);
+	set8(lo,v);
+	flags8(v);
+      }
+      break;
+
+    case 0x18:				// sub.b rs,rd
+      set8(lo,sub8(reg8(lo),reg8(hi),0,0));
+      break;
+    case 0x19:				// sub.w rs,rd
+      cpu.r[lo & 7]=sub16(cpu.r[lo & 7],cpu.r[hi & 7]);
+      break;
+    case 0x1a:				// dec.b
+      v=reg8(lo);
+      set8(lo,v-1);
+      flags8(v-1);
+      if(v==0x80)
+	cpu.ccr|=CCR_V;
+      break;
+    case 0x1b:				// subs #1 / #2
+      cpu.r[lo & 7]-=(hi & 8) ? 2 : 1;
+      break;
+    case 0x1c:				// cmp.b rs,rd
+      sub8(reg8(lo),reg8(hi),0,0);
+      break;
+    case 0x1d:				// cmp.w rs,rd
+      sub16(cpu.r[lo & 7],cpu.r[hi & 7]);
+      break;
+    case 0x1e:				// subx rs,rd
+      set8(lo,sub8(reg8(lo),reg8(hi),cpu.ccr & CCR_C,1));
+      break;
+    case 0x1f:				// das
+      set8(lo,das(reg8(lo)));
+      break;
+
+    case 0x20: case 0x21: case 0x22: case 0x23:	// mov.b @aa:8,rd
+    case 0x24: case 0x25: case 0x26: case 0x27:
+    case 0x28: case 0x29: case 0x2a: case 0x2b:
+    case 0x2c: case 0x2d: case 0x2e: case 0x2f:
+      v=rd8(0xff00 | b);
+      set8(op & 0xf,v);
+      flags8(v);
+      break;
+
+    case 0x30: case 0x31: case 0x32: case 0x33:	// mov.b rs,@aa:8
+    case 0x34: case 0x35: case 0x36: case 0x37:
+    case 0x38: case 0x39: case 0x3a: case 0x3b:
+    case 0x3c: case 0x3d: case 0x3e: case 0x3f:
+      v=reg8(op & 0xf);
+      wr8(0xff00 | b,v);
+      flags8(v);
+      break;
+
+    case 0x40: case 0x41: case 0x42: case 0x43:	// bcc d:8
+    case 0x44: case 0x45: case 0x46: case 0x47:
+    case 0x48: case 0x49: case 0x4a: case 0x4b:
+    case 0x4c: case 0x4d: case 0x4e: case 0x4f:
+      if(condition(op & 0xf))
+	cpu.pc+=(signed char) b;
+      prefetch(cpu.pc);
+      break;
+
+    case 0x50:				// mulxu rs,rd
+      cpu.r[lo & 7]=(cpu.r[lo & 7] & 0xff) * reg8(hi);
+      st+=12;
+      break;
+    case 0x51:				// divxu rs,rd
+      v=reg8(hi);
+      cpu.ccr&=~(CCR_N | CCR_Z);
+      if(v & 0x80)
+	cpu.ccr|=CCR_N;
+      if(!v)
+	cpu.ccr|=CCR_Z;
+      else {
+	x=cpu.r[lo & 7];
+	cpu.r[lo & 7]=((x % v)<<8) | ((x / v) & 0xff);
+      }
+      st+=12;
+      break;
+
+    case 0x52:				// undefined, halt in the ROM stubs
+      return b==0x01 && cpu.pc-2<MEM_ROM_END ? CPU_HALT : CPU_ILLEGAL;
+
+    case 0x54:				// rts
+      if(b!=0x70)
+	return CPU_ILLEGAL;
+      cpu.pc=pop();
+      prefetch(cpu.pc);
+      st+=2;
+      break;
+    case 0x55:				// bsr d:8
+      push(cpu.pc);
+      cpu.pc+=(signed char) b;
+      prefetch(cpu.pc);
+      profile_call(cpu.pc);
+      break;
+    case 0x56:				// rte
+      if(b!=0x70)
+	return CPU_ILLEGAL;
+      cpu.ccr=pop()>>8;
+      cpu.pc=pop();
+      prefetch(cpu.pc);
+      st+=2;
+      break;
+
+    case 0x59:				// jmp @rn
+      cpu.pc=cpu.r[hi & 7];
+      prefetch(cpu.pc);
+      break;
+    case 0x5a:				// jmp @aa:16
+      cpu.pc=fetch();
+      st+=2;
+      break;
+    case 0x5b:				// jmp @@aa:8
+      cpu.pc=rd16(b);
+      prefetch(cpu.pc);
+      st+=2;
+      break;
+    case 0x5d:				// jsr @rn
+      push(cpu.pc);
+      cpu.pc=cpu.r[hi & 7];
+      prefetch(cpu.pc);
+      profile_call(cpu.pc);
+      break;
+    case 0x5e:				// jsr @aa:16
+      a=fetch();
+      push(cpu.pc);
+      cpu.pc=a;
+      st+=2;
+      profile_call(cpu.pc);
+      break;
+    case 0x5f:				// jsr @@aa:8
+      a=rd16(b);
+      push(cpu.pc);
+      cpu.pc=a;
+      prefetch(cpu.pc);
+      profile_call(cpu.pc);
+      break;
+
+    case 0x60: case 0x61: case 0x62: case 0x63:	// bit ops, bit in rn
+    case 0x70: case 0x71: case 0x72: case 0x73:	// bit ops, #xx:3
+    case 0x74: case 0x75: case 0x76: case 0x77:
+    case 0x67:					// bst / bist
+      set8(lo,bit_op(op,hi,reg8(lo)));
+      break;
+
+    case 0x68:				// mov.b @rs,rd / rs,@rd
+      if(hi & 8) {
+	v=reg8(lo);
+	wr8(cpu.r[hi & 7],v);
+      } else {
+	v=rd8(cpu.r[hi & 7]);
+	set8(lo,v);
+      }
+      flags8(v);
+      break;
+    case 0x69:				// mov.w @rs,rd / rs,@rd
+      if(hi & 8) {
+	x=cpu.r[lo & 7];
+	wr16(cpu.r[hi & 7],x);
+      } else {
+	x=rd16(cpu.r[hi & 7]);
+	cpu.r[lo & 7]=x;
+      }
+      flags16(x);
+      break;
+    case 0x6a:				// mov.b @aa:16,rd / rs,@aa:16
+      a=fetch();
+      if(hi & 8) {
+	v=reg8(lo);
+	wr8(a,v);
+      } else {
+	v=rd8(a);
+	set8(lo,v);
+      }
+      flags8(v);
+      break;
+    case 0x6b:				// mov.w @aa:16,rd / rs,@aa:16
+      a=fetch();
+      if(hi & 8) {
+	x=cpu.r[lo & 7];
+	wr16(a,x);
+      } else {
+	x=rd16(a);
+	cpu.r[lo & 7]=x;
+      }
+      flags16(x);
+      break;
+    case 0x6c:				// mov.b @rs+,rd / rs,@-rd
+      if(hi & 8) {
+	v=reg8(lo);
+	cpu.r[hi & 7]-=1;
+	wr8(cpu.r[hi & 7],v);
+      } else {
+	a=cpu.r[hi & 7];
+	cpu.r[hi & 7]+=1;
+	v=rd8(a);
+	set8(lo,v);
+      }
+      flags8(v);
+      st+=2;
+      break;
+    case 0x6d:				// mov.w @rs+,rd / rs,@-rd (pop/push)
+      if(hi & 8) {
+	x=cpu.r[lo & 7];
+	cpu.r[hi & 7]-=2;
+	wr16(cpu.r[hi & 7],x);
+      } else {
+	a=cpu.r[hi & 7];
+	cpu.r[hi & 7]+=2;
+	x=rd16(a);
+	cpu.r[lo & 7]=x;
+      }
+      flags16(x);
+      st+=2;
+      break;
+    case 0x6e:				// mov.b @(d:16,rs),rd / rs,@(d:16,rd)
+      a=cpu.r[hi & 7]+fetch();
+      if(hi & 8) {
+	v=reg8(lo);
+	wr8(a,v);
+      } else {
+	v=rd8(a);
+	set8(lo,v);
+      }
+      flags8(v);
+      break;
+    case 0x6f:				// mov.w @(d:16,rs),rd / rs,@(d:16,rd)
+      a=cpu.r[hi & 7]+fetch();
+      if(hi & 8) {
+	x=cpu.r[lo & 7];
+	wr16(a,x);
+      } else {
+	x=rd16(a);
+	cpu.r[lo & 7]=x;
+      }
+      flags16(x);
+      break;
+
+    case 0x79:				// mov.w #xx:16,rd
+      if(hi)
+	return CPU_ILLEGAL;
+      x=fetch();
+      cpu.r[lo & 7]=x;
+      flags16(x);
+      break;
+
+    case 0x7b:				// eepmov
+      if(b!=0x5c || fetch()!=0x598f)
+	return CPU_ILLEGAL;
+      st+=mem_states(cpu.r[5],0)+mem_states(cpu.r[6],0);
+      for(v=cpu.r[4] & 0xff; v; v--) {
+	wr8(cpu.r[6],rd8(cpu.r[5]));
+	cpu.r[5]++;
+	cpu.r[6]++;
+      }
+      cpu.r[4]&=0xff00;
+      break;
+
+    case 0x7c:				// bit test ops on @rd
+    case 0x7d:				// bit set ops on @rd
+      w2=fetch();
+      if(!bit_mem(cpu.r[hi & 7],w2,op & 1))
+	return CPU_ILLEGAL;
+      break;
+    case 0x7e:				// bit test ops on @aa:8
+    case 0x7f:				// bit set ops on @aa:8
+      w2=fetch();
+      if(!bit_mem(0xff00 | b,w2,op & 1))
+	return CPU_ILLEGAL;
+      break;
+
+    default:
+      switch(op & 0xf0) {
+	case 0x80:			// add.b #xx,rd
+	  set8(op & 0xf,add8(reg8(op & 0xf),b,0,0));
+	  break;
+	case 0x90:			// addx #xx,rd
+	  set8(op & 0xf,add8(reg8(op & 0xf),b,cpu.ccr & CCR_C,1));
+	  break;
+	case 0xa0:			// cmp.b #xx,rd
+	  sub8(reg8(op & 0xf),b,0,0);
+	  break;
+	case 0xb0:			// subx #xx,rd
+	  set8(op & 0xf,sub8(reg8(op & 0xf),b,cpu.ccr & CCR_C,1));
+	  break;
+	case 0xc0:			// or.b #xx,rd
+	  v=reg8(op & 0xf) | b;
+	  set8(op & 0xf,v);
+	  flags8(v);
+	  break;
+	case 0xd0:			// xor.b #xx,rd
+	  v=reg8(op & 0xf) ^ b;
+	  set8(op & 0xf,v);
+	  flags8(v);
+	  break;
+	case 0xe0:			// and.b #xx,rd
+	  v=reg8(op & 0xf) & b;
+	  set8(op & 0xf,v);
+	  flags8(v);
+	  break;
+	case 0xf0:			// mov.b #xx,rd
+	  set8(op & 0xf,b);
+	  flags8(b);
+	  break;
+	default:
+	  return CPU_ILLEGAL;
+      }
+      break;
+  }
+  return CPU_OK;
+}
+
+cpu_status_t cpu_step(unsigned *states) {
+  unsigned short pc=cpu.pc;
+  cpu_status_t status=CPU_OK;
+  int vector=0, insn=0;
+
+  st=0;
+  if(!cpu.irq_hold)
+    vector=io_irq(cpu.ccr & CCR_I);
+  cpu.irq_hold=0;
+
+  if(vector) {
+    interrupt(vector);
+    pc=cpu.pc;				// charge the handler
+    profile_call(pc);
+  } else if(cpu.sleeping) {
+    st=io_quiet();			// charged to the sleep instruction
+    pc-=2;
+  } else {
+    status=execute();
+    if(status!=CPU_OK)
+      cpu.pc=pc;
+    insn=1;
+  }
+
+  profile_account(pc,st,insn);
+  *states=st;
+  return status;
+}
@@ -0,0 +1,173 @@
+/*! \file   h8sim.c
+    \brief  H8/300 simulator: command line and main loop
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  usage: h8sim [options] brickOS.srec
+ *
+ *  Runs a kernel image for a fixed stretch of simulated time and
+ *  prints the states spent per symbol. With a baseline report from
+ *  an earlier run, symbols that got slower by more than the threshold
+ *  are flagged and the exit status is 1, so two kernel builds can be
+ *  compared from a script.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "h8sim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+states_t sim_now;			//!< states since reset
+const char *sim_halt_reason;		//!< why the simulation stopped
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static void usage(const char *progname) {
+  fprintf(stderr,
+	  "usage: %s [options] brickOS.srec\n"
+	  "  -m<map>        kernel symbol map (brickOS.map)\n"
+	  "  -r<rom.srec>   ROM image (default: stubs for the ROM entry points)\n"
+	  "  -p<prog.lx>    download program over the simulated IR link\n"
+	  "  -M<prog.dmap>  symbol map of the program\n"
+	  "  -P<prognum>    program number (default 1)\n"
+	  "  -z             download the program LZSS compressed\n"
+	  "  -i<file>       put a recorded byte stream on the IR link\n"
+	  "  -t<msecs>      simulated time (default 10000)\n"
+	  "  -w<states>     external bus wait states (default 0)\n"
+	  "  -a<ch>=<val>   10 bit A/D input of channel ch (default 1023)\n"
+	  "  -o<file>       write the report to file (default stdout)\n"
+	  "  -d<file>       write the memory image to file when stopped\n"
+	  "  -b<file>       compare with a baseline report\n"
+	  "  -T<percent>    regression threshold (default 1)\n",
+	  progname);
+  exit(2);
+}
+
+int main(int argc,char **argv) {
+  const char *kernel_map=NULL, *rom=NULL, *prog_lx=NULL, *prog_map=NULL;
+  const char *output=NULL, *baseline=NULL, *dump=NULL, *replay=NULL;
+  unsigned long msecs=10000;
+  double threshold=1.0;
+  int prog=1, lzss=0, opt, ch, regressed;
+  unsigned val, states;
+  long entry;
+  states_t limit;
+  cpu_status_t status=CPU_OK;
+  FILE *out=stdout;
+
+  while((opt=getopt(argc,argv,"m:r:p:M:P:zi:t:w:a:o:d:b:T:"))!=-1) {
+    switch(opt) {
+      case 'm': kernel_map=optarg; break;
+      case 'r': rom=optarg; break;
+      case 'p': prog_lx=optarg; break;
+      case 'M': prog_map=optarg; break;
+      case 'P': prog=atoi(optarg); break;
+      case 'z': lzss=1; break;
+      case 'i': replay=optarg; break;
+      case 't': msecs=strtoul(optarg,NULL,0); break;
+      case 'w': mem_wait=atoi(optarg); break;
+      case 'o': output=optarg; break;
+      case 'd': dump=optarg; break;
+      case 'b': baseline=optarg; break;
+      case 'T': threshold=atof(optarg); break;
+      case 'a':
+	if(sscanf(optarg,"%d=%u",&ch,&val)!=2 || ch<0 || ch>7) {
+	  fprintf(stderr,"%s: bad A/D input %s\n",argv[0],optarg);
+	  return 2;
+	}
+	io_set_analog(ch,val);
+	break;
+      default:
+	usage(argv[0]);
+    }
+  }
+  if(optind!=argc-1)
+    usage(argv[0]);
+  if(prog<1 || prog>8) {
+    fprintf(stderr,"%s: program not in range 1..8\n",argv[0]);
+    return 2;
+  }
+
+  // the ROM first, the kernel overlays whatever it likes
+  //
+  io_reset();
+  if(rom) {
+    if(mem_load_srec(rom)<0)
+      return 2;
+  } else
+    mem_rom_stubs();
+  if((entry=mem_load_srec(argv[optind]))<0)
+    return 2;
+  if(kernel_map && profile_load_map(kernel_map,0))
+    return 2;
+  if(prog_lx && link_download(prog_lx,prog_map,prog,lzss))
+    return 2;
+  if(replay && link_replay(replay))
+    return 2;
+
+  cpu_reset(entry);
+  limit=(states_t) msecs*(H8_CLOCK/1000);
+  while(sim_now<limit) {
+    status=cpu_step(&states);
+    io_advance(states);
+    sim_now+=states;
+    if(status!=CPU_OK || sim_halt_reason)
+      break;
+    link_poll();
+  }
+
+  if(status==CPU_HALT)
+    sim_halt_reason=cpu.pc==ROM_POWER_OFF ? "power off" : "ROM reset";
+  else if(status==CPU_ILLEGAL)
+    sim_halt_reason="illegal instruction";
+  else if(!sim_halt_reason)
+    sim_halt_reason="time limit";
+  if(link_busy())
+    fprintf(stderr,"%s: program download incomplete\n",argv[0]);
+
+  if(dump && mem_dump(dump))
+    return 2;
+
+  if(output && (out=fopen(output,"w"))==NULL) {
+    perror(output);
+    return 2;
+  }
+  fprintf(out,"# %s: %llu states, %.6f s\n",argv[optind],
+	  sim_now,(double) sim_now/H8_CLOCK);
+  fprintf(out,"# stopped: %s at 0x%04x (%s)\n",
+	  sim_halt_reason,cpu.pc,profile_symbol(cpu.pc));
+  if(replay)
+    fprintf(out,"# replayed: %ld bytes of %s\n",link_replayed(),replay);
+  regressed=profile_report(out,baseline,threshold);
+  if(out!=stdout)
+    fclose(out);
+
+  if(status==CPU_ILLEGAL)
+    fprintf(stderr,"%s: illegal instruction at 0x%04x (%s)\n",
+	    argv[0],cpu.pc,profile_symbol(cpu.pc));
+  return (status==CPU_ILLEGAL || regressed) ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+/*! \file   h8sim.h
+    \brief  H8/300 simulator for the RCX: shared definitions
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+#ifndef __h8sim_h__
+#define __h8sim_h__
+
+#include <stdio.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define H8_CLOCK	16000000UL	//!< RCX system clock (states/s)
+
+typedef unsigned long long states_t;	//!< a point in time, in states
+
+//! the CPU registers
+typedef struct {
+  unsigned short r[8];			//!< r0..r7, r7 is sp
+  unsigned short pc;			//!< program counter
+  unsigned char ccr;			//!< condition code register
+  unsigned char sleeping;		//!< SLEEP executed, waiting for IRQ
+  unsigned char irq_hold;		//!< no IRQ after this instruction
+} cpu_t;
+
+// condition code bits
+//
+#define CCR_I	0x80			//!< interrupt mask
+#define CCR_H	0x20			//!< half carry
+#define CCR_N	0x08			//!< negative
+#define CCR_Z	0x04			//!< zero
+#define CCR_V	0x02			//!< overflow
+#define CCR_C	0x01			//!< carry
+
+//! reasons for cpu_step() to stop the simulation
+typedef enum {
+  CPU_OK,				//!< keep going
+  CPU_HALT,				//!< ROM reset / power off reached
+  CPU_ILLEGAL				//!< undefined opcode
+} cpu_status_t;
+
+// memory map
+//
+#define MEM_ROM_END	0x8000		//!< ROM area, read only
+#define MEM_ONCHIP_ROM	0x4000		//!< end of on-chip ROM
+#define MEM_RAM		0xfd80		//!< on-chip RAM
+#define MEM_RESERVED	0xff80		//!< end of on-chip RAM
+#define MEM_REGS	0xff88		//!< on-chip register field
+
+#define MEM_VECTORS	0xfd90		//!< RAM interrupt vectors (reset_vector)
+#define MEM_STACK_TOP	0xff80		//!< initial stack pointer
+
+// ROM entry points (see h8300.rcx)
+//
+#define ROM_RESET	0x03ae		//!< cold start
+#define ROM_DUMMY	0x046a		//!< empty interrupt handler
+#define ROM_OCIA	0x04cc		//!< compare A dispatch
+#define ROM_POWER_OFF	0x2a62		//!< power off
+
+// interrupt vector numbers of the H8/3292
+//
+#define VEC_NMI		3
+#define VEC_IRQ0	4
+#define VEC_ICIA	12
+#define VEC_OCIA	16
+#define VEC_OCIB	17
+#define VEC_FOVI	18
+#define VEC_CMI0A	19
+#define VEC_ERI		27
+#define VEC_RXI		28
+#define VEC_TXI		29
+#define VEC_TEI		30
+#define VEC_ADI		35
+#define VEC_WOVI	36
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+extern cpu_t cpu;			//!< the CPU
+extern states_t sim_now;		//!< states since reset
+extern unsigned char mem[0x10000];	//!< memory image
+extern int mem_wait;			//!< external bus wait states
+extern const char *sim_halt_reason;	//!< why the simulation stopped
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// cpu.c
+//
+
+//! reset the CPU to start at entry with the stack at MEM_STACK_TOP
+extern void cpu_reset(unsigned short entry);
+
+//! execute one instruction or take one interrupt
+/*! \param states is set to the states used
+    \return CPU_OK or the reason to stop
+*/
+extern cpu_status_t cpu_step(unsigned *states);
+
+// mem.c
+//
+
+//! states for a byte (word=0) or word (word=1) access to addr
+extern unsigned mem_states(unsigned short addr,int word);
+
+extern unsigned char mem_read8(unsigned short addr);
+extern void mem_write8(unsigned short addr,unsigned char val);
+extern unsigned short mem_read16(unsigned short addr);
+extern void mem_write16(unsigned short addr,unsigned short val);
+
+//! fill the ROM area with stubs for the ROM entry points brickOS uses
+extern void mem_rom_stubs(void);
+
+//! load an S-record file
+/*! \return the start address, or -1 on error
+*/
+extern long mem_load_srec(const char *filename);
+
+//! write the 64k memory image to a file
+/*! \return 0 on success
+*/
+extern int mem_dump(const char *filename);
+
+// io.c
+//
+
+extern void io_reset(void);
+extern unsigned char io_read(unsigned short addr);
+extern void io_write(unsigned short addr,unsigned char val);
+extern void io_write16(unsigned short addr,unsigned short val);
+
+//! run the on-chip peripherals for some states
+extern void io_advance(unsigned states);
+
+//! states until a peripheral may next raise an interrupt
+extern unsigned io_quiet(void);
+
+//! highest priority interrupt request pending, or 0
+/*! \param masked nonzero if the CCR I bit is set (only NMI is taken)
+*/
+extern int io_irq(int masked);
+
+//! the interrupt for vector was taken
+extern void io_irq_taken(int vector);
+
+//! set the analog input of A/D channel ch (10 bit)
+extern void io_set_analog(int ch,unsigned value);
+
+//! receiver side of the IR link: put a byte on the air for the RCX
+/*! \return 0 if the line is busy, try again later
+*/
+extern int io_ir_send(unsigned char c);
+
+// link.c
+//
+
+//! schedule a program download over the simulated IR link
+/*! \param map symbol map of the program, loaded once it is relocated
+    \param lzss nonzero to send it compressed (CONF_PROGRAM_LZSS kernels)
+    \return 0 if the program could be read
+*/
+extern int link_download(const char *filename,const char *map,int prog,
+			 int lzss);
+
+//! schedule a recorded byte stream for the RCX, after any download
+/*! \return 0 if the file could be read
+*/
+extern int link_replay(const char *filename);
+
+//! bytes of the recorded stream put on the air so far
+extern long link_replayed(void);
+
+//! a byte the RCX transmitted
+extern void link_receive(unsigned char c);
+
+//! drive the host side of the link
+extern void link_poll(void);
+
+//! nonzero while a download is in progress
+extern int link_busy(void);
+
+// profile.c
+//
+
+//! read an nm symbol map (as made for merge-map)
+/*! \param offset is added to each address (for relocated programs)
+*/
+extern int profile_load_map(const char *filename,long offset);
+
+//! attribute states spent at pc
+/*! \param insn 1 for an instruction, 0 for an interrupt or sleeping
+*/
+extern void profile_account(unsigned short pc,unsigned states,int insn);
+
+//! control was transferred to addr by a call or interrupt
+extern void profile_call(unsigned short addr);
+
+//! name of the symbol containing addr (for messages)
+extern const char *profile_symbol(unsigned short addr);
+
+//! print the report; compare with baseline if not NULL
+/*! \return nonzero if a symbol regressed beyond threshold percent
+*/
+extern int profile_report(FILE *out,const char *baseline,double threshold);
+
+#endif // __h8sim_h__
@@ -0,0 +1,524 @@
+/*! \file   io.c
+    \brief  H8/300 simulator: on-chip peripherals of the H8/3292
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Modelled are the peripherals brickOS takes interrupts from: the
+ *  16 bit free running timer, the watchdog timer (clock NMI), the
+ *  serial port (IR) and the A/D converter. The serial port echoes
+ *  what it sends, like the IR receiver does, and exchanges bytes
+ *  with the host side in link.c at the programmed bit rate. Port
+ *  pins read high (keys released), A/D inputs read open. The 8 bit
+ *  timers only make the IR carrier on the RCX and are plain
+ *  registers here.
+ */
+
+#include "h8sim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define FRT_TIER	0xff90		//!< 16 bit timer IRQ enables
+#define FRT_TCSR	0xff91		//!< control / status
+#define FRT_FRC		0xff92		//!< counter
+#define FRT_OCR		0xff94		//!< compare A or B, by TOCR_OCRS
+#define FRT_TCR		0xff96		//!< control (clock select)
+#define FRT_TOCR	0xff97		//!< compare control
+
+#define TOCR_OCRS	0x10		//!< compare B selected
+#define TCSR_OCFA	0x08
+#define TCSR_OCFB	0x04
+#define TCSR_OVF	0x02
+#define TCSR_CCLRA	0x01
+
+#define WDT_TCSR	0xffa8		//!< watchdog control / status
+#define WDT_TCNT	0xffa9		//!< watchdog counter
+
+#define WDT_OVF		0x80
+#define WDT_WT		0x40		//!< watchdog (not interval) mode
+#define WDT_TME		0x20		//!< timer enable
+#define WDT_RST		0x08		//!< reset, not NMI, on overflow
+
+#define PORT_DDR1	0xffb0		//!< first data direction register
+#define PORT_DR7	0xffbe		//!< port 7, input only
+
+#define SCI_SMR		0xffd8		//!< serial mode
+#define SCI_BRR		0xffd9		//!< bit rate
+#define SCI_SCR		0xffda		//!< serial control
+#define SCI_TDR		0xffdb		//!< transmit data
+#define SCI_SSR		0xffdc		//!< serial status
+#define SCI_RDR		0xffdd		//!< receive data
+
+#define SCR_TIE		0x80
+#define SCR_RIE		0x40
+#define SCR_TE		0x20
+#define SCR_RE		0x10
+#define SCR_TEIE	0x04
+
+#define SSR_TDRE	0x80
+#define SSR_RDRF	0x40
+#define SSR_ORER	0x20
+#define SSR_FER		0x10
+#define SSR_PER		0x08
+#define SSR_TEND	0x04
+
+#define AD_ADDR		0xffe0		//!< A/D data A..D, high and low
+#define AD_ADCSR	0xffe8		//!< A/D control / status
+#define AD_ADCR		0xffe9		//!< A/D control
+
+#define ADCSR_ADF	0x80
+#define ADCSR_ADIE	0x40
+#define ADCSR_ADST	0x20
+#define ADCSR_SCAN	0x10
+#define ADCSR_CKS	0x08
+
+#define IO_QUIET_MAX	(H8_CLOCK/1000)	//!< longest step while sleeping
+
+#define REG(a)		(reg[(a)-MEM_REGS])
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Internal Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static unsigned char reg[0x10000-MEM_REGS];	//!< plain registers
+
+// 16 bit free running timer
+//
+static unsigned frt_frc,frt_ocra,frt_ocrb;
+static unsigned char frt_tier,frt_tcsr;
+static unsigned frt_sub;		//!< states towards the next count
+
+// watchdog timer
+//
+static unsigned char wdt_tcsr,wdt_tcnt;
+static unsigned wdt_sub;		//!< states towards the next count
+static int nmi;				//!< NMI request latch
+
+// serial port
+//
+static unsigned char sci_ssr;
+static unsigned char sci_tsr;		//!< transmit shift register
+static unsigned long sci_tx_left;	//!< states until TSR is on the air
+static unsigned char sci_rx_byte;	//!< host byte on the air
+static unsigned long sci_rx_left;	//!< states until it has arrived
+
+// A/D converter
+//
+static unsigned char ad_adcsr;
+static unsigned ad_channel;		//!< channel being converted
+static unsigned ad_left;		//!< states until it is done
+static unsigned ad_analog[8];		//!< input values, 10 bit
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void io_reset(void) {
+  int i;
+
+  for(i=0; i<(int) sizeof(reg); i++)
+    reg[i]=0;
+
+  frt_frc=0;
+  frt_ocra=frt_ocrb=0xffff;
+  frt_tier=0x01;
+  frt_tcsr=0;
+  frt_sub=0;
+  REG(FRT_TOCR)=0xe0;
+
+  wdt_tcsr=0x18;
+  wdt_tcnt=0;
+  wdt_sub=0;
+  nmi=0;
+
+  REG(SCI_BRR)=0xff;
+  REG(SCI_TDR)=0xff;
+  sci_ssr=SSR_TDRE | SSR_TEND;
+  sci_tx_left=sci_rx_left=0;
+
+  ad_adcsr=0;
+  ad_left=0;
+  for(i=0; i<8; i++)
+    ad_analog[i]=0x3ff;
+}
+
+void io_set_analog(int ch,unsigned value) {
+  ad_analog[ch & 7]=value & 0x3ff;
+}
+
+//! states per 16 bit timer count, 0 for the external clock
+static unsigned frt_prescale(void) {
+  static const unsigned div[4]={ 2, 8, 32, 0 };
+
+  return div[REG(FRT_TCR) & 3];
+}
+
+//! states per watchdog count
+static unsigned wdt_prescale(void) {
+  static const unsigned div[8]={ 2, 32, 64, 128, 256, 512, 2048, 4096 };
+
+  return div[wdt_tcsr & 7];
+}
+
+//! states per serial frame
+static unsigned long sci_frame(void) {
+  unsigned char smr=REG(SCI_SMR);
+  unsigned long bit=(32UL<<(2*(smr & 3))) * (REG(SCI_BRR)+1);
+  int bits=1 + ((smr & 0x40) ? 7 : 8) + ((smr & 0x20) ? 1 : 0)
+             + ((smr & 0x04) ? 1 : 0) + ((smr & 0x08) ? 2 : 1);
+
+  return bit*bits;
+}
+
+//! states per A/D conversion
+static unsigned ad_time(void) {
+  return (ad_adcsr & ADCSR_CKS) ? 134 : 266;
+}
+
+//! move TDR to the shift register, if there is something to send
+static void sci_tx_start(unsigned long late) {
+  if(!(REG(SCI_SCR) & SCR_TE) || (sci_ssr & SSR_TDRE)) {
+    sci_ssr|=SSR_TEND;
+    return;
+  }
+  sci_tsr=REG(SCI_TDR);
+  sci_ssr|=SSR_TDRE;
+  sci_tx_left=sci_frame()-late;
+}
+
+//! a byte arrived at the receiver
+static void sci_receive(unsigned char c) {
+  if(!(REG(SCI_SCR) & SCR_RE))
+    return;
+  if(sci_ssr & SSR_RDRF)
+    sci_ssr|=SSR_ORER;
+  else {
+    REG(SCI_RDR)=c;
+    sci_ssr|=SSR_RDRF;
+  }
+}
+
+int io_ir_send(unsigned char c) {
+  if(sci_tx_left || sci_rx_left)
+    return 0;
+  sci_rx_byte=c;
+  sci_rx_left=sci_frame();
+  return 1;
+}
+
+//! start converting the first channel
+static void ad_start(void) {
+  ad_channel=(ad_adcsr & ADCSR_SCAN) ? (ad_adcsr & 4) : (ad_adcsr & 7);
+  ad_left=ad_time();
+}
+
+//! a conversion is done
+static void ad_done(void) {
+  unsigned v=ad_analog[ad_channel];
+  unsigned last=ad_adcsr & 7;
+
+  REG(AD_ADDR+2*(ad_channel & 3)  )=v>>2;
+  REG(AD_ADDR+2*(ad_channel & 3)+1)=v<<6;
+
+  if(!(ad_adcsr & ADCSR_SCAN)) {
+    ad_adcsr=(ad_adcsr & ~ADCSR_ADST) | ADCSR_ADF;
+    ad_left=0;
+  } else if(ad_channel==last) {
+    ad_adcsr|=ADCSR_ADF;
+    ad_start();				// scan until ADST is cleared
+  } else {
+    ad_channel++;
+    ad_left=ad_time();
+  }
+}
+
+//! the 16 bit timer counts once
+static void frt_count(void) {
+  if((frt_tcsr & TCSR_CCLRA) && frt_frc==frt_ocra)
+    frt_frc=0;
+  else if(++frt_frc>0xffff) {
+    frt_frc=0;
+    frt_tcsr|=TCSR_OVF;
+  }
+  if(frt_frc==frt_ocra)
+    frt_tcsr|=TCSR_OCFA;
+  if(frt_frc==frt_ocrb)
+    frt_tcsr|=TCSR_OCFB;
+}
+
+//! the watchdog counts once
+static void wdt_count(void) {
+  if(++wdt_tcnt)
+    return;
+  wdt_tcsr|=WDT_OVF;
+  if(wdt_tcsr & WDT_WT) {
+    if(wdt_tcsr & WDT_RST)
+      sim_halt_reason="watchdog reset";
+    else
+      nmi=1;
+  }
+}
+
+void io_advance(unsigned states) {
+  unsigned presc;
+
+  if((presc=frt_prescale())!=0)
+    for(frt_sub+=states; frt_sub>=presc; frt_sub-=presc)
+      frt_count();
+
+  if(wdt_tcsr & WDT_TME) {
+    presc=wdt_prescale();
+    for(wdt_sub+=states; wdt_sub>=presc; wdt_sub-=presc)
+      wdt_count();
+  }
+
+  if(sci_tx_left) {
+    if(sci_tx_left>states)
+      sci_tx_left-=states;
+    else {
+      unsigned long late=states-sci_tx_left;
+
+      sci_tx_left=0;
+      sci_receive(sci_tsr);		// we hear ourselves
+      link_receive(sci_tsr);
+      sci_tx_start(late);
+    }
+  }
+
+  if(sci_rx_left) {
+    if(sci_rx_left>states)
+      sci_rx_left-=states;
+    else {
+      sci_rx_left=0;
+      sci_receive(sci_rx_byte);
+    }
+  }
+
+  if(ad_left) {
+    if(ad_left>states)
+      ad_left-=states;
+    else {
+      unsigned late=states-ad_left;
+
+      ad_done();
+      if(ad_left)			// next channel of a scan
+	ad_left=late<ad_left ? ad_left-late : 1;
+    }
+  }
+}
+
+//! states until the counter reaches target, ~0 if it does not
+static unsigned long frt_until(unsigned long target,unsigned presc) {
+  unsigned long counts;
+
+  if((frt_tcsr & TCSR_CCLRA) && frt_frc<=frt_ocra) {
+    if(target>frt_ocra)
+      return ~0UL;			// cleared before
+    counts=target>frt_frc ? target-frt_frc : frt_ocra-frt_frc+1+target;
+  } else
+    counts=target>frt_frc ? target-frt_frc : 0x10000-frt_frc+target;
+  return counts*presc-frt_sub;
+}
+
+unsigned io_quiet(void) {
+  unsigned long quiet=IO_QUIET_MAX, t;
+  unsigned presc;
+
+  if((presc=frt_prescale())!=0) {
+    if((t=frt_until(frt_ocra,presc))<quiet)
+      quiet=t;
+    if((t=frt_until(frt_ocrb,presc))<quiet)
+      quiet=t;
+    if((t=frt_until(0x10000,presc))<quiet)
+      quiet=t;
+  }
+  if(wdt_tcsr & WDT_TME) {
+    t=(0x100-wdt_tcnt)*(unsigned long) wdt_prescale()-wdt_sub;
+    if(t<quiet)
+      quiet=t;
+  }
+  if(sci_tx_left && sci_tx_left<quiet)
+    quiet=sci_tx_left;
+  if(sci_rx_left && sci_rx_left<quiet)
+    quiet=sci_rx_left;
+  if(ad_left && ad_left<quiet)
+    quiet=ad_left;
+
+  return quiet ? quiet : 1;
+}
+
+int io_irq(int masked) {
+  unsigned char scr;
+
+  if(nmi)
+    return VEC_NMI;
+  if(masked)
+    return 0;
+
+  if(frt_tcsr & frt_tier & TCSR_OCFA)
+    return VEC_OCIA;
+  if(frt_tcsr & frt_tier & TCSR_OCFB)
+    return VEC_OCIB;
+  if(frt_tcsr & frt_tier & TCSR_OVF)
+    return VEC_FOVI;
+
+  scr=REG(SCI_SCR);
+  if((scr & SCR_RIE) && (sci_ssr & (SSR_ORER | SSR_FER | SSR_PER)))
+    return VEC_ERI;
+  if((scr & SCR_RIE) && (sci_ssr & SSR_RDRF))
+    return VEC_RXI;
+  if((scr & SCR_TIE) && (sci_ssr & SSR_TDRE))
+    return VEC_TXI;
+  if((scr & SCR_TEIE) && (sci_ssr & SSR_TEND))
+    return VEC_TEI;
+
+  if((ad_adcsr & ADCSR_ADF) && (ad_adcsr & ADCSR_ADIE))
+    return VEC_ADI;
+  if((wdt_tcsr & WDT_OVF) && !(wdt_tcsr & WDT_WT))
+    return VEC_WOVI;
+
+  return 0;
+}
+
+void io_irq_taken(int vector) {
+  if(vector==VEC_NMI)
+    nmi=0;				// edge triggered
+}
+
+unsigned char io_read(unsigned short addr) {
+  switch(addr) {
+    case FRT_TIER:  return frt_tier | 0x01;
+    case FRT_TCSR:  return frt_tcsr;
+    case FRT_FRC:   return frt_frc>>8;
+    case FRT_FRC+1: return frt_frc;
+    case FRT_OCR:
+      return ((REG(FRT_TOCR) & TOCR_OCRS) ? frt_ocrb : frt_ocra)>>8;
+    case FRT_OCR+1:
+      return (REG(FRT_TOCR) & TOCR_OCRS) ? frt_ocrb : frt_ocra;
+
+    case WDT_TCSR:  return wdt_tcsr | 0x18;
+    case WDT_TCNT:  return wdt_tcnt;
+
+    case SCI_SSR:   return sci_ssr;
+
+    case AD_ADCSR:  return ad_adcsr;
+    case AD_ADCR:   return REG(AD_ADCR) | 0x7f;
+
+    case PORT_DR7:  return 0xff;	// keys released
+  }
+
+  // ports 1-6: data direction registers are write only,
+  // inputs read high
+  //
+  if(addr>=PORT_DDR1 && addr<PORT_DDR1+12) {
+    unsigned short ddr=addr & ~2;
+
+    if(addr & 2)
+      return (REG(addr) & REG(ddr)) | ~REG(ddr);
+    return 0xff;
+  }
+  return REG(addr);
+}
+
+void io_write(unsigned short addr,unsigned char val) {
+  unsigned char old;
+
+  switch(addr) {
+    case FRT_TIER:
+      frt_tier=val;
+      return;
+    case FRT_TCSR:			// flags can only be cleared
+      frt_tcsr=(frt_tcsr & val & ~TCSR_CCLRA) | (val & TCSR_CCLRA);
+      return;
+    case FRT_FRC:
+      frt_frc=(frt_frc & 0x00ff) | (val<<8);
+      return;
+    case FRT_FRC+1:
+      frt_frc=(frt_frc & 0xff00) | val;
+      return;
+    case FRT_OCR:
+    case FRT_OCR+1:
+      {
+	unsigned *ocr=(REG(FRT_TOCR) & TOCR_OCRS) ? &frt_ocrb : &frt_ocra;
+
+	if(addr & 1)
+	  *ocr=(*ocr & 0xff00) | val;
+	else
+	  *ocr=(*ocr & 0x00ff) | (val<<8);
+      }
+      return;
+
+    case WDT_TCSR:
+    case WDT_TCNT:
+      return;				// word writes with password only
+
+    case SCI_SCR:
+      REG(SCI_SCR)=val;
+      if(!(val & SCR_TE))
+	sci_ssr|=SSR_TDRE;
+      return;
+    case SCI_SSR:			// flags can only be cleared
+      old=sci_ssr;
+      sci_ssr=(sci_ssr & (val | 0x07) & ~0x01) | (val & 0x01);
+      if((old & SSR_TDRE) && !(sci_ssr & SSR_TDRE)) {
+	sci_ssr&=~SSR_TEND;
+	if(!sci_tx_left)
+	  sci_tx_start(0);
+      }
+      return;
+    case SCI_RDR:
+      return;
+
+    case AD_ADCSR:
+      old=ad_adcsr;
+      ad_adcsr=(val & ~ADCSR_ADF) | (ad_adcsr & val & ADCSR_ADF);
+      if(!(ad_adcsr & ADCSR_ADST))
+	ad_left=0;
+      else if(!(old & ADCSR_ADST))
+	ad_start();
+      return;
+
+    case PORT_DR7:
+      return;
+  }
+  REG(addr)=val;
+}
+
+void io_write16(unsigned short addr,unsigned short val) {
+  if(addr==WDT_TCSR) {
+    switch(val>>8) {
+      case 0xa5:
+	wdt_tcsr=(val & 0x7f) | (wdt_tcsr & val & WDT_OVF);
+	if(!(wdt_tcsr & WDT_TME)) {
+	  wdt_tcnt=0;
+	  wdt_sub=0;
+	}
+	break;
+      case 0x5a:
+	wdt_tcnt=val;
+	break;
+    }
+    return;
+  }
+  io_write(addr,val>>8);
+  io_write(addr+1,val);
+}
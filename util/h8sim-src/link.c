@@ -0,0 +1,308 @@
+/*! \file   link.c
+    \brief  H8/300 simulator: the host side of the IR link
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  Downloads a program the way dll does - delete, create, data,
+ *  run, each acknowledged by the kernel - so the simulated kernel
+ *  receives, checksums and relocates it with its own code. Bytes go
+ *  on the air only while the line is quiet. Compressed, the data go
+ *  as CMDwindow chunks of LZSS tokens, each acknowledged with the
+ *  bytes expanded so far, so the profile shows the kernel's decoder.
+ *  A recorded byte stream is replayed after the download, byte after
+ *  byte as the line allows, for the states of the receive path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "h8sim.h"
+#include "../dll-src/lx.h"
+#include <lzss.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define LINK_HOST	0x80		//!< dll's address and port
+#define LINK_RCX	0x00		//!< the kernel's program port
+#define LINK_START	(H8_CLOCK/10)	//!< time for the kernel to boot
+#define LINK_TIMEOUT	(H8_CLOCK*3/4)	//!< reply timeout, as dll's
+#define LINK_RETRIES	5		//!< transmit retries, as dll's
+#define LINK_CHUNK	0xf8		//!< data bytes per packet, as dll's
+#define LINK_PRIORITY	10		//!< program priority, as dll's
+
+// program protocol commands (sys/program.h)
+//
+#define CMDacknowledge	0
+#define CMDdelete	1
+#define CMDcreate	2
+#define CMDdata		4
+#define CMDrun		5
+#define CMDwindow	10
+#define PROG_ACK	0x80
+#define PROG_LZSS	0x40
+
+//! download progress
+typedef enum {
+  LINK_OFF,				//!< nothing to do
+  LINK_DELETE,				//!< delete sent
+  LINK_CREATE,				//!< create sent
+  LINK_DATA,				//!< data chunk sent
+  LINK_RUN,				//!< run sent
+  LINK_DONE				//!< program running, or given up
+} link_state_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Internal Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static lx_t lx;				//!< the program
+static const char *link_map;		//!< its symbol map
+static int link_prog;			//!< program slot, 1..8
+static int link_lzss;			//!< send the data compressed
+static link_state_t link_state;
+static unsigned link_offset;		//!< data sent and acknowledged
+
+static unsigned char tx_buf[LINK_CHUNK+16];	//!< packet to send
+static int tx_len,tx_pos;
+static states_t tx_deadline;		//!< resend if no reply by then
+static int tx_tries;
+
+static unsigned char rx_buf[256+4];	//!< packet being received
+static int rx_len;
+
+static unsigned char *replay_buf;	//!< recorded bytes to put on the air
+static long replay_len,replay_pos;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! queue an addressing layer packet to the kernel's program port
+static void link_send(const unsigned char *data,int len) {
+  unsigned char sum=0xff;
+  int i;
+
+  tx_buf[0]=0xf1;
+  tx_buf[1]=len+2;
+  tx_buf[2]=LINK_RCX;
+  tx_buf[3]=LINK_HOST;
+  for(i=0; i<len; i++)
+    tx_buf[4+i]=data[i];
+  for(i=0; i<len+4; i++)
+    sum+=tx_buf[i];
+  tx_buf[len+4]=sum;
+
+  tx_len=len+5;
+  tx_pos=0;
+  tx_tries=0;
+  tx_deadline=0;
+}
+
+//! send the next data chunk, or run the program
+static void link_next(void) {
+  unsigned char buf[LINK_CHUNK+4];
+  unsigned total=lx.text_size+lx.data_size, chunk=total-link_offset, i, len;
+
+  if(chunk==0) {
+    buf[0]=CMDrun;
+    buf[1]=link_prog-1;
+    link_send(buf,2);
+    link_state=LINK_RUN;
+    return;
+  }
+
+  if(link_lzss) {
+    buf[0]=CMDwindow;
+    buf[1]=(link_prog-1) | PROG_ACK | PROG_LZSS;
+    buf[2]=link_offset>>8;
+    buf[3]=link_offset;
+    link_send(buf,lx_compress(&lx,link_offset,buf+4,LINK_CHUNK,&len)+4);
+    link_state=LINK_DATA;
+    return;
+  }
+
+  if(chunk>LINK_CHUNK)
+    chunk=LINK_CHUNK;
+  buf[0]=CMDdata;
+  buf[1]=link_prog-1;
+  buf[2]=link_offset>>8;
+  buf[3]=link_offset;
+  for(i=0; i<chunk; i++)
+    buf[4+i]=lx.text[link_offset+i];
+  link_send(buf,chunk+4);
+  link_state=LINK_DATA;
+}
+
+//! the kernel acknowledged the last packet
+static void link_acknowledged(const unsigned char *data,int len) {
+  unsigned char buf[13];
+  unsigned text;
+
+  switch(link_state) {
+    case LINK_DELETE:
+      buf[ 0]=CMDcreate;
+      buf[ 1]=link_prog-1;
+      buf[ 2]=lx.text_size>>8;
+      buf[ 3]=lx.text_size;
+      buf[ 4]=lx.data_size>>8;
+      buf[ 5]=lx.data_size;
+      buf[ 6]=lx.bss_size>>8;
+      buf[ 7]=lx.bss_size;
+      buf[ 8]=lx.stack_size>>8;
+      buf[ 9]=lx.stack_size;
+      buf[10]=lx.offset>>8;
+      buf[11]=lx.offset;
+      buf[12]=LINK_PRIORITY;
+      link_send(buf,13);
+      link_state=LINK_CREATE;
+      break;
+
+    case LINK_CREATE:
+      if(len!=8)
+	return;				// not the offsets
+      text=(data[2]<<8) | data[3];
+      if(link_map)
+	profile_load_map(link_map,(long) text-lx.base);
+      lx_relocate(&lx,text);
+      link_offset=0;
+      link_next();
+      break;
+
+    case LINK_DATA:
+      if(link_lzss) {
+	if(len!=4)
+	  return;			// not the bytes expanded
+	link_offset=(data[2]<<8) | data[3];
+      } else
+	link_offset+=tx_len-9;		// header, command, offset, checksum
+      link_next();
+      break;
+
+    case LINK_RUN:
+      fprintf(stderr,"h8sim: program %d running at %lu ms\n",link_prog,
+	      (unsigned long) (sim_now/(H8_CLOCK/1000)));
+      link_state=LINK_DONE;
+      break;
+
+    default:
+      break;
+  }
+}
+
+int link_download(const char *filename,const char *map,int prog,int lzss) {
+  unsigned char buf[2];
+
+  if(lx_read(&lx,(const unsigned char *) filename)) {
+    fprintf(stderr,"%s: not a brickOS executable\n",filename);
+    return -1;
+  }
+  link_map=map;
+  link_prog=prog;
+  link_lzss=lzss;
+
+  buf[0]=CMDdelete;
+  buf[1]=link_prog-1;
+  link_send(buf,2);
+  tx_deadline=LINK_START;		// first byte not before
+  link_state=LINK_DELETE;
+  return 0;
+}
+
+int link_replay(const char *filename) {
+  FILE *f;
+  long len;
+
+  if((f=fopen(filename,"rb"))==NULL) {
+    perror(filename);
+    return -1;
+  }
+  if(fseek(f,0,SEEK_END) || (len=ftell(f))<0 || fseek(f,0,SEEK_SET)
+     || (replay_buf=malloc(len+1))==NULL
+     || fread(replay_buf,1,len,f)!=(size_t) len) {
+    fprintf(stderr,"%s: unable to read\n",filename);
+    fclose(f);
+    return -1;
+  }
+  fclose(f);
+
+  replay_len=len;
+  replay_pos=0;
+  return 0;
+}
+
+long link_replayed(void) {
+  return replay_pos;
+}
+
+int link_busy(void) {
+  return link_state!=LINK_OFF && link_state!=LINK_DONE;
+}
+
+void link_receive(unsigned char c) {
+  unsigned char sum=0xff;
+  int i;
+
+  if(!link_busy())
+    return;
+
+  if(rx_len==0 && c!=0xf1)
+    return;				// not an addressing packet
+  rx_buf[rx_len++]=c;
+  if(rx_len<2 || rx_len<rx_buf[1]+3)
+    return;
+
+  for(i=0; i<rx_len-1; i++)
+    sum+=rx_buf[i];
+  if(sum==rx_buf[rx_len-1] && rx_buf[2]==LINK_HOST
+     && rx_buf[1]>2 && rx_buf[4]==CMDacknowledge && tx_pos==tx_len) {
+    tx_len=0;
+    link_acknowledged(rx_buf+4,rx_buf[1]-2);
+  }
+  rx_len=0;
+}
+
+void link_poll(void) {
+  if(!link_busy()) {
+    if(replay_pos<replay_len && sim_now>=LINK_START
+       && io_ir_send(replay_buf[replay_pos]))
+      replay_pos++;
+    return;
+  }
+  if(!tx_len)
+    return;
+
+  if(tx_pos<tx_len) {			// sending
+    if(sim_now>=tx_deadline && io_ir_send(tx_buf[tx_pos])) {
+      if(++tx_pos==tx_len)
+	tx_deadline=sim_now+LINK_TIMEOUT;
+    }
+  } else if(sim_now>=tx_deadline) {	// waiting for the reply
+    if(++tx_tries>LINK_RETRIES) {
+      fprintf(stderr,"h8sim: program download failed\n");
+      link_state=LINK_DONE;
+      return;
+    }
+    tx_pos=0;
+    rx_len=0;
+  }
+}
@@ -0,0 +1,204 @@
+/*! \file   lnpsum.c
+    \brief  H8/300 simulator: states of the LNP checksum routines
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  usage: lnpsum [-w states]
+ *
+ *  Runs _lnp_checksum from kernel/lnp.c, and the byte at a time
+ *  _lnp_checksum_copy it replaced, on the simulated CPU for buffers
+ *  of several lengths at even and odd addresses. Code and data are in
+ *  the external RAM, where the kernel keeps them. Prints the states
+ *  of every call and checks the sums (and the copy) against C.
+ *
+ *  There is no H8 cross compiler here, so both routines are assembled
+ *  by hand below; keep them in step with the source.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "h8sim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define CODE		0x8000		//!< where the routine goes
+#define RETURN		0x8f00		//!< return address, never executed
+#define DATA		0xa000		//!< the bytes to sum
+#define DEST		0xb000		//!< the copy of the old routine
+
+#define MAX_STATES	100000		//!< a runaway routine
+
+//! _lnp_checksum: r0l sum, r1 data, r2 length
+static const unsigned char new_code[]={
+  0x09,0x12,		//     add.w r1,r2
+  0x1d,0x12,		//     cmp.w r1,r2
+  0x47,0x1c,		//     beq   3f
+  0x1b,0x02,		//     subs  #1,r2
+  0x73,0x09,		//     btst  #0,r1l
+  0x47,0x0c,		//     beq   1f
+  0x6c,0x1b,		//     mov.b @r1+,r3l
+  0x08,0xb8,		//     add.b r3l,r0l
+  0x40,0x06,		//     bra   1f
+  0x6d,0x13,		// 0:  mov.w @r1+,r3
+  0x08,0x38,		//     add.b r3h,r0l
+  0x08,0xb8,		//     add.b r3l,r0l
+  0x1d,0x21,		// 1:  cmp.w r2,r1
+  0x45,0xf6,		//     bcs   0b
+  0x46,0x04,		//     bne   3f
+  0x68,0x1b,		//     mov.b @r1,r3l
+  0x08,0xb8,		//     add.b r3l,r0l
+  0x18,0x00,		// 3:  sub.b r0h,r0h
+  0x54,0x70		//     rts
+};
+
+//! _lnp_checksum_copy: r0 dest, r1 data, r2 length (not 0)
+static const unsigned char old_code[]={
+  0x09,0x02,		//     add.w r0,r2
+  0xfb,0xff,		//     mov.b #0xff,r3l
+  0x6c,0x13,		// 0:  mov.b @r1+,r3h
+  0x08,0x3b,		//     add.b r3h,r3l
+  0x68,0x83,		//     mov.b r3h,@r0
+  0x0b,0x00,		//     adds  #1,r0
+  0x1d,0x02,		//     cmp.w r0,r2
+  0x46,0xf4,		//     bne   0b
+  0x19,0x00,		//     sub.w r0,r0
+  0x0c,0xb8,		//     mov.b r3l,r0l
+  0x54,0x70		//     rts
+};
+
+//! a buffer to sum
+typedef struct {
+  unsigned short offset;		//!< from DATA
+  unsigned short length;
+} input_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+states_t sim_now;			//!< states since reset
+const char *sim_halt_reason;		//!< why the simulation stopped
+
+static const input_t inputs[]={
+  { 0,   0 }, { 1,   0 },
+  { 0,   1 }, { 1,   1 },
+  { 0,   2 }, { 1,   2 },
+  { 0,   3 }, { 1,   3 },
+  { 0,   4 }, { 1,   4 },
+  { 0, 255 }, { 1, 255 },
+  { 0, 256 }, { 1, 256 }
+};
+
+static int failures;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//! call the routine at CODE with r0..r2 set
+/*! \return its states, up to and with the rts, or 0 if it ran away
+*/
+static unsigned long call(unsigned short r0,unsigned short r1,
+			  unsigned short r2) {
+  unsigned long total=0;
+  unsigned states;
+
+  cpu_reset(CODE);
+  cpu.ccr=CCR_I;
+  cpu.r[0]=r0;
+  cpu.r[1]=r1;
+  cpu.r[2]=r2;
+  cpu.r[7]-=2;
+  mem_write16(cpu.r[7],RETURN);
+
+  while(cpu.pc!=RETURN) {
+    if(cpu_step(&states)!=CPU_OK || total>MAX_STATES)
+      return 0;
+    io_advance(states);
+    sim_now+=states;
+    total+=states;
+  }
+  return total;
+}
+
+//! report and check a call
+static void check(const char *name,const input_t *in,unsigned long states,
+		  int ok) {
+  printf("%-20s %s %3u bytes: %5lu states",name,
+	 in->offset & 1 ? "odd " : "even",in->length,states);
+  if(in->length>1)
+    printf(", %5.1f per byte",(double) states/in->length);
+  puts(ok && states ? "" : "  FAILED");
+  if(!ok || !states)
+    failures++;
+}
+
+int main(int argc,char **argv) {
+  unsigned i,j;
+  int opt;
+
+  while((opt=getopt(argc,argv,"w:"))!=-1) {
+    switch(opt) {
+      case 'w': mem_wait=atoi(optarg); break;
+      default:
+	fprintf(stderr,"usage: %s [-w states]\n",argv[0]);
+	return 2;
+    }
+  }
+
+  io_reset();
+  for(i=0; i<0x200; i++)
+    mem_write8(DATA+i,i*37+11);
+
+  for(i=0; i<sizeof(inputs)/sizeof(inputs[0]); i++) {
+    const input_t *in=inputs+i;
+    unsigned char sum=0xff;
+    unsigned long states;
+
+    for(j=0; j<in->length; j++)
+      sum+=mem_read8(DATA+in->offset+j);
+
+    for(j=0; j<sizeof(new_code); j++)
+      mem_write8(CODE+j,new_code[j]);
+    states=call(0xff,DATA+in->offset,in->length);
+    check("_lnp_checksum",in,states,cpu.r[0]==sum);
+
+    if(in->length==0)			// it would copy 64k
+      continue;
+    for(j=0; j<sizeof(old_code); j++)
+      mem_write8(CODE+j,old_code[j]);
+    for(j=0; j<in->length; j++)
+      mem_write8(DEST+j,0);
+    states=call(DEST,DATA+in->offset,in->length);
+    for(j=0; j<in->length; j++)
+      if(mem_read8(DEST+j)!=mem_read8(DATA+in->offset+j))
+	break;
+    check("_lnp_checksum_copy",in,states,cpu.r[0]==sum && j==in->length);
+  }
+
+  if(failures)
+    printf("%d calls failed\n",failures);
+  return failures!=0;
+}
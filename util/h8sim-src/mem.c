@@ -0,0 +1,202 @@
+/*! \file   mem.c
+    \brief  H8/300 simulator: RCX memory map and bus timing
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  The RCX runs the H8/3292 in mode 2: 16k on-chip ROM at 0x0000,
+ *  512 bytes on-chip RAM at 0xfd80 and the register field at 0xff88
+ *  take two states per access (three for a register byte, two
+ *  accesses for a register word). Everything else - the 32k RAM,
+ *  lcddata at 0xef30 and the motor controller at 0xf000 - hangs off
+ *  the 8 bit external bus: three states per byte plus wait states,
+ *  a word is two byte accesses.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "h8sim.h"
+#include "../firmdl/srec.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned char mem[0x10000];		//!< memory image
+int mem_wait;				//!< external bus wait states
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+unsigned mem_states(unsigned short addr,int word) {
+  if(addr<MEM_ONCHIP_ROM || (addr>=MEM_RAM && addr<MEM_RESERVED))
+    return 2;
+  if(addr>=MEM_REGS)
+    return word ? 6 : 3;
+  return word ? 6+2*mem_wait : 3+mem_wait;
+}
+
+unsigned char mem_read8(unsigned short addr) {
+  if(addr>=MEM_REGS)
+    return io_read(addr);
+  return mem[addr];
+}
+
+void mem_write8(unsigned short addr,unsigned char val) {
+  if(addr<MEM_ROM_END)
+    return;
+  if(addr>=MEM_REGS)
+    io_write(addr,val);
+  else
+    mem[addr]=val;
+}
+
+//! words are big endian, the address LSB is ignored
+unsigned short mem_read16(unsigned short addr) {
+  addr&=~1;
+  if(addr>=MEM_REGS)
+    return (io_read(addr)<<8) | io_read(addr+1);
+  return (mem[addr]<<8) | mem[addr+1];
+}
+
+void mem_write16(unsigned short addr,unsigned short val) {
+  addr&=~1;
+  if(addr<MEM_ROM_END)
+    return;
+  if(addr>=MEM_REGS)
+    io_write16(addr,val);
+  else {
+    mem[addr  ]=val>>8;
+    mem[addr+1]=val;
+  }
+}
+
+//! put a big endian word into the ROM image
+static void rom_word(unsigned short addr,unsigned short val) {
+  mem[addr  ]=val>>8;
+  mem[addr+1]=val;
+}
+
+//! build a dispatcher for vector like the ROM's
+/*! push r6 / mov.w @ram_vector,r6 / jsr @r6 / pop r6 / rte.
+    the compare A dispatcher must end at rom_ocia_return (0x04d4),
+    tm.c builds initial task stacks that return there.
+*/
+static unsigned short rom_dispatcher(unsigned short addr,int vector,
+                                     unsigned short ram_vector) {
+  rom_word(2*vector,addr);
+  rom_word(addr   ,0x6df6);
+  rom_word(addr+ 2,0x6b06);
+  rom_word(addr+ 4,ram_vector);
+  rom_word(addr+ 6,0x5d60);
+  rom_word(addr+ 8,0x6d76);
+  rom_word(addr+10,0x5670);
+  return addr+12;
+}
+
+void mem_rom_stubs(void) {
+  static const struct {
+    int vector;				// H8/3292 vector number
+    int index;				// index into the RAM vectors
+  } dispatch[]={
+    { VEC_NMI  , 1}, { VEC_IRQ0  , 2}, { VEC_IRQ0+1, 3}, { VEC_IRQ0+2, 4},
+    { VEC_ICIA , 5}, { VEC_ICIA+1, 6}, { VEC_ICIA+2, 7}, { VEC_ICIA+3, 8},
+    { VEC_OCIB ,10}, { VEC_FOVI  ,11},
+    { VEC_CMI0A,12}, { VEC_CMI0A+1,13}, { VEC_CMI0A+2,14},
+    { VEC_CMI0A+3,15}, { VEC_CMI0A+4,16}, { VEC_CMI0A+5,17},
+    { VEC_ERI  ,18}, { VEC_RXI   ,19}, { VEC_TXI   ,20}, { VEC_TEI   ,21},
+    { VEC_ADI  ,22}, { VEC_WOVI  ,23}
+  };
+  static const unsigned short returns[]={
+    0x042a,				// rom_memcpy
+    0x1b62, 0x1e4a, 0x1ff2, 0x27ac,	// lcd_show, lcd_hide, lcd_number, lcd_clear
+    0x2964, 0x299a, 0x3ccc,		// power_init, sound_system, sound_playing
+    ROM_DUMMY
+  };
+  unsigned short addr;
+  unsigned i;
+
+  // undefined opcodes everywhere stop a run that strays into the ROM
+  //
+  for(addr=0; addr<MEM_ROM_END; addr+=2)
+    rom_word(addr,0x5200);
+
+  rom_word(0,ROM_RESET);		// rom_reset_vector
+  rom_word(ROM_RESET,0x5201);		// halt
+  rom_word(ROM_POWER_OFF,0x5201);
+
+  for(i=0; i<sizeof(returns)/sizeof(returns[0]); i++)
+    rom_word(returns[i],0x5470);	// rts
+
+  rom_dispatcher(ROM_OCIA,VEC_OCIA,MEM_VECTORS+2*9);
+  addr=0x0500;
+  for(i=0; i<sizeof(dispatch)/sizeof(dispatch[0]); i++)
+    addr=rom_dispatcher(addr,dispatch[i].vector,
+                        MEM_VECTORS+2*dispatch[i].index);
+}
+
+long mem_load_srec(const char *filename) {
+  FILE *file;
+  char line[2*SREC_DATA_SIZE+16];
+  srec_t srec;
+  long start=-1;
+  int lineno=0,rc,i;
+
+  if((file=fopen(filename,"r"))==NULL) {
+    perror(filename);
+    return -1;
+  }
+
+  while(fgets(line,sizeof(line),file)) {
+    lineno++;
+    if(line[0]!='S')
+      continue;				// blank or symbol lines
+    if((rc=srec_decode(&srec,line))<0) {
+      fprintf(stderr,"%s:%d: %s\n",filename,lineno,srec_strerror(rc));
+      fclose(file);
+      return -1;
+    }
+    if(srec.type>=1 && srec.type<=3)
+      for(i=0; i<srec.count; i++)
+	mem[(srec.addr+i) & 0xffff]=srec.data[i];
+    else if(srec.type>=7 && srec.type<=9)
+      start=srec.addr & 0xffff;
+  }
+
+  fclose(file);
+  if(start<0)
+    start=MEM_ROM_END;			// where firmdl starts the firmware
+  return start;
+}
+
+int mem_dump(const char *filename) {
+  FILE *file;
+
+  if((file=fopen(filename,"wb"))==NULL) {
+    perror(filename);
+    return -1;
+  }
+  if(fwrite(mem,1,sizeof(mem),file)!=sizeof(mem)) {
+    perror(filename);
+    fclose(file);
+    return -1;
+  }
+  return fclose(file) ? -1 : 0;
+}
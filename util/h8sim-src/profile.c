@@ -0,0 +1,273 @@
+/*! \file   profile.c
+    \brief  H8/300 simulator: states per symbol
+*/
+
+/*
+ *  The contents of this file are subject to the Mozilla Public License
+ *  Version 1.0 (the "License"); you may not use this file except in
+ *  compliance with the License. You may obtain a copy of the License at
+ *  http://www.mozilla.org/MPL/
+ *
+ *  Software distributed under the License is distributed on an "AS IS"
+ *  basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ *  License for the specific language governing rights and limitations
+ *  under the License.
+ */
+
+/*
+ *  States are counted per address while running and summed up per
+ *  symbol for the report, so maps can be loaded at any time. Map
+ *  files are nm output as for merge-map ("0000a0b2 T _tm_switcher").
+ *  C symbols and global asm labels (leading underscore) and the
+ *  absolute ROM entries start a range; data symbols end one. Local
+ *  asm labels are ignored, they belong to the function around them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "h8sim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Definitions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define NAME_MAX_LEN	63		//!< longest symbol name kept
+
+//! a symbol from a map
+typedef struct {
+  unsigned short addr;			//!< start address
+  unsigned char code;			//!< 1 if code, 0 if data
+  char name[NAME_MAX_LEN+1];		//!< symbol name
+} symbol_t;
+
+//! a line of the report
+typedef struct {
+  const char *name;			//!< symbol name
+  states_t states;			//!< states spent in the symbol
+  unsigned long insns;			//!< instructions executed
+  unsigned long calls;			//!< calls and interrupts to the start
+} entry_t;
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Internal Variables
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static states_t prof_states[0x10000];	//!< states per address
+static unsigned long prof_insns[0x10000];	//!< instructions per address
+static unsigned long prof_calls[0x10000];	//!< calls per address
+
+static symbol_t *symbols;		//!< symbols, sorted by address
+static int symbol_count;
+static int symbol_size;
+static int symbols_sorted;
+
+static const char unknown[]="<unknown>";	//!< outside of any symbol
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Functions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+void profile_account(unsigned short pc,unsigned states,int insn) {
+  prof_states[pc]+=states;
+  prof_insns[pc]+=insn;
+}
+
+void profile_call(unsigned short addr) {
+  prof_calls[addr]++;
+}
+
+int profile_load_map(const char *filename,long offset) {
+  FILE *file;
+  char line[256],name[NAME_MAX_LEN+1];
+  unsigned long addr;
+  char type;
+  int code;
+
+  if((file=fopen(filename,"r"))==NULL) {
+    perror(filename);
+    return -1;
+  }
+
+  while(fgets(line,sizeof(line),file)) {
+    if(sscanf(line,"%lx %c %63s",&addr,&type,name)!=3)
+      continue;				// undefined symbols have no address
+
+    code=strchr("TtWwAa",type)!=NULL;
+    if(code && name[0]!='_' && type!='A' && type!='a')
+      continue;				// local asm label
+
+    if(symbol_count==symbol_size) {
+      symbol_size=symbol_size ? 2*symbol_size : 1024;
+      symbols=realloc(symbols,symbol_size*sizeof(symbol_t));
+      if(!symbols) {
+	fputs("out of memory\n",stderr);
+	exit(1);
+      }
+    }
+    symbols[symbol_count].addr=(addr+offset) & 0xffff;
+    symbols[symbol_count].code=code;
+    strcpy(symbols[symbol_count].name,name);
+    symbol_count++;
+  }
+
+  fclose(file);
+  symbols_sorted=0;
+  return 0;
+}
+
+//! order by address, code before data, then by name
+static int symbol_cmp(const void *a,const void *b) {
+  const symbol_t *x=a, *y=b;
+
+  if(x->addr!=y->addr)
+    return x->addr<y->addr ? -1 : 1;
+  if(x->code!=y->code)
+    return y->code-x->code;
+  return strcmp(x->name,y->name);
+}
+
+static void symbols_sort(void) {
+  int i,j;
+
+  if(symbols_sorted)
+    return;
+  qsort(symbols,symbol_count,sizeof(symbol_t),symbol_cmp);
+
+  // one symbol per address
+  //
+  for(i=j=0; i<symbol_count; i++)
+    if(!j || symbols[i].addr!=symbols[j-1].addr)
+      symbols[j++]=symbols[i];
+  symbol_count=j;
+  symbols_sorted=1;
+}
+
+//! index of the symbol containing addr, -1 if none
+static int symbol_find(unsigned short addr) {
+  int lo=0, hi=symbol_count-1, mid;
+
+  symbols_sort();
+  if(!symbol_count || addr<symbols[0].addr)
+    return -1;
+  while(lo<hi) {
+    mid=(lo+hi+1)/2;
+    if(symbols[mid].addr<=addr)
+      lo=mid;
+    else
+      hi=mid-1;
+  }
+  return lo;
+}
+
+const char *profile_symbol(unsigned short addr) {
+  int i=symbol_find(addr);
+
+  return (i<0 || !symbols[i].code) ? unknown : symbols[i].name;
+}
+
+//! most states first
+static int entry_cmp(const void *a,const void *b) {
+  const entry_t *x=a, *y=b;
+
+  if(x->states!=y->states)
+    return x->states>y->states ? -1 : 1;
+  return strcmp(x->name,y->name);
+}
+
+//! states of name in a previous report, 0 if not found
+static states_t baseline_states(FILE *file,const char *name) {
+  char line[256],other[NAME_MAX_LEN+1];
+  unsigned long long states;
+  double percent;
+  unsigned long insns,calls;
+
+  rewind(file);
+  while(fgets(line,sizeof(line),file)) {
+    if(line[0]=='#')
+      continue;
+    if(sscanf(line,"%llu %lf %lu %lu %63s",
+	      &states,&percent,&insns,&calls,other)==5
+       && !strcmp(name,other))
+      return states;
+  }
+  return 0;
+}
+
+int profile_report(FILE *out,const char *baseline,double threshold) {
+  entry_t *entries;
+  int count=0, i, sym, cur, regressed=0;
+  FILE *base=NULL;
+  states_t total=0;
+  unsigned long addr;
+
+  symbols_sort();
+  if((entries=calloc(symbol_count+1,sizeof(entry_t)))==NULL) {
+    fputs("out of memory\n",stderr);
+    return -1;
+  }
+  if(baseline && (base=fopen(baseline,"r"))==NULL)
+    perror(baseline);
+
+  // sum up per symbol. symbols and addresses are both ascending.
+  //
+  for(addr=0, sym=-1, cur=-1; addr<0x10000; addr++) {
+    while(sym+1<symbol_count && symbols[sym+1].addr<=addr) {
+      sym++;
+      cur=-1;
+    }
+    if(!prof_states[addr] && !prof_insns[addr] && !prof_calls[addr])
+      continue;
+
+    if(cur<0) {				// <unknown> comes up again and again
+      const char *name=(sym<0 || !symbols[sym].code) ? unknown
+                                                     : symbols[sym].name;
+      for(cur=0; cur<count && entries[cur].name!=name; cur++)
+	;
+      if(cur==count)
+	entries[count++].name=name;
+    }
+    entries[cur].states+=prof_states[addr];
+    entries[cur].insns +=prof_insns[addr];
+    entries[cur].calls +=prof_calls[addr];
+    total+=prof_states[addr];
+  }
+  qsort(entries,count,sizeof(entry_t),entry_cmp);
+
+  fprintf(out,"#%16s %7s %12s %10s  %s%s\n",
+	  "states","%","insns","calls","symbol",base ? "  (vs. baseline)" : "");
+  for(i=0; i<count; i++) {
+    fprintf(out,"%17llu %7.3f %12lu %10lu  %s",
+	    entries[i].states,
+	    total ? 100.0*entries[i].states/total : 0.0,
+	    entries[i].insns,entries[i].calls,entries[i].name);
+    if(base) {
+      states_t old=baseline_states(base,entries[i].name);
+
+      if(!old)
+	fputs("  (new)",out);
+      else {
+	double delta=100.0*((double) entries[i].states-(double) old)/old;
+
+	fprintf(out,"  %+.3f%%",delta);
+	if(delta>threshold) {
+	  fputs("  REGRESSION",out);
+	  regressed=1;
+	}
+      }
+    }
+    fputc('\n',out);
+  }
+
+  if(base)
+    fclose(base);
+  free(entries);
+  return regressed;
+}